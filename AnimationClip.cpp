@@ -0,0 +1,252 @@
+// Keyframe animation clips written by Parker Drake
+#include "AnimationClip.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <math.h>
+#include "Quaternion.h"
+
+static const char CLIP_MAGIC[4] = { 'R', 'C', 'L', 'P' };
+
+AnimationClip::AnimationClip()
+{
+	memset(&header, 0, sizeof(header));
+}
+
+AnimationClip::~AnimationClip()
+{
+}
+
+bool AnimationClip::ValidateHeader(const char* path, size_t fileSize)
+{
+	if (memcmp(header.magic, CLIP_MAGIC, 4) != 0)
+		std::cerr << path << " is not an animation clip" << std::endl;
+	else if (header.version != CLIP_VERSION)
+		std::cerr << path << " has clip version " << header.version << ", expected " << CLIP_VERSION << std::endl;
+	else if (header.jointCount == 0 || header.frameCount == 0 || header.framesPerChunk == 0 || !(header.sampleRate > 0.0f))
+		std::cerr << path << " has an empty or malformed clip header" << std::endl;
+	else if (header.dataOffset < sizeof(ClipHeader) || header.dataOffset % 16 != 0
+		|| fileSize < header.dataOffset + (size_t)header.frameCount * FrameBytes())
+		std::cerr << path << " is truncated" << std::endl;
+	else
+		return true;
+
+	memset(&header, 0, sizeof(header));
+	return false;
+}
+
+void AnimationClip::Sample(double time, Pose& out)
+{
+	int joints = header.jointCount;
+	int frames = header.frameCount;
+	out.Resize(joints);
+
+	double position = fmod(time * header.sampleRate, (double)frames);
+	if (position < 0.0)
+		position += frames;
+	// Times that land on a keyframe return it exactly rather than a blend with weight ~1
+	double nearest = floor(position + 0.5);
+	if (fabs(position - nearest) < 1e-9)
+		position = nearest < frames ? nearest : 0.0;
+
+	int first = (int)position;
+	float alpha = (float)(position - first);
+	const float* a = Frame(first);
+	const float* b = alpha > 0.0f ? Frame((first + 1) % frames) : a;
+
+	if (alpha == 0.0f)
+	{
+		memcpy(&out.translation[0].x, a, joints * sizeof(glm::vec3));
+		memcpy(&out.rotation[0].x, a + joints * 3, joints * sizeof(glm::quat));
+		memcpy(&out.scale[0].x, a + joints * 7, joints * sizeof(glm::vec3));
+		return;
+	}
+
+	float* translation = &out.translation[0].x;
+	float* scale = &out.scale[0].x;
+	for (int i = 0; i < joints * 3; i++)
+	{
+		translation[i] = a[i] + (b[i] - a[i]) * alpha;
+		scale[i] = a[joints * 7 + i] + (b[joints * 7 + i] - a[joints * 7 + i]) * alpha;
+	}
+	QuatBlend::Nlerp((const glm::quat*)(a + joints * 3), (const glm::quat*)(b + joints * 3), alpha, &out.rotation[0], joints);
+}
+
+// MappedClip
+
+bool MappedClip::Open(const char* path)
+{
+	Close();
+	if (!file.Open(path))
+		return false;
+	if (file.Size() < sizeof(ClipHeader))
+	{
+		std::cerr << path << " is truncated" << std::endl;
+		file.Close();
+		return false;
+	}
+	memcpy(&header, file.Data(), sizeof(ClipHeader));
+	if (!ValidateHeader(path, file.Size()))
+	{
+		file.Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedClip::Close()
+{
+	file.Close();
+	memset(&header, 0, sizeof(header));
+}
+
+const float* MappedClip::Frame(int index)
+{
+	return (const float*)(file.Data() + header.dataOffset + index * FrameBytes());
+}
+
+// StreamedClip
+
+StreamedClip::StreamedClip()
+	: file(NULL), useCounter(0), chunkLoads(0)
+{
+}
+
+StreamedClip::~StreamedClip()
+{
+	Close();
+}
+
+bool StreamedClip::Open(const char* path)
+{
+	Close();
+	file = fopen(path, "rb");
+	if (!file)
+	{
+		std::cerr << "Failed to open the file:" << path << std::endl;
+		return false;
+	}
+
+	fseek(file, 0, SEEK_END);
+	size_t fileSize = (size_t)ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if (fread(&header, sizeof(ClipHeader), 1, file) != 1 || !ValidateHeader(path, fileSize))
+	{
+		Close();
+		return false;
+	}
+
+	for (int s = 0; s < 2; s++)
+	{
+		slots[s].chunk = -1;
+		slots[s].lastUse = 0;
+		slots[s].frames.resize(header.framesPerChunk * FrameBytes() / sizeof(float));
+	}
+	return true;
+}
+
+void StreamedClip::Close()
+{
+	if (file)
+		fclose(file);
+	file = NULL;
+	for (int s = 0; s < 2; s++)
+	{
+		slots[s].chunk = -1;
+		std::vector<float>().swap(slots[s].frames);
+	}
+	memset(&header, 0, sizeof(header));
+}
+
+const float* StreamedClip::Frame(int index)
+{
+	int chunk = index / header.framesPerChunk;
+	int offset = index % header.framesPerChunk;
+	size_t frameFloats = FrameBytes() / sizeof(float);
+
+	useCounter++;
+	for (int s = 0; s < 2; s++)
+	{
+		if (slots[s].chunk == chunk)
+		{
+			slots[s].lastUse = useCounter;
+			return &slots[s].frames[offset * frameFloats];
+		}
+	}
+
+	// Replace the chunk used longest ago, which keeps the other half of an interpolation pair resident
+	Slot& slot = slots[0].lastUse <= slots[1].lastUse ? slots[0] : slots[1];
+	int first = chunk * header.framesPerChunk;
+	int count = std::min((int)header.framesPerChunk, (int)header.frameCount - first);
+	fseek(file, (long)(header.dataOffset + first * FrameBytes()), SEEK_SET);
+	if (fread(&slot.frames[0], FrameBytes(), count, file) != (size_t)count)
+		std::cerr << "Failed to read clip chunk " << chunk << std::endl;
+	slot.chunk = chunk;
+	slot.lastUse = useCounter;
+	chunkLoads++;
+	return &slot.frames[offset * frameFloats];
+}
+
+// ClipWriter
+
+ClipWriter::ClipWriter()
+	: file(NULL)
+{
+	memset(&header, 0, sizeof(header));
+}
+
+ClipWriter::~ClipWriter()
+{
+	if (file)
+		Finish();
+}
+
+bool ClipWriter::Begin(const char* path, int jointCount, float sampleRate, unsigned channels, int framesPerChunk)
+{
+	file = fopen(path, "wb");
+	if (!file)
+	{
+		std::cerr << "Failed to open the file:" << path << std::endl;
+		return false;
+	}
+
+	memcpy(header.magic, CLIP_MAGIC, 4);
+	header.version = CLIP_VERSION;
+	header.jointCount = jointCount;
+	header.frameCount = 0;
+	header.sampleRate = sampleRate;
+	header.channels = channels;
+	header.framesPerChunk = framesPerChunk;
+	header.dataOffset = (sizeof(ClipHeader) + 15) & ~15u;
+
+	char padding[16] = { 0 };
+	fwrite(&header, sizeof(ClipHeader), 1, file);
+	fwrite(padding, header.dataOffset - sizeof(ClipHeader), 1, file);
+	frame.resize(jointCount * 10);
+	return true;
+}
+
+void ClipWriter::AddFrame(const Pose& pose)
+{
+	int joints = header.jointCount;
+	if (!file || pose.size() != joints)
+		return;
+	memcpy(&frame[0], &pose.translation[0], joints * sizeof(glm::vec3));
+	memcpy(&frame[joints * 3], &pose.rotation[0], joints * sizeof(glm::quat));
+	memcpy(&frame[joints * 7], &pose.scale[0], joints * sizeof(glm::vec3));
+	fwrite(&frame[0], sizeof(float), frame.size(), file);
+	header.frameCount++;
+}
+
+bool ClipWriter::Finish()
+{
+	if (!file)
+		return false;
+	fseek(file, 0, SEEK_SET);
+	fwrite(&header, sizeof(ClipHeader), 1, file);
+	bool success = !ferror(file);
+	fclose(file);
+	file = NULL;
+	return success;
+}
@@ -0,0 +1,128 @@
+// Keyframe animation clips written by Parker Drake
+#pragma once
+#ifndef _AnimationClip_H_
+#define _AnimationClip_H_
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include "MappedFile.h"
+#include "Pose.h"
+
+// On-disk layout (little-endian), version 2:
+//   ClipHeader
+//   padding up to dataOffset (16-byte aligned)
+//   frameCount frames, each jointCount translations (x, y, z), then jointCount
+//   rotation quaternions (x, y, z, w), then jointCount scales (x, y, z)
+// Version 1 stored rotations as Euler angles and is no longer read.
+// Frames are fixed size so a frame is found by arithmetic alone, and the file
+// can be used straight from a memory mapping. Frames are grouped into chunks
+// of framesPerChunk for streaming.
+struct ClipHeader
+{
+	char magic[4]; // "RCLP"
+	uint32_t version;
+	uint32_t jointCount;
+	uint32_t frameCount;
+	float sampleRate; // Keyframes per second
+	uint32_t channels; // Pose::Channel bits the clip animates
+	uint32_t framesPerChunk;
+	uint32_t dataOffset; // Byte offset of the first frame
+};
+
+static const uint32_t CLIP_VERSION = 2;
+
+// Base for the clip readers. Sampling takes a time in seconds, so playback
+// does not depend on the rate it is sampled at. Clips loop.
+class AnimationClip
+{
+public:
+	AnimationClip();
+	virtual ~AnimationClip();
+
+	const ClipHeader& Header() const { return header; }
+	int JointCount() const { return header.jointCount; }
+	int FrameCount() const { return header.frameCount; }
+	unsigned Channels() const { return header.channels; }
+	double Duration() const { return header.frameCount / (double)header.sampleRate; }
+	bool IsOpen() const { return header.frameCount > 0; }
+
+	// Interpolates the two keyframes around time into out; rotations are nlerped
+	void Sample(double time, Pose& out);
+
+	size_t FrameBytes() const { return header.jointCount * 10 * sizeof(float); }
+
+protected:
+	// Returns keyframe index. The pointer must stay valid until the next call after that.
+	virtual const float* Frame(int index) = 0;
+
+	bool ValidateHeader(const char* path, size_t fileSize);
+
+	ClipHeader header;
+};
+
+// Reads the clip in place from a memory mapping
+class MappedClip : public AnimationClip
+{
+public:
+	bool Open(const char* path);
+	void Close();
+
+protected:
+	const float* Frame(int index);
+
+private:
+	MappedFile file;
+};
+
+// Reads the clip one chunk at a time, keeping two chunks resident so
+// interpolation across a chunk boundary does not reload. Memory use does not
+// grow with the length of the clip.
+class StreamedClip : public AnimationClip
+{
+public:
+	StreamedClip();
+	~StreamedClip();
+
+	bool Open(const char* path);
+	void Close();
+
+	size_t ResidentBytes() const { return slots[0].frames.size() * sizeof(float) * 2; }
+	int ChunkLoads() const { return chunkLoads; }
+
+protected:
+	const float* Frame(int index);
+
+private:
+	struct Slot
+	{
+		int chunk;
+		unsigned lastUse;
+		std::vector<float> frames;
+	};
+
+	FILE* file;
+	Slot slots[2];
+	unsigned useCounter;
+	int chunkLoads;
+};
+
+// Writes a clip one keyframe at a time
+class ClipWriter
+{
+public:
+	ClipWriter();
+	~ClipWriter();
+
+	bool Begin(const char* path, int jointCount, float sampleRate, unsigned channels, int framesPerChunk = 256);
+	void AddFrame(const Pose& pose);
+	// Patches the frame count into the header and closes the file
+	bool Finish();
+
+private:
+	FILE* file;
+	ClipHeader header;
+	std::vector<float> frame;
+};
+
+#endif
@@ -0,0 +1,374 @@
+// Data-driven animation graph written by Parker Drake
+#include "AnimationGraph.h"
+#include "Quaternion.h"
+#include "Skeleton.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+AnimationGraph::AnimationGraph()
+{
+	Clear();
+}
+
+AnimationGraph::~AnimationGraph()
+{
+}
+
+void AnimationGraph::Clear()
+{
+	joints = 0;
+	channels = 0;
+	clips.clear();
+	states.clear();
+	transitions.clear();
+	layers.clear();
+	defaultFade = 0.25f;
+	current = 0;
+	previous = -1;
+	fadeTime = 0.0f;
+	fadeDuration = 0.0f;
+}
+
+int AnimationGraph::FindClip(const std::string& name) const
+{
+	for (size_t i = 0; i < clips.size(); i++)
+		if (clips[i].name == name)
+			return (int)i;
+	return -1;
+}
+
+int AnimationGraph::FindState(const std::string& name) const
+{
+	for (size_t i = 0; i < states.size(); i++)
+		if (states[i].name == name)
+			return (int)i;
+	return -1;
+}
+
+bool AnimationGraph::Load(const char* path, int jointCount)
+{
+	Clear();
+	joints = jointCount;
+
+	std::ifstream ifs(path);
+	if (!ifs)
+	{
+		std::cerr << "Failed to open the animation graph:" << path << std::endl;
+		return false;
+	}
+
+	// Clip paths are relative to the graph file
+	std::string directory(path);
+	size_t slash = directory.find_last_of("/\\");
+	directory = slash == std::string::npos ? "" : directory.substr(0, slash + 1);
+
+	std::map<std::string, std::vector<float> > masks;
+	std::string line;
+	int lineNumber = 0;
+	bool valid = true;
+	while (valid && std::getline(ifs, line))
+	{
+		lineNumber++;
+		line = line.substr(0, line.find('#'));
+		std::istringstream words(line);
+		std::string keyword;
+		if (!(words >> keyword))
+			continue;
+
+		std::string error;
+		if (keyword == "clip")
+		{
+			Clip clip;
+			std::string file;
+			words >> clip.name >> file;
+			clip.clip.reset(new MappedClip);
+			if (file.empty())
+				error = "expected: clip <name> <file>";
+			else if (!clip.clip->Open((directory + file).c_str()))
+				error = "cannot load clip " + file;
+			else if (clip.clip->JointCount() != joints)
+				error = "clip " + file + " does not match the skeleton";
+			else
+			{
+				clip.clip->Sample(0.0, clip.reference);
+				channels |= clip.clip->Channels();
+				clips.push_back(std::move(clip));
+			}
+		}
+		else if (keyword == "mask")
+		{
+			std::string name, joint;
+			words >> name;
+			std::vector<float>& weights = masks[name];
+			weights.assign(joints, 0.0f);
+			while (words >> joint)
+			{
+				int index = atoi(joint.c_str());
+				size_t colon = joint.find(':');
+				if (index < 0 || index >= joints)
+					error = "joint " + joint + " is out of range";
+				else
+					weights[index] = colon == std::string::npos ? 1.0f : (float)atof(joint.c_str() + colon + 1);
+			}
+		}
+		else if (keyword == "state")
+		{
+			State state;
+			std::string clip, option;
+			words >> state.name >> clip;
+			state.clip = FindClip(clip);
+			state.speed = 1.0f;
+			state.time = 0.0;
+			while (words >> option)
+			{
+				if (option == "speed")
+					words >> state.speed;
+				else
+					error = "unknown state option " + option;
+			}
+			if (state.clip < 0)
+				error = "unknown clip " + clip;
+			else
+				states.push_back(state);
+		}
+		else if (keyword == "fade")
+		{
+			if (!(words >> defaultFade))
+				error = "expected: fade <seconds>";
+		}
+		else if (keyword == "transition")
+		{
+			std::string from, to;
+			Transition transition;
+			words >> from >> to >> transition.duration;
+			transition.from = from == "*" ? -1 : FindState(from);
+			transition.to = FindState(to);
+			if (!words || (from != "*" && transition.from < 0) || transition.to < 0)
+				error = "expected: transition <from|*> <to> <seconds> between known states";
+			else
+				transitions.push_back(transition);
+		}
+		else if (keyword == "layer")
+		{
+			Layer layer;
+			std::string clip, mode, option;
+			words >> layer.name >> clip >> mode;
+			layer.clip = FindClip(clip);
+			layer.additive = mode == "additive";
+			layer.mask.assign(joints, 1.0f);
+			layer.weight = layer.target = 1.0f;
+			layer.fade = 0.25f;
+			layer.time = 0.0;
+			while (words >> option)
+			{
+				if (option == "mask")
+				{
+					std::string mask;
+					words >> mask;
+					if (masks.count(mask))
+						layer.mask = masks[mask];
+					else
+						error = "unknown mask " + mask;
+				}
+				else if (option == "weight")
+				{
+					words >> layer.weight;
+					layer.target = layer.weight;
+				}
+				else if (option == "fade")
+					words >> layer.fade;
+				else
+					error = "unknown layer option " + option;
+			}
+			if (layer.clip < 0)
+				error = "unknown clip " + clip;
+			else if (mode != "override" && mode != "additive")
+				error = "layer mode must be override or additive";
+			else
+				layers.push_back(layer);
+		}
+		else
+			error = "unknown statement " + keyword;
+
+		if (!error.empty())
+		{
+			std::cerr << path << ":" << lineNumber << ": " << error << std::endl;
+			valid = false;
+		}
+	}
+
+	if (valid && states.empty())
+	{
+		std::cerr << path << ": the graph has no states" << std::endl;
+		valid = false;
+	}
+	if (!valid)
+	{
+		Clear();
+		return false;
+	}
+
+	output.Resize(joints);
+	fading.Resize(joints);
+	layerPose.Resize(joints);
+	jointAlpha.resize(joints);
+	identity.assign(joints, glm::quat(1, 0, 0, 0));
+	delta.resize(joints);
+	Update(0.0);
+	return true;
+}
+
+float AnimationGraph::FadeTime(int from, int to) const
+{
+	// A transition from this exact state wins over a wildcard one
+	float duration = defaultFade;
+	for (size_t i = 0; i < transitions.size(); i++)
+	{
+		if (transitions[i].to != to)
+			continue;
+		if (transitions[i].from == from)
+			return transitions[i].duration;
+		if (transitions[i].from < 0)
+			duration = transitions[i].duration;
+	}
+	return duration;
+}
+
+bool AnimationGraph::SetState(int state)
+{
+	if (state < 0 || state >= StateCount())
+		return false;
+	if (state == current)
+		return true;
+
+	// A state change during a cross-fade fades out of the newer state only
+	previous = current;
+	current = state;
+	states[current].time = 0.0;
+	fadeTime = 0.0f;
+	fadeDuration = FadeTime(previous, current);
+	if (fadeDuration <= 0.0f)
+		previous = -1;
+	return true;
+}
+
+bool AnimationGraph::SetState(const std::string& name)
+{
+	return SetState(FindState(name));
+}
+
+bool AnimationGraph::SetLayerWeight(const std::string& name, float target)
+{
+	for (int i = 0; i < LayerCount(); i++)
+	{
+		if (layers[i].name == name)
+		{
+			SetLayerWeight(i, target);
+			return true;
+		}
+	}
+	return false;
+}
+
+void AnimationGraph::SetLayerWeight(int layer, float target)
+{
+	layers[layer].target = std::max(0.0f, std::min(1.0f, target));
+	if (layers[layer].fade <= 0.0f)
+		layers[layer].weight = layers[layer].target;
+}
+
+void AnimationGraph::Update(double seconds)
+{
+	if (!IsLoaded())
+		return;
+	PROFILE_SCOPE("Animation graph");
+
+	// Base state, cross-faded from the previous one
+	State& state = states[current];
+	state.time += seconds * state.speed;
+	clips[state.clip].clip->Sample(state.time, output);
+
+	if (previous >= 0)
+	{
+		fadeTime += (float)seconds;
+		if (fadeTime >= fadeDuration)
+			previous = -1;
+	}
+	if (previous >= 0)
+	{
+		State& old = states[previous];
+		old.time += seconds * old.speed;
+		clips[old.clip].clip->Sample(old.time, fading);
+
+		// Eased so the fade starts and ends without a kink
+		float t = fadeTime / fadeDuration;
+		float alpha = t * t * (3.0f - 2.0f * t);
+		for (int j = 0; j < joints; j++)
+		{
+			output.translation[j] = glm::mix(fading.translation[j], output.translation[j], alpha);
+			output.scale[j] = glm::mix(fading.scale[j], output.scale[j], alpha);
+		}
+		QuatBlend::Slerp(&fading.rotation[0], &output.rotation[0], alpha, &output.rotation[0], joints);
+	}
+
+	for (size_t i = 0; i < layers.size(); i++)
+	{
+		Layer& layer = layers[i];
+		float step = layer.fade > 0.0f ? (float)seconds / layer.fade : 1.0f;
+		if (layer.weight < layer.target)
+			layer.weight = std::min(layer.target, layer.weight + step);
+		else
+			layer.weight = std::max(layer.target, layer.weight - step);
+
+		if (layer.weight > 0.0f)
+		{
+			layer.time += seconds;
+			BlendLayer(layer);
+		}
+	}
+}
+
+void AnimationGraph::BlendLayer(Layer& layer)
+{
+	const Clip& clip = clips[layer.clip];
+	unsigned layerChannels = clip.clip->Channels();
+	clip.clip->Sample(layer.time, layerPose);
+	for (int j = 0; j < joints; j++)
+		jointAlpha[j] = layer.weight * layer.mask[j];
+
+	if (!layer.additive)
+	{
+		for (int j = 0; j < joints; j++)
+		{
+			if (layerChannels & Pose::TRANSLATION)
+				output.translation[j] = glm::mix(output.translation[j], layerPose.translation[j], jointAlpha[j]);
+			if (layerChannels & Pose::SCALE)
+				output.scale[j] = glm::mix(output.scale[j], layerPose.scale[j], jointAlpha[j]);
+		}
+		if (layerChannels & Pose::ROTATION)
+			QuatBlend::Nlerp(&output.rotation[0], &layerPose.rotation[0], &jointAlpha[0], &output.rotation[0], joints);
+		return;
+	}
+
+	// Additive: apply the weighted change from the clip's first frame
+	for (int j = 0; j < joints; j++)
+	{
+		if (layerChannels & Pose::TRANSLATION)
+			output.translation[j] += (layerPose.translation[j] - clip.reference.translation[j]) * jointAlpha[j];
+		if (layerChannels & Pose::SCALE)
+			output.scale[j] *= glm::mix(glm::vec3(1.0f), layerPose.scale[j] / clip.reference.scale[j], jointAlpha[j]);
+		delta[j] = glm::conjugate(clip.reference.rotation[j]) * layerPose.rotation[j];
+	}
+	if (layerChannels & Pose::ROTATION)
+	{
+		QuatBlend::Nlerp(&identity[0], &delta[0], &jointAlpha[0], &delta[0], joints);
+		for (int j = 0; j < joints; j++)
+			output.rotation[j] = output.rotation[j] * delta[j];
+	}
+}
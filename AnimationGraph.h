@@ -0,0 +1,121 @@
+// Data-driven animation graph written by Parker Drake
+#pragma once
+#ifndef _AnimationGraph_H_
+#define _AnimationGraph_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "AnimationClip.h"
+#include "Pose.h"
+
+class Skeleton;
+
+// A state machine of clips with cross-fades, plus layers blended on top of it.
+// Graphs are loaded from a text file, one statement per line ('#' starts a comment):
+//
+//   clip <name> <file>                     Clip file, relative to the graph file
+//   mask <name> <joint>[:<weight>] ...     Per-joint layer weights; unlisted joints get 0
+//   state <name> <clip> [speed <s>]        The first state is the initial one
+//   fade <seconds>                         Default cross-fade time
+//   transition <from|*> <to> <seconds>     Cross-fade time for one state change
+//   layer <name> <clip> <override|additive> [mask <m>] [weight <w>] [fade <seconds>]
+//
+// Additive layers add the difference between each frame and the clip's first frame.
+// All pose buffers are allocated by Load; Update does not allocate.
+class AnimationGraph
+{
+public:
+	AnimationGraph();
+	~AnimationGraph();
+
+	// Returns false, with a message naming the line, if the file cannot be used
+	bool Load(const char* path, int jointCount);
+	void Clear();
+	bool IsLoaded() const { return !states.empty(); }
+
+	int StateCount() const { return (int)states.size(); }
+	const std::string& StateName(int state) const { return states[state].name; }
+	int CurrentState() const { return current; }
+	// Cross-fades from the current state to state. Returns false for unknown states.
+	bool SetState(int state);
+	bool SetState(const std::string& name);
+
+	int LayerCount() const { return (int)layers.size(); }
+	const std::string& LayerName(int layer) const { return layers[layer].name; }
+	float LayerWeight(int layer) const { return layers[layer].weight; }
+	// Moves the layer's weight to target over the layer's fade time
+	bool SetLayerWeight(const std::string& name, float target);
+	void SetLayerWeight(int layer, float target);
+
+	// Advances every playing clip by seconds and blends the output pose
+	void Update(double seconds);
+
+	const Pose& Output() const { return output; }
+	unsigned Channels() const { return channels; }
+	void Apply(Skeleton& skeleton) const { output.Apply(skeleton, channels); }
+
+private:
+	struct Clip
+	{
+		std::string name;
+		std::unique_ptr<MappedClip> clip;
+		Pose reference; // First frame, the base of additive layers
+	};
+
+	struct State
+	{
+		std::string name;
+		int clip;
+		float speed;
+		double time;
+	};
+
+	struct Transition
+	{
+		int from; // -1 for any state
+		int to;
+		float duration;
+	};
+
+	struct Layer
+	{
+		std::string name;
+		int clip;
+		bool additive;
+		std::vector<float> mask;
+		float weight;
+		float target;
+		float fade;
+		double time;
+	};
+
+	int FindClip(const std::string& name) const;
+	int FindState(const std::string& name) const;
+	float FadeTime(int from, int to) const;
+
+	void BlendLayer(Layer& layer);
+
+	int joints;
+	unsigned channels;
+	std::vector<Clip> clips;
+	std::vector<State> states;
+	std::vector<Transition> transitions;
+	std::vector<Layer> layers;
+	float defaultFade;
+
+	int current;
+	int previous; // State fading out, -1 when not cross-fading
+	float fadeTime;
+	float fadeDuration;
+
+	// Preallocated working buffers
+	Pose output;
+	Pose fading;
+	Pose layerPose;
+	std::vector<float> jointAlpha;
+	std::vector<glm::quat> identity;
+	std::vector<glm::quat> delta;
+};
+
+#endif
@@ -0,0 +1,246 @@
+// Viewer input handling written by Parker Drake
+#include "Controls.h"
+#include "AnimationGraph.h"
+#include "MatrixStack.h"
+#include "Quaternion.h"
+#include "Robot.h"
+#include "Skeleton.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+InputEvent InputEvent::Cursor(double x, double y)
+{
+	InputEvent event = InputEvent();
+	event.type = CURSOR;
+	event.x = x;
+	event.y = y;
+	return event;
+}
+
+InputEvent InputEvent::Button(int button, bool pressed)
+{
+	InputEvent event = InputEvent();
+	event.type = BUTTON;
+	event.button = button;
+	event.pressed = pressed;
+	return event;
+}
+
+InputEvent InputEvent::Scroll(double y)
+{
+	InputEvent event = InputEvent();
+	event.type = SCROLL;
+	event.y = y;
+	return event;
+}
+
+InputEvent InputEvent::Character(unsigned key)
+{
+	InputEvent event = InputEvent();
+	event.type = CHARACTER;
+	event.key = key;
+	return event;
+}
+
+Controls::Controls()
+	: eye(0.0f, 0.0f, 20.0f), center(0.0f, 0.0f, 0.0f), up(0.0f, 1.0f, 0.0f), limbIndex(0), animate(false), layersEnabled(false),
+	robot(NULL), graph(NULL), index(0), lastx(0.0f), lasty(0.0f), leftPressed(false), rightPressed(false)
+{
+}
+
+void Controls::Attach(Skeleton& r, AnimationGraph* g)
+{
+	robot = &r;
+	graph = g;
+	limbIndex = 0; // Start with the torso selected
+	index = 0;
+}
+
+bool Controls::Handle(const InputEvent& event)
+{
+	switch (event.type)
+	{
+	case InputEvent::CURSOR:
+		Cursor(event.x, event.y);
+		return true;
+	case InputEvent::BUTTON:
+		if (event.button == 0)
+			leftPressed = event.pressed;
+		else if (event.button == 1)
+			rightPressed = event.pressed;
+		return true;
+	case InputEvent::SCROLL:
+		Scroll(event.y);
+		return true;
+	case InputEvent::CHARACTER:
+		return Character(event.key);
+	}
+	return false;
+}
+
+void Controls::Scroll(double offset)
+{
+	glm::vec3 b = eye - center;
+	if (offset == 1)
+	{
+		b /= 1.1;
+	}
+	if (offset == -1)
+	{
+		b *= 1.1;
+	}
+	eye = b + center;
+}
+
+void Controls::Cursor(double xpos, double ypos)
+{
+	if (leftPressed)
+	{
+		// Orbit around center
+		float theta = -0.02 * (xpos - lastx);
+		float phi = -0.02 * (ypos - lasty);
+
+		glm::vec3 b = (eye - center);
+		glm::vec4 b4(b[0], b[1], b[2], 1);
+		glm::vec4 up4(up[0], up[1], up[2], 1);
+
+		glm::vec3 right = glm::normalize(glm::cross(up, b));
+
+		glm::mat4 thetaMat = glm::rotate(glm::mat4(1.0f), theta, up);
+		glm::mat4 phiMat = glm::rotate(glm::mat4(1.0f), phi, right);
+
+		b4 = phiMat * thetaMat * b4;
+		up4 = phiMat * thetaMat * up4;
+
+		b = glm::vec3(b4[0], b4[1], b4[2]);
+		up = glm::vec3(up4[0], up4[1], up4[2]);
+
+		eye = center + b;
+	}
+	if (rightPressed)
+	{
+		// Pan
+		eye[0] += 0.02 * (xpos - lastx);
+		center[0] += 0.02 * (xpos - lastx);
+
+		eye[1] -= 0.02 * (ypos - lasty);
+		center[1] -= 0.02 * (ypos - lasty);
+	}
+
+	lastx = xpos;
+	lasty = ypos;
+}
+
+void Controls::SelectPrevious()
+{
+	if (robot->parent[limbIndex] < 0)
+		return;
+
+	int torso = 0;
+	if (robot->parent[limbIndex] != torso)
+	{
+		limbIndex = robot->parent[limbIndex];
+	}
+	else if (index == 0)
+	{
+		limbIndex = torso;
+	}
+	else
+	{
+		index--;
+		limbIndex = robot->Child(torso, index);
+		if (robot->ChildCount(limbIndex) > 0)
+		{
+			limbIndex = robot->LastChild(limbIndex);
+		}
+	}
+}
+
+void Controls::SelectNext()
+{
+	if (robot->parent[limbIndex] < 0)
+	{
+		limbIndex = robot->Child(limbIndex, index);
+	}
+	else if (robot->ChildCount(limbIndex) > 0)
+	{
+		limbIndex = robot->Child(limbIndex, 0);
+	}
+	else if (index < robot->ChildCount(0) - 1)
+	{
+		index++;
+		limbIndex = robot->Child(0, index);
+	}
+}
+
+bool Controls::Character(unsigned key)
+{
+	switch (key)
+	{
+	case ',':
+	case '.':
+		// The selected limb is drawn 10% larger
+		robot->scaleFactor[limbIndex] /= 1.1;
+		if (key == ',')
+			SelectPrevious();
+		else
+			SelectNext();
+		robot->scaleFactor[limbIndex] *= 1.1;
+		return true;
+	case 'x':
+	case 'X':
+	case 'y':
+	case 'Y':
+	case 'z':
+	case 'Z':
+	{
+		// Lower case turns the selected limb one way around the axis, upper case the other
+		int axis = key == 'x' || key == 'X' ? 0 : key == 'y' || key == 'Y' ? 1 : 2;
+		float angle = key >= 'a' ? -0.1f : 0.1f;
+		robot->SetRotation(limbIndex, AddEulerAngle(robot->rotRelJoint[limbIndex], axis, angle));
+		return true;
+	}
+	case '~':
+		if (!animate)
+		{
+			animate = true;
+			SetRunningStartPose(*robot);
+		}
+		else
+			animate = false;
+		return true;
+	case 'n':
+		// Cross-fade to the next state of the animation graph
+		if (graph && graph->IsLoaded())
+			graph->SetState((graph->CurrentState() + 1) % graph->StateCount());
+		return true;
+	case 'l':
+		// Fade the graph's layers in or out
+		layersEnabled = !layersEnabled;
+		for (int i = 0; graph && i < graph->LayerCount(); i++)
+			graph->SetLayerWeight(i, layersEnabled ? 1.0f : 0.0f);
+		return true;
+	}
+	return false;
+}
+
+void Controls::Simulate(double time, double step)
+{
+	if (!animate)
+		return;
+	if (graph && graph->IsLoaded())
+	{
+		graph->Update(step);
+		graph->Apply(*robot);
+	}
+	else
+		SetRunningPose(*robot, time);
+}
+
+glm::mat4 Controls::ViewProjection(float aspect) const
+{
+	MatrixStack camera;
+	camera.Perspective(glm::radians(60.0f), aspect, 0.1f, 100.0f);
+	camera.LookAt(eye, center, up);
+	return camera.topMatrix();
+}
@@ -0,0 +1,77 @@
+// Viewer input handling written by Parker Drake
+#pragma once
+#ifndef _Controls_H_
+#define _Controls_H_
+
+#include <glm/glm.hpp>
+
+class Skeleton;
+class AnimationGraph;
+
+// One input callback, as the window delivered it
+struct InputEvent
+{
+	enum Type
+	{
+		CURSOR, // x, y: cursor position in screen coordinates
+		BUTTON, // button (0 left, 1 right, 2 middle), pressed
+		SCROLL, // y: wheel offset
+		CHARACTER // key: Unicode code point
+	};
+
+	Type type;
+	double x;
+	double y;
+	int button;
+	bool pressed;
+	unsigned key;
+
+	static InputEvent Cursor(double x, double y);
+	static InputEvent Button(int button, bool pressed);
+	static InputEvent Scroll(double y);
+	static InputEvent Character(unsigned key);
+};
+
+// Everything the viewer's mouse and keyboard change: the orbit camera, the
+// selected limb and the animation toggles, along with the simulation step
+// that animates the robot. It holds no window or GL state, so a recorded
+// session can be replayed headlessly through exactly the same code.
+class Controls
+{
+public:
+	Controls();
+
+	// graph may be NULL, or not loaded, to animate with the procedural running cycle
+	void Attach(Skeleton& robot, AnimationGraph* graph);
+
+	// Returns false for events the controls leave to the caller
+	bool Handle(const InputEvent& event);
+
+	// Advances the robot by one fixed simulation step of length step, ending at time
+	void Simulate(double time, double step);
+
+	glm::mat4 ViewProjection(float aspect) const;
+
+	glm::vec3 eye;
+	glm::vec3 center;
+	glm::vec3 up;
+	int limbIndex; // Selected limb, drawn slightly larger
+	bool animate;
+	bool layersEnabled;
+
+private:
+	void Cursor(double x, double y);
+	void Scroll(double offset);
+	bool Character(unsigned key);
+	void SelectPrevious();
+	void SelectNext();
+
+	Skeleton* robot;
+	AnimationGraph* graph;
+	int index; // Branch of the torso the selection is in
+	float lastx, lasty;
+	bool leftPressed;
+	bool rightPressed;
+};
+
+#endif
@@ -0,0 +1,406 @@
+// Batched crowd evaluation written by Parker Drake
+#include "Crowd.h"
+#include "Robot.h"
+#include "Profiler.h"
+#include "WorkerPool.h"
+#include "JobSystem.h"
+#include "Quaternion.h"
+#include "MatrixKernels.h"
+
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+	const int PROXY_POSES = 16; // Poses of the running cycle the proxy box is fitted around
+	const float LOD_HYSTERESIS = 1.2f; // A coarser instance must grow this much past a threshold to refine again
+
+	glm::mat4 Lerp(const glm::mat4& a, const glm::mat4& b, float alpha)
+	{
+		glm::mat4 out;
+		for (int column = 0; column < 4; column++)
+			out[column] = a[column] + (b[column] - a[column]) * alpha;
+		return out;
+	}
+}
+
+Crowd::Crowd(const Skeleton& r)
+	: rig(r), projected(false), frame(0)
+{
+	SetRunningStartPose(rig);
+	stats = CrowdStats();
+
+	// Fit the proxy around the limbs over one running cycle, in the torso's frame
+	Skeleton pose = rig;
+	Bounds shape;
+	for (int s = 0; s < PROXY_POSES; s++)
+	{
+		SetRunningPose(pose, s * 2.0 * 3.14159265358979323846 / 6.0 / PROXY_POSES);
+		pose.UpdateTransforms(glm::mat4(1.0f));
+		glm::mat4 toTorso = glm::inverse(pose.World(0));
+		for (int i = 0; i < pose.size(); i++)
+			shape.Grow(LimbBounds(toTorso * pose.World(i), pose.scaleFactor[i]));
+	}
+	glm::vec3 center = shape.Center(), extent = shape.Extent();
+	proxyShape = glm::mat4(glm::vec4(extent.x, 0.0f, 0.0f, 0.0f), glm::vec4(0.0f, extent.y, 0.0f, 0.0f),
+		glm::vec4(0.0f, 0.0f, extent.z, 0.0f), glm::vec4(center, 1.0f));
+}
+
+Crowd::~Crowd()
+{
+	for (size_t i = 0; i < scratch.size(); i++)
+		scratchPool.Destroy(scratch[i]);
+}
+
+void Crowd::Add(const CrowdInstance& instance)
+{
+	instances.push_back(instance);
+	dirty.push_back(1);
+	moved.push_back(1);
+}
+
+void Crowd::Reserve(int count)
+{
+	instances.reserve(count);
+	dirty.reserve(count);
+	moved.reserve(count);
+}
+
+void Crowd::Clear()
+{
+	instances.clear();
+	dirty.clear();
+	moved.clear();
+	world.clear();
+	mvp.clear();
+	limbBounds.clear();
+	bounds.clear();
+	proxyMvp.clear();
+	lod.clear();
+}
+
+void Crowd::ChooseLods(const glm::mat4& viewProjection)
+{
+	for (int level = 0; level < LOD_COUNT; level++)
+		lodOrder[level].clear();
+	if (!lodSettings.enabled)
+	{
+		lod.clear();
+		return;
+	}
+
+	int limbs = LimbCount();
+	lod.resize(size(), LOD_FULL);
+	previousLod.resize(size());
+	sampledFrom.resize(size() * limbs);
+	sampledTo.resize(size() * limbs);
+	proxyFrom.resize(size());
+	proxyTo.resize(size());
+	sampleFrame.resize(size());
+
+	// Clip w is the distance along the view direction, and the length of the second
+	// row's linear part the vertical projection scale, for any rigid view matrix
+	glm::vec4 distanceRow(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+	float projectionScale = glm::length(glm::vec3(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1]));
+	const float thresholds[LOD_COUNT - 1] = { lodSettings.reducedBelow, lodSettings.proxyBelow };
+
+	// Every instance is measured by the sphere around the proxy at its root, which
+	// does not change with the level the way the instance's box does
+	float radius = glm::length(glm::vec3(proxyShape[0][0], proxyShape[1][1], proxyShape[2][2]));
+	for (int n = 0; n < size(); n++)
+	{
+		float distance = fabsf(glm::dot(distanceRow, instances[n].root * proxyShape[3]));
+		float screenSize = radius * projectionScale / std::max(distance, radius);
+		int level = LOD_FULL;
+		while (level < LOD_COUNT - 1 && screenSize < thresholds[level] * (level < lod[n] ? LOD_HYSTERESIS : 1.0f))
+			level++;
+		previousLod[n] = lod[n];
+		lod[n] = (unsigned char)level;
+		lodOrder[level].push_back(n);
+	}
+}
+
+void Crowd::UpdateBounds(int n, const Skeleton& skeleton)
+{
+	int limbs = LimbCount();
+	Bounds instanceBounds;
+	for (int i = 0; i < limbs; i++)
+	{
+		limbBounds[n * limbs + i] = LimbBounds(world[n * limbs + i], skeleton.scaleFactor[i]);
+		instanceBounds.Grow(limbBounds[n * limbs + i]);
+	}
+	bounds[n] = instanceBounds;
+	moved[n] = 1;
+}
+
+void Crowd::EvaluateFull(int n, double time, const glm::mat4& viewProjection, bool cameraMoved, Scratch& local)
+{
+	int limbs = LimbCount();
+	const CrowdInstance& instance = instances[n];
+	if (instance.animated || dirty[n])
+	{
+		SetRunningPose(local.skeleton, instance.animated ? time + instance.phase : instance.phase, instance.frequency);
+		local.evaluator.Evaluate(local.skeleton, instance.root, viewProjection, &world[n * limbs], &mvp[n * limbs]);
+		local.stats.posed++;
+		local.stats.jointsRecomputed += local.skeleton.Recomputed();
+		local.stats.jointsReused += local.skeleton.Reused();
+		local.stats.lodSampled[LOD_FULL]++;
+		dirty[n] = 0;
+		UpdateBounds(n, local.skeleton);
+	}
+	else
+	{
+		// Coming back from a proxy, the limb matrices hold an old camera
+		if (cameraMoved || (!lod.empty() && previousLod[n] == LOD_PROXY))
+		{
+			local.evaluator.Project(rig, viewProjection, &world[n * limbs], &mvp[n * limbs]);
+			local.stats.projected++;
+		}
+		else
+			local.stats.skipped++;
+		local.stats.jointsReused += limbs;
+	}
+}
+
+void Crowd::EvaluateReduced(int n, double time, const glm::mat4& viewProjection, Scratch& local)
+{
+	int limbs = LimbCount();
+	const CrowdInstance& instance = instances[n];
+	glm::mat4* from = &sampledFrom[n * limbs];
+	glm::mat4* to = &sampledTo[n * limbs];
+	int interval = std::max(1, lodSettings.reducedInterval);
+
+	// Samples are staggered across instances so each frame poses about the same number
+	int previous = previousLod[n];
+	if (previous != LOD_REDUCED || dirty[n] || (frame + n) % interval == 0)
+	{
+		SetRunningPose(local.skeleton, time + instance.phase, instance.frequency);
+		local.skeleton.UpdateTransforms(instance.root);
+		for (int i = 0; i < limbs; i++)
+		{
+			// Blend on from where the instance was last drawn; a proxy's limbs are stale
+			from[i] = previous == LOD_FULL ? world[n * limbs + i] : previous == LOD_PROXY ? local.skeleton.World(i) : to[i];
+			to[i] = local.skeleton.World(i);
+		}
+		local.stats.posed++;
+		local.stats.jointsRecomputed += local.skeleton.Recomputed();
+		local.stats.jointsReused += local.skeleton.Reused();
+		local.stats.lodSampled[LOD_REDUCED]++;
+		sampleFrame[n] = frame;
+		dirty[n] = 0;
+
+		// Blended cube corners stay between the two samples' corners, so until the
+		// next sample every limb stays inside the union of its two boxes
+		Bounds instanceBounds;
+		for (int i = 0; i < limbs; i++)
+		{
+			Bounds limb = LimbBounds(from[i], local.skeleton.scaleFactor[i]);
+			limb.Grow(LimbBounds(to[i], local.skeleton.scaleFactor[i]));
+			limbBounds[n * limbs + i] = limb;
+			instanceBounds.Grow(limb);
+		}
+		bounds[n] = instanceBounds;
+		moved[n] = 1;
+	}
+	else
+		local.stats.jointsReused += limbs;
+
+	// Reach the latest sample just before the next one is taken
+	float alpha = std::min(1.0f, (frame - sampleFrame[n] + 1) / (float)interval);
+	for (int i = 0; i < limbs; i++)
+		world[n * limbs + i] = Lerp(from[i], to[i], alpha);
+	local.evaluator.Project(local.skeleton, viewProjection, &world[n * limbs], &mvp[n * limbs]);
+}
+
+void Crowd::EvaluateProxy(int n, double time, const glm::mat4& viewProjection, bool cameraMoved, Scratch& local)
+{
+	const CrowdInstance& instance = instances[n];
+	int interval = std::max(1, lodSettings.proxyInterval);
+
+	if (!instance.animated && !dirty[n])
+	{
+		// The torso of a standing instance is already posed
+		if (previousLod[n] != LOD_PROXY)
+			proxyFrom[n] = proxyTo[n] = world[n * LimbCount()] * proxyShape;
+		else if (!cameraMoved)
+		{
+			local.stats.skipped++;
+			return;
+		}
+		proxyMvp[n] = viewProjection * proxyTo[n];
+		local.stats.projected++;
+		return;
+	}
+
+	bool entered = previousLod[n] != LOD_PROXY;
+	if (entered || dirty[n] || (frame + n) % interval == 0)
+	{
+		// Only the torso is evaluated: root * torso joint * proxy box
+		SetRunningPose(local.skeleton, instance.animated ? time + instance.phase : instance.phase, instance.frequency);
+		glm::mat4 torso, torsoWorld;
+		ComposeAffine(local.skeleton.rotRelJoint[0], local.skeleton.transRelParent[0], glm::vec3(1.0f), local.skeleton.transRelJoint[0], torso);
+		MatrixKernels::MultiplyAffine(glm::value_ptr(instance.root), glm::value_ptr(torso), glm::value_ptr(torsoWorld));
+		proxyFrom[n] = proxyTo[n];
+		proxyTo[n] = torsoWorld * proxyShape;
+		if (entered || !instance.animated)
+			proxyFrom[n] = proxyTo[n];
+		local.stats.posed++;
+		local.stats.jointsRecomputed++;
+		local.stats.lodSampled[LOD_PROXY]++;
+		sampleFrame[n] = frame;
+		dirty[n] = 0;
+	}
+
+	float alpha = std::min(1.0f, (frame - sampleFrame[n] + 1) / (float)interval);
+	glm::mat4 proxyWorld = Lerp(proxyFrom[n], proxyTo[n], alpha);
+	proxyMvp[n] = viewProjection * proxyWorld;
+	bounds[n] = LimbBounds(proxyWorld, glm::vec3(1.0f));
+	moved[n] = 1;
+	local.stats.jointsReused += LimbCount() - 1;
+}
+
+void Crowd::Evaluate(double time, const glm::mat4& viewProjection, WorkerPool& pool)
+{
+	EvaluateOn(time, viewProjection, pool);
+}
+
+void Crowd::Evaluate(double time, const glm::mat4& viewProjection, JobSystem& jobs)
+{
+	EvaluateOn(time, viewProjection, jobs);
+}
+
+template <typename Pool>
+void Crowd::EvaluateOn(double time, const glm::mat4& viewProjection, Pool& pool)
+{
+	PROFILE_SCOPE("Crowd");
+	int limbs = LimbCount();
+	world.resize(instances.size() * limbs);
+	mvp.resize(instances.size() * limbs);
+	limbBounds.resize(instances.size() * limbs);
+	bounds.resize(instances.size());
+	proxyMvp.resize(instances.size());
+
+	// Only the animated channels are rewritten per instance, so a worker's copy never carries state between instances
+	while ((int)scratch.size() < pool.ThreadCount())
+	{
+		scratch.push_back(scratchPool.Create());
+		scratch.back()->skeleton = rig;
+	}
+
+	bool cameraMoved = !projected || viewProjection != lastViewProjection;
+	lastViewProjection = viewProjection;
+	projected = true;
+
+	for (size_t i = 0; i < scratch.size(); i++)
+		scratch[i]->stats = CrowdStats();
+
+	// One pass per level, so each level's cost can be measured on its own
+	ChooseLods(viewProjection);
+	stats = CrowdStats();
+	for (int level = 0; level < LOD_COUNT; level++)
+	{
+		const int* order = lod.empty() ? NULL : (lodOrder[level].empty() ? NULL : &lodOrder[level][0]);
+		int count = lod.empty() ? (level == LOD_FULL ? size() : 0) : (int)lodOrder[level].size();
+		stats.lodInstances[level] = count;
+		if (count == 0)
+			continue;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		pool.ParallelFor(count, 0, [&](int begin, int end, int worker)
+		{
+			PROFILE_SCOPE("Crowd batch");
+			Scratch& local = *scratch[worker];
+			for (int k = begin; k < end; k++)
+			{
+				int n = order ? order[k] : k;
+				if (level == LOD_FULL || (level == LOD_REDUCED && !instances[n].animated))
+					EvaluateFull(n, time, viewProjection, cameraMoved, local);
+				else if (level == LOD_REDUCED)
+					EvaluateReduced(n, time, viewProjection, local);
+				else
+					EvaluateProxy(n, time, viewProjection, cameraMoved, local);
+			}
+		});
+		stats.lodSeconds[level] = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+	frame++;
+
+	for (size_t i = 0; i < scratch.size(); i++)
+	{
+		stats.posed += scratch[i]->stats.posed;
+		stats.projected += scratch[i]->stats.projected;
+		stats.skipped += scratch[i]->stats.skipped;
+		stats.jointsRecomputed += scratch[i]->stats.jointsRecomputed;
+		stats.jointsReused += scratch[i]->stats.jointsReused;
+		for (int level = 0; level < LOD_COUNT; level++)
+			stats.lodSampled[level] += scratch[i]->stats.lodSampled[level];
+	}
+
+	// Refit above the instances that moved; rebuild when instances were added or the refit boxes grew loose
+	if (hierarchy.ObjectCount() != size())
+		hierarchy.Build(bounds.empty() ? NULL : &bounds[0], size());
+	else
+	{
+		for (int n = 0; n < size(); n++)
+		{
+			if (moved[n])
+				hierarchy.Update(n, bounds[n]);
+		}
+		hierarchy.Refit();
+		if (hierarchy.Looseness() > 1.5f)
+			hierarchy.Build(&bounds[0], size());
+	}
+	std::fill(moved.begin(), moved.end(), 0);
+}
+
+void Crowd::Gather(std::vector<glm::mat4>& out) const
+{
+	int limbs = LimbCount();
+	out.clear();
+	for (int n = 0; n < size(); n++)
+	{
+		if (Lod(n) == LOD_PROXY)
+			out.push_back(proxyMvp[n]);
+		else
+			out.insert(out.end(), mvp.begin() + n * limbs, mvp.begin() + (n + 1) * limbs);
+	}
+}
+
+void Crowd::Cull(const Frustum& frustum, std::vector<glm::mat4>& visible, CullStats& stats)
+{
+	PROFILE_SCOPE("Culling");
+	int limbs = LimbCount();
+	visible.clear();
+	hierarchy.Cull(frustum, inside, intersecting, stats);
+
+	// Instances inside the frustum draw every limb; only those crossing a plane test their limbs
+	std::sort(inside.begin(), inside.end());
+	std::sort(intersecting.begin(), intersecting.end());
+	size_t a = 0, b = 0;
+	while (a < inside.size() || b < intersecting.size())
+	{
+		bool crossing = a == inside.size() || (b < intersecting.size() && intersecting[b] < inside[a]);
+		int n = crossing ? intersecting[b++] : inside[a++];
+		if (Lod(n) == LOD_PROXY)
+		{
+			// The instance's box is the proxy's, already tested
+			visible.push_back(proxyMvp[n]);
+			continue;
+		}
+		if (!crossing)
+		{
+			visible.insert(visible.end(), mvp.begin() + n * limbs, mvp.begin() + (n + 1) * limbs);
+			continue;
+		}
+		for (int i = 0; i < limbs; i++)
+		{
+			stats.limbsTested++;
+			if (frustum.Classify(limbBounds[n * limbs + i]) != CULL_OUTSIDE)
+				visible.push_back(mvp[n * limbs + i]);
+			else
+				stats.limbsCulled++;
+		}
+	}
+}
@@ -0,0 +1,154 @@
+// Batched crowd evaluation written by Parker Drake
+#pragma once
+#ifndef _Crowd_H_
+#define _Crowd_H_
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Skeleton.h"
+#include "PoseEvaluator.h"
+#include "Culling.h"
+#include "Memory.h"
+
+class WorkerPool;
+class JobSystem;
+
+// One robot in the crowd
+struct CrowdInstance
+{
+	float phase; // Time offset into the running cycle, in seconds
+	float frequency; // Running cycle frequency
+	glm::mat4 root; // Placement of the robot's torso in the world
+	bool animated = true; // Static robots hold the pose at phase and are only re-evaluated when marked dirty
+};
+
+// Levels of detail, nearest first
+enum CrowdLod
+{
+	LOD_FULL, // Every joint posed every frame, one cube per limb
+	LOD_REDUCED, // Every joint posed every few frames and interpolated in between, one cube per limb
+	LOD_PROXY, // Only the torso posed every few frames, drawn as one box around the whole robot
+	LOD_COUNT
+};
+
+// When instances drop to cheaper levels. Screen size is the radius of an
+// instance's box over its distance, scaled by the projection: roughly the
+// fraction of the viewport height it covers.
+struct LodSettings
+{
+	bool enabled = false;
+	float reducedBelow = 0.1f; // Screen size under which LOD_REDUCED is used
+	float proxyBelow = 0.03f; // Screen size under which LOD_PROXY is used
+	int reducedInterval = 2; // Frames between poses at LOD_REDUCED
+	int proxyInterval = 4; // Frames between poses at LOD_PROXY
+};
+
+// Work done by the last Crowd::Evaluate
+struct CrowdStats
+{
+	int posed; // Instances whose joints were recomputed
+	int projected; // Static instances whose cached world transforms were reprojected for a new camera
+	int skipped; // Static instances left untouched
+	long long jointsRecomputed;
+	long long jointsReused;
+	int lodInstances[LOD_COUNT]; // Instances at each level
+	int lodSampled[LOD_COUNT]; // Instances at each level whose pose was sampled this frame
+	double lodSeconds[LOD_COUNT]; // Wall time spent evaluating each level
+};
+
+// Poses many copies of one skeleton. Output matrices for every instance are
+// kept in one contiguous buffer, instance-major: limb i of instance n lives
+// at index n * LimbCount() + i. The buffers double as a cache: static instances
+// keep their matrices until they are marked dirty or the camera moves.
+// Every limb and instance also keeps a world space box, and a hierarchy over
+// the instance boxes, refit as they move, lets Cull skip whole groups at once.
+//
+// With level of detail enabled, instances at LOD_PROXY leave their limb
+// matrices stale; draw through Gather or Cull, which pick each instance's level.
+class Crowd
+{
+public:
+	explicit Crowd(const Skeleton& rig);
+	~Crowd();
+
+	int LimbCount() const { return rig.size(); }
+	int size() const { return (int)instances.size(); }
+
+	void Add(const CrowdInstance& instance);
+	// Makes room for count instances, so adding them does not reallocate
+	void Reserve(int count);
+	void Clear();
+	// Call after changing instances[n]
+	void MarkDirty(int n) { dirty[n] = 1; }
+
+	void SetLod(const LodSettings& settings) { lodSettings = settings; }
+	const LodSettings& GetLod() const { return lodSettings; }
+	CrowdLod Lod(int instance) const { return lod.empty() ? LOD_FULL : (CrowdLod)lod[instance]; }
+
+	// Poses every animated or dirty instance with the running cycle at time and fills world and mvp
+	void Evaluate(double time, const glm::mat4& viewProjection, WorkerPool& pool);
+	// Same, with the instances split between the job system's threads
+	void Evaluate(double time, const glm::mat4& viewProjection, JobSystem& jobs);
+	const CrowdStats& GetStats() const { return stats; }
+
+	// Fills out with the matrices to draw a unit cube with: one per limb, or one per proxy
+	void Gather(std::vector<glm::mat4>& out) const;
+	// Same as Gather, leaving out instances and limbs outside the frustum, in instance order
+	void Cull(const Frustum& frustum, std::vector<glm::mat4>& visible, CullStats& stats);
+
+	const glm::mat4* World(int instance) const { return &world[instance * LimbCount()]; }
+	const glm::mat4* MVP(int instance) const { return &mvp[instance * LimbCount()]; }
+
+	std::vector<CrowdInstance> instances;
+	std::vector<glm::mat4> world;
+	std::vector<glm::mat4> mvp;
+	std::vector<Bounds> limbBounds; // Same layout as world
+	std::vector<Bounds> bounds; // Per instance, around its limbs
+	std::vector<glm::mat4> proxyMvp; // Per instance, valid at LOD_PROXY
+
+private:
+	Crowd(const Crowd&);
+	Crowd& operator=(const Crowd&);
+
+	// Each worker poses instances in its own copy of the rig
+	struct Scratch
+	{
+		Skeleton skeleton;
+		PoseEvaluator evaluator;
+		CrowdStats stats;
+	};
+
+	// Evaluate on either kind of pool; both split index ranges the same way
+	template <typename Pool>
+	void EvaluateOn(double time, const glm::mat4& viewProjection, Pool& pool);
+	// Picks each instance's level from last frame's boxes and sorts the instances by level
+	void ChooseLods(const glm::mat4& viewProjection);
+	void EvaluateFull(int n, double time, const glm::mat4& viewProjection, bool cameraMoved, Scratch& local);
+	void EvaluateReduced(int n, double time, const glm::mat4& viewProjection, Scratch& local);
+	void EvaluateProxy(int n, double time, const glm::mat4& viewProjection, bool cameraMoved, Scratch& local);
+	void UpdateBounds(int n, const Skeleton& skeleton);
+
+	Skeleton rig;
+	ObjectPool<Scratch> scratchPool; // Pads each worker's scratch to its own cache lines
+	std::vector<Scratch*> scratch;
+	std::vector<unsigned char> dirty;
+	std::vector<unsigned char> moved; // Posed by the last Evaluate, so its box changed
+	BoundingVolumeHierarchy hierarchy;
+	std::vector<int> inside, intersecting;
+	glm::mat4 lastViewProjection;
+	bool projected; // lastViewProjection holds the camera of the cached mvp matrices
+	CrowdStats stats;
+
+	// Level of detail
+	LodSettings lodSettings;
+	long long frame;
+	std::vector<unsigned char> lod; // Per instance, empty while disabled
+	std::vector<unsigned char> previousLod; // Level in the frame before, to tell when an instance changes level
+	std::vector<int> lodOrder[LOD_COUNT]; // Instances at each level
+	std::vector<glm::mat4> sampledFrom, sampledTo; // LOD_REDUCED: the last two poses sampled, per limb
+	std::vector<glm::mat4> proxyFrom, proxyTo; // LOD_PROXY: the last two proxy boxes sampled, per instance
+	std::vector<long long> sampleFrame; // Frame of each instance's last sample
+	glm::mat4 proxyShape; // Unit cube to a box around the running robot, in the torso's frame
+};
+
+#endif
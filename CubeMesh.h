@@ -0,0 +1,12 @@
+// Cube geometry shared by the GL and software renderers written by Parker Drake
+#pragma once
+#ifndef _CubeMesh_H_
+#define _CubeMesh_H_
+
+// Unit cube spanning [-1, 1] on each axis as 12 triangles, one color per axis
+const int CUBE_VERTEX_COUNT = 36;
+const int CUBE_VERTEX_STRIDE = 6; // x, y, z, r, g, b
+
+extern const float cubeVertices[CUBE_VERTEX_COUNT * CUBE_VERTEX_STRIDE];
+
+#endif
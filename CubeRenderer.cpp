@@ -0,0 +1,30 @@
+// Cube draw interface written by Parker Drake
+#include "CubeRenderer.h"
+
+#include <cstring>
+
+size_t CubeInstanceLayout::Stride()
+{
+	return sizeof(glm::vec4) * 4;
+}
+
+size_t CubeInstanceLayout::ColumnOffset(int column)
+{
+	return sizeof(glm::vec4) * column;
+}
+
+size_t CubeInstanceLayout::RegionOffset(int region, int capacity)
+{
+	return Stride() * capacity * region;
+}
+
+size_t CubeInstanceLayout::Pack(const glm::mat4* mvp, int count, int region, int capacity, void* buffer)
+{
+	unsigned char* out = static_cast<unsigned char*>(buffer) + RegionOffset(region, capacity);
+	for (int i = 0; i < count; i++)
+	{
+		for (int column = 0; column < 4; column++)
+			memcpy(out + i * Stride() + ColumnOffset(column), &mvp[i][column][0], sizeof(glm::vec4));
+	}
+	return Stride() * count;
+}
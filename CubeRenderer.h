@@ -0,0 +1,39 @@
+// Cube draw interface written by Parker Drake
+#pragma once
+#ifndef _CubeRenderer_H_
+#define _CubeRenderer_H_
+
+#include <cstddef>
+#include <glm/glm.hpp>
+
+// Draws one unit cube (see CubeMesh.h) per MVP matrix. Implemented by the GL
+// renderers and by the software rasterizer.
+class CubeRenderer
+{
+public:
+	virtual ~CubeRenderer() {}
+	virtual const char* Name() const = 0;
+	virtual void Draw(const glm::mat4* mvp, int count) = 0;
+};
+
+// Layout of the instanced renderer's buffer: a ring of regions of capacity
+// instances each, and per instance the MVP's four columns, one per location
+// of the instanceMVP attribute. The renderer takes its buffer size, region
+// offsets and attribute stride and offsets from here, and packs through
+// Pack, so the layout can be checked headless against what GL will read.
+struct CubeInstanceLayout
+{
+	static const int REGIONS = 3; // Regions of the persistently mapped ring
+
+	// Bytes from one instance to the next, the stride of every column attribute
+	static size_t Stride();
+	// Byte offset in an instance of the column read by location instanceMVP + column
+	static size_t ColumnOffset(int column);
+	// Byte offset of a region of capacity instances; RegionOffset(REGIONS, capacity) is the ring's size
+	static size_t RegionOffset(int region, int capacity);
+
+	// Writes count MVPs into region of the ring at buffer. Returns the bytes written.
+	static size_t Pack(const glm::mat4* mvp, int count, int region, int capacity, void* buffer);
+};
+
+#endif
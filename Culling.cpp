@@ -0,0 +1,313 @@
+// Frustum culling and bounding volume hierarchy written by Parker Drake
+#include "Culling.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULLING_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define CULLING_NEON
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+	const int LEAF_SIZE = 4; // Objects per leaf
+}
+
+void Bounds::Grow(const Bounds& other)
+{
+	min = glm::min(min, other.min);
+	max = glm::max(max, other.max);
+}
+
+float Bounds::SurfaceArea() const
+{
+	if (IsEmpty())
+		return 0.0f;
+	glm::vec3 size = max - min;
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+Bounds LimbBounds(const glm::mat4& world, const glm::vec3& scale)
+{
+	// The cube's half extent along each world axis is the absolute linear part times the scale
+	glm::vec3 extent = glm::abs(glm::vec3(world[0])) * scale.x + glm::abs(glm::vec3(world[1])) * scale.y + glm::abs(glm::vec3(world[2])) * scale.z;
+	glm::vec3 center(world[3]);
+	Bounds bounds;
+	bounds.min = center - extent;
+	bounds.max = center + extent;
+	return bounds;
+}
+
+Frustum::Frustum()
+{
+	Set(glm::mat4(1.0f));
+}
+
+Frustum::Frustum(const glm::mat4& viewProjection)
+{
+	Set(viewProjection);
+}
+
+void Frustum::Set(const glm::mat4& m)
+{
+	// Clip space planes -w <= x, y, z <= w, as rows of the matrix: left, right, bottom, top, near, far
+	glm::vec4 rows[4];
+	for (int r = 0; r < 4; r++)
+		rows[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+	glm::vec4 planes[6] = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[3] + rows[2], rows[3] - rows[2] };
+
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec4 plane = planes[std::min(i, 5)];
+		float length = glm::length(glm::vec3(plane));
+		if (length > 0.0f)
+			plane *= 1.0f / length;
+		x[i] = plane.x;
+		y[i] = plane.y;
+		z[i] = plane.z;
+		w[i] = plane.w;
+	}
+}
+
+CullResult Frustum::ClassifyReference(const Bounds& bounds) const
+{
+	glm::vec3 center = bounds.Center(), extent = bounds.Extent();
+	CullResult result = CULL_INSIDE;
+	for (int i = 0; i < 6; i++)
+	{
+		float distance = x[i] * center.x + y[i] * center.y + z[i] * center.z + w[i];
+		float radius = fabsf(x[i]) * extent.x + fabsf(y[i]) * extent.y + fabsf(z[i]) * extent.z;
+		if (distance < -radius)
+			return CULL_OUTSIDE;
+		if (distance < radius)
+			result = CULL_INTERSECTS;
+	}
+	return result;
+}
+
+#if defined(CULLING_SSE)
+CullResult Frustum::Classify(const Bounds& bounds) const
+{
+	glm::vec3 center = bounds.Center(), extent = bounds.Extent();
+	__m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+	__m128 ex = _mm_set1_ps(extent.x), ey = _mm_set1_ps(extent.y), ez = _mm_set1_ps(extent.z);
+	__m128 signMask = _mm_set1_ps(-0.0f);
+	int outside = 0, crossing = 0;
+	for (int i = 0; i < 8; i += 4)
+	{
+		__m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+		__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, cx), _mm_mul_ps(py, cy)), _mm_add_ps(_mm_mul_ps(pz, cz), _mm_loadu_ps(w + i)));
+		__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, px), ex), _mm_mul_ps(_mm_andnot_ps(signMask, py), ey)),
+			_mm_mul_ps(_mm_andnot_ps(signMask, pz), ez));
+		outside |= _mm_movemask_ps(_mm_cmplt_ps(distance, _mm_xor_ps(radius, signMask)));
+		crossing |= _mm_movemask_ps(_mm_cmplt_ps(distance, radius));
+	}
+	return outside ? CULL_OUTSIDE : crossing ? CULL_INTERSECTS : CULL_INSIDE;
+}
+#elif defined(CULLING_NEON)
+CullResult Frustum::Classify(const Bounds& bounds) const
+{
+	glm::vec3 center = bounds.Center(), extent = bounds.Extent();
+	uint32x4_t outside = vdupq_n_u32(0), crossing = vdupq_n_u32(0);
+	for (int i = 0; i < 8; i += 4)
+	{
+		float32x4_t px = vld1q_f32(x + i), py = vld1q_f32(y + i), pz = vld1q_f32(z + i);
+		float32x4_t distance = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vld1q_f32(w + i), px, center.x), py, center.y), pz, center.z);
+		float32x4_t radius = vmlaq_n_f32(vmlaq_n_f32(vmulq_n_f32(vabsq_f32(px), extent.x), vabsq_f32(py), extent.y), vabsq_f32(pz), extent.z);
+		outside = vorrq_u32(outside, vcltq_f32(distance, vnegq_f32(radius)));
+		crossing = vorrq_u32(crossing, vcltq_f32(distance, radius));
+	}
+	uint32x2_t o = vorr_u32(vget_low_u32(outside), vget_high_u32(outside));
+	uint32x2_t c = vorr_u32(vget_low_u32(crossing), vget_high_u32(crossing));
+	if (vget_lane_u32(o, 0) | vget_lane_u32(o, 1))
+		return CULL_OUTSIDE;
+	return vget_lane_u32(c, 0) | vget_lane_u32(c, 1) ? CULL_INTERSECTS : CULL_INSIDE;
+}
+#else
+CullResult Frustum::Classify(const Bounds& bounds) const
+{
+	return ClassifyReference(bounds);
+}
+#endif
+
+const char* Frustum::Name()
+{
+#if defined(CULLING_SSE)
+	return "SSE";
+#elif defined(CULLING_NEON)
+	return "NEON";
+#else
+	return "scalar";
+#endif
+}
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+	: anyStale(false), builtArea(0.0f)
+{
+}
+
+void BoundingVolumeHierarchy::Build(const Bounds* objects, int count)
+{
+	objectBounds.assign(objects, objects + count);
+	order.resize(count);
+	for (int i = 0; i < count; i++)
+		order[i] = i;
+	leafOf.assign(count, 0);
+	nodes.clear();
+	if (count > 0)
+		BuildNode(-1, 0, count);
+	stale.assign(nodes.size(), 0);
+	anyStale = false;
+	builtArea = TotalArea();
+}
+
+int BoundingVolumeHierarchy::BuildNode(int parent, int begin, int end)
+{
+	int index = (int)nodes.size();
+	nodes.push_back(Node());
+	nodes[index].parent = parent;
+
+	Bounds bounds, centers;
+	for (int i = begin; i < end; i++)
+	{
+		const Bounds& object = objectBounds[order[i]];
+		bounds.Grow(object);
+		Bounds center;
+		center.min = center.max = object.Center();
+		centers.Grow(center);
+	}
+	nodes[index].bounds = bounds;
+
+	if (end - begin <= LEAF_SIZE)
+	{
+		nodes[index].first = begin;
+		nodes[index].count = end - begin;
+		for (int i = begin; i < end; i++)
+			leafOf[order[i]] = index;
+		return index;
+	}
+
+	glm::vec3 spread = centers.max - centers.min;
+	int axis = spread.x >= spread.y && spread.x >= spread.z ? 0 : spread.y >= spread.z ? 1 : 2;
+	int middle = (begin + end) / 2;
+	std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [&](int a, int b)
+	{
+		return objectBounds[a].Center()[axis] < objectBounds[b].Center()[axis];
+	});
+
+	BuildNode(index, begin, middle);
+	int right = BuildNode(index, middle, end);
+	nodes[index].first = right;
+	nodes[index].count = 0;
+	return index;
+}
+
+void BoundingVolumeHierarchy::Update(int object, const Bounds& bounds)
+{
+	objectBounds[object] = bounds;
+	stale[leafOf[object]] = 1;
+	anyStale = true;
+}
+
+void BoundingVolumeHierarchy::Refit()
+{
+	if (!anyStale)
+		return;
+
+	// Children come after their parent, so one backward pass refits bottom up
+	for (int i = (int)nodes.size() - 1; i >= 0; i--)
+	{
+		if (!stale[i])
+			continue;
+		Node& node = nodes[i];
+		Bounds bounds;
+		if (node.count > 0)
+		{
+			for (int k = node.first; k < node.first + node.count; k++)
+				bounds.Grow(objectBounds[order[k]]);
+		}
+		else
+		{
+			bounds = nodes[i + 1].bounds;
+			bounds.Grow(nodes[node.first].bounds);
+		}
+		node.bounds = bounds;
+		stale[i] = 0;
+		if (node.parent >= 0)
+			stale[node.parent] = 1;
+	}
+	anyStale = false;
+}
+
+float BoundingVolumeHierarchy::TotalArea() const
+{
+	float total = 0.0f;
+	for (size_t i = 0; i < nodes.size(); i++)
+		total += nodes[i].bounds.SurfaceArea();
+	return total;
+}
+
+float BoundingVolumeHierarchy::Looseness() const
+{
+	return builtArea > 0.0f ? TotalArea() / builtArea : 1.0f;
+}
+
+void BoundingVolumeHierarchy::AddAll(int node, std::vector<int>& out) const
+{
+	const Node& n = nodes[node];
+	if (n.count > 0)
+		out.insert(out.end(), order.begin() + n.first, order.begin() + n.first + n.count);
+	else
+	{
+		AddAll(node + 1, out);
+		AddAll(n.first, out);
+	}
+}
+
+void BoundingVolumeHierarchy::Cull(const Frustum& frustum, std::vector<int>& inside, std::vector<int>& intersecting, CullStats& stats) const
+{
+	inside.clear();
+	intersecting.clear();
+	if (nodes.empty())
+		return;
+
+	int stack[64];
+	int depth = 0;
+	stack[depth++] = 0;
+	while (depth > 0)
+	{
+		int index = stack[--depth];
+		const Node& node = nodes[index];
+		stats.nodesTested++;
+		CullResult result = frustum.Classify(node.bounds);
+		if (result == CULL_OUTSIDE)
+			continue;
+		if (result == CULL_INSIDE)
+		{
+			// Nothing below can cross a plane
+			AddAll(index, inside);
+			continue;
+		}
+		if (node.count == 0)
+		{
+			stack[depth++] = node.first;
+			stack[depth++] = index + 1;
+			continue;
+		}
+		for (int k = node.first; k < node.first + node.count; k++)
+		{
+			int object = order[k];
+			stats.instancesTested++;
+			result = frustum.Classify(objectBounds[object]);
+			if (result == CULL_INSIDE)
+				inside.push_back(object);
+			else if (result == CULL_INTERSECTS)
+				intersecting.push_back(object);
+		}
+	}
+	stats.instancesCulled += ObjectCount() - (int)(inside.size() + intersecting.size());
+}
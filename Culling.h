@@ -0,0 +1,113 @@
+// Frustum culling and bounding volume hierarchy written by Parker Drake
+#pragma once
+#ifndef _Culling_H_
+#define _Culling_H_
+
+#include <vector>
+#include <cfloat>
+#include <glm/glm.hpp>
+
+// Axis-aligned box; starts empty and grows to fit what is added to it
+struct Bounds
+{
+	glm::vec3 min;
+	glm::vec3 max;
+
+	Bounds() : min(FLT_MAX), max(-FLT_MAX) {}
+
+	bool IsEmpty() const { return min.x > max.x; }
+	void Grow(const Bounds& other);
+	glm::vec3 Center() const { return (min + max) * 0.5f; }
+	glm::vec3 Extent() const { return (max - min) * 0.5f; }
+	float SurfaceArea() const;
+};
+
+// Box around the unit cube drawn for a limb, world * scale(scaleFactor) applied to [-1, 1]^3
+Bounds LimbBounds(const glm::mat4& world, const glm::vec3& scale);
+
+enum CullResult
+{
+	CULL_OUTSIDE,
+	CULL_INTERSECTS,
+	CULL_INSIDE
+};
+
+// The six clip planes of a view-projection matrix, tested four at a time
+// with SSE or NEON where available
+class Frustum
+{
+public:
+	Frustum();
+	explicit Frustum(const glm::mat4& viewProjection);
+
+	void Set(const glm::mat4& viewProjection);
+	CullResult Classify(const Bounds& bounds) const;
+	// One plane at a time, for checking the SIMD path
+	CullResult ClassifyReference(const Bounds& bounds) const;
+
+	// Instruction set used by Classify
+	static const char* Name();
+
+private:
+	// Planes as structure of arrays, normals pointing inside, padded to eight by repeating the far plane
+	float x[8], y[8], z[8], w[8];
+};
+
+// Objects tested and culled by the last culling pass
+struct CullStats
+{
+	int nodesTested;
+	int instancesTested;
+	int instancesCulled;
+	int limbsTested;
+	int limbsCulled;
+
+	CullStats() : nodesTested(0), instancesTested(0), instancesCulled(0), limbsTested(0), limbsCulled(0) {}
+};
+
+// Binary tree of boxes over a set of objects, built once and refit in place
+// as the objects move. Only the nodes above updated objects are refit; Build
+// again when Looseness() says the refit boxes overlap too much.
+class BoundingVolumeHierarchy
+{
+public:
+	BoundingVolumeHierarchy();
+
+	// Splits at the median of each node's longest axis, down to a few objects per leaf
+	void Build(const Bounds* objects, int count);
+	int ObjectCount() const { return (int)objectBounds.size(); }
+
+	// Replaces an object's box; the nodes above it are refit by the next Refit()
+	void Update(int object, const Bounds& bounds);
+	void Refit();
+
+	// Total node surface area now relative to the last build; 1 right after Build
+	float Looseness() const;
+
+	// Sorts the objects that are not culled into those fully inside the
+	// frustum and those crossing one of its planes
+	void Cull(const Frustum& frustum, std::vector<int>& inside, std::vector<int>& intersecting, CullStats& stats) const;
+
+private:
+	struct Node
+	{
+		Bounds bounds;
+		int first; // Leaves: first entry in order. Inner nodes: index of the right child, the left one follows the node
+		int count; // Objects in a leaf, 0 for inner nodes
+		int parent;
+	};
+
+	int BuildNode(int parent, int begin, int end);
+	void AddAll(int node, std::vector<int>& out) const;
+	float TotalArea() const;
+
+	std::vector<Node> nodes; // Depth first, so children come after their parent
+	std::vector<int> order; // Objects grouped by leaf
+	std::vector<int> leafOf; // Leaf node holding each object
+	std::vector<Bounds> objectBounds;
+	std::vector<unsigned char> stale; // Node needs refitting
+	bool anyStale;
+	float builtArea;
+};
+
+#endif
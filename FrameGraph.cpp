@@ -0,0 +1,81 @@
+// Frame stages as a dependency graph written by Parker Drake
+#include "FrameGraph.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+
+#include <chrono>
+#include <iostream>
+
+int FrameGraph::AddStage(const char* name, const std::function<void(JobSystem&)>& work, const std::vector<int>& dependencies)
+{
+	int index = (int)stages.size();
+	Stage stage;
+	stage.name = name;
+	stage.work = work;
+	stage.seconds = 0.0;
+	stage.graph = this;
+	stage.index = index;
+	for (size_t i = 0; i < dependencies.size(); i++)
+	{
+		if (dependencies[i] < 0 || dependencies[i] >= index)
+		{
+			std::cerr << "Frame stage " << name << " depends on stage " << dependencies[i] << ", which has not been added" << std::endl;
+			continue;
+		}
+		stage.dependencies.push_back(dependencies[i]);
+		stages[dependencies[i]].dependents.push_back(index);
+	}
+	stages.push_back(stage);
+	return index;
+}
+
+void FrameGraph::Clear()
+{
+	stages.clear();
+}
+
+void FrameGraph::Run(JobSystem& jobs)
+{
+	if ((int)waiting.size() != StageCount())
+		waiting = std::vector<std::atomic<int>>(StageCount());
+	for (int i = 0; i < StageCount(); i++)
+		waiting[i] = (int)stages[i].dependencies.size();
+
+	// Every stage is a child of the frame job, so waiting on it waits for all of them
+	this->jobs = &jobs;
+	frame = jobs.Create(NULL, NULL);
+	for (int i = 0; i < StageCount(); i++)
+	{
+		if (stages[i].dependencies.empty())
+			Launch(i);
+	}
+	jobs.Run(frame);
+	jobs.Wait(frame);
+	this->jobs = NULL;
+	frame = NULL;
+}
+
+void FrameGraph::Launch(int index)
+{
+	jobs->Run(jobs->Create(&FrameGraph::RunStage, &stages[index], frame));
+}
+
+void FrameGraph::RunStage(void* data)
+{
+	Stage& stage = *static_cast<Stage*>(data);
+	FrameGraph& graph = *stage.graph;
+	auto start = std::chrono::high_resolution_clock::now();
+	{
+		PROFILE_SCOPE(stage.name);
+		stage.work(*graph.jobs);
+	}
+	stage.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+	// Start the stages this was the last dependency of, before this job
+	// finishes and lets the frame job finish
+	for (size_t i = 0; i < stage.dependents.size(); i++)
+	{
+		if (graph.waiting[stage.dependents[i]].fetch_sub(1) == 1)
+			graph.Launch(stage.dependents[i]);
+	}
+}
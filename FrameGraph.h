@@ -0,0 +1,66 @@
+// Frame stages as a dependency graph written by Parker Drake
+#pragma once
+#ifndef _FrameGraph_H_
+#define _FrameGraph_H_
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+class JobSystem;
+struct Job;
+
+// The stages of a frame, such as input, animation, world transforms, culling
+// and command building, and which stages each one needs finished first. Run()
+// starts every stage as a job as soon as its dependencies are done, so stages
+// that do not depend on each other overlap, and each stage can split its own
+// work with JobSystem::ParallelFor.
+class FrameGraph
+{
+public:
+	FrameGraph() : jobs(NULL), frame(NULL) {}
+
+	// Stages may only depend on stages added before them, which keeps the graph acyclic.
+	// name is kept by pointer and handed to the profiler, so it must outlive the
+	// profile: pass a string literal. Returns the stage's index.
+	int AddStage(const char* name, const std::function<void(JobSystem&)>& work, const std::vector<int>& dependencies = std::vector<int>());
+	void Clear();
+
+	// Runs every stage once and returns when all are done
+	void Run(JobSystem& jobs);
+
+	int StageCount() const { return (int)stages.size(); }
+	const char* StageName(int stage) const { return stages[stage].name; }
+	const std::vector<int>& Dependencies(int stage) const { return stages[stage].dependencies; }
+	// Wall time of the stage in the last Run()
+	double StageSeconds(int stage) const { return stages[stage].seconds; }
+
+private:
+	// Every stage points back at its graph
+	FrameGraph(const FrameGraph&);
+	FrameGraph& operator=(const FrameGraph&);
+
+	struct Stage
+	{
+		const char* name;
+		std::function<void(JobSystem&)> work;
+		std::vector<int> dependencies;
+		std::vector<int> dependents;
+		double seconds;
+
+		// What the stage's job needs, kept here so starting it does not allocate
+		FrameGraph* graph;
+		int index;
+	};
+
+	static void RunStage(void* stage);
+	void Launch(int stage);
+
+	std::vector<Stage> stages;
+	std::vector<std::atomic<int>> waiting; // Per stage, dependencies not finished yet in this Run()
+	JobSystem* jobs; // During Run()
+	Job* frame; // Parent of every stage's job during Run()
+};
+
+#endif
@@ -0,0 +1,106 @@
+// Frame pacing and per-stage time budgets written by Parker Drake
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+FramePacer::FramePacer(double framesPerSecond)
+	: frames(0)
+{
+	SetRate(framesPerSecond);
+	for (int i = 0; i < STAGE_COUNT; i++)
+		overruns[i] = 0;
+	deadline = Clock::now() + period;
+}
+
+void FramePacer::SetRate(double framesPerSecond)
+{
+	period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond));
+}
+
+void FramePacer::BeginFrame()
+{
+	frames++;
+}
+
+double FramePacer::Limit(Stage stage) const
+{
+	switch (stage)
+	{
+	case STAGE_INPUT: return budget.input;
+	case STAGE_SIMULATION: return budget.simulation;
+	default: return budget.render;
+	}
+}
+
+bool FramePacer::EndStage(Stage stage, double seconds)
+{
+	if (seconds <= Limit(stage))
+		return true;
+	overruns[stage]++;
+	return false;
+}
+
+bool FramePacer::WithinBudget(Stage stage, double elapsed) const
+{
+	return elapsed < Limit(stage);
+}
+
+void FramePacer::WaitForNextFrame()
+{
+	Clock::time_point now = Clock::now();
+	if (now < deadline)
+	{
+		std::this_thread::sleep_until(deadline);
+		deadline += period;
+	}
+	else
+	{
+		// Missed the deadline: start a fresh cadence from now
+		deadline = now + period;
+	}
+}
+
+LatencyStats::LatencyStats(size_t capacity)
+	: capacity(capacity > 0 ? capacity : 1), count(0), sum(0.0), max(0.0), random(1)
+{
+	samples.reserve(this->capacity);
+}
+
+void LatencyStats::Add(double seconds)
+{
+	count++;
+	sum += seconds;
+	max = count == 1 ? seconds : std::max(max, seconds);
+	if (samples.size() < capacity)
+	{
+		samples.push_back(seconds);
+		return;
+	}
+
+	// Keep the new sample with probability capacity / count, in place of a random one
+	random = random * 6364136223846793005ULL + 1442695040888963407ULL;
+	unsigned long long slot = (random >> 33) % (unsigned long long)count;
+	if (slot < capacity)
+		samples[slot] = seconds;
+}
+
+void LatencyStats::Clear()
+{
+	samples.clear();
+	count = 0;
+	sum = 0.0;
+	max = 0.0;
+}
+
+double LatencyStats::Percentile(double fraction) const
+{
+	if (samples.empty())
+		return 0.0;
+	std::vector<double> sorted(samples);
+	size_t rank = (size_t)std::ceil(fraction * sorted.size());
+	rank = rank > 0 ? rank - 1 : 0;
+	std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+	return sorted[rank];
+}
@@ -0,0 +1,89 @@
+// Frame pacing and per-stage time budgets written by Parker Drake
+#pragma once
+#ifndef _FramePacer_H_
+#define _FramePacer_H_
+
+#include <chrono>
+#include <vector>
+
+// Seconds each part of a frame may take before it counts as an overrun
+struct FrameBudget
+{
+	double input;
+	double simulation;
+	double render;
+
+	FrameBudget() : input(0.002), simulation(0.004), render(0.008) {}
+};
+
+// Keeps frames on a fixed cadence by sleeping until the next deadline instead
+// of spinning. Used when vsync is not available to pace the swap.
+class FramePacer
+{
+public:
+	explicit FramePacer(double framesPerSecond = 60.0);
+
+	enum Stage
+	{
+		STAGE_INPUT,
+		STAGE_SIMULATION,
+		STAGE_RENDER,
+		STAGE_COUNT
+	};
+
+	void SetRate(double framesPerSecond);
+	FrameBudget& Budget() { return budget; }
+
+	// Marks the start of a frame
+	void BeginFrame();
+	// Records how long a stage took; returns false if it went over its budget
+	bool EndStage(Stage stage, double seconds);
+	// True while stage still has time left in the current frame
+	bool WithinBudget(Stage stage, double elapsed) const;
+	// Sleeps until the next frame deadline. Late frames move the deadline instead of trying to catch up.
+	void WaitForNextFrame();
+
+	long long Frames() const { return frames; }
+	long long Overruns(Stage stage) const { return overruns[stage]; }
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	double Limit(Stage stage) const;
+
+	FrameBudget budget;
+	Clock::duration period;
+	Clock::time_point deadline;
+	long long frames;
+	long long overruns[STAGE_COUNT];
+};
+
+// Latency samples, such as the time from an input event to the swap that
+// first shows it, summarized when the session ends. The count, mean and
+// maximum cover every sample; percentiles come from a uniform reservoir of
+// at most capacity samples, allocated up front, so adding one every frame of
+// a long session never touches the heap.
+class LatencyStats
+{
+public:
+	explicit LatencyStats(size_t capacity = 4096);
+
+	void Add(double seconds);
+	void Clear();
+
+	size_t Count() const { return (size_t)count; }
+	double Mean() const { return count > 0 ? sum / count : 0.0; }
+	double Max() const { return max; }
+	// Nearest-rank percentile, fraction in [0, 1]; 0 without samples
+	double Percentile(double fraction) const;
+
+private:
+	std::vector<double> samples;
+	size_t capacity;
+	long long count;
+	double sum;
+	double max;
+	unsigned long long random; // Picks which samples the reservoir keeps once it is full
+};
+
+#endif
@@ -0,0 +1,172 @@
+// OpenGL cube draw paths written by Parker Drake
+#include "GLCubeRenderer.h"
+#include "Profiler.h"
+
+#include <iostream>
+
+PerLimbCubeRenderer::PerLimbCubeRenderer(Program& p, const GLMesh& c)
+	: program(p), cube(c)
+{
+	mvpUniform = program.GetUniformHandle("mvp");
+}
+
+void PerLimbCubeRenderer::Draw(const glm::mat4* mvp, int count)
+{
+	// Uploads and draws interleave here, so both count as draw submission
+	PROFILE_SCOPE("Draw submission");
+	program.Bind();
+	glBindVertexArray(cube.VertexArray());
+	for (int i = 0; i < count; i++)
+	{
+		program.SendUniformData(mvp[i], mvpUniform);
+		cube.Draw();
+	}
+	GLVertexArray::Unbind();
+	program.Unbind();
+}
+
+InstancedCubeRenderer::InstancedCubeRenderer()
+	: cube(NULL), mvpAttribute(-1), persistent(false), capacity(0), region(0), mapped(NULL)
+{
+	for (int i = 0; i < REGIONS; i++)
+		fences[i] = 0;
+}
+
+InstancedCubeRenderer::~InstancedCubeRenderer()
+{
+	ReleaseBuffer();
+}
+
+bool InstancedCubeRenderer::Init(const GLMesh& cubeMesh)
+{
+	mvpAttribute = program.GetAttributeLocation("instanceMVP");
+	if (mvpAttribute < 0)
+	{
+		std::cerr << "Instanced shader has no instanceMVP attribute" << std::endl;
+		return false;
+	}
+
+	persistent = GLEW_ARB_buffer_storage != 0;
+
+	// The cube's vertex attributes and indices are captured once in the vertex array
+	cube = &cubeMesh;
+	vertexArray.Bind();
+	cube->BindAttributes(program);
+
+	// A mat4 attribute takes four consecutive locations, one per column
+	for (int column = 0; column < 4; column++)
+	{
+		glEnableVertexAttribArray(mvpAttribute + column);
+		glVertexAttribDivisor(mvpAttribute + column, 1);
+	}
+	GLVertexArray::Unbind();
+	return true;
+}
+
+void InstancedCubeRenderer::ReleaseBuffer()
+{
+	for (int i = 0; i < REGIONS; i++)
+	{
+		if (fences[i])
+			glDeleteSync(fences[i]);
+		fences[i] = 0;
+	}
+	if (mapped)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer.Id());
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	}
+	instanceBuffer.Release();
+	mapped = NULL;
+	capacity = 0;
+}
+
+void InstancedCubeRenderer::Reserve(int count)
+{
+	if (count <= capacity)
+		return;
+
+	// Grow geometrically so a growing crowd does not reallocate every frame
+	int newCapacity = capacity > 0 ? capacity : 64;
+	while (newCapacity < count)
+		newCapacity *= 2;
+
+	ReleaseBuffer();
+	capacity = newCapacity;
+
+	if (persistent)
+	{
+		// Immutable storage, mapped once for the buffer's lifetime
+		GLsizeiptr size = CubeInstanceLayout::RegionOffset(REGIONS, capacity);
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		instanceBuffer.Storage(GL_ARRAY_BUFFER, size, flags);
+		mapped = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+		if (!mapped)
+		{
+			// Fall back to orphaning for the rest of the run
+			std::cerr << "Unable to map the instance buffer persistently" << std::endl;
+			persistent = false;
+			instanceBuffer.Release();
+		}
+	}
+	if (!persistent)
+	{
+		instanceBuffer.Data(GL_ARRAY_BUFFER, CubeInstanceLayout::RegionOffset(1, capacity), NULL, GL_STREAM_DRAW);
+		packed.resize(CubeInstanceLayout::RegionOffset(1, capacity));
+	}
+}
+
+void InstancedCubeRenderer::BindInstanceAttributes(size_t offset)
+{
+	for (int column = 0; column < 4; column++)
+	{
+		glVertexAttribPointer(mvpAttribute + column, 4, GL_FLOAT, GL_FALSE, (GLsizei)CubeInstanceLayout::Stride(),
+			(void*)(offset + CubeInstanceLayout::ColumnOffset(column)));
+	}
+}
+
+size_t InstancedCubeRenderer::Upload(const glm::mat4* mvp, int count)
+{
+	PROFILE_SCOPE("Instance upload");
+	Reserve(count);
+
+	if (!persistent)
+	{
+		// Orphan last frame's storage so the driver can hand out fresh memory without a stall
+		size_t bytes = CubeInstanceLayout::Pack(mvp, count, 0, capacity, &packed[0]);
+		instanceBuffer.Data(GL_ARRAY_BUFFER, CubeInstanceLayout::RegionOffset(1, capacity), NULL, GL_STREAM_DRAW);
+		instanceBuffer.SubData(GL_ARRAY_BUFFER, 0, bytes, &packed[0]);
+		return 0;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer.Id());
+
+	// Wait only if the GPU is still reading this region from REGIONS frames ago
+	region = (region + 1) % REGIONS;
+	if (fences[region])
+	{
+		glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		glDeleteSync(fences[region]);
+		fences[region] = 0;
+	}
+	GLBuffer::CountUpload(CubeInstanceLayout::Pack(mvp, count, region, capacity, mapped));
+	return CubeInstanceLayout::RegionOffset(region, capacity);
+}
+
+void InstancedCubeRenderer::Draw(const glm::mat4* mvp, int count)
+{
+	if (count <= 0 || !cube)
+		return;
+
+	vertexArray.Bind();
+	BindInstanceAttributes(Upload(mvp, count));
+
+	PROFILE_SCOPE("Draw submission");
+	program.Bind();
+	cube->DrawInstanced(count);
+	program.Unbind();
+
+	if (persistent)
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	GLVertexArray::Unbind();
+}
@@ -0,0 +1,71 @@
+// OpenGL cube draw paths written by Parker Drake
+#pragma once
+#ifndef _GLCubeRenderer_H_
+#define _GLCubeRenderer_H_
+
+#include <GL/glew.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Program.h"
+#include "CubeRenderer.h"
+#include "GLMesh.h"
+
+// One uniform upload and one indexed draw per cube
+class PerLimbCubeRenderer : public CubeRenderer
+{
+public:
+	// cube must be set up for program and outlive the renderer
+	PerLimbCubeRenderer(Program& program, const GLMesh& cube);
+
+	const char* Name() const { return "per-limb"; }
+	void Draw(const glm::mat4* mvp, int count);
+
+private:
+	Program& program;
+	const GLMesh& cube;
+	UniformHandle mvpUniform;
+};
+
+// Every cube in a single instanced draw. MVPs are streamed into a ring of
+// persistently mapped buffer regions guarded by fences, or into an orphaned
+// buffer when GL_ARB_buffer_storage is missing, so the CPU never waits on
+// the GPU still reading last frame's matrices.
+class InstancedCubeRenderer : public CubeRenderer
+{
+public:
+	InstancedCubeRenderer();
+	~InstancedCubeRenderer();
+
+	// Built by the caller, before Init
+	Program& GetProgram() { return program; }
+	// Draws cube, which must outlive the renderer
+	bool Init(const GLMesh& cube);
+
+	const char* Name() const { return persistent ? "instanced (persistent)" : "instanced (orphaned)"; }
+	void Draw(const glm::mat4* mvp, int count);
+
+private:
+	static const int REGIONS = CubeInstanceLayout::REGIONS;
+
+	void Reserve(int count);
+	void ReleaseBuffer();
+	// Packs the matrices into the instance buffer and returns their byte offset
+	size_t Upload(const glm::mat4* mvp, int count);
+	// Points the per-instance attributes at byte offset in the instance buffer
+	void BindInstanceAttributes(size_t offset);
+
+	Program program;
+	const GLMesh* cube;
+	GLVertexArray vertexArray;
+	GLBuffer instanceBuffer;
+	GLint mvpAttribute;
+	bool persistent;
+
+	int capacity; // Matrices per region
+	int region;
+	unsigned char* mapped;
+	std::vector<unsigned char> packed; // Staging for the orphaned buffer
+	GLsync fences[REGIONS];
+};
+
+#endif
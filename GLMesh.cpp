@@ -0,0 +1,163 @@
+// OpenGL buffers, vertex arrays and meshes written by Parker Drake
+#include "GLMesh.h"
+#include "Program.h"
+
+#include <iostream>
+
+long long GLBuffer::uploaded = 0;
+
+GLBuffer& GLBuffer::operator=(GLBuffer&& other)
+{
+	if (this != &other)
+	{
+		Release();
+		id = other.id;
+		size = other.size;
+		other.id = 0;
+		other.size = 0;
+	}
+	return *this;
+}
+
+void GLBuffer::Data(GLenum target, size_t bytes, const void* data, GLenum usage)
+{
+	if (!id)
+		glGenBuffers(1, &id);
+	glBindBuffer(target, id);
+	glBufferData(target, bytes, data, usage);
+	size = bytes;
+	if (data)
+		uploaded += bytes;
+}
+
+void GLBuffer::Storage(GLenum target, size_t bytes, GLbitfield flags)
+{
+	if (!id)
+		glGenBuffers(1, &id);
+	glBindBuffer(target, id);
+	glBufferStorage(target, bytes, NULL, flags);
+	size = bytes;
+}
+
+void GLBuffer::SubData(GLenum target, size_t offset, size_t bytes, const void* data)
+{
+	glBindBuffer(target, id);
+	glBufferSubData(target, offset, bytes, data);
+	uploaded += bytes;
+}
+
+void GLBuffer::Release()
+{
+	if (id)
+		glDeleteBuffers(1, &id);
+	id = 0;
+	size = 0;
+}
+
+GLVertexArray& GLVertexArray::operator=(GLVertexArray&& other)
+{
+	if (this != &other)
+	{
+		Release();
+		id = other.id;
+		other.id = 0;
+	}
+	return *this;
+}
+
+void GLVertexArray::Bind()
+{
+	if (!id)
+		glGenVertexArrays(1, &id);
+	glBindVertexArray(id);
+}
+
+void GLVertexArray::Release()
+{
+	if (id)
+		glDeleteVertexArrays(1, &id);
+	id = 0;
+}
+
+GLMesh::GLMesh()
+	: indexCount(0), indexType(GL_UNSIGNED_SHORT)
+{
+}
+
+bool GLMesh::Init(const PackedMesh& mesh, const Program& program)
+{
+	Release();
+	if (mesh.vertices.empty() || mesh.indices.empty())
+	{
+		std::cerr << "Unable to upload an empty mesh" << std::endl;
+		return false;
+	}
+
+	layout = mesh.layout;
+	vertexBuffer.Data(GL_ARRAY_BUFFER, mesh.VertexBytes(), &mesh.vertices[0], GL_STATIC_DRAW);
+	indexCount = (int)mesh.indices.size();
+	if (mesh.ShortIndices())
+	{
+		std::vector<unsigned short> shortIndices(mesh.indices.begin(), mesh.indices.end());
+		indexType = GL_UNSIGNED_SHORT;
+		indexBuffer.Data(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned short) * shortIndices.size(), &shortIndices[0], GL_STATIC_DRAW);
+	}
+	else
+	{
+		indexType = GL_UNSIGNED_INT;
+		indexBuffer.Data(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned) * mesh.indices.size(), &mesh.indices[0], GL_STATIC_DRAW);
+	}
+
+	vertexArray.Bind();
+	BindAttributes(program);
+	GLVertexArray::Unbind();
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return true;
+}
+
+void GLMesh::Release()
+{
+	vertexArray.Release();
+	vertexBuffer.Release();
+	indexBuffer.Release();
+	indexCount = 0;
+}
+
+void GLMesh::BindAttributes(const Program& program) const
+{
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer.Id());
+	for (size_t i = 0; i < layout.attributes.size(); i++)
+	{
+		const VertexLayout::Attribute& attribute = layout.attributes[i];
+		GLint location = program.GetAttributeLocation(attribute.name);
+		if (location < 0)
+			continue;
+
+		// Packed values reach the shader as floats: normalized to [0, 1] or
+		// [-1, 1], or as the plain integers for joint indices
+		GLint size = 4;
+		GLenum type = GL_UNSIGNED_BYTE;
+		GLboolean normalized = GL_TRUE;
+		switch (attribute.format)
+		{
+		case FORMAT_FLOAT3: size = 3; type = GL_FLOAT; normalized = GL_FALSE; break;
+		case FORMAT_HALF3: size = 3; type = GL_HALF_FLOAT; normalized = GL_FALSE; break;
+		case FORMAT_SNORM_10_10_10_2: type = GL_INT_2_10_10_10_REV; break;
+		case FORMAT_UNORM8x4: break;
+		case FORMAT_UINT8x4: normalized = GL_FALSE; break;
+		}
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, size, type, normalized, layout.stride, (void*)(size_t)attribute.offset);
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer.Id());
+}
+
+void GLMesh::Draw() const
+{
+	glDrawElements(GL_TRIANGLES, indexCount, indexType, 0);
+}
+
+void GLMesh::DrawInstanced(int instances) const
+{
+	glDrawElementsInstanced(GL_TRIANGLES, indexCount, indexType, 0, instances);
+}
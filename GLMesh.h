@@ -0,0 +1,103 @@
+// OpenGL buffers, vertex arrays and meshes written by Parker Drake
+#pragma once
+#ifndef _GLMesh_H_
+#define _GLMesh_H_
+
+#include <GL/glew.h>
+#include <cstddef>
+#include "VertexFormat.h"
+
+class Program;
+
+// Owns one buffer object, deleted with it. Moves, but does not copy. Every
+// upload through it is counted, so Uploaded() is the total sent to the GPU.
+class GLBuffer
+{
+public:
+	GLBuffer() : id(0), size(0) {}
+	~GLBuffer() { Release(); }
+	GLBuffer(GLBuffer&& other) : id(other.id), size(other.size) { other.id = 0; other.size = 0; }
+	GLBuffer& operator=(GLBuffer&& other);
+
+	// Creates the buffer on first use and (re)allocates its storage
+	void Data(GLenum target, size_t bytes, const void* data, GLenum usage);
+	// Immutable storage (GL_ARB_buffer_storage); the buffer must not have any yet
+	void Storage(GLenum target, size_t bytes, GLbitfield flags);
+	void SubData(GLenum target, size_t offset, size_t bytes, const void* data);
+	void Release();
+
+	GLuint Id() const { return id; }
+	size_t Size() const { return size; }
+
+	// For writes that bypass glBufferData, such as persistently mapped memory
+	static void CountUpload(size_t bytes) { uploaded += bytes; }
+	static long long Uploaded() { return uploaded; }
+
+private:
+	GLBuffer(const GLBuffer&);
+	GLBuffer& operator=(const GLBuffer&);
+
+	GLuint id;
+	size_t size; // Bytes allocated
+	static long long uploaded;
+};
+
+// Owns one vertex array object
+class GLVertexArray
+{
+public:
+	GLVertexArray() : id(0) {}
+	~GLVertexArray() { Release(); }
+	GLVertexArray(GLVertexArray&& other) : id(other.id) { other.id = 0; }
+	GLVertexArray& operator=(GLVertexArray&& other);
+
+	// Creates the vertex array on first use and binds it
+	void Bind();
+	static void Unbind() { glBindVertexArray(0); }
+	void Release();
+
+	GLuint Id() const { return id; }
+
+private:
+	GLVertexArray(const GLVertexArray&);
+	GLVertexArray& operator=(const GLVertexArray&);
+
+	GLuint id;
+};
+
+// A PackedMesh in GPU memory: one interleaved vertex buffer, an index buffer
+// with 16-bit indices where they fit, and a vertex array matching a program.
+class GLMesh
+{
+public:
+	GLMesh();
+
+	// Uploads the mesh and sets up a vertex array for the program's attributes
+	bool Init(const PackedMesh& mesh, const Program& program);
+	void Release();
+
+	// Points the bound vertex array at the attributes the program takes from
+	// this mesh, and at the index buffer. For vertex arrays that mix the mesh
+	// with other buffers.
+	void BindAttributes(const Program& program) const;
+
+	// Draw with VertexArray(), or a vertex array set up by BindAttributes, bound
+	void Draw() const;
+	void DrawInstanced(int instances) const;
+
+	int IndexCount() const { return indexCount; }
+	GLenum IndexType() const { return indexType; }
+	GLuint VertexArray() const { return vertexArray.Id(); }
+	// GPU memory held by the vertex and index buffers
+	size_t Bytes() const { return vertexBuffer.Size() + indexBuffer.Size(); }
+
+private:
+	VertexLayout layout;
+	GLBuffer vertexBuffer;
+	GLBuffer indexBuffer;
+	GLVertexArray vertexArray;
+	int indexCount;
+	GLenum indexType;
+};
+
+#endif
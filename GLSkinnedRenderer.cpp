@@ -0,0 +1,80 @@
+// OpenGL skinned mesh draw paths written by Parker Drake
+#include "GLSkinnedRenderer.h"
+#include "SkinnedMesh.h"
+#include "Profiler.h"
+
+#include <glm/gtc/type_ptr.hpp>
+#include <iostream>
+
+SkinnedMeshRenderer::SkinnedMeshRenderer()
+	: mesh(NULL)
+{
+}
+
+bool SkinnedMeshRenderer::Init(const SkinnedMesh& m)
+{
+	if (m.jointCount > MAX_GPU_JOINTS)
+	{
+		std::cerr << "The skinned mesh uses " << m.jointCount << " joints, the shader palette holds " << MAX_GPU_JOINTS << std::endl;
+		return false;
+	}
+
+	cpuViewProjection = cpuProgram.GetUniformHandle("viewProjection");
+	gpuViewProjection = gpuProgram.GetUniformHandle("viewProjection");
+	if (!cpuProgram.IsLinked() || gpuProgram.GetUniformLocation("bones") < 0)
+	{
+		std::cerr << "Skinning shaders failed to build or have no bones uniform" << std::endl;
+		return false;
+	}
+
+	PackedMesh bindPose;
+	PackSkinnedMesh(m, bindPose);
+	if (!packed.Init(bindPose, gpuProgram))
+		return false;
+	mesh = &m;
+	skinned.resize(m.positions.size());
+	streamBuffer.Data(GL_ARRAY_BUFFER, sizeof(float) * skinned.size(), NULL, GL_STREAM_DRAW);
+
+	// Everything but the positions comes from the packed mesh
+	cpuArray.Bind();
+	packed.BindAttributes(cpuProgram);
+	GLint position = cpuProgram.GetAttributeLocation("position");
+	if (position >= 0)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, streamBuffer.Id());
+		glEnableVertexAttribArray(position);
+		glVertexAttribPointer(position, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	}
+	GLVertexArray::Unbind();
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return true;
+}
+
+void SkinnedMeshRenderer::Draw(Mode mode, const glm::mat4* palette, const glm::mat4& viewProjection, WorkerPool& pool)
+{
+	if (!mesh)
+		return;
+
+	Program& program = mode == CPU_SKINNING ? cpuProgram : gpuProgram;
+	if (mode == CPU_SKINNING)
+	{
+		Skinning::Skin(*mesh, palette, &skinned[0], pool);
+
+		PROFILE_SCOPE("Vertex upload");
+		// Orphan last frame's positions so the driver can hand out fresh memory without a stall
+		streamBuffer.Data(GL_ARRAY_BUFFER, sizeof(float) * skinned.size(), NULL, GL_STREAM_DRAW);
+		streamBuffer.SubData(GL_ARRAY_BUFFER, 0, sizeof(float) * skinned.size(), &skinned[0]);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	PROFILE_SCOPE("Draw submission");
+	program.Bind();
+	program.SendUniformData(viewProjection, mode == CPU_SKINNING ? cpuViewProjection : gpuViewProjection);
+	// Looked up each frame, as a reloaded shader may have moved it
+	if (mode == GPU_SKINNING)
+		glUniformMatrix4fv(gpuProgram.GetUniformLocation("bones"), mesh->jointCount, GL_FALSE, glm::value_ptr(palette[0]));
+	glBindVertexArray(mode == CPU_SKINNING ? cpuArray.Id() : packed.VertexArray());
+	packed.Draw();
+	GLVertexArray::Unbind();
+	program.Unbind();
+}
@@ -0,0 +1,57 @@
+// OpenGL skinned mesh draw paths written by Parker Drake
+#pragma once
+#ifndef _GLSkinnedRenderer_H_
+#define _GLSkinnedRenderer_H_
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "Program.h"
+#include "GLMesh.h"
+
+struct SkinnedMesh;
+class WorkerPool;
+
+// Draws a SkinnedMesh either skinned on the CPU, with the positions streamed
+// into an orphaned buffer every frame, or skinned in the vertex shader from
+// a palette of joint matrices uploaded as a uniform array. The bind pose is
+// kept packed (see PackSkinnedMesh) and shared by both paths.
+class SkinnedMeshRenderer
+{
+public:
+	enum Mode { CPU_SKINNING, GPU_SKINNING };
+
+	// Joints the GPU path's palette holds; must match bones[] in skinned.vert
+	static const int MAX_GPU_JOINTS = 32;
+
+	SkinnedMeshRenderer();
+
+	// Built by the caller, before Init
+	Program& GetProgram(Mode mode) { return mode == CPU_SKINNING ? cpuProgram : gpuProgram; }
+	// Uploads the mesh's static attributes. The mesh must outlive the renderer.
+	bool Init(const SkinnedMesh& mesh);
+
+	static const char* ModeName(Mode mode) { return mode == CPU_SKINNING ? "CPU skinned" : "GPU skinned"; }
+	// palette holds one matrix per joint of the mesh (see Skinning::ComputePalette)
+	void Draw(Mode mode, const glm::mat4* palette, const glm::mat4& viewProjection, WorkerPool& pool);
+
+	// GPU memory held for the mesh, including the CPU path's position stream
+	size_t Bytes() const { return packed.Bytes() + streamBuffer.Size(); }
+
+private:
+	SkinnedMeshRenderer(const SkinnedMeshRenderer&);
+	SkinnedMeshRenderer& operator=(const SkinnedMeshRenderer&);
+
+	const SkinnedMesh* mesh;
+	Program cpuProgram;
+	Program gpuProgram;
+	UniformHandle cpuViewProjection;
+	UniformHandle gpuViewProjection;
+
+	GLMesh packed; // Bind pose, set up for the GPU path
+	GLVertexArray cpuArray; // The packed colors and indices with the streamed positions
+	GLBuffer streamBuffer; // CPU skinned positions, replaced every frame
+	std::vector<float> skinned;
+};
+
+#endif
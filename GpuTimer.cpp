@@ -0,0 +1,78 @@
+// GPU timings for the frame profiler written by Parker Drake
+#include "GpuTimer.h"
+#include "Profiler.h"
+
+GpuTimer::GpuTimer()
+	: active(-1), available(false)
+{
+	for (int i = 0; i < QUERIES; i++)
+	{
+		queries[i] = 0;
+		names[i] = 0;
+		starts[i] = 0;
+		pending[i] = false;
+	}
+}
+
+GpuTimer::~GpuTimer()
+{
+	if (available)
+		glDeleteQueries(QUERIES, queries);
+}
+
+bool GpuTimer::Init()
+{
+	available = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+	if (available)
+		glGenQueries(QUERIES, queries);
+	return available;
+}
+
+void GpuTimer::Begin(const char* name)
+{
+	active = -1;
+	if (!available || !Profiler::Enabled())
+		return;
+
+	// When every query is still in flight the region goes untimed rather than waiting
+	for (int i = 0; i < QUERIES; i++)
+	{
+		if (!pending[i])
+		{
+			active = i;
+			break;
+		}
+	}
+	if (active < 0)
+		return;
+
+	names[active] = name;
+	starts[active] = Profiler::Now();
+	glBeginQuery(GL_TIME_ELAPSED, queries[active]);
+}
+
+void GpuTimer::End()
+{
+	if (active < 0)
+		return;
+	glEndQuery(GL_TIME_ELAPSED);
+	pending[active] = true;
+	active = -1;
+}
+
+void GpuTimer::Collect()
+{
+	for (int i = 0; i < QUERIES; i++)
+	{
+		if (!pending[i])
+			continue;
+		GLint ready = 0;
+		glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &ready);
+		if (!ready)
+			continue;
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &elapsed);
+		Profiler::Record(names[i], starts[i], (long long)elapsed, PROFILE_GPU_THREAD);
+		pending[i] = false;
+	}
+}
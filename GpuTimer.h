@@ -0,0 +1,42 @@
+// GPU timings for the frame profiler written by Parker Drake
+#pragma once
+#ifndef _GpuTimer_H_
+#define _GpuTimer_H_
+
+#include <GL/glew.h>
+
+// Times GL work with GL_TIME_ELAPSED queries and hands the results to the
+// Profiler on its GPU track. Results are collected frames later, once the GPU
+// has them, so timing never stalls the pipeline. An event is placed at the CPU
+// time its commands were submitted. Only one region may be open at a time.
+class GpuTimer
+{
+public:
+	GpuTimer();
+	~GpuTimer();
+
+	// Returns false when the context has no timer queries; Begin and End then do nothing
+	bool Init();
+
+	// name must outlive the profiler. Skipped while the profiler is off.
+	void Begin(const char* name);
+	void End();
+
+	// Records every query whose result has arrived
+	void Collect();
+
+private:
+	static const int QUERIES = 8; // Regions in flight, a few frames' worth
+
+	GpuTimer(const GpuTimer&);
+	GpuTimer& operator=(const GpuTimer&);
+
+	GLuint queries[QUERIES];
+	const char* names[QUERIES];
+	long long starts[QUERIES];
+	bool pending[QUERIES];
+	int active; // Query between Begin and End, -1 when none
+	bool available;
+};
+
+#endif
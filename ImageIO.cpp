@@ -0,0 +1,178 @@
+// Image file reading and writing written by Parker Drake
+#include "ImageIO.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+bool WritePPM(const char* path, int width, int height, const unsigned char* rgba)
+{
+	FILE* file = fopen(path, "wb");
+	if (!file)
+	{
+		std::cerr << "Failed to open the image file:" << path << std::endl;
+		return false;
+	}
+
+	fprintf(file, "P6\n%d %d\n255\n", width, height);
+	std::vector<unsigned char> row(width * 3);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+			memcpy(&row[x * 3], rgba + (y * width + x) * 4, 3);
+		fwrite(&row[0], 1, row.size(), file);
+	}
+	fclose(file);
+	return true;
+}
+
+namespace
+{
+	unsigned long Crc32(unsigned long crc, const unsigned char* data, size_t length)
+	{
+		static unsigned long table[256];
+		static bool initialized = false;
+		if (!initialized)
+		{
+			for (unsigned long n = 0; n < 256; n++)
+			{
+				unsigned long c = n;
+				for (int k = 0; k < 8; k++)
+					c = (c & 1) ? 0xEDB88320UL ^ (c >> 1) : c >> 1;
+				table[n] = c;
+			}
+			initialized = true;
+		}
+
+		crc ^= 0xFFFFFFFFUL;
+		for (size_t i = 0; i < length; i++)
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return crc ^ 0xFFFFFFFFUL;
+	}
+
+	void PutBigEndian(std::vector<unsigned char>& out, unsigned long value)
+	{
+		out.push_back((value >> 24) & 0xFF);
+		out.push_back((value >> 16) & 0xFF);
+		out.push_back((value >> 8) & 0xFF);
+		out.push_back(value & 0xFF);
+	}
+
+	void WriteChunk(FILE* file, const char* type, const std::vector<unsigned char>& data)
+	{
+		std::vector<unsigned char> chunk;
+		PutBigEndian(chunk, (unsigned long)data.size());
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		PutBigEndian(chunk, Crc32(0, &chunk[4], chunk.size() - 4));
+		fwrite(&chunk[0], 1, chunk.size(), file);
+	}
+}
+
+bool WritePNG(const char* path, int width, int height, const unsigned char* rgba)
+{
+	FILE* file = fopen(path, "wb");
+	if (!file)
+	{
+		std::cerr << "Failed to open the image file:" << path << std::endl;
+		return false;
+	}
+
+	static const unsigned char signature[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+	fwrite(signature, 1, 8, file);
+
+	// 8-bit RGB, no interlacing
+	std::vector<unsigned char> header;
+	PutBigEndian(header, width);
+	PutBigEndian(header, height);
+	header.push_back(8);
+	header.push_back(2);
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+	WriteChunk(file, "IHDR", header);
+
+	// Scanlines with filter type 0
+	std::vector<unsigned char> raw;
+	raw.reserve((width * 3 + 1) * height);
+	for (int y = 0; y < height; y++)
+	{
+		raw.push_back(0);
+		for (int x = 0; x < width; x++)
+			raw.insert(raw.end(), rgba + (y * width + x) * 4, rgba + (y * width + x) * 4 + 3);
+	}
+
+	// zlib stream made of stored (uncompressed) deflate blocks, so no zlib dependency is needed
+	std::vector<unsigned char> zlib;
+	zlib.push_back(0x78);
+	zlib.push_back(0x01);
+	size_t offset = 0;
+	do
+	{
+		size_t length = raw.size() - offset < 65535 ? raw.size() - offset : 65535;
+		zlib.push_back(offset + length == raw.size() ? 1 : 0);
+		zlib.push_back(length & 0xFF);
+		zlib.push_back((length >> 8) & 0xFF);
+		zlib.push_back(~length & 0xFF);
+		zlib.push_back((~length >> 8) & 0xFF);
+		zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+		offset += length;
+	} while (offset < raw.size());
+
+	unsigned long a = 1, b = 0;
+	for (size_t i = 0; i < raw.size(); i++)
+	{
+		a = (a + raw[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	PutBigEndian(zlib, (b << 16) | a);
+	WriteChunk(file, "IDAT", zlib);
+
+	WriteChunk(file, "IEND", std::vector<unsigned char>());
+	fclose(file);
+	return true;
+}
+
+bool WriteImage(const char* path, int width, int height, const unsigned char* rgba)
+{
+	size_t length = strlen(path);
+	if (length > 4 && !strcmp(path + length - 4, ".png"))
+		return WritePNG(path, width, height, rgba);
+	return WritePPM(path, width, height, rgba);
+}
+
+bool ReadPPM(const char* path, int& width, int& height, std::vector<unsigned char>& rgba)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+	{
+		std::cerr << "Failed to open the image file:" << path << std::endl;
+		return false;
+	}
+
+	int maxValue = 0;
+	if (fscanf(file, "P6 %d %d %d", &width, &height, &maxValue) != 3 || maxValue != 255 || width <= 0 || height <= 0)
+	{
+		std::cerr << "Not an 8-bit binary PPM file:" << path << std::endl;
+		fclose(file);
+		return false;
+	}
+	fgetc(file); // Single whitespace before the pixel data
+
+	std::vector<unsigned char> rgb(width * height * 3);
+	bool complete = fread(&rgb[0], 1, rgb.size(), file) == rgb.size();
+	fclose(file);
+	if (!complete)
+	{
+		std::cerr << "Truncated PPM file:" << path << std::endl;
+		return false;
+	}
+
+	rgba.resize(width * height * 4);
+	for (int i = 0; i < width * height; i++)
+	{
+		memcpy(&rgba[i * 4], &rgb[i * 3], 3);
+		rgba[i * 4 + 3] = 255;
+	}
+	return true;
+}
@@ -0,0 +1,16 @@
+// Image file reading and writing written by Parker Drake
+#pragma once
+#ifndef _ImageIO_H_
+#define _ImageIO_H_
+
+#include <vector>
+
+// Images are tightly packed 8-bit RGBA rows, top row first. Alpha is not stored in the files.
+bool WritePPM(const char* path, int width, int height, const unsigned char* rgba);
+bool WritePNG(const char* path, int width, int height, const unsigned char* rgba);
+// Writes PNG if path ends in ".png", PPM otherwise
+bool WriteImage(const char* path, int width, int height, const unsigned char* rgba);
+// Reads a binary (P6) PPM with 8-bit channels
+bool ReadPPM(const char* path, int& width, int& height, std::vector<unsigned char>& rgba);
+
+#endif
@@ -0,0 +1,279 @@
+// Input session recording and replay written by Parker Drake
+#include "InputRecording.h"
+#include "SimulationClock.h"
+#include "Skeleton.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	const char FRAME_TAG = 'F';
+	const char END_TAG = 'E';
+
+	template<typename T> void Write(FILE* file, const T& value)
+	{
+		fwrite(&value, sizeof(T), 1, file);
+	}
+
+	template<typename T> bool Read(FILE* file, T& value)
+	{
+		return fread(&value, sizeof(T), 1, file) == 1;
+	}
+
+	void Append(std::vector<float>& state, const float* values, int count)
+	{
+		state.insert(state.end(), values, values + count);
+	}
+}
+
+void CaptureState(const Skeleton& robot, const Skeleton& rendered, const Controls& controls, std::vector<float>& state)
+{
+	state.clear();
+	for (int j = 0; j < robot.size(); j++)
+	{
+		Append(state, &robot.transRelParent[j].x, 3);
+		const glm::quat& q = robot.rotRelJoint[j];
+		float rotation[4] = { q.x, q.y, q.z, q.w };
+		Append(state, rotation, 4);
+		Append(state, &robot.scaleFactor[j].x, 3);
+	}
+	for (int j = 0; j < rendered.size(); j++)
+	{
+		for (int column = 0; column < 4; column++)
+			Append(state, &rendered.World(j)[column].x, 4);
+		Append(state, &rendered.scaleFactor[j].x, 3);
+	}
+	Append(state, &controls.eye.x, 3);
+	Append(state, &controls.center.x, 3);
+	Append(state, &controls.up.x, 3);
+}
+
+InputRecorder::InputRecorder()
+	: file(NULL), frames(0)
+{
+}
+
+InputRecorder::~InputRecorder()
+{
+	if (file)
+		fclose(file);
+}
+
+bool InputRecorder::Open(const char* path, const SimulationClock& clock, double start, const char* graphPath)
+{
+	file = fopen(path, "wb");
+	if (!file)
+	{
+		std::cerr << "Unable to create the recording " << path << std::endl;
+		return false;
+	}
+
+	RecordingHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "RREC", 4);
+	header.version = RECORDING_VERSION;
+	header.step = clock.Step();
+	header.maxSteps = clock.MaxSteps();
+	header.start = start;
+	header.graphPathLength = graphPath ? (uint32_t)strlen(graphPath) : 0;
+	Write(file, header);
+	fwrite(graphPath, 1, header.graphPathLength, file);
+	pending.clear();
+	frames = 0;
+	return true;
+}
+
+void InputRecorder::Record(const InputEvent& event)
+{
+	if (file)
+		pending.push_back(event);
+}
+
+void InputRecorder::EndFrame(double now, int steps)
+{
+	if (!file)
+		return;
+
+	Write(file, FRAME_TAG);
+	Write(file, (uint16_t)pending.size());
+	for (size_t i = 0; i < pending.size(); i++)
+	{
+		const InputEvent& event = pending[i];
+		Write(file, (uint8_t)event.type);
+		switch (event.type)
+		{
+		case InputEvent::CURSOR:
+			Write(file, event.x);
+			Write(file, event.y);
+			break;
+		case InputEvent::BUTTON:
+			Write(file, (uint8_t)event.button);
+			Write(file, (uint8_t)event.pressed);
+			break;
+		case InputEvent::SCROLL:
+			Write(file, event.y);
+			break;
+		case InputEvent::CHARACTER:
+			Write(file, (uint32_t)event.key);
+			break;
+		}
+	}
+	Write(file, now);
+	Write(file, (uint16_t)steps);
+	pending.clear();
+	frames++;
+}
+
+bool InputRecorder::Close(const Skeleton& robot, const Skeleton& rendered, const Controls& controls)
+{
+	if (!file)
+		return false;
+
+	std::vector<float> state;
+	CaptureState(robot, rendered, controls, state);
+	Write(file, END_TAG);
+	Write(file, (uint32_t)state.size());
+	fwrite(&state[0], sizeof(float), state.size(), file);
+
+	bool written = !ferror(file);
+	written = fclose(file) == 0 && written;
+	file = NULL;
+	return written;
+}
+
+InputPlayback::InputPlayback()
+	: file(NULL), failed(false)
+{
+	memset(&header, 0, sizeof(header));
+}
+
+InputPlayback::~InputPlayback()
+{
+	Close();
+}
+
+void InputPlayback::Close()
+{
+	if (file)
+		fclose(file);
+	file = NULL;
+}
+
+bool InputPlayback::Open(const char* p)
+{
+	Close();
+	path = p;
+	failed = false;
+	finalState.clear();
+
+	file = fopen(p, "rb");
+	if (!file)
+	{
+		std::cerr << "Unable to open the recording " << p << std::endl;
+		return false;
+	}
+	if (!Read(file, header) || memcmp(header.magic, "RREC", 4) != 0)
+	{
+		std::cerr << p << " is not a recording" << std::endl;
+		Close();
+		return false;
+	}
+	if (header.version != RECORDING_VERSION)
+	{
+		std::cerr << p << " is recording version " << header.version << ", expected " << RECORDING_VERSION << std::endl;
+		Close();
+		return false;
+	}
+
+	graphPath.assign(header.graphPathLength, '\0');
+	if (header.graphPathLength > 0 && fread(&graphPath[0], 1, header.graphPathLength, file) != header.graphPathLength)
+	{
+		std::cerr << p << " is truncated" << std::endl;
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool InputPlayback::ReadEvent(InputEvent& event)
+{
+	uint8_t type;
+	if (!Read(file, type))
+		return false;
+
+	uint8_t button, pressed;
+	uint32_t key;
+	switch (type)
+	{
+	case InputEvent::CURSOR:
+		event = InputEvent::Cursor(0.0, 0.0);
+		return Read(file, event.x) && Read(file, event.y);
+	case InputEvent::BUTTON:
+		if (!Read(file, button) || !Read(file, pressed))
+			return false;
+		event = InputEvent::Button(button, pressed != 0);
+		return true;
+	case InputEvent::SCROLL:
+		event = InputEvent::Scroll(0.0);
+		return Read(file, event.y);
+	case InputEvent::CHARACTER:
+		if (!Read(file, key))
+			return false;
+		event = InputEvent::Character(key);
+		return true;
+	}
+	return false;
+}
+
+bool InputPlayback::NextFrame(std::vector<InputEvent>& events, double& now, int& steps)
+{
+	events.clear();
+	if (!file)
+		return false;
+
+	char tag;
+	if (!Read(file, tag))
+	{
+		Close();
+		return false;
+	}
+
+	if (tag == END_TAG)
+	{
+		uint32_t count;
+		if (Read(file, count))
+		{
+			finalState.resize(count);
+			if (count > 0 && fread(&finalState[0], sizeof(float), count, file) != count)
+				finalState.clear();
+		}
+		Close();
+		return false;
+	}
+
+	uint16_t count, ran;
+	bool valid = tag == FRAME_TAG && Read(file, count);
+	for (uint16_t i = 0; valid && i < count; i++)
+	{
+		InputEvent event;
+		valid = ReadEvent(event);
+		events.push_back(event);
+	}
+	valid = valid && Read(file, now) && Read(file, ran);
+	if (!valid && feof(file))
+	{
+		// Cut off before the final state, e.g. by a crash; every whole frame still replays
+		Close();
+		return false;
+	}
+	if (!valid)
+	{
+		std::cerr << path << " is damaged" << std::endl;
+		failed = true;
+		Close();
+		return false;
+	}
+	steps = ran;
+	return true;
+}
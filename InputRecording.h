@@ -0,0 +1,105 @@
+// Input session recording and replay written by Parker Drake
+#pragma once
+#ifndef _InputRecording_H_
+#define _InputRecording_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "Controls.h"
+
+class Skeleton;
+class SimulationClock;
+
+// A recording is a header, then one record per frame, then the final state:
+//
+//   RecordingHeader, graph path (graphPathLength bytes)
+//   per frame:   'F', uint16 event count, events, double clock time, uint16 simulation steps run
+//   per event:   uint8 type, then CURSOR: double x, y | BUTTON: uint8 button, pressed
+//                | SCROLL: double y | CHARACTER: uint32 key
+//   final state: 'E', uint32 float count, floats (see CaptureState)
+//
+// Frames keep the clock readings and the steps actually run, so a replay
+// reaches the same simulation states and interpolation without a real clock.
+struct RecordingHeader
+{
+	char magic[4]; // "RREC"
+	uint32_t version;
+	double step; // SimulationClock step
+	int32_t maxSteps;
+	double start; // Clock time the session was reset at
+	uint32_t graphPathLength; // 0 when the session used the procedural running cycle
+};
+
+static const uint32_t RECORDING_VERSION = 1;
+
+// Writes a session as it happens. Events are buffered until their frame ends.
+class InputRecorder
+{
+public:
+	InputRecorder();
+	~InputRecorder();
+
+	bool Open(const char* path, const SimulationClock& clock, double start, const char* graphPath);
+	bool IsOpen() const { return file != NULL; }
+
+	void Record(const InputEvent& event);
+	// Ends a frame whose simulation was advanced to now and ran steps steps
+	void EndFrame(double now, int steps);
+	// Appends the state a replay must reproduce and closes the file
+	bool Close(const Skeleton& robot, const Skeleton& rendered, const Controls& controls);
+
+	long long Frames() const { return frames; }
+
+private:
+	InputRecorder(const InputRecorder&);
+	InputRecorder& operator=(const InputRecorder&);
+
+	FILE* file;
+	std::vector<InputEvent> pending;
+	long long frames;
+};
+
+// Reads a recording back one frame at a time
+class InputPlayback
+{
+public:
+	InputPlayback();
+	~InputPlayback();
+
+	bool Open(const char* path);
+	void Close();
+
+	double Step() const { return header.step; }
+	int MaxSteps() const { return header.maxSteps; }
+	double Start() const { return header.start; }
+	const std::string& GraphPath() const { return graphPath; }
+
+	// Returns false after the last frame, or on a damaged file (see Failed)
+	bool NextFrame(std::vector<InputEvent>& events, double& now, int& steps);
+	bool Failed() const { return failed; }
+
+	// The recorded final state; empty if the session was cut off
+	const std::vector<float>& FinalState() const { return finalState; }
+
+private:
+	InputPlayback(const InputPlayback&);
+	InputPlayback& operator=(const InputPlayback&);
+
+	bool ReadEvent(InputEvent& event);
+
+	FILE* file;
+	std::string path;
+	RecordingHeader header;
+	std::string graphPath;
+	std::vector<float> finalState;
+	bool failed;
+};
+
+// Flattens everything a session's input and simulation decide: the robot's
+// channels, the rendered robot's world transforms (UpdateTransforms must have
+// run) and the camera. Two sessions match when these floats are bit for bit equal.
+void CaptureState(const Skeleton& robot, const Skeleton& rendered, const Controls& controls, std::vector<float>& state);
+
+#endif
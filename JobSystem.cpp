@@ -0,0 +1,327 @@
+// Work-stealing job system written by Parker Drake
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+	// Which system the current thread works for, and as which worker
+	struct CurrentWorker
+	{
+		const JobSystem* system;
+		int index;
+	};
+	thread_local CurrentWorker current = { NULL, 0 };
+
+	// Rounds of stealing before an idle worker goes to sleep
+	const int IDLE_SPINS = 64;
+}
+
+JobDeque::JobDeque(int capacity)
+	: top(0), bottom(0)
+{
+	int size = 1;
+	while (size < capacity)
+		size <<= 1;
+	slots = std::vector<std::atomic<Job*>>(size);
+	mask = size - 1;
+}
+
+bool JobDeque::Push(Job* job)
+{
+	long b = bottom.load(std::memory_order_relaxed);
+	if (b - top.load() > mask)
+		return false;
+	slots[b & mask].store(job, std::memory_order_relaxed);
+	bottom.store(b + 1);
+	return true;
+}
+
+Job* JobDeque::Pop()
+{
+	long b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b);
+	long t = top.load();
+	if (t > b)
+	{
+		// Empty
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return NULL;
+	}
+
+	Job* job = slots[b & mask].load(std::memory_order_relaxed);
+	if (t == b)
+	{
+		// Last job: race the thieves for it
+		if (!top.compare_exchange_strong(t, t + 1))
+			job = NULL;
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+Job* JobDeque::Steal()
+{
+	long t = top.load();
+	long b = bottom.load();
+	if (t >= b)
+		return NULL;
+	Job* job = slots[t & mask].load(std::memory_order_relaxed);
+	if (!top.compare_exchange_strong(t, t + 1))
+		return NULL;
+	return job;
+}
+
+JobSystem::JobSystem(int threads)
+	: threadCount(0), queued(0), sleeping(0), quit(false)
+{
+	Start(threads);
+}
+
+JobSystem::~JobSystem()
+{
+	Stop();
+}
+
+int JobSystem::HardwareThreads()
+{
+	unsigned n = std::thread::hardware_concurrency();
+	return n > 0 ? (int)n : 1;
+}
+
+void JobSystem::Resize(int threads)
+{
+	Stop();
+	Start(threads);
+}
+
+void JobSystem::Start(int count)
+{
+	if (count <= 0)
+		count = HardwareThreads();
+	threadCount = count;
+	workers.reset(new Worker[count]);
+	quit = false;
+	for (int i = 1; i < count; i++)
+		threads.push_back(std::thread(&JobSystem::WorkerLoop, this, i));
+}
+
+void JobSystem::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+	threads.clear();
+}
+
+int JobSystem::WorkerIndex() const
+{
+	return current.system == this ? current.index : 0;
+}
+
+Job* JobSystem::Allocate(int worker)
+{
+	Worker& owner = workers[worker];
+	Job* job = &owner.jobs[owner.nextJob++ % JOBS_PER_THREAD];
+	job->function = NULL;
+	job->data = NULL;
+	if (job->work)
+		job->work = nullptr;
+	job->range = NULL;
+	job->parent = NULL;
+	job->unfinished.store(1, std::memory_order_relaxed);
+	return job;
+}
+
+Job* JobSystem::Create(const std::function<void()>& work, Job* parent)
+{
+	Job* job = Allocate(WorkerIndex());
+	job->work = work;
+	job->parent = parent;
+	if (parent)
+		parent->unfinished.fetch_add(1);
+	return job;
+}
+
+Job* JobSystem::Create(void (*function)(void*), void* data, Job* parent)
+{
+	Job* job = Allocate(WorkerIndex());
+	job->function = function;
+	job->data = data;
+	job->parent = parent;
+	if (parent)
+		parent->unfinished.fetch_add(1);
+	return job;
+}
+
+void JobSystem::Run(Job* job)
+{
+	int worker = WorkerIndex();
+	if (!workers[worker].deque.Push(job))
+	{
+		// Full: the caller does the work itself
+		Execute(job, worker);
+		return;
+	}
+	queued.fetch_add(1);
+	if (sleeping.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		wake.notify_one();
+	}
+}
+
+Job* JobSystem::Take(int worker)
+{
+	Job* job = workers[worker].deque.Pop();
+	if (!job)
+	{
+		// Try the others in turn, starting after this thread so thieves spread out
+		for (int i = 1; i < threadCount && !job; i++)
+			job = workers[(worker + i) % threadCount].deque.Steal();
+		if (!job)
+			return NULL;
+		workers[worker].stolen.fetch_add(1, std::memory_order_relaxed);
+	}
+	queued.fetch_sub(1);
+	return job;
+}
+
+void JobSystem::Execute(Job* job, int worker)
+{
+	if (job->range)
+		RunRange(job, worker);
+	else if (job->function)
+		job->function(job->data);
+	else if (job->work)
+		job->work();
+	workers[worker].executed.fetch_add(1, std::memory_order_relaxed);
+	Finish(job);
+}
+
+void JobSystem::Finish(Job* job)
+{
+	while (job && job->unfinished.fetch_sub(1) == 1)
+		job = job->parent;
+}
+
+void JobSystem::Wait(Job* job)
+{
+	int worker = WorkerIndex();
+	while (job->unfinished.load() > 0)
+	{
+		Job* next = Take(worker);
+		if (next)
+			Execute(next, worker);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::RunRange(Job* job, int worker)
+{
+	int begin = job->begin, end = job->end;
+	while (begin < end)
+	{
+		// An empty deque means the other threads took what was split off
+		// before, so split again; otherwise keep the rest of the range here
+		if (end - begin > job->grain && workers[worker].deque.Empty())
+		{
+			int middle = begin + (end - begin) / 2;
+			Job* half = Allocate(worker);
+			half->range = job->range;
+			half->begin = middle;
+			half->end = end;
+			half->grain = job->grain;
+			half->parent = job;
+			job->unfinished.fetch_add(1);
+			Run(half);
+			end = middle;
+			continue;
+		}
+		int stop = std::min(begin + job->grain, end);
+		(*job->range)(begin, stop, worker);
+		begin = stop;
+	}
+}
+
+void JobSystem::ParallelFor(int count, int grain, const RangeTask& task)
+{
+	if (count <= 0)
+		return;
+	if (grain <= 0)
+		grain = std::max(1, count / (threadCount * 16));
+
+	// Nothing to share, skip the jobs
+	int worker = WorkerIndex();
+	if (threadCount == 1 || grain >= count)
+	{
+		task(0, count, worker);
+		return;
+	}
+
+	Job* root = Allocate(worker);
+	root->range = &task;
+	root->begin = 0;
+	root->end = count;
+	root->grain = grain;
+	Execute(root, worker);
+	Wait(root);
+}
+
+void JobSystem::WorkerLoop(int index)
+{
+	current.system = this;
+	current.index = index;
+	int idle = 0;
+	while (!quit.load())
+	{
+		Job* job = Take(index);
+		if (job)
+		{
+			Execute(job, index);
+			idle = 0;
+			continue;
+		}
+		if (++idle < IDLE_SPINS)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		// Sleep until a job is queued. The timeout covers a wake up that
+		// raced with this thread going to sleep.
+		std::unique_lock<std::mutex> lock(mutex);
+		sleeping.fetch_add(1);
+		wake.wait_for(lock, std::chrono::milliseconds(1), [this] { return quit.load() || queued.load() > 0; });
+		sleeping.fetch_sub(1);
+		idle = 0;
+	}
+	current.system = NULL;
+	current.index = 0;
+}
+
+JobStats JobSystem::GetStats() const
+{
+	JobStats stats = { 0, 0 };
+	for (int i = 0; i < threadCount; i++)
+	{
+		stats.executed += workers[i].executed.load(std::memory_order_relaxed);
+		stats.stolen += workers[i].stolen.load(std::memory_order_relaxed);
+	}
+	return stats;
+}
+
+void JobSystem::ResetStats()
+{
+	for (int i = 0; i < threadCount; i++)
+	{
+		workers[i].executed = 0;
+		workers[i].stolen = 0;
+	}
+}
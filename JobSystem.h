@@ -0,0 +1,146 @@
+// Work-stealing job system written by Parker Drake
+#pragma once
+#ifndef _JobSystem_H_
+#define _JobSystem_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "WorkerPool.h"
+
+// A unit of work. Jobs are created by JobSystem::Create, which also links a
+// job to its parent: a parent is not finished until all of its children are.
+struct Job
+{
+	// Runs function(data) if set, otherwise work
+	void (*function)(void*);
+	void* data;
+	std::function<void()> work;
+	// ParallelFor ranges run range(begin, end, worker) instead
+	const RangeTask* range;
+	int begin;
+	int end;
+	int grain;
+	Job* parent;
+	std::atomic<int> unfinished; // This job and its unfinished children
+};
+
+// Fixed-capacity Chase-Lev deque of jobs. The owning thread pushes and pops
+// at the bottom; other threads steal from the top.
+class JobDeque
+{
+public:
+	explicit JobDeque(int capacity = 4096);
+
+	// Owner only. Returns false when the deque is full.
+	bool Push(Job* job);
+	Job* Pop();
+	// Any thread
+	Job* Steal();
+	bool Empty() const { return bottom.load() <= top.load(); }
+
+private:
+	JobDeque(const JobDeque&);
+	JobDeque& operator=(const JobDeque&);
+
+	std::vector<std::atomic<Job*>> slots;
+	long mask;
+	std::atomic<long> top;
+	char padding[64]; // Keeps the thieves' and the owner's ends on separate cache lines
+	std::atomic<long> bottom;
+};
+
+// Per-thread totals since the system was started
+struct JobStats
+{
+	long long executed;
+	long long stolen;
+};
+
+// Threads that each keep a deque of jobs. A thread runs its own jobs newest
+// first, and takes the oldest job of another thread when it runs out, so
+// large pieces of work migrate while small ones stay where their data is hot.
+// Waiting on a job runs other jobs instead of blocking, so jobs may start
+// and wait on child jobs of their own.
+//
+// Like WorkerPool, the thread that creates the system takes part as worker 0,
+// and only it may submit work from outside the system's own threads. Each
+// thread can have at most JOBS_PER_THREAD jobs in flight.
+class JobSystem
+{
+public:
+	// threads <= 0 uses one thread per hardware thread
+	explicit JobSystem(int threads = 0);
+	~JobSystem();
+
+	int ThreadCount() const { return threadCount; }
+	// Only while no jobs are in flight
+	void Resize(int threads);
+
+	// A job that calls work. With a parent, the parent does not finish before it.
+	Job* Create(const std::function<void()>& work, Job* parent = NULL);
+	// A job that calls function(data). Unlike a std::function with captures,
+	// it never allocates, for jobs created every frame.
+	Job* Create(void (*function)(void*), void* data, Job* parent = NULL);
+	// Queues job on the calling thread's deque
+	void Run(Job* job);
+	// Runs other jobs until job and all of its children are finished
+	void Wait(Job* job);
+
+	// Calls task(begin, end, worker) over [0, count) and returns once every
+	// index is done; worker is in [0, ThreadCount()). Ranges are split in
+	// half whenever the running thread's deque is empty, which means other
+	// threads took its work, down to grain indices, so chunks adapt to how
+	// busy the threads are. grain <= 0 picks a size that gives each thread
+	// several chunks. Same contract as WorkerPool::ParallelFor.
+	void ParallelFor(int count, int grain, const RangeTask& task);
+
+	// The calling thread's worker index; 0 outside the system's threads
+	int WorkerIndex() const;
+	JobStats GetStats() const;
+	void ResetStats();
+
+	static int HardwareThreads();
+	static const int JOBS_PER_THREAD = 4096;
+
+private:
+	JobSystem(const JobSystem&);
+	JobSystem& operator=(const JobSystem&);
+
+	struct Worker
+	{
+		JobDeque deque;
+		std::vector<Job> jobs; // Ring the worker creates its jobs in
+		unsigned nextJob;
+		std::atomic<long long> executed;
+		std::atomic<long long> stolen;
+		char padding[64];
+
+		Worker() : jobs(JOBS_PER_THREAD), nextJob(0), executed(0), stolen(0) {}
+	};
+
+	void Start(int threads);
+	void Stop();
+	void WorkerLoop(int index);
+
+	Job* Allocate(int worker);
+	Job* Take(int worker);
+	void Execute(Job* job, int worker);
+	void Finish(Job* job);
+	void RunRange(Job* job, int worker);
+
+	int threadCount;
+	std::unique_ptr<Worker[]> workers;
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::atomic<int> queued; // Jobs in any deque
+	std::atomic<int> sleeping;
+	std::atomic<bool> quit;
+};
+
+#endif
@@ -0,0 +1,34 @@
+// Read-only memory mapped files written by Parker Drake
+#pragma once
+#ifndef _MappedFile_H_
+#define _MappedFile_H_
+
+#include <cstddef>
+
+// Maps a whole file into memory for reading. Pages are loaded by the OS on first touch.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool Open(const char* path);
+	void Close();
+
+	bool IsOpen() const { return data != NULL; }
+	const unsigned char* Data() const { return data; }
+	size_t Size() const { return size; }
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	const unsigned char* data;
+	size_t size;
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#endif
+};
+
+#endif
@@ -0,0 +1,330 @@
+// SIMD 4x4 matrix kernels written by Parker Drake
+#include "MatrixKernels.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define MATRIX_KERNELS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define MATRIX_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang need AVX code to be marked so it can be built without -mavx
+#if defined(MATRIX_KERNELS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define MATRIX_KERNELS_AVX_TARGET __attribute__((target("avx")))
+#else
+#define MATRIX_KERNELS_AVX_TARGET
+#endif
+
+namespace
+{
+	typedef void (*ProductFunction)(const float*, const float*, float*);
+
+	// Scalar fallback. Sums are accumulated in the same order as the SIMD versions.
+	void MultiplyScalar(const float* a, const float* b, float* out)
+	{
+		float r[16];
+		for (int j = 0; j < 4; j++)
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				r[j * 4 + i] = a[i] * b[j * 4] + a[4 + i] * b[j * 4 + 1] + a[8 + i] * b[j * 4 + 2] + a[12 + i] * b[j * 4 + 3];
+			}
+		}
+		for (int i = 0; i < 16; i++)
+			out[i] = r[i];
+	}
+
+	void MultiplyAffineScalar(const float* a, const float* b, float* out)
+	{
+		// b's w components are 0, 0, 0, 1, so a's last column only feeds the translation
+		float r[16];
+		for (int j = 0; j < 4; j++)
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				r[j * 4 + i] = a[i] * b[j * 4] + a[4 + i] * b[j * 4 + 1] + a[8 + i] * b[j * 4 + 2];
+			}
+		}
+		for (int i = 0; i < 4; i++)
+			r[12 + i] += a[12 + i];
+		for (int i = 0; i < 16; i++)
+			out[i] = r[i];
+	}
+
+#ifdef MATRIX_KERNELS_X86
+	// Each output column is a linear combination of a's columns weighted by one column of b
+	void MultiplySSE(const float* a, const float* b, float* out)
+	{
+		__m128 a0 = _mm_loadu_ps(a);
+		__m128 a1 = _mm_loadu_ps(a + 4);
+		__m128 a2 = _mm_loadu_ps(a + 8);
+		__m128 a3 = _mm_loadu_ps(a + 12);
+		__m128 b0 = _mm_loadu_ps(b);
+		__m128 b1 = _mm_loadu_ps(b + 4);
+		__m128 b2 = _mm_loadu_ps(b + 8);
+		__m128 b3 = _mm_loadu_ps(b + 12);
+		__m128 bs[4] = { b0, b1, b2, b3 };
+
+		for (int j = 0; j < 4; j++)
+		{
+			__m128 c = _mm_mul_ps(a0, _mm_shuffle_ps(bs[j], bs[j], _MM_SHUFFLE(0, 0, 0, 0)));
+			c = _mm_add_ps(c, _mm_mul_ps(a1, _mm_shuffle_ps(bs[j], bs[j], _MM_SHUFFLE(1, 1, 1, 1))));
+			c = _mm_add_ps(c, _mm_mul_ps(a2, _mm_shuffle_ps(bs[j], bs[j], _MM_SHUFFLE(2, 2, 2, 2))));
+			c = _mm_add_ps(c, _mm_mul_ps(a3, _mm_shuffle_ps(bs[j], bs[j], _MM_SHUFFLE(3, 3, 3, 3))));
+			_mm_storeu_ps(out + j * 4, c);
+		}
+	}
+
+	void MultiplyAffineSSE(const float* a, const float* b, float* out)
+	{
+		__m128 a0 = _mm_loadu_ps(a);
+		__m128 a1 = _mm_loadu_ps(a + 4);
+		__m128 a2 = _mm_loadu_ps(a + 8);
+		__m128 a3 = _mm_loadu_ps(a + 12);
+		__m128 bs[4] = { _mm_loadu_ps(b), _mm_loadu_ps(b + 4), _mm_loadu_ps(b + 8), _mm_loadu_ps(b + 12) };
+
+		// b's w components are 0, 0, 0, 1, so a3 only feeds the translation
+		for (int j = 0; j < 4; j++)
+		{
+			__m128 c = _mm_mul_ps(a0, _mm_shuffle_ps(bs[j], bs[j], _MM_SHUFFLE(0, 0, 0, 0)));
+			c = _mm_add_ps(c, _mm_mul_ps(a1, _mm_shuffle_ps(bs[j], bs[j], _MM_SHUFFLE(1, 1, 1, 1))));
+			c = _mm_add_ps(c, _mm_mul_ps(a2, _mm_shuffle_ps(bs[j], bs[j], _MM_SHUFFLE(2, 2, 2, 2))));
+			if (j == 3)
+				c = _mm_add_ps(c, a3);
+			_mm_storeu_ps(out + j * 4, c);
+		}
+	}
+
+	// Two output columns per 256-bit register
+	MATRIX_KERNELS_AVX_TARGET void MultiplyAVX(const float* a, const float* b, float* out)
+	{
+		__m256 a0 = _mm256_broadcast_ps((const __m128*)a);
+		__m256 a1 = _mm256_broadcast_ps((const __m128*)(a + 4));
+		__m256 a2 = _mm256_broadcast_ps((const __m128*)(a + 8));
+		__m256 a3 = _mm256_broadcast_ps((const __m128*)(a + 12));
+		__m256 b01 = _mm256_loadu_ps(b);
+		__m256 b23 = _mm256_loadu_ps(b + 8);
+
+		__m256 c01 = _mm256_mul_ps(a0, _mm256_permute_ps(b01, 0x00));
+		c01 = _mm256_add_ps(c01, _mm256_mul_ps(a1, _mm256_permute_ps(b01, 0x55)));
+		c01 = _mm256_add_ps(c01, _mm256_mul_ps(a2, _mm256_permute_ps(b01, 0xAA)));
+		c01 = _mm256_add_ps(c01, _mm256_mul_ps(a3, _mm256_permute_ps(b01, 0xFF)));
+
+		__m256 c23 = _mm256_mul_ps(a0, _mm256_permute_ps(b23, 0x00));
+		c23 = _mm256_add_ps(c23, _mm256_mul_ps(a1, _mm256_permute_ps(b23, 0x55)));
+		c23 = _mm256_add_ps(c23, _mm256_mul_ps(a2, _mm256_permute_ps(b23, 0xAA)));
+		c23 = _mm256_add_ps(c23, _mm256_mul_ps(a3, _mm256_permute_ps(b23, 0xFF)));
+
+		_mm256_storeu_ps(out, c01);
+		_mm256_storeu_ps(out + 8, c23);
+	}
+
+	MATRIX_KERNELS_AVX_TARGET void MultiplyAffineAVX(const float* a, const float* b, float* out)
+	{
+		__m256 a0 = _mm256_broadcast_ps((const __m128*)a);
+		__m256 a1 = _mm256_broadcast_ps((const __m128*)(a + 4));
+		__m256 a2 = _mm256_broadcast_ps((const __m128*)(a + 8));
+		// Translation of a only lands in the last column
+		__m256 t = _mm256_insertf128_ps(_mm256_setzero_ps(), _mm_loadu_ps(a + 12), 1);
+		__m256 b01 = _mm256_loadu_ps(b);
+		__m256 b23 = _mm256_loadu_ps(b + 8);
+
+		__m256 c01 = _mm256_mul_ps(a0, _mm256_permute_ps(b01, 0x00));
+		c01 = _mm256_add_ps(c01, _mm256_mul_ps(a1, _mm256_permute_ps(b01, 0x55)));
+		c01 = _mm256_add_ps(c01, _mm256_mul_ps(a2, _mm256_permute_ps(b01, 0xAA)));
+
+		__m256 c23 = _mm256_mul_ps(a0, _mm256_permute_ps(b23, 0x00));
+		c23 = _mm256_add_ps(c23, _mm256_mul_ps(a1, _mm256_permute_ps(b23, 0x55)));
+		c23 = _mm256_add_ps(c23, _mm256_mul_ps(a2, _mm256_permute_ps(b23, 0xAA)));
+		c23 = _mm256_add_ps(c23, t);
+
+		_mm256_storeu_ps(out, c01);
+		_mm256_storeu_ps(out + 8, c23);
+	}
+
+	bool CpuHasSSE()
+	{
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+		return true;
+#elif defined(__GNUC__) || defined(__clang__)
+		return __builtin_cpu_supports("sse2");
+#else
+		return false;
+#endif
+	}
+
+	bool CpuHasAVX()
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return __builtin_cpu_supports("avx");
+#elif defined(_MSC_VER)
+		// AVX needs both CPU support and the OS saving the YMM registers
+		int info[4];
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		return osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+#else
+		return false;
+#endif
+	}
+#endif
+
+#ifdef MATRIX_KERNELS_NEON
+	void MultiplyNEON(const float* a, const float* b, float* out)
+	{
+		float32x4_t a0 = vld1q_f32(a);
+		float32x4_t a1 = vld1q_f32(a + 4);
+		float32x4_t a2 = vld1q_f32(a + 8);
+		float32x4_t a3 = vld1q_f32(a + 12);
+		float32x4_t bs[4] = { vld1q_f32(b), vld1q_f32(b + 4), vld1q_f32(b + 8), vld1q_f32(b + 12) };
+
+		for (int j = 0; j < 4; j++)
+		{
+			float32x4_t c = vmulq_n_f32(a0, vgetq_lane_f32(bs[j], 0));
+			c = vaddq_f32(c, vmulq_n_f32(a1, vgetq_lane_f32(bs[j], 1)));
+			c = vaddq_f32(c, vmulq_n_f32(a2, vgetq_lane_f32(bs[j], 2)));
+			c = vaddq_f32(c, vmulq_n_f32(a3, vgetq_lane_f32(bs[j], 3)));
+			vst1q_f32(out + j * 4, c);
+		}
+	}
+
+	void MultiplyAffineNEON(const float* a, const float* b, float* out)
+	{
+		float32x4_t a0 = vld1q_f32(a);
+		float32x4_t a1 = vld1q_f32(a + 4);
+		float32x4_t a2 = vld1q_f32(a + 8);
+		float32x4_t a3 = vld1q_f32(a + 12);
+		float32x4_t bs[4] = { vld1q_f32(b), vld1q_f32(b + 4), vld1q_f32(b + 8), vld1q_f32(b + 12) };
+
+		for (int j = 0; j < 4; j++)
+		{
+			float32x4_t c = vmulq_n_f32(a0, vgetq_lane_f32(bs[j], 0));
+			c = vaddq_f32(c, vmulq_n_f32(a1, vgetq_lane_f32(bs[j], 1)));
+			c = vaddq_f32(c, vmulq_n_f32(a2, vgetq_lane_f32(bs[j], 2)));
+			if (j == 3)
+				c = vaddq_f32(c, a3);
+			vst1q_f32(out + j * 4, c);
+		}
+	}
+#endif
+
+	struct KernelTable
+	{
+		MatrixKernels::Kernel kernel;
+		ProductFunction multiply;
+		ProductFunction multiplyAffine;
+	};
+
+	KernelTable TableFor(MatrixKernels::Kernel kernel)
+	{
+		KernelTable table = { MatrixKernels::KERNEL_SCALAR, MultiplyScalar, MultiplyAffineScalar };
+		switch (kernel)
+		{
+#ifdef MATRIX_KERNELS_X86
+		case MatrixKernels::KERNEL_SSE:
+			table.kernel = kernel;
+			table.multiply = MultiplySSE;
+			table.multiplyAffine = MultiplyAffineSSE;
+			break;
+		case MatrixKernels::KERNEL_AVX:
+			table.kernel = kernel;
+			table.multiply = MultiplyAVX;
+			table.multiplyAffine = MultiplyAffineAVX;
+			break;
+#endif
+#ifdef MATRIX_KERNELS_NEON
+		case MatrixKernels::KERNEL_NEON:
+			table.kernel = kernel;
+			table.multiply = MultiplyNEON;
+			table.multiplyAffine = MultiplyAffineNEON;
+			break;
+#endif
+		default:
+			break;
+		}
+		return table;
+	}
+
+	KernelTable BestTable()
+	{
+		if (MatrixKernels::Supported(MatrixKernels::KERNEL_AVX))
+			return TableFor(MatrixKernels::KERNEL_AVX);
+		if (MatrixKernels::Supported(MatrixKernels::KERNEL_NEON))
+			return TableFor(MatrixKernels::KERNEL_NEON);
+		if (MatrixKernels::Supported(MatrixKernels::KERNEL_SSE))
+			return TableFor(MatrixKernels::KERNEL_SSE);
+		return TableFor(MatrixKernels::KERNEL_SCALAR);
+	}
+
+	// Picked on first use so static initializers in other files can multiply safely
+	KernelTable& ActiveTable()
+	{
+		static KernelTable table = BestTable();
+		return table;
+	}
+}
+
+namespace MatrixKernels
+{
+	void Multiply(const float* a, const float* b, float* out)
+	{
+		ActiveTable().multiply(a, b, out);
+	}
+
+	void MultiplyAffine(const float* a, const float* b, float* out)
+	{
+		ActiveTable().multiplyAffine(a, b, out);
+	}
+
+	Kernel Active()
+	{
+		return ActiveTable().kernel;
+	}
+
+	const char* Name(Kernel kernel)
+	{
+		switch (kernel)
+		{
+		case KERNEL_SSE: return "SSE";
+		case KERNEL_AVX: return "AVX";
+		case KERNEL_NEON: return "NEON";
+		default: return "scalar";
+		}
+	}
+
+	bool Supported(Kernel kernel)
+	{
+		switch (kernel)
+		{
+		case KERNEL_SCALAR:
+			return true;
+#ifdef MATRIX_KERNELS_X86
+		case KERNEL_SSE:
+			return CpuHasSSE();
+		case KERNEL_AVX:
+			return CpuHasAVX();
+#endif
+#ifdef MATRIX_KERNELS_NEON
+		case KERNEL_NEON:
+			return true;
+#endif
+		default:
+			return false;
+		}
+	}
+
+	bool Select(Kernel kernel)
+	{
+		if (!Supported(kernel))
+			return false;
+		ActiveTable() = TableFor(kernel);
+		return true;
+	}
+}
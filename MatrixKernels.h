@@ -0,0 +1,33 @@
+// SIMD 4x4 matrix kernels written by Parker Drake
+#pragma once
+#ifndef _MatrixKernels_H_
+#define _MatrixKernels_H_
+
+// Column-major 4x4 float matrix products, as stored by glm::mat4.
+// The fastest kernel set supported by the CPU is picked on first use;
+// the scalar set is always available as a fallback.
+namespace MatrixKernels
+{
+	enum Kernel
+	{
+		KERNEL_SCALAR,
+		KERNEL_SSE,
+		KERNEL_AVX,
+		KERNEL_NEON
+	};
+
+	// out = a * b. out may alias a or b.
+	void Multiply(const float* a, const float* b, float* out);
+	// out = a * b where the bottom row of b is (0, 0, 0, 1). out may alias a or b.
+	void MultiplyAffine(const float* a, const float* b, float* out);
+
+	// Kernel set in use
+	Kernel Active();
+	const char* Name(Kernel kernel);
+	// Returns true if kernel can run on this CPU
+	bool Supported(Kernel kernel);
+	// Switches to kernel if supported (used for benchmarking); returns false otherwise
+	bool Select(Kernel kernel);
+}
+
+#endif
@@ -1,10 +1,9 @@
 // Matrix Stack transformation functions written by Parker Drake
 #include "MatrixStack.h"
+#include "MatrixKernels.h"
 
 #include <stdio.h>
-#include <cassert>
-#include <vector>
-#include <iostream>
+#include <stdexcept>
 
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
@@ -13,178 +12,115 @@
 
 using namespace std;
 
-MatrixStack::MatrixStack()
+MatrixStackBase::MatrixStackBase(glm::mat4* storage, int capacity)
+	: matrices(storage), depth(1), limit(capacity)
 {
-	mstack = make_shared< stack<glm::mat4> >();
-	mstack->push(glm::mat4(1.0));
+	matrices[0] = glm::mat4(1.0);
 }
 
-MatrixStack::~MatrixStack()
+MatrixStackBase::~MatrixStackBase()
 {
 }
 
-void MatrixStack::pushMatrix()
+void MatrixStackBase::copyFrom(const MatrixStackBase& other)
 {
-	const glm::mat4 &top = mstack->top();
-	mstack->push(top);
-	assert(mstack->size() < 100);
+	if (other.depth > limit)
+		throw overflow_error("MatrixStack copy exceeds the destination's capacity");
+	for (int i = 0; i < other.depth; i++)
+		matrices[i] = other.matrices[i];
+	depth = other.depth;
 }
 
-void MatrixStack::popMatrix()
+void MatrixStackBase::overflow()
 {
-	assert(!mstack->empty());
-	mstack->pop();
-	// There should always be one matrix left.
-	assert(!mstack->empty());
+	throw overflow_error("MatrixStack overflow");
 }
 
-void MatrixStack::loadIdentity()
+void MatrixStackBase::underflow()
 {
-	glm::mat4 &top = mstack->top();
-	top = glm::mat4(1.0);
+	throw underflow_error("MatrixStack underflow");
 }
 
-void MatrixStack::translate(const glm::vec3 &t)
+void MatrixStackBase::loadIdentity()
 {
-	glm::mat4 translationMatrix(1.0f);
-
-	// Need to comment out the following line and write your own version
-	//translationMatrix = glm::translate(glm::mat4(1.0f), t);
-
-	float A[16] =
-	{
-		1, 0, 0, 0,
-		0, 1, 0, 0,
-		0, 0, 1, 0,
-		t[0], t[1], t[2], 1
-	};
-	translationMatrix = glm::make_mat4(A);
-	multMatrix(translationMatrix);
+	glm::mat4 &top = matrices[depth - 1];
+	top = glm::mat4(1.0);
 }
 
-void MatrixStack::scale(const glm::vec3& s)
-{
-	glm::mat4 scaleMatrix(1.0);
-
-	// Need to comment out the following line and write your own version
-	//scaleMatrix = glm::scale(glm::mat4(1.0f), s);
+// The transform helpers below only touch the columns of the top matrix that the
+// product changes, instead of building a full matrix and calling multMatrix().
 
-	float A[16] =
-	{
-		s[0], 0, 0, 0,
-		0, s[1], 0, 0,
-		0, 0, s[2], 0,
-		0, 0, 0, 1
-	};
+void MatrixStackBase::translate(const glm::vec3 &t)
+{
+	glm::mat4 &top = matrices[depth - 1];
 
-	scaleMatrix = glm::make_mat4(A);
-	multMatrix(scaleMatrix);
+	// top * T only changes the last column
+	top[3] = top[0] * t[0] + top[1] * t[1] + top[2] * t[2] + top[3];
 }
 
-void MatrixStack::rotateX(float angle)
+void MatrixStackBase::scale(const glm::vec3& s)
 {
-	glm::mat4 rotationMatrix(1.0f);
+	glm::mat4 &top = matrices[depth - 1];
 
-	// Need to comment out the following line and write your own version
-	//rotationMatrix = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(1.0f, 0.0f, 0.0f));
-
-	float A[16] =
-	{
-		1, 0, 0, 0,
-		0, cos(angle), sin(angle), 0,
-		0, -1 * sin(angle), cos(angle), 0,
-		0, 0, 0, 1
-	};
-
-	rotationMatrix = glm::make_mat4(A);
-
-	multMatrix(rotationMatrix);
+	top[0] = top[0] * s[0];
+	top[1] = top[1] * s[1];
+	top[2] = top[2] * s[2];
 }
 
-void MatrixStack::rotateY(float angle)
+void MatrixStackBase::rotateX(float angle)
 {
-	glm::mat4 rotationMatrix(1.0f);
-
-	// Need to comment out the following line and write your own version
-	//rotationMatrix = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 1.0f, 0.0f));
-
-	float A[16] =
-	{
-		cos(angle), 0, -1 * sin(angle), 0,
-		0, 1, 0, 0,
-		sin(angle), 0, cos(angle), 0,
-		0, 0, 0, 1
-	};
-
-	rotationMatrix = glm::make_mat4(A);
+	glm::mat4 &top = matrices[depth - 1];
+	float c = cos(angle);
+	float s = sin(angle);
 
-	multMatrix(rotationMatrix);
+	// Rotation about x mixes the y and z columns
+	glm::vec4 y = top[1] * c + top[2] * s;
+	glm::vec4 z = top[1] * (-1 * s) + top[2] * c;
+	top[1] = y;
+	top[2] = z;
 }
 
-void MatrixStack::rotateZ(float angle)
+void MatrixStackBase::rotateY(float angle)
 {
-	glm::mat4 rotationMatrix(1.0f);
+	glm::mat4 &top = matrices[depth - 1];
+	float c = cos(angle);
+	float s = sin(angle);
 
-	// Need to comment out the following line and write your own version
-	//rotationMatrix = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 0.0f, 1.0f));
-
-	float A[16] =
-	{
-		cos(angle), sin(angle), 0, 0,
-		-1 * sin(angle), cos(angle), 0, 0,
-		0, 0, 1, 0,
-		0, 0, 0, 1
-	};
-
-	rotationMatrix = glm::make_mat4(A);
-
-	multMatrix(rotationMatrix);
+	// Rotation about y mixes the x and z columns
+	glm::vec4 x = top[0] * c + top[2] * (-1 * s);
+	glm::vec4 z = top[0] * s + top[2] * c;
+	top[0] = x;
+	top[2] = z;
 }
 
-void MatrixStack::multMatrix(glm::mat4 &matrix)
+void MatrixStackBase::rotateZ(float angle)
 {
-	glm::mat4 &top = mstack->top();
-
-	// Need to comment out the following line and write your own version
-	//top *= matrix;
-
-	float A[16] =
-	{
-		0, 0, 0, 0,
-		0, 0, 0, 0,
-		0, 0, 0, 0,
-		0, 0, 0, 0
-	};
-
-	glm::mat4 temp = glm::make_mat4(A);
+	glm::mat4 &top = matrices[depth - 1];
+	float c = cos(angle);
+	float s = sin(angle);
 
-	for (int i = 0; i < 4; i++)
-	{
-		for (int j = 0; j < 4; j++)
-		{
-			for (int k = 0; k < 4; k++)
-			{
-				temp[i][j] += matrix[i][k] * top[k][j];
-			}
-		}
-	}
-
-	for (int i = 0; i < 4; i++)
-	{
-		for (int j = 0; j < 4; j++)
-		{
-			top[i][j] = temp[i][j];
-		}
-	}
+	// Rotation about z mixes the x and y columns
+	glm::vec4 x = top[0] * c + top[1] * s;
+	glm::vec4 y = top[0] * (-1 * s) + top[1] * c;
+	top[0] = x;
+	top[1] = y;
+}
 
+void MatrixStackBase::multMatrix(const glm::mat4 &matrix)
+{
+	glm::mat4 &top = matrices[depth - 1];
 
+	// Right multiply with the fastest kernel the CPU supports
+	MatrixKernels::Multiply(glm::value_ptr(top), glm::value_ptr(matrix), glm::value_ptr(top));
+}
 
-	// Getting a pointer to the glm::mat4 matrix
-	float* topArray = glm::value_ptr(top);
-	float* matrixArray = glm::value_ptr(matrix);
+void MatrixStackBase::multAffineMatrix(const glm::mat4 &matrix)
+{
+	glm::mat4 &top = matrices[depth - 1];
+	MatrixKernels::MultiplyAffine(glm::value_ptr(top), glm::value_ptr(matrix), glm::value_ptr(top));
 }
 
-void MatrixStack::Perspective(float fovy, float aspect, float near, float far)
+void MatrixStackBase::Perspective(float fovy, float aspect, float near, float far)
 {
 	glm::mat4 projectionMatrix(0.0f);
 
@@ -202,7 +138,7 @@ void MatrixStack::Perspective(float fovy, float aspect, float near, float far)
 	multMatrix(projectionMatrix);
 }
 
-void MatrixStack::LookAt(glm::vec3 eye, glm::vec3 center, glm::vec3 up)
+void MatrixStackBase::LookAt(glm::vec3 eye, glm::vec3 center, glm::vec3 up)
 {
 	glm::mat4 viewMatrix(1.0f);
 
@@ -223,31 +159,26 @@ void MatrixStack::LookAt(glm::vec3 eye, glm::vec3 center, glm::vec3 up)
 	viewMatrix = glm::make_mat4(A);
 
 
-	multMatrix(viewMatrix);
+	multAffineMatrix(viewMatrix);
 }
 
 
-void MatrixStack::translate(float x, float y, float z)
+void MatrixStackBase::translate(float x, float y, float z)
 {
 	translate(glm::vec3(x, y, z));
 }
 
-void MatrixStack::scale(float x, float y, float z)
+void MatrixStackBase::scale(float x, float y, float z)
 {
 	scale(glm::vec3(x, y, z));
 }
 
-void MatrixStack::scale(float s)
+void MatrixStackBase::scale(float s)
 {
 	scale(glm::vec3(s, s, s));
 }
 
-glm::mat4 &MatrixStack::topMatrix()
-{
-	return mstack->top();
-}
-
-void MatrixStack::print(const glm::mat4 &mat, const char *name)
+void MatrixStackBase::print(const glm::mat4 &mat, const char *name)
 {
 	if(name) {
 		printf("%s = [\n", name);
@@ -265,7 +196,7 @@ void MatrixStack::print(const glm::mat4 &mat, const char *name)
 	printf("\n");
 }
 
-void MatrixStack::print(const char *name) const
+void MatrixStackBase::print(const char *name) const
 {
-	print(mstack->top(), name);
+	print(matrices[depth - 1], name);
 }
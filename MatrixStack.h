@@ -5,25 +5,39 @@
 #ifndef _MatrixStack_H_
 #define _MatrixStack_H_
 
-#include <stack>
-#include <memory>
-#include <glm/fwd.hpp>
+#include <glm/glm.hpp>
 
-class MatrixStack
+// Stack operations over contiguous storage owned by a FixedMatrixStack. The
+// stack never allocates; pushing past capacity throws std::overflow_error and
+// popping the last matrix throws std::underflow_error, in every build type.
+class MatrixStackBase
 {
 public:
-	MatrixStack();
-	virtual ~MatrixStack();
+	virtual ~MatrixStackBase();
 	
 	// glPushMatrix(): Copies the current matrix and adds it to the top of the stack
-	void pushMatrix();
+	void pushMatrix()
+	{
+		if (depth == limit)
+			overflow();
+		matrices[depth] = matrices[depth - 1];
+		depth++;
+	}
 	// glPopMatrix(): Removes the top of the stack and sets the current matrix to be the matrix that is now on top
-	void popMatrix();
+	void popMatrix()
+	{
+		// There should always be one matrix left.
+		if (depth == 1)
+			underflow();
+		depth--;
+	}
 	
 	// glLoadIdentity(): Sets the top matrix to be the identity
 	void loadIdentity();
 	// glMultMatrix(): Right multiplies the top matrix
-	void multMatrix(glm::mat4 &matrix);
+	void multMatrix(const glm::mat4 &matrix);
+	// Right multiplies the top matrix by an affine matrix (bottom row (0, 0, 0, 1))
+	void multAffineMatrix(const glm::mat4 &matrix);
 	
 	// glTranslate(): Right multiplies the top matrix by a translation matrix
 	void translate(const glm::vec3 &trans);
@@ -45,16 +59,68 @@ public:
 	void LookAt(glm::vec3 eye, glm::vec3 center, glm::vec3 up);
 	
 	// glGet(GL_MODELVIEW_MATRIX): Gets the top matrix
-	glm::mat4 &topMatrix();
+	glm::mat4 &topMatrix() { return matrices[depth - 1]; }
 	
 	// Prints out the specified matrix
 	static void print(const glm::mat4 &mat, const char *name = 0);
 	// Prints out the top matrix
 	void print(const char *name = 0) const;
-	
+
+	// Number of matrices on the stack (at least one) and the most it can hold
+	int size() const { return depth; }
+	int capacity() const { return limit; }
+
+protected:
+	// The stack starts with one identity matrix in storage[0]
+	MatrixStackBase(glm::mat4* storage, int capacity);
+	void copyFrom(const MatrixStackBase& other);
+
 private:
-	std::shared_ptr< std::stack<glm::mat4> > mstack;
-	
+	// Copies must own their storage, which only the derived class can provide
+	MatrixStackBase(const MatrixStackBase&);
+	MatrixStackBase& operator=(const MatrixStackBase&);
+
+	// Kept out of line so push and pop inline to a compare and a copy
+	static void overflow();
+	static void underflow();
+
+	glm::mat4* matrices;
+	int depth;
+	int limit;
+};
+
+// A matrix stack holding up to Capacity matrices inline, aligned for SSE loads.
+// (16 rather than 32 bytes: containers before C++17 do not honor larger alignments.)
+template <int Capacity>
+class FixedMatrixStack : public MatrixStackBase
+{
+public:
+	FixedMatrixStack() : MatrixStackBase(storage, Capacity) {}
+	FixedMatrixStack(const FixedMatrixStack& other) : MatrixStackBase(storage, Capacity) { copyFrom(other); }
+	FixedMatrixStack& operator=(const FixedMatrixStack& other) { copyFrom(other); return *this; }
+
+private:
+	alignas(16) glm::mat4 storage[Capacity];
+};
+
+// Default stack, deep enough for any skeleton walk in this project
+class MatrixStack : public FixedMatrixStack<32>
+{
+};
+
+// Pushes on construction and pops when it goes out of scope:
+//   { MatrixScope scope(stack); stack.translate(...); ... }
+class MatrixScope
+{
+public:
+	explicit MatrixScope(MatrixStackBase& s) : stack(s) { stack.pushMatrix(); }
+	~MatrixScope() { stack.popMatrix(); }
+
+private:
+	MatrixScope(const MatrixScope&);
+	MatrixScope& operator=(const MatrixScope&);
+
+	MatrixStackBase& stack;
 };
 
 #endif
@@ -0,0 +1,167 @@
+// Frame arenas, object pools and allocation counters written by Parker Drake
+#include "Memory.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#if COUNT_ALLOCATIONS
+namespace
+{
+	// Constant initialized, so they count allocations made before main too
+	std::atomic<long long> allocations(0);
+	std::atomic<long long> frees(0);
+}
+
+void* operator new(std::size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (size == 0)
+		size = 1;
+	for (;;)
+	{
+		void* memory = malloc(size);
+		if (memory)
+			return memory;
+		std::new_handler handler = std::get_new_handler();
+		if (!handler)
+			throw std::bad_alloc();
+		handler();
+	}
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return operator new(size);
+	}
+	catch (...)
+	{
+		return NULL;
+	}
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void* memory) noexcept
+{
+	if (!memory)
+		return;
+	frees.fetch_add(1, std::memory_order_relaxed);
+	free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	operator delete(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+	operator delete(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+	operator delete(memory);
+}
+
+bool Memory::Counting()
+{
+	return true;
+}
+
+long long Memory::Allocations()
+{
+	return allocations.load(std::memory_order_relaxed);
+}
+
+long long Memory::Frees()
+{
+	return frees.load(std::memory_order_relaxed);
+}
+#else
+bool Memory::Counting()
+{
+	return false;
+}
+
+long long Memory::Allocations()
+{
+	return 0;
+}
+
+long long Memory::Frees()
+{
+	return 0;
+}
+#endif
+
+FrameArena::FrameArena(size_t capacity)
+	: memory(NULL), base(NULL), capacity(0), used(0), overflowBytes(0), highWater(0), overflows(0)
+{
+	Reserve(capacity);
+}
+
+FrameArena::~FrameArena()
+{
+	Reset();
+	delete[] memory;
+}
+
+void FrameArena::Reserve(size_t bytes)
+{
+	if (bytes <= capacity)
+		return;
+	delete[] memory;
+	memory = new char[bytes + Memory::CACHE_LINE - 1];
+	base = reinterpret_cast<char*>(Memory::AlignUp(reinterpret_cast<size_t>(memory), Memory::CACHE_LINE));
+	capacity = bytes;
+}
+
+void* FrameArena::Allocate(size_t bytes, size_t alignment)
+{
+	size_t address = reinterpret_cast<size_t>(base);
+	size_t offset = used.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		size_t start = Memory::AlignUp(address + offset, alignment) - address;
+		if (start + bytes > capacity)
+			break;
+		// Another thread may have taken the space first; retry after it
+		if (used.compare_exchange_weak(offset, start + bytes, std::memory_order_relaxed))
+			return base + start;
+	}
+
+	// Out of room for this frame
+	std::lock_guard<std::mutex> lock(overflowMutex);
+	char* block = new char[bytes + alignment - 1];
+	overflow.push_back(block);
+	overflowBytes += bytes + alignment - 1;
+	overflows++;
+	return reinterpret_cast<char*>(Memory::AlignUp(reinterpret_cast<size_t>(block), alignment));
+}
+
+void FrameArena::Reset()
+{
+	size_t frameBytes = Used();
+	highWater = std::max(highWater, frameBytes);
+	if (!overflow.empty())
+	{
+		for (size_t i = 0; i < overflow.size(); i++)
+			delete[] overflow[i];
+		overflow.clear();
+		// Room for the whole of a frame like this one, plus some for frames that need a little more
+		Reserve(Memory::AlignUp(frameBytes + frameBytes / 4, Memory::CACHE_LINE));
+	}
+	used.store(0, std::memory_order_relaxed);
+	overflowBytes = 0;
+}
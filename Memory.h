@@ -0,0 +1,153 @@
+// Frame arenas, object pools and allocation counters written by Parker Drake
+#pragma once
+#ifndef _Memory_H_
+#define _Memory_H_
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Counting replaces the global operator new and delete. Turn it off with
+// -DCOUNT_ALLOCATIONS=0 (the COUNT_ALLOCATIONS CMake option) to keep the
+// standard ones, e.g. under a sanitizer that brings its own.
+#ifndef COUNT_ALLOCATIONS
+#define COUNT_ALLOCATIONS 1
+#endif
+
+namespace Memory
+{
+	// Whether the counters below count anything
+	bool Counting();
+	// Calls to the global operator new and delete so far, from every thread.
+	// Take the difference around a frame to see whether it touched the heap.
+	long long Allocations();
+	long long Frees();
+
+	const size_t CACHE_LINE = 64;
+
+	inline size_t AlignUp(size_t value, size_t alignment) { return (value + alignment - 1) & ~(alignment - 1); }
+}
+
+// Linear allocator for data that lives for one frame: command lists, visible
+// sets and other scratch arrays. Allocation bumps an offset, from any thread;
+// Reset() drops everything at once. Nothing is destroyed, so only put
+// trivially destructible types in it.
+//
+// A frame that needs more than the capacity gets the rest from the heap, and
+// the next Reset() grows the buffer to what that frame used, so after a frame
+// or two of warm up a steady workload never touches the heap.
+class FrameArena
+{
+public:
+	explicit FrameArena(size_t capacity = 1 << 20);
+	~FrameArena();
+
+	// bytes aligned to alignment, a power of two. Never returns NULL.
+	void* Allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+	template <typename T>
+	T* Allocate(size_t count) { return static_cast<T*>(Allocate(count * sizeof(T), alignof(T))); }
+
+	// Frees everything allocated since the last Reset. No allocation may be in flight.
+	void Reset();
+
+	size_t Used() const { return used.load(std::memory_order_relaxed) + overflowBytes; }
+	size_t Capacity() const { return capacity; }
+	size_t HighWater() const { return highWater; } // Most bytes used by one frame
+	long long Overflows() const { return overflows; } // Allocations that went to the heap
+
+private:
+	FrameArena(const FrameArena&);
+	FrameArena& operator=(const FrameArena&);
+
+	void Reserve(size_t bytes);
+
+	char* memory; // As allocated
+	char* base; // memory aligned to a cache line
+	size_t capacity;
+	std::atomic<size_t> used;
+
+	std::mutex overflowMutex;
+	std::vector<char*> overflow; // Heap blocks handed out past the capacity this frame
+	size_t overflowBytes;
+	size_t highWater;
+	long long overflows;
+};
+
+// Fixed-size slots for objects that are created and destroyed often, such as
+// skeletons. Slots are cache line aligned and padded, so objects used by
+// different threads never share a line, and are carved from chunks that are
+// never given back, so a destroyed object's slot is reused by the next one
+// instead of fragmenting the heap. Not thread safe.
+template <typename T>
+class ObjectPool
+{
+public:
+	explicit ObjectPool(int slotsPerChunk = 64) : perChunk(slotsPerChunk > 0 ? slotsPerChunk : 1), freeList(NULL), live(0) {}
+	// Objects still live are not destroyed, only their memory is released
+	~ObjectPool()
+	{
+		for (size_t i = 0; i < chunks.size(); i++)
+			delete[] chunks[i];
+	}
+
+	template <typename... Args>
+	T* Create(Args&&... args)
+	{
+		if (!freeList)
+			Grow();
+		FreeSlot* slot = freeList;
+		freeList = slot->next;
+		live++;
+		return new (slot) T(std::forward<Args>(args)...);
+	}
+
+	void Destroy(T* object)
+	{
+		if (!object)
+			return;
+		object->~T();
+		FreeSlot* slot = reinterpret_cast<FreeSlot*>(object);
+		slot->next = freeList;
+		freeList = slot;
+		live--;
+	}
+
+	int Live() const { return live; }
+	int Capacity() const { return (int)chunks.size() * perChunk; }
+
+private:
+	ObjectPool(const ObjectPool&);
+	ObjectPool& operator=(const ObjectPool&);
+
+	struct FreeSlot
+	{
+		FreeSlot* next;
+	};
+
+	static const size_t ALIGNMENT = alignof(T) > Memory::CACHE_LINE ? alignof(T) : Memory::CACHE_LINE;
+	static const size_t SLOT = ((sizeof(T) > sizeof(FreeSlot) ? sizeof(T) : sizeof(FreeSlot)) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+	void Grow()
+	{
+		char* chunk = new char[SLOT * perChunk + ALIGNMENT - 1];
+		chunks.push_back(chunk);
+		char* first = reinterpret_cast<char*>(Memory::AlignUp(reinterpret_cast<size_t>(chunk), ALIGNMENT));
+		// Linked back to front, so slots are handed out in address order
+		for (int i = perChunk - 1; i >= 0; i--)
+		{
+			FreeSlot* slot = reinterpret_cast<FreeSlot*>(first + i * SLOT);
+			slot->next = freeList;
+			freeList = slot;
+		}
+	}
+
+	int perChunk;
+	std::vector<char*> chunks;
+	FreeSlot* freeList;
+	int live;
+};
+
+#endif
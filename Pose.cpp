@@ -0,0 +1,35 @@
+// Joint pose channels written by Parker Drake
+#include "Pose.h"
+#include "Skeleton.h"
+
+#include <cassert>
+
+void Pose::Resize(int joints)
+{
+	translation.resize(joints);
+	rotation.resize(joints);
+	scale.resize(joints);
+}
+
+void Pose::Capture(const Skeleton& skeleton)
+{
+	translation = skeleton.transRelParent;
+	rotation = skeleton.rotRelJoint;
+	scale = skeleton.scaleFactor;
+}
+
+void Pose::Apply(Skeleton& skeleton, unsigned channels) const
+{
+	assert(size() == skeleton.size());
+
+	// Joints that already hold these values keep their cached transforms
+	for (int i = 0; i < size(); i++)
+	{
+		if ((channels & TRANSLATION) && skeleton.transRelParent[i] != translation[i])
+			skeleton.SetTranslation(i, translation[i]);
+		if ((channels & ROTATION) && skeleton.rotRelJoint[i] != rotation[i])
+			skeleton.SetRotation(i, rotation[i]);
+		if ((channels & SCALE) && skeleton.scaleFactor[i] != scale[i])
+			skeleton.SetScale(i, scale[i]);
+	}
+}
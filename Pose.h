@@ -0,0 +1,35 @@
+// Joint pose channels written by Parker Drake
+#pragma once
+#ifndef _Pose_H_
+#define _Pose_H_
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+class Skeleton;
+
+// Animated channels of every joint, in skeleton order
+struct Pose
+{
+	enum Channel
+	{
+		TRANSLATION = 1, // transRelParent
+		ROTATION = 2, // rotRelJoint
+		SCALE = 4, // scaleFactor
+		ALL_CHANNELS = 7
+	};
+
+	std::vector<glm::vec3> translation;
+	std::vector<glm::quat> rotation;
+	std::vector<glm::vec3> scale;
+
+	int size() const { return (int)translation.size(); }
+	void Resize(int joints);
+
+	// Copies the channels out of / into a skeleton with the same layout
+	void Capture(const Skeleton& skeleton);
+	void Apply(Skeleton& skeleton, unsigned channels = ALL_CHANNELS) const;
+};
+
+#endif
@@ -0,0 +1,64 @@
+// Headless pose evaluation written by Parker Drake
+#include "PoseEvaluator.h"
+#include "Skeleton.h"
+#include "Robot.h"
+#include "Profiler.h"
+
+
+void PoseBuffer::Resize(int limbs)
+{
+	world.resize(limbs);
+	mvp.resize(limbs);
+}
+
+PoseEvaluator::PoseEvaluator()
+{
+}
+
+PoseEvaluator::~PoseEvaluator()
+{
+}
+
+void PoseEvaluator::Evaluate(Skeleton& skeleton, double time, const glm::mat4& viewProjection, PoseBuffer& out)
+{
+	SetRunningPose(skeleton, time);
+	Evaluate(skeleton, viewProjection, out);
+}
+
+void PoseEvaluator::Evaluate(Skeleton& skeleton, const glm::mat4& viewProjection, PoseBuffer& out)
+{
+	out.Resize(skeleton.size());
+	if (skeleton.size() == 0)
+		return;
+
+	// Timed as separate stages; crowds use the overload below, which is timed per batch
+	{
+		PROFILE_SCOPE("Hierarchy");
+		skeleton.UpdateTransforms(glm::mat4(1.0f));
+		for (int i = 0; i < skeleton.size(); i++)
+			out.world[i] = skeleton.World(i);
+	}
+	PROFILE_SCOPE("Projection");
+	Project(skeleton, viewProjection, &out.world[0], &out.mvp[0]);
+}
+
+void PoseEvaluator::Evaluate(Skeleton& skeleton, const glm::mat4& root, const glm::mat4& viewProjection, glm::mat4* world, glm::mat4* mvp)
+{
+	// Hierarchy walk: one forward pass in topological order over the changed joints
+	skeleton.UpdateTransforms(root);
+	for (int i = 0; i < skeleton.size(); i++)
+		world[i] = skeleton.World(i);
+	Project(skeleton, viewProjection, world, mvp);
+}
+
+void PoseEvaluator::Project(const Skeleton& skeleton, const glm::mat4& viewProjection, const glm::mat4* world, glm::mat4* mvp)
+{
+	// Projection of each limb's scaled cube
+	for (int i = 0; i < skeleton.size(); i++)
+	{
+		stack.topMatrix() = viewProjection;
+		stack.multAffineMatrix(world[i]);
+		stack.scale(skeleton.scaleFactor[i]); // Scale by scaleFactor
+		mvp[i] = stack.topMatrix();
+	}
+}
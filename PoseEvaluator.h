@@ -0,0 +1,42 @@
+// Headless pose evaluation written by Parker Drake
+#pragma once
+#ifndef _PoseEvaluator_H_
+#define _PoseEvaluator_H_
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "MatrixStack.h"
+
+class Skeleton;
+
+// Per-limb output of an evaluation, in skeleton order
+struct PoseBuffer
+{
+	std::vector<glm::mat4> world; // Limb joint transform, without the limb's scale (what children inherit)
+	std::vector<glm::mat4> mvp; // viewProjection * world * scale, ready to draw
+
+	void Resize(int limbs);
+};
+
+// Turns a skeleton into per-limb matrices. Needs no window or GL context.
+class PoseEvaluator
+{
+public:
+	PoseEvaluator();
+	~PoseEvaluator();
+
+	// Poses skeleton with the running cycle at time, then evaluates it
+	void Evaluate(Skeleton& skeleton, double time, const glm::mat4& viewProjection, PoseBuffer& out);
+	// Evaluates skeleton in its current pose. Unchanged joints reuse the skeleton's cached transforms.
+	void Evaluate(Skeleton& skeleton, const glm::mat4& viewProjection, PoseBuffer& out);
+	// Evaluates skeleton placed at root into caller-owned arrays of skeleton.size() matrices
+	void Evaluate(Skeleton& skeleton, const glm::mat4& root, const glm::mat4& viewProjection, glm::mat4* world, glm::mat4* mvp);
+
+	// Recomputes mvp from world transforms alone, for a camera change on an unchanged pose
+	void Project(const Skeleton& skeleton, const glm::mat4& viewProjection, const glm::mat4* world, glm::mat4* mvp);
+
+private:
+	MatrixStack stack;
+};
+
+#endif
@@ -0,0 +1,206 @@
+// Scoped frame profiler written by Parker Drake
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <map>
+
+namespace
+{
+	const unsigned long long CAPACITY = 1 << 16; // Power of two
+
+	// Seqlock slot: the sequence is odd while a writer fills the event and
+	// 2 * (index + 1) once event index is complete
+	struct Slot
+	{
+		std::atomic<unsigned long long> sequence;
+		ProfileEvent event;
+	};
+
+	Slot slots[CAPACITY];
+	std::atomic<unsigned long long> writeIndex(0);
+	std::atomic<int> frameIndex(0);
+	std::atomic<long long> frameStart(-1);
+	std::atomic<int> nextThread(0);
+
+	const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+	// Nearest-rank percentile of sorted values
+	double Percentile(const std::vector<double>& sorted, double fraction)
+	{
+		size_t rank = (size_t)std::ceil(fraction * sorted.size());
+		return sorted[rank > 0 ? rank - 1 : 0];
+	}
+
+	// Keeps a name safe inside a JSON string
+	std::string Escape(const char* name)
+	{
+		std::string escaped;
+		for (const char* c = name; *c; c++)
+		{
+			if (*c == '"' || *c == '\\')
+				escaped += '\\';
+			if ((unsigned char)*c >= 0x20)
+				escaped += *c;
+		}
+		return escaped;
+	}
+}
+
+namespace Profiler
+{
+	std::atomic<bool> enabled(false);
+
+	void SetEnabled(bool enable)
+	{
+		if (enable && !Enabled())
+			frameStart.store(-1, std::memory_order_relaxed);
+		enabled.store(enable, std::memory_order_relaxed);
+	}
+
+	void BeginFrame()
+	{
+		if (!Enabled())
+			return;
+		long long now = Now();
+		long long start = frameStart.exchange(now, std::memory_order_relaxed);
+		if (start >= 0)
+			Record("Frame", start, now - start, ThreadId());
+		frameIndex.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	int Frame()
+	{
+		return frameIndex.load(std::memory_order_relaxed);
+	}
+
+	long long Now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+	}
+
+	void Record(const char* name, long long start, long long duration, int thread)
+	{
+		unsigned long long index = writeIndex.fetch_add(1, std::memory_order_relaxed);
+		Slot& slot = slots[index & (CAPACITY - 1)];
+		slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.event.name = name;
+		slot.event.start = start;
+		slot.event.duration = duration;
+		slot.event.thread = thread;
+		slot.event.frame = Frame();
+		slot.sequence.store(2 * index + 2, std::memory_order_release);
+	}
+
+	int ThreadId()
+	{
+		static thread_local int id = nextThread.fetch_add(1, std::memory_order_relaxed);
+		return id;
+	}
+
+	void Clear()
+	{
+		// A zero sequence never matches the index a reader expects
+		for (unsigned long long i = 0; i < CAPACITY; i++)
+			slots[i].sequence.store(0, std::memory_order_relaxed);
+		frameStart.store(-1, std::memory_order_relaxed);
+	}
+
+	void Snapshot(std::vector<ProfileEvent>& events)
+	{
+		events.clear();
+		unsigned long long end = writeIndex.load(std::memory_order_acquire);
+		unsigned long long begin = end > CAPACITY ? end - CAPACITY : 0;
+		events.reserve((size_t)(end - begin));
+		for (unsigned long long index = begin; index < end; index++)
+		{
+			const Slot& slot = slots[index & (CAPACITY - 1)];
+			unsigned long long sequence = slot.sequence.load(std::memory_order_acquire);
+			if (sequence != 2 * index + 2)
+				continue;
+			ProfileEvent event = slot.event;
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.sequence.load(std::memory_order_relaxed) == sequence)
+				events.push_back(event);
+		}
+	}
+
+	void Summarize(std::vector<ProfileSummary>& summaries, int frames)
+	{
+		summaries.clear();
+		std::vector<ProfileEvent> events;
+		Snapshot(events);
+
+		// The oldest frame in the ring may be cut short; the current one is unfinished
+		int last = Frame() - 1;
+		int first = events.empty() ? last : events[0].frame + 1;
+		if (frames > 0)
+			first = std::max(first, last - frames + 1);
+
+		std::map<std::string, std::map<int, double> > totals;
+		for (size_t i = 0; i < events.size(); i++)
+		{
+			const ProfileEvent& event = events[i];
+			if (event.frame >= first && event.frame <= last)
+				totals[event.name][event.frame] += event.duration * 1e-6;
+		}
+
+		for (std::map<std::string, std::map<int, double> >::const_iterator it = totals.begin(); it != totals.end(); ++it)
+		{
+			std::vector<double> values;
+			for (std::map<int, double>::const_iterator frame = it->second.begin(); frame != it->second.end(); ++frame)
+				values.push_back(frame->second);
+			std::sort(values.begin(), values.end());
+
+			ProfileSummary summary;
+			summary.name = it->first;
+			summary.frames = (int)values.size();
+			summary.p50 = Percentile(values, 0.50);
+			summary.p95 = Percentile(values, 0.95);
+			summary.p99 = Percentile(values, 0.99);
+			summary.max = values.back();
+			summaries.push_back(summary);
+		}
+	}
+
+	bool WriteChromeTrace(const char* path)
+	{
+		FILE* file = fopen(path, "w");
+		if (!file)
+			return false;
+
+		std::vector<ProfileEvent> events;
+		Snapshot(events);
+		fprintf(file, "{\"traceEvents\":[\n");
+		fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"GPU\"}}", PROFILE_GPU_THREAD);
+		for (size_t i = 0; i < events.size(); i++)
+		{
+			const ProfileEvent& event = events[i];
+			fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%d}}",
+				Escape(event.name).c_str(), event.thread, event.start * 1e-3, event.duration * 1e-3, event.frame);
+		}
+		fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+		return fclose(file) == 0;
+	}
+
+	bool WritePercentiles(const char* path)
+	{
+		FILE* file = fopen(path, "w");
+		if (!file)
+			return false;
+
+		std::vector<ProfileSummary> summaries;
+		Summarize(summaries);
+		fprintf(file, "name,frames,p50_ms,p95_ms,p99_ms,max_ms\n");
+		for (size_t i = 0; i < summaries.size(); i++)
+		{
+			const ProfileSummary& summary = summaries[i];
+			fprintf(file, "%s,%d,%.4f,%.4f,%.4f,%.4f\n", summary.name.c_str(), summary.frames,
+				summary.p50, summary.p95, summary.p99, summary.max);
+		}
+		return fclose(file) == 0;
+	}
+}
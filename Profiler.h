@@ -0,0 +1,102 @@
+// Scoped frame profiler written by Parker Drake
+#pragma once
+#ifndef _Profiler_H_
+#define _Profiler_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Building with PROFILING=0 compiles every PROFILE_SCOPE away. Otherwise a
+// scope costs one relaxed load and a branch until Profiler::SetEnabled(true).
+#ifndef PROFILING
+#define PROFILING 1
+#endif
+
+// One timed region. Times are nanoseconds since the profiler started.
+struct ProfileEvent
+{
+	const char* name; // Must outlive the profiler; string literals in practice
+	long long start;
+	long long duration;
+	int thread; // Small per-thread number; PROFILE_GPU_THREAD for GL timer queries
+	int frame;
+};
+
+// Per-frame totals of one event name over the recorded frames, in milliseconds
+struct ProfileSummary
+{
+	std::string name;
+	int frames;
+	double p50;
+	double p95;
+	double p99;
+	double max;
+};
+
+static const int PROFILE_GPU_THREAD = 1000;
+
+// Events go into a fixed-size lock-free ring shared by all threads; when it is
+// full the oldest events are overwritten. Exports read a snapshot of the ring,
+// skipping any event a thread is writing at that moment.
+namespace Profiler
+{
+	extern std::atomic<bool> enabled;
+
+	void SetEnabled(bool enable);
+	inline bool Enabled() { return enabled.load(std::memory_order_relaxed); }
+
+	// Starts a new frame and records the previous one as a "Frame" event
+	void BeginFrame();
+	int Frame();
+
+	long long Now();
+	void Record(const char* name, long long start, long long duration, int thread);
+	int ThreadId();
+
+	// Drops every recorded event
+	void Clear();
+	// Copies the recorded events, oldest first
+	void Snapshot(std::vector<ProfileEvent>& events);
+	// Percentiles of each name's per-frame total over the last frames (0 for all recorded)
+	void Summarize(std::vector<ProfileSummary>& summaries, int frames = 0);
+
+	// Chrome trace event format, viewable in chrome://tracing or Perfetto
+	bool WriteChromeTrace(const char* path);
+	// name,frames,p50_ms,p95_ms,p99_ms,max_ms
+	bool WritePercentiles(const char* path);
+}
+
+#if PROFILING
+
+// Times the enclosing scope when the profiler is enabled
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* label)
+		: name(Profiler::Enabled() ? label : 0), start(name ? Profiler::Now() : 0) {}
+	~ProfileScope()
+	{
+		if (name)
+			Profiler::Record(name, start, Profiler::Now() - start, Profiler::ThreadId());
+	}
+
+private:
+	ProfileScope(const ProfileScope&);
+	ProfileScope& operator=(const ProfileScope&);
+
+	const char* name;
+	long long start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+
+#endif
+
+#endif
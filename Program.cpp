@@ -2,9 +2,11 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <cstring>
 
 
 Program::Program()
+	: programID(0)
 {
 }
 
@@ -12,140 +14,208 @@ Program::~Program()
 {
 }
 
-void Program::SetShadersFileName(char *vFileName, char *sFileName)
-{
-	vertexShaderFileName = vFileName;
-	fragmentShaderFileName = sFileName;
-}
-
-void Program::CheckShaderCompileStatus(GLuint shader)
+bool Program::CheckShaderCompileStatus(GLuint shader, const char* name)
 {
 	GLint status;
 	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-	if (status == GL_FALSE) {
-		GLint logLength;
+	if (status == GL_FALSE)
+	{
+		GLint logLength = 0;
 		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
-		GLchar* buffer = new GLchar[logLength];
-		GLsizei bufferSize;
-		glGetShaderInfoLog(shader, logLength, &bufferSize, buffer);
-		std::cout << "unsuccessful" << std::endl;
-		std::cout << buffer << std::endl;
-		delete[] buffer;
-
-		return;
-	}
-	else {
-		std::cout << "successful" << std::endl;
+		std::vector<GLchar> buffer(logLength + 1);
+		GLsizei bufferSize = 0;
+		glGetShaderInfoLog(shader, (GLsizei)buffer.size(), &bufferSize, &buffer[0]);
+		buffer[bufferSize] = 0;
+		std::cerr << "Unable to compile " << name << ":" << std::endl;
+		std::cerr << &buffer[0] << std::endl;
+		return false;
 	}
+	return true;
 }
 
-void Program::Init()
+bool Program::CheckLinkStatus(GLuint program, const char* vertexName, const char* fragmentName)
 {
-	GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
-	GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
-
-	std::string vstr = ReadShader(vertexShaderFileName);
-	std::string fstr = ReadShader(fragmentShaderFileName);
+	GLint status;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status == GL_FALSE)
+	{
+		GLint logLength = 0;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+		std::vector<GLchar> buffer(logLength + 1);
+		GLsizei bufferSize = 0;
+		glGetProgramInfoLog(program, (GLsizei)buffer.size(), &bufferSize, &buffer[0]);
+		std::cerr << "Unable to link " << vertexName << " with " << fragmentName << ":" << std::endl;
+		std::cerr << std::string(&buffer[0], bufferSize) << std::endl;
+		return false;
+	}
+	return true;
+}
 
-	const char* vsText = vstr.c_str();
-	glShaderSource(vertShader, 1, &vsText, 0);
-	const char* fsText = fstr.c_str();
-	glShaderSource(fragShader, 1, &fsText, 0);
+GLuint Program::CompileShader(GLenum type, const std::string& source)
+{
+	GLuint shader = glCreateShader(type);
+	const char* text = source.c_str();
+	glShaderSource(shader, 1, &text, 0);
+	glCompileShader(shader);
+	return shader;
+}
 
-	glCompileShader(vertShader);
-	std::cout << "Vertex shader compilation ";
-	CheckShaderCompileStatus(vertShader);
+void Program::Adopt(GLuint linkedProgram)
+{
+	if (programID)
+		glDeleteProgram(programID);
+	programID = linkedProgram;
+	QueryInterface();
+}
 
-	glCompileShader(fragShader);
-	std::cout << "Fragment shader compilation ";
-	CheckShaderCompileStatus(fragShader);
+void Program::QueryInterface()
+{
+	// Uniforms keep their index across programs so handles survive a reload;
+	// ones the new program lacks get location -1, which GL ignores
+	for (size_t i = 0; i < uniforms.size(); i++)
+	{
+		uniforms[i].location = -1;
+		uniforms[i].known = false;
+	}
+	attributeLocations.clear();
 
-	programID = glCreateProgram();
-	glAttachShader(programID, vertShader);
-	glAttachShader(programID, fragShader);
+	GLint count = 0, maxLength = 0;
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	std::vector<GLchar> name(maxLength + 1);
+	for (GLint i = 0; i < count; i++)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(programID, i, (GLsizei)name.size(), &length, &size, &type, &name[0]);
+
+		// Arrays are reported as "name[0]", but are looked up by their plain name too
+		std::string key(&name[0], length);
+		Uniform uniform;
+		uniform.location = glGetUniformLocation(programID, key.c_str());
+		uniform.type = type;
+		uniform.known = false;
+		if (key.size() > 3 && key.compare(key.size() - 3, 3, "[0]") == 0)
+			key.resize(key.size() - 3);
+
+		std::map<std::string, int>::iterator existing = uniformIndex.find(key);
+		if (existing != uniformIndex.end())
+			uniforms[existing->second] = uniform;
+		else
+		{
+			uniformIndex[key] = (int)uniforms.size();
+			uniforms.push_back(uniform);
+		}
+	}
 
-	glLinkProgram(programID);
-	GLint status;
-	glGetProgramiv(programID, GL_LINK_STATUS, &status);
-	if (!status) {
-		std::cerr << "Unable to link the shaders" << std::endl;
-		return;
+	glGetProgramiv(programID, GL_ACTIVE_ATTRIBUTES, &count);
+	glGetProgramiv(programID, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+	name.resize(maxLength + 1);
+	for (GLint i = 0; i < count; i++)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveAttrib(programID, i, (GLsizei)name.size(), &length, &size, &type, &name[0]);
+		std::string key(&name[0], length);
+		attributeLocations[key] = glGetAttribLocation(programID, key.c_str());
 	}
 }
 
-std::string Program::ReadShader(const char *name)
+UniformHandle Program::GetUniformHandle(const char* name) const
 {
-	GLint status;
-
-	std::ifstream ifs;
-	std::string str;
-	std::stringstream ss;
-
-	ifs.open(name);
-	if (!ifs) {
-		std::cerr << "Failed to open the shader file:" << name << std::endl;
-		return 0;
-	}
-	ss << ifs.rdbuf();
-	ifs.close();
-	str = ss.str();
+	std::map<std::string, int>::const_iterator it = uniformIndex.find(name);
+	return UniformHandle(it != uniformIndex.end() ? it->second : -1);
+}
 
-	return str;
+GLint Program::GetUniformLocation(const char* name) const
+{
+	UniformHandle handle = GetUniformHandle(name);
+	return handle.IsValid() ? uniforms[handle.index].location : -1;
 }
 
-void Program::SendVaryingData(std::vector<float> &posBuff, std::vector<float> &norBuff, std::vector<float> &texBuff)
+GLint Program::GetAttributeLocation(const char* name) const
 {
-	GLuint posBufferID;
-	glGenBuffers(1, &posBufferID);
-	glBindBuffer(GL_ARRAY_BUFFER, posBufferID);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * posBuff.size(), &posBuff[0], GL_STATIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	std::map<std::string, GLint>::const_iterator it = attributeLocations.find(name);
+	return it != attributeLocations.end() ? it->second : -1;
+}
 
-	if (!norBuff.empty())
+bool Program::UpdateShadow(UniformHandle handle, const void* value, size_t bytes)
+{
+	Uniform& uniform = uniforms[handle.index];
+	if (uniform.known && memcmp(uniform.value, value, bytes) == 0)
 	{
-		GLuint norBufferID;
-		glGenBuffers(1, &norBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, norBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(float) * norBuff.size(), &norBuff[0], GL_STATIC_DRAW);
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
+		uniformStats.skipped++;
+		return false;
 	}
+	memcpy(uniform.value, value, bytes);
+	uniform.known = true;
+	uniformStats.issued++;
+	return true;
+}
 
-	if (!texBuff.empty())
-	{
-		GLuint texBufferID;
-		glGenBuffers(1, &texBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, texBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(float) * texBuff.size(), &texBuff[0], GL_STATIC_DRAW);
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, 0);
+bool Program::ReadShader(const char *name, std::string& source)
+{
+	std::ifstream ifs(name, std::ios::in | std::ios::binary);
+	if (!ifs) {
+		std::cerr << "Failed to open the shader file: " << name << std::endl;
+		return false;
 	}
+	std::stringstream ss;
+	ss << ifs.rdbuf();
+	source = ss.str();
+	return true;
 }
 
 // Send an integer to the shader.
 void Program::SendUniformData(int input, const char* name)
 {
-
-	glUniform1i(glGetUniformLocation(programID, name), input);
+	SendUniformData(input, GetUniformHandle(name));
 }
 
 // Send a float number to the shader.
 void Program::SendUniformData(float input, const char* name)
 {
-	glUniform1f(glGetUniformLocation(programID, name), input);
+	SendUniformData(input, GetUniformHandle(name));
 }
 
 // Send a vec3 to the shader.
 void Program::SendUniformData(glm::vec3 input, const char* name)
 {
-	glUniform3f(glGetUniformLocation(programID, name), input.x, input.y, input.z);
+	SendUniformData(input, GetUniformHandle(name));
 }
 
 //send a matrix to the shader.
 void Program::SendUniformData(glm::mat4 &input, const char* name)
 {
-	glUniformMatrix4fv(glGetUniformLocation(programID, name), 1, GL_FALSE, &input[0][0]);
+	SendUniformData(input, GetUniformHandle(name));
+}
+
+// The handle versions only talk to GL when the value changed since the last upload.
+void Program::SendUniformData(int input, UniformHandle handle)
+{
+	if (handle.IsValid() && UpdateShadow(handle, &input, sizeof(input)))
+		glUniform1i(uniforms[handle.index].location, input);
+}
+
+void Program::SendUniformData(float input, UniformHandle handle)
+{
+	if (handle.IsValid() && UpdateShadow(handle, &input, sizeof(input)))
+		glUniform1f(uniforms[handle.index].location, input);
+}
+
+void Program::SendUniformData(const glm::vec3& input, UniformHandle handle)
+{
+	float value[3] = { input.x, input.y, input.z };
+	if (handle.IsValid() && UpdateShadow(handle, value, sizeof(value)))
+		glUniform3f(uniforms[handle.index].location, input.x, input.y, input.z);
+}
+
+void Program::SendUniformData(const glm::mat4& input, UniformHandle handle)
+{
+	if (handle.IsValid() && UpdateShadow(handle, &input[0][0], 16 * sizeof(float)))
+		glUniformMatrix4fv(uniforms[handle.index].location, 1, GL_FALSE, &input[0][0]);
 }
 
 void Program::Bind()
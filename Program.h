@@ -2,30 +2,89 @@
 #include <GL/glew.h>
 #include <string>
 #include <vector>
+#include <map>
 #include <glm/glm.hpp>
 
+// Refers to one active uniform of a Program. Invalid handles are ignored when sending data.
+struct UniformHandle
+{
+	int index;
+
+	explicit UniformHandle(int i = -1) : index(i) {}
+	bool IsValid() const { return index >= 0; }
+};
+
+// Uniform uploads issued to GL versus skipped because the value had not changed
+struct UniformStats
+{
+	long long issued;
+	long long skipped;
+
+	UniformStats() : issued(0), skipped(0) {}
+};
+
 class Program
 {
 public:
 	
 	Program();
 	~Program();
-	void SetShadersFileName(char *vFileName, char *sFileName);
-	void CheckShaderCompileStatus(GLuint shader);
-	void Init();
-	std::string ReadShader(const char *name);
-	void SendVaryingData(std::vector<float> &posBuff, std::vector<float> &norBuff, std::vector<float> &texBuff);
+	// Programs are built by ShaderCache, which hands them over here.
+	// Takes over a linked program object, deleting the one held before. Uniform
+	// handles taken before stay valid for uniforms the new program still has.
+	void Adopt(GLuint linkedProgram);
+	bool IsLinked() const { return programID != 0; }
+
+	// Helpers shared with ShaderCache; diagnostics name the file they came from
+	static bool ReadShader(const char *name, std::string& source);
+	static bool CheckShaderCompileStatus(GLuint shader, const char* name);
+	static bool CheckLinkStatus(GLuint program, const char* vertexName, const char* fragmentName);
+	// Compiles one shader stage without waiting for the result
+	static GLuint CompileShader(GLenum type, const std::string& source);
 	void SendUniformData(int a, const char* name);
 	void SendUniformData(float a, const char* name);
 	void SendUniformData(glm::vec3 input, const char* name);
 	void SendUniformData(glm::mat4 &mat, const char* name);
+
+	// Cached lookups, filled in by Adopt() after linking
+	UniformHandle GetUniformHandle(const char* name) const;
+	GLint GetUniformLocation(const char* name) const;
+	GLint GetAttributeLocation(const char* name) const;
+
+	// Send data through a handle. The upload is skipped if the uniform already holds the value.
+	void SendUniformData(int a, UniformHandle handle);
+	void SendUniformData(float a, UniformHandle handle);
+	void SendUniformData(const glm::vec3& input, UniformHandle handle);
+	void SendUniformData(const glm::mat4& mat, UniformHandle handle);
+
+	const UniformStats& GetUniformStats() const { return uniformStats; }
+	void ResetUniformStats() { uniformStats = UniformStats(); }
+
 	void Bind();
 	void Unbind();
 	GLint GetPID() { return programID; };
+	const std::map<std::string, GLint>& GetAttributeLocations() const { return attributeLocations; }
 
 
 private:
-	GLint programID;
-	char *vertexShaderFileName, *fragmentShaderFileName;
+	// Active uniform with a copy of the last value sent to it
+	struct Uniform
+	{
+		GLint location;
+		GLenum type;
+		bool known;
+		float value[16];
+	};
+
+	void QueryInterface();
+	// Returns false if the uniform already holds value, otherwise remembers it
+	bool UpdateShadow(UniformHandle handle, const void* value, size_t bytes);
+
+	GLuint programID;
+
+	std::vector<Uniform> uniforms;
+	std::map<std::string, int> uniformIndex;
+	std::map<std::string, GLint> attributeLocations;
+	UniformStats uniformStats;
 };
 
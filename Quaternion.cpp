@@ -0,0 +1,263 @@
+// Quaternion joint rotations written by Parker Drake
+#include "Quaternion.h"
+
+#include <math.h>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QUAT_BLEND_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define QUAT_BLEND_NEON
+#include <arm_neon.h>
+#endif
+
+// The batched paths load quaternions as four packed floats in x, y, z, w order
+static_assert(sizeof(glm::quat) == 4 * sizeof(float), "glm::quat must be four packed floats");
+
+namespace
+{
+	glm::quat AxisAngle(int axis, float angle)
+	{
+		glm::quat q(cos(angle * 0.5f), 0.0f, 0.0f, 0.0f);
+		q[axis] = sin(angle * 0.5f); // x, y and z come first in memory
+		return q;
+	}
+
+	// Nlerp blend factor correction that approximates slerp (Zeux, "Approximating slerp").
+	// d is the absolute cosine of the angle between the two quaternions.
+	inline float CorrectAlpha(float t, float d)
+	{
+		float a = 1.0904f + d * (-3.2452f + d * (3.55645f - d * 1.43519f));
+		float b = 0.848013f + d * (-1.06021f + d * 0.215638f);
+		float k = a * (t - 0.5f) * (t - 0.5f) + b;
+		return t + t * (t - 0.5f) * (t - 1.0f) * k;
+	}
+
+	// One quaternion at a time, with the same operation order as the SIMD paths
+	void BlendScalar(const float* a, const float* b, const float* alpha, int alphaStride, float* out, int count, bool corrected)
+	{
+		for (int i = 0; i < count; i++, a += 4, b += 4, out += 4, alpha += alphaStride)
+		{
+			float d = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+			float sign = d < 0.0f ? -1.0f : 1.0f;
+			float t = corrected ? CorrectAlpha(*alpha, fabsf(d)) : *alpha;
+
+			float r[4];
+			for (int c = 0; c < 4; c++)
+				r[c] = a[c] + (b[c] * sign - a[c]) * t;
+			float inverseLength = 1.0f / sqrtf(r[0] * r[0] + r[1] * r[1] + r[2] * r[2] + r[3] * r[3]);
+			for (int c = 0; c < 4; c++)
+				out[c] = r[c] * inverseLength;
+		}
+	}
+
+#ifdef QUAT_BLEND_SSE
+	// Four quaternions per iteration, transposed so each register holds one component of all four
+	void BlendSSE(const float* a, const float* b, const float* alpha, int alphaStride, float* out, int count, bool corrected)
+	{
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 one = _mm_set1_ps(1.0f);
+
+		int i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 ax = _mm_loadu_ps(a + i * 4), ay = _mm_loadu_ps(a + i * 4 + 4), az = _mm_loadu_ps(a + i * 4 + 8), aw = _mm_loadu_ps(a + i * 4 + 12);
+			__m128 bx = _mm_loadu_ps(b + i * 4), by = _mm_loadu_ps(b + i * 4 + 4), bz = _mm_loadu_ps(b + i * 4 + 8), bw = _mm_loadu_ps(b + i * 4 + 12);
+			_MM_TRANSPOSE4_PS(ax, ay, az, aw);
+			_MM_TRANSPOSE4_PS(bx, by, bz, bw);
+
+			__m128 t = alphaStride ? _mm_loadu_ps(alpha + i) : _mm_set1_ps(*alpha);
+
+			// Flip b onto a's hemisphere by copying the sign of the dot product into b
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+			__m128 sign = _mm_and_ps(d, signMask);
+			bx = _mm_xor_ps(bx, sign);
+			by = _mm_xor_ps(by, sign);
+			bz = _mm_xor_ps(bz, sign);
+			bw = _mm_xor_ps(bw, sign);
+
+			if (corrected)
+			{
+				__m128 ad = _mm_andnot_ps(signMask, d);
+				__m128 ka = _mm_add_ps(_mm_set1_ps(1.0904f), _mm_mul_ps(ad, _mm_add_ps(_mm_set1_ps(-3.2452f),
+					_mm_mul_ps(ad, _mm_sub_ps(_mm_set1_ps(3.55645f), _mm_mul_ps(ad, _mm_set1_ps(1.43519f)))))));
+				__m128 kb = _mm_add_ps(_mm_set1_ps(0.848013f), _mm_mul_ps(ad, _mm_add_ps(_mm_set1_ps(-1.06021f), _mm_mul_ps(ad, _mm_set1_ps(0.215638f)))));
+				__m128 centered = _mm_sub_ps(t, half);
+				__m128 k = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ka, centered), centered), kb);
+				t = _mm_add_ps(t, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, centered), _mm_sub_ps(t, one)), k));
+			}
+
+			__m128 rx = _mm_add_ps(ax, _mm_mul_ps(_mm_sub_ps(bx, ax), t));
+			__m128 ry = _mm_add_ps(ay, _mm_mul_ps(_mm_sub_ps(by, ay), t));
+			__m128 rz = _mm_add_ps(az, _mm_mul_ps(_mm_sub_ps(bz, az), t));
+			__m128 rw = _mm_add_ps(aw, _mm_mul_ps(_mm_sub_ps(bw, aw), t));
+
+			__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)), _mm_add_ps(_mm_mul_ps(rz, rz), _mm_mul_ps(rw, rw))));
+			__m128 inverseLength = _mm_div_ps(one, length);
+			rx = _mm_mul_ps(rx, inverseLength);
+			ry = _mm_mul_ps(ry, inverseLength);
+			rz = _mm_mul_ps(rz, inverseLength);
+			rw = _mm_mul_ps(rw, inverseLength);
+
+			_MM_TRANSPOSE4_PS(rx, ry, rz, rw);
+			_mm_storeu_ps(out + i * 4, rx);
+			_mm_storeu_ps(out + i * 4 + 4, ry);
+			_mm_storeu_ps(out + i * 4 + 8, rz);
+			_mm_storeu_ps(out + i * 4 + 12, rw);
+		}
+		BlendScalar(a + i * 4, b + i * 4, alpha + i * alphaStride, alphaStride, out + i * 4, count - i, corrected);
+	}
+#endif
+
+#ifdef QUAT_BLEND_NEON
+	void BlendNEON(const float* a, const float* b, const float* alpha, int alphaStride, float* out, int count, bool corrected)
+	{
+		const float32x4_t half = vdupq_n_f32(0.5f);
+		const float32x4_t one = vdupq_n_f32(1.0f);
+
+		int i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			// De-interleaving loads transpose four quaternions into component registers
+			float32x4x4_t qa = vld4q_f32(a + i * 4);
+			float32x4x4_t qb = vld4q_f32(b + i * 4);
+			float32x4_t t = alphaStride ? vld1q_f32(alpha + i) : vdupq_n_f32(*alpha);
+
+			float32x4_t d = vmulq_f32(qa.val[0], qb.val[0]);
+			for (int c = 1; c < 4; c++)
+				d = vmlaq_f32(d, qa.val[c], qb.val[c]);
+			uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(d), vdupq_n_u32(0x80000000u));
+			for (int c = 0; c < 4; c++)
+				qb.val[c] = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(qb.val[c]), sign));
+
+			if (corrected)
+			{
+				float32x4_t ad = vabsq_f32(d);
+				float32x4_t ka = vmlaq_f32(vdupq_n_f32(1.0904f), ad, vmlaq_f32(vdupq_n_f32(-3.2452f), ad, vmlsq_f32(vdupq_n_f32(3.55645f), ad, vdupq_n_f32(1.43519f))));
+				float32x4_t kb = vmlaq_f32(vdupq_n_f32(0.848013f), ad, vmlaq_f32(vdupq_n_f32(-1.06021f), ad, vdupq_n_f32(0.215638f)));
+				float32x4_t centered = vsubq_f32(t, half);
+				float32x4_t k = vmlaq_f32(kb, vmulq_f32(ka, centered), centered);
+				t = vmlaq_f32(t, vmulq_f32(vmulq_f32(t, centered), vsubq_f32(t, one)), k);
+			}
+
+			float32x4x4_t r;
+			for (int c = 0; c < 4; c++)
+				r.val[c] = vmlaq_f32(qa.val[c], vsubq_f32(qb.val[c], qa.val[c]), t);
+			float32x4_t lengthSquared = vmulq_f32(r.val[0], r.val[0]);
+			for (int c = 1; c < 4; c++)
+				lengthSquared = vmlaq_f32(lengthSquared, r.val[c], r.val[c]);
+			float32x4_t inverseLength = vdivq_f32(one, vsqrtq_f32(lengthSquared));
+			for (int c = 0; c < 4; c++)
+				r.val[c] = vmulq_f32(r.val[c], inverseLength);
+			vst4q_f32(out + i * 4, r);
+		}
+		BlendScalar(a + i * 4, b + i * 4, alpha + i * alphaStride, alphaStride, out + i * 4, count - i, corrected);
+	}
+#endif
+
+	void Blend(const glm::quat* a, const glm::quat* b, const float* alpha, int alphaStride, glm::quat* out, int count, bool corrected)
+	{
+		if (count <= 0)
+			return;
+#if defined(QUAT_BLEND_SSE)
+		BlendSSE(&a->x, &b->x, alpha, alphaStride, &out->x, count, corrected);
+#elif defined(QUAT_BLEND_NEON)
+		BlendNEON(&a->x, &b->x, alpha, alphaStride, &out->x, count, corrected);
+#else
+		BlendScalar(&a->x, &b->x, alpha, alphaStride, &out->x, count, corrected);
+#endif
+	}
+}
+
+glm::quat EulerToQuat(const glm::vec3& angles)
+{
+	float cx = cos(angles.x * 0.5f), sx = sin(angles.x * 0.5f);
+	float cy = cos(angles.y * 0.5f), sy = sin(angles.y * 0.5f);
+	float cz = cos(angles.z * 0.5f), sz = sin(angles.z * 0.5f);
+
+	// qx * qy * qz, expanded
+	return glm::quat(
+		cx * cy * cz - sx * sy * sz,
+		sx * cy * cz + cx * sy * sz,
+		cx * sy * cz - sx * cy * sz,
+		cx * cy * sz + sx * sy * cz);
+}
+
+glm::vec3 QuatToEuler(const glm::quat& q)
+{
+	// Entries of the rotation matrix, indexed [row][column]
+	float r02 = 2.0f * (q.x * q.z + q.w * q.y);
+	float r12 = 2.0f * (q.y * q.z - q.w * q.x);
+	float r22 = 1.0f - 2.0f * (q.x * q.x + q.y * q.y);
+	float r01 = 2.0f * (q.x * q.y - q.w * q.z);
+	float r00 = 1.0f - 2.0f * (q.y * q.y + q.z * q.z);
+
+	return glm::vec3(atan2(-r12, r22), asin(std::max(-1.0f, std::min(1.0f, r02))), atan2(-r01, r00));
+}
+
+glm::quat AddEulerAngle(const glm::quat& rotation, int axis, float angle)
+{
+	glm::quat result;
+	if (axis == 0)
+		result = AxisAngle(0, angle) * rotation; // Rx(a + angle) = Rx(angle) * Rx(a)
+	else if (axis == 2)
+		result = rotation * AxisAngle(2, angle); // Rz(c + angle) = Rz(c) * Rz(angle)
+	else
+	{
+		// Ry sits between the other two, so turn about y as seen after Rx
+		glm::quat x = AxisAngle(0, QuatToEuler(rotation).x);
+		result = x * AxisAngle(1, angle) * glm::conjugate(x) * rotation;
+	}
+	return glm::normalize(result);
+}
+
+void ComposeAffine(const glm::quat& q, const glm::vec3& translation, const glm::vec3& scale, const glm::vec3& pivot, glm::mat4& out)
+{
+	float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+	out[0] = glm::vec4((1.0f - 2.0f * (yy + zz)) * scale.x, 2.0f * (xy + wz) * scale.x, 2.0f * (xz - wy) * scale.x, 0.0f);
+	out[1] = glm::vec4(2.0f * (xy - wz) * scale.y, (1.0f - 2.0f * (xx + zz)) * scale.y, 2.0f * (yz + wx) * scale.y, 0.0f);
+	out[2] = glm::vec4(2.0f * (xz + wy) * scale.z, 2.0f * (yz - wx) * scale.z, (1.0f - 2.0f * (xx + yy)) * scale.z, 0.0f);
+
+	// The pivot is moved to the origin, rotated and scaled, then moved back
+	glm::vec3 offset = translation + pivot - (glm::vec3(out[0]) * pivot.x + glm::vec3(out[1]) * pivot.y + glm::vec3(out[2]) * pivot.z);
+	out[3] = glm::vec4(offset, 1.0f);
+}
+
+namespace QuatBlend
+{
+	void Nlerp(const glm::quat* a, const glm::quat* b, float alpha, glm::quat* out, int count)
+	{
+		Blend(a, b, &alpha, 0, out, count, false);
+	}
+
+	void Nlerp(const glm::quat* a, const glm::quat* b, const float* alpha, glm::quat* out, int count)
+	{
+		Blend(a, b, alpha, 1, out, count, false);
+	}
+
+	void Slerp(const glm::quat* a, const glm::quat* b, float alpha, glm::quat* out, int count)
+	{
+		Blend(a, b, &alpha, 0, out, count, true);
+	}
+
+	void Slerp(const glm::quat* a, const glm::quat* b, const float* alpha, glm::quat* out, int count)
+	{
+		Blend(a, b, alpha, 1, out, count, true);
+	}
+
+	const char* Name()
+	{
+#if defined(QUAT_BLEND_SSE)
+		return "SSE";
+#elif defined(QUAT_BLEND_NEON)
+		return "NEON";
+#else
+		return "scalar";
+#endif
+	}
+}
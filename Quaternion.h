@@ -0,0 +1,42 @@
+// Quaternion joint rotations written by Parker Drake
+#pragma once
+#ifndef _Quaternion_H_
+#define _Quaternion_H_
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Euler angles follow the order the skeleton used before quaternions:
+// rotateX, then rotateY, then rotateZ on the stack, so R = Rx * Ry * Rz.
+glm::quat EulerToQuat(const glm::vec3& angles);
+glm::vec3 QuatToEuler(const glm::quat& rotation);
+
+// Adds angle (radians) to one Euler angle of rotation (axis 0, 1 or 2) without
+// a round trip through Euler angles, so editing never flips to the other
+// Euler solution.
+glm::quat AddEulerAngle(const glm::quat& rotation, int axis, float angle);
+
+// out = T(translation + pivot) * R * S * T(-pivot), built directly from the
+// quaternion instead of a chain of matrix products. rotation must be unit length.
+void ComposeAffine(const glm::quat& rotation, const glm::vec3& translation, const glm::vec3& scale, const glm::vec3& pivot, glm::mat4& out);
+
+// Blends arrays of quaternions, four at a time with SSE or NEON where available.
+// Arrays may hold the joints of many characters back to back. out may alias a or b.
+// Each pair is blended along the shorter arc.
+namespace QuatBlend
+{
+	// Normalized linear interpolation, out[i] = normalize(mix(a[i], b[i], alpha))
+	void Nlerp(const glm::quat* a, const glm::quat* b, float alpha, glm::quat* out, int count);
+	void Nlerp(const glm::quat* a, const glm::quat* b, const float* alpha, glm::quat* out, int count);
+
+	// Spherical interpolation. Uses nlerp with a corrected blend factor, which stays
+	// within 1e-4 radians of exact slerp for rotations up to 90 degrees apart
+	// (a few 1e-3 for opposite ones) at a fraction of the cost.
+	void Slerp(const glm::quat* a, const glm::quat* b, float alpha, glm::quat* out, int count);
+	void Slerp(const glm::quat* a, const glm::quat* b, const float* alpha, glm::quat* out, int count);
+
+	// Instruction set used by the batched paths
+	const char* Name();
+}
+
+#endif
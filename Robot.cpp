@@ -0,0 +1,143 @@
+// Robot construction and animation functions written by Parker Drake
+#include "Robot.h"
+#include "Skeleton.h"
+#include "Pose.h"
+#include "AnimationClip.h"
+#include "Quaternion.h"
+
+#include <math.h>
+
+void ConstructRobot(Skeleton& robot)
+{
+	robot.Clear();
+
+	// Limbs are added parent-first
+	int torso = robot.AddJoint(-1, glm::vec3(0, 0, 0), glm::vec3(0, 0, 0), glm::vec3(0, 0, 0), glm::vec3(1.1, 2.2, 0.88));
+	robot.AddJoint(torso, glm::vec3(0, 2.5, 0), glm::vec3(0, 0, 0), glm::vec3(0, 0, 0), glm::vec3(.5, 0.5, 0.5)); // Head
+
+	int upperLeftArm = robot.AddJoint(torso, glm::vec3(2, 1.5, 0), glm::vec3(0, 0, 0), glm::vec3(-1.5, 0, 0), glm::vec3(1, 0.4, 0.4));
+	robot.AddJoint(upperLeftArm, glm::vec3(2, 0, 0), glm::vec3(0, 0, 0), glm::vec3(-1.5, 0, 0), glm::vec3(1, 0.3, 0.3)); // Lower left arm
+
+	int upperRightArm = robot.AddJoint(torso, glm::vec3(-2, 1.5, 0), glm::vec3(0, 0, 0), glm::vec3(1.5, 0, 0), glm::vec3(1, 0.4, 0.4));
+	robot.AddJoint(upperRightArm, glm::vec3(-2, 0, 0), glm::vec3(0, 0, 0), glm::vec3(1.5, 0, 0), glm::vec3(1, 0.3, 0.3)); // Lower right arm
+
+	int upperLeftLeg = robot.AddJoint(torso, glm::vec3(0.5, -4, 0), glm::vec3(0, 0, 0), glm::vec3(0, 2.5, 0), glm::vec3(0.45, 2, 0.5));
+	robot.AddJoint(upperLeftLeg, glm::vec3(0, -4, 0), glm::vec3(0, 0, 0), glm::vec3(0, 2.5, 0), glm::vec3(0.35, 2, 0.4)); // Lower left leg
+
+	int upperRightLeg = robot.AddJoint(torso, glm::vec3(-0.5, -4, 0), glm::vec3(0, 0, 0), glm::vec3(0, 2.5, 0), glm::vec3(0.45, 2, 0.5));
+	robot.AddJoint(upperRightLeg, glm::vec3(0, -4, 0), glm::vec3(0, 0, 0), glm::vec3(0, 2.5, 0), glm::vec3(0.35, 2, .4)); // Lower right leg
+}
+
+bool MatchesRobot(const Skeleton& skeleton)
+{
+	Skeleton robot;
+	ConstructRobot(robot);
+	return skeleton.parent == robot.parent;
+}
+
+void SetRunningStartPose(Skeleton& robot)
+{
+	// Limbs are looked up through the torso's children
+	int torso = 0;
+	int head = robot.Child(torso, 0);
+	int upperLeftArm = robot.Child(torso, 1);
+	int upperRightArm = robot.Child(torso, 2);
+	int upperLeftLeg = robot.Child(torso, 3);
+	int upperRightLeg = robot.Child(torso, 4);
+
+	robot.SetRotation(torso, EulerToQuat(glm::vec3(0.8, 0, 0))); // Torso position
+	robot.SetRotation(head, EulerToQuat(glm::vec3(-0.5, 0, 0))); // Head position
+	robot.SetRotation(upperLeftArm, EulerToQuat(glm::vec3(0.0, 1, 0))); // Left upper arm position
+	robot.SetRotation(robot.Child(upperLeftArm, 0), EulerToQuat(glm::vec3(0.0, 0, 0))); // Left lower arm position
+	robot.SetRotation(upperRightArm, EulerToQuat(glm::vec3(0.0, -1, 0))); // Right upper arm position
+	robot.SetRotation(robot.Child(upperRightArm, 0), EulerToQuat(glm::vec3(0.0, 0, 0))); // Right lower arm position
+	robot.SetRotation(upperLeftLeg, EulerToQuat(glm::vec3(-2, 0, 0))); // Left upper leg position
+	robot.SetRotation(robot.Child(upperLeftLeg, 0), EulerToQuat(glm::vec3(2, 0, 0))); // Left lower leg position
+	robot.SetRotation(upperRightLeg, EulerToQuat(glm::vec3(0.0, 0, 0))); // Right upper leg position
+	robot.SetRotation(robot.Child(upperRightLeg, 0), EulerToQuat(glm::vec3(0.0, 0, 0))); // Right lower leg position
+}
+
+void SetRunningPose(Skeleton& robot, double time, double frequency)
+{
+	int torso = 0;
+	int upperLeftArm = robot.Child(torso, 1);
+	int upperRightArm = robot.Child(torso, 2);
+	int upperLeftLeg = robot.Child(torso, 3);
+	int upperRightLeg = robot.Child(torso, 4);
+
+	robot.SetTranslation(torso, glm::vec3(0, 0.75 * sin(2 * frequency * time - 3.14 / 10), 0)); // Torso bounce
+	robot.SetRotation(torso, EulerToQuat(glm::vec3(0.8, 0.1 * sin(frequency * time), 0))); // Torso twist
+
+	robot.SetRotation(upperLeftArm, EulerToQuat(glm::vec3(0, 1, 0.2 * sin(frequency * time) - 0.5)));
+	robot.SetRotation(upperRightArm, EulerToQuat(glm::vec3(0, -1, 0.2 * sin(frequency * time) + 0.5)));
+
+	robot.SetRotation(upperLeftLeg, EulerToQuat(glm::vec3(sin(frequency * time) - 1, 0, 0)));
+	robot.SetRotation(robot.Child(upperLeftLeg, 0), EulerToQuat(glm::vec3((-1 * sin(frequency * time) + 1), 0, 0)));
+
+	robot.SetRotation(upperRightLeg, EulerToQuat(glm::vec3((-1 * sin(frequency * time) - 1), 0, 0)));
+	robot.SetRotation(robot.Child(upperRightLeg, 0), EulerToQuat(glm::vec3((sin(frequency * time) + 1), 0, 0)));
+}
+
+void SetIdlePose(Skeleton& robot, double time, double frequency)
+{
+	int torso = 0;
+	int head = robot.Child(torso, 0);
+	int upperLeftArm = robot.Child(torso, 1);
+	int upperRightArm = robot.Child(torso, 2);
+
+	for (int i = 0; i < robot.size(); i++)
+		robot.SetRotation(i, glm::quat(1, 0, 0, 0));
+
+	robot.SetTranslation(torso, glm::vec3(0, 0.1 * sin(frequency * time), 0)); // Breathing
+	robot.SetRotation(head, EulerToQuat(glm::vec3(0, 0.15 * cos(frequency * time), 0))); // Looking around
+	robot.SetRotation(upperLeftArm, EulerToQuat(glm::vec3(0, 0, -1.3 - 0.05 * sin(frequency * time)))); // Arms hang down
+	robot.SetRotation(upperRightArm, EulerToQuat(glm::vec3(0, 0, 1.3 + 0.05 * sin(frequency * time))));
+}
+
+void SetWavingPose(Skeleton& robot, double time, double frequency)
+{
+	int torso = 0;
+	int upperLeftArm = robot.Child(torso, 1);
+	int upperRightArm = robot.Child(torso, 2);
+
+	robot.SetRotation(upperLeftArm, EulerToQuat(glm::vec3(0, 0, -1.3)));
+	robot.SetRotation(robot.Child(upperLeftArm, 0), glm::quat(1, 0, 0, 0));
+	robot.SetRotation(upperRightArm, EulerToQuat(glm::vec3(0, 0.3, -1.0))); // Raised
+	robot.SetRotation(robot.Child(upperRightArm, 0), EulerToQuat(glm::vec3(0, 0, -0.6 + 0.5 * sin(frequency * time))));
+}
+
+bool ExportRobotClip(const char* path, RobotMotion motion, int framesPerCycle, int cycles)
+{
+	static const double frequencies[] = { 6, 2, 4 };
+	double frequency = frequencies[motion];
+
+	Skeleton robot;
+	ConstructRobot(robot);
+	SetRunningStartPose(robot);
+
+	// Every sine in a motion repeats after 2 pi / frequency seconds
+	double period = 2.0 * 3.14159265358979323846 / frequency;
+	double sampleRate = framesPerCycle / period;
+
+	ClipWriter writer;
+	if (!writer.Begin(path, robot.size(), (float)sampleRate, Pose::TRANSLATION | Pose::ROTATION))
+		return false;
+
+	Pose pose;
+	for (int frame = 0; frame < framesPerCycle * cycles; frame++)
+	{
+		double time = frame / (double)(float)sampleRate;
+		if (motion == MOTION_RUNNING)
+			SetRunningPose(robot, time, frequency);
+		else if (motion == MOTION_IDLE)
+			SetIdlePose(robot, time, frequency);
+		else
+		{
+			SetIdlePose(robot, 0.0);
+			SetWavingPose(robot, time, frequency);
+		}
+		pose.Capture(robot);
+		writer.AddFrame(pose);
+	}
+	return writer.Finish();
+}
@@ -0,0 +1,41 @@
+// Robot construction and animation functions written by Parker Drake
+#pragma once
+#ifndef _Robot_H_
+#define _Robot_H_
+
+class Skeleton;
+
+// Builds the ten limb robot: torso, head, two-part arms and two-part legs.
+// The torso is joint 0 and its children are ordered head, left arm, right arm, left leg, right leg.
+// scenes/robot.scene describes the same rig.
+void ConstructRobot(Skeleton& robot);
+
+// Whether skeleton has the robot's hierarchy, which the poses below depend on.
+// Offsets and sizes may differ.
+bool MatchesRobot(const Skeleton& skeleton);
+
+// Sets the pose the running cycle starts from
+void SetRunningStartPose(Skeleton& robot);
+
+// Poses the running cycle at time (in seconds)
+void SetRunningPose(Skeleton& robot, double time, double frequency = 6);
+
+// Standing with the arms down, breathing at time (in seconds)
+void SetIdlePose(Skeleton& robot, double time, double frequency = 2);
+
+// Raises the right arm and waves it at time (in seconds). Only the arms are posed.
+void SetWavingPose(Skeleton& robot, double time, double frequency = 4);
+
+// Built-in motions that can be exported as clips
+enum RobotMotion
+{
+	MOTION_RUNNING,
+	MOTION_IDLE,
+	MOTION_WAVING
+};
+
+// Samples cycles of motion at its default frequency into a looping clip. The sample rate is
+// chosen so one cycle spans exactly framesPerCycle keyframes. Returns false on I/O failure.
+bool ExportRobotClip(const char* path, RobotMotion motion, int framesPerCycle = 128, int cycles = 1);
+
+#endif
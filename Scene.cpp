@@ -0,0 +1,378 @@
+// Rig and crowd scene files written by Parker Drake
+#include "Scene.h"
+#include "Skeleton.h"
+#include "Crowd.h"
+#include "MatrixStack.h"
+#include "Quaternion.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+static const char SCENE_MAGIC[4] = { 'R', 'S', 'C', 'N' };
+
+namespace
+{
+	uint32_t Align16(size_t offset)
+	{
+		return (uint32_t)((offset + 15) & ~(size_t)15);
+	}
+
+	// Reads the three floats after a keyword
+	bool ReadVector(std::istringstream& words, glm::vec3& out)
+	{
+		return (bool)(words >> out.x >> out.y >> out.z);
+	}
+}
+
+glm::mat4 SceneInstance::Root() const
+{
+	MatrixStack placement;
+	placement.translate(position[0], position[1], position[2]);
+	placement.rotateY(yaw);
+	return placement.topMatrix();
+}
+
+Scene::Scene()
+{
+	Clear();
+}
+
+void Scene::Clear()
+{
+	file.Close();
+	names.clear();
+	ownedParents.clear();
+	ownedTranslations.clear();
+	ownedRotations.clear();
+	ownedPivots.clear();
+	ownedScales.clear();
+	ownedInstances.clear();
+	UseOwned();
+}
+
+void Scene::UseOwned()
+{
+	jointCount = (int)ownedParents.size();
+	instanceCount = (int)ownedInstances.size();
+	parents = ownedParents.empty() ? NULL : &ownedParents[0];
+	translations = ownedTranslations.empty() ? NULL : &ownedTranslations[0];
+	rotations = ownedRotations.empty() ? NULL : &ownedRotations[0];
+	pivots = ownedPivots.empty() ? NULL : &ownedPivots[0];
+	scales = ownedScales.empty() ? NULL : &ownedScales[0];
+	instances = ownedInstances.empty() ? NULL : &ownedInstances[0];
+}
+
+bool Scene::Load(const char* path)
+{
+	Clear();
+	char magic[4] = { 0, 0, 0, 0 };
+	std::ifstream probe(path, std::ios::in | std::ios::binary);
+	if (!probe)
+	{
+		std::cerr << "Failed to open the scene: " << path << std::endl;
+		return false;
+	}
+	probe.read(magic, sizeof(magic));
+	probe.close();
+
+	bool loaded = memcmp(magic, SCENE_MAGIC, sizeof(magic)) == 0 ? LoadBinary(path) : LoadText(path);
+	if (!loaded)
+		Clear();
+	return loaded;
+}
+
+bool Scene::LoadText(const char* path)
+{
+	std::ifstream ifs(path);
+	std::map<std::string, int> jointIndex;
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(ifs, line))
+	{
+		lineNumber++;
+		line = line.substr(0, line.find('#'));
+		std::istringstream words(line);
+		std::string keyword;
+		if (!(words >> keyword))
+			continue;
+
+		std::string error;
+		if (keyword == "joint")
+		{
+			std::string name, parentName, field;
+			glm::vec3 offset(0.0f), pivot(0.0f), scale(1.0f), rotation(0.0f);
+			words >> name >> parentName;
+			while (error.empty() && words >> field)
+			{
+				bool read = false;
+				if (field == "offset")
+					read = ReadVector(words, offset);
+				else if (field == "pivot")
+					read = ReadVector(words, pivot);
+				else if (field == "scale")
+					read = ReadVector(words, scale);
+				else if (field == "rotation")
+					read = ReadVector(words, rotation);
+				if (!read)
+					error = "expected x y z after offset, pivot, scale or rotation, got " + field;
+			}
+
+			std::map<std::string, int>::const_iterator parent = jointIndex.find(parentName);
+			if (!error.empty())
+				error = "joint " + name + ": " + error;
+			else if (parentName.empty())
+				error = "expected: joint <name> <parent|-> offset <x> <y> <z> pivot <x> <y> <z> scale <x> <y> <z>";
+			else if (jointIndex.count(name))
+				error = "joint " + name + " is defined twice";
+			else if (parentName != "-" && parent == jointIndex.end())
+				error = "parent " + parentName + " must be defined before " + name;
+			else if ((parentName == "-") != ownedParents.empty())
+				error = "the first joint, and only the first, is the root (parent -)";
+			else
+			{
+				glm::quat q = EulerToQuat(rotation);
+				float xyzw[4] = { q.x, q.y, q.z, q.w };
+				jointIndex[name] = (int)ownedParents.size();
+				names.push_back(name);
+				ownedParents.push_back(parentName == "-" ? -1 : parent->second);
+				ownedTranslations.push_back(offset);
+				ownedRotations.insert(ownedRotations.end(), xyzw, xyzw + 4);
+				ownedPivots.push_back(pivot);
+				ownedScales.push_back(scale);
+			}
+		}
+		else if (keyword == "instance")
+		{
+			SceneInstance instance = SceneInstance();
+			instance.frequency = 6.0f;
+			std::string field;
+			if (!(words >> instance.position[0] >> instance.position[1] >> instance.position[2]))
+				error = "expected: instance <x> <y> <z> [yaw <radians>] [phase <s>] [frequency <f>] [static]";
+			while (error.empty() && words >> field)
+			{
+				if (field == "static")
+					instance.flags |= SceneInstance::STATIC;
+				else if (!((field == "yaw" && words >> instance.yaw) || (field == "phase" && words >> instance.phase)
+					|| (field == "frequency" && words >> instance.frequency)))
+					error = "unknown or incomplete instance field " + field;
+			}
+			if (error.empty())
+				ownedInstances.push_back(instance);
+		}
+		else
+			error = "unknown statement " + keyword;
+
+		if (!error.empty())
+		{
+			std::cerr << path << ":" << lineNumber << ": " << error << std::endl;
+			return false;
+		}
+	}
+
+	if (ownedParents.empty())
+	{
+		std::cerr << path << " has no joints" << std::endl;
+		return false;
+	}
+	UseOwned();
+	return true;
+}
+
+bool Scene::LoadBinary(const char* path)
+{
+	if (!file.Open(path))
+		return false;
+
+	SceneHeader header;
+	if (file.Size() < sizeof(header))
+	{
+		std::cerr << path << " is truncated" << std::endl;
+		return false;
+	}
+	memcpy(&header, file.Data(), sizeof(header));
+	if (header.version != SCENE_VERSION)
+	{
+		std::cerr << path << " has scene version " << header.version << ", expected " << SCENE_VERSION << std::endl;
+		return false;
+	}
+
+	// Every array must be aligned and lie inside the file
+	size_t joints = header.jointCount;
+	uint32_t offsets[6] = { header.parentOffset, header.translationOffset, header.rotationOffset, header.pivotOffset, header.scaleOffset, header.instanceOffset };
+	size_t sizes[6] = { joints * sizeof(int32_t), joints * sizeof(glm::vec3), joints * 4 * sizeof(float), joints * sizeof(glm::vec3),
+		joints * sizeof(glm::vec3), (size_t)header.instanceCount * sizeof(SceneInstance) };
+	for (int i = 0; i < 6; i++)
+	{
+		if (offsets[i] < sizeof(header) || offsets[i] % 16 != 0 || offsets[i] + sizes[i] > file.Size())
+		{
+			std::cerr << path << " is truncated or malformed" << std::endl;
+			return false;
+		}
+	}
+	if (joints == 0)
+	{
+		std::cerr << path << " has no joints" << std::endl;
+		return false;
+	}
+
+	const unsigned char* data = file.Data();
+	const int32_t* mappedParents = (const int32_t*)(data + header.parentOffset);
+	for (size_t j = 0; j < joints; j++)
+	{
+		if (mappedParents[j] >= (int32_t)j || mappedParents[j] < -1 || (mappedParents[j] == -1) != (j == 0))
+		{
+			std::cerr << path << ": joint " << j << " has parent " << mappedParents[j] << ", joints must come parent first" << std::endl;
+			return false;
+		}
+	}
+
+	jointCount = (int)joints;
+	instanceCount = (int)header.instanceCount;
+	parents = mappedParents;
+	translations = (const glm::vec3*)(data + header.translationOffset);
+	rotations = (const float*)(data + header.rotationOffset);
+	pivots = (const glm::vec3*)(data + header.pivotOffset);
+	scales = (const glm::vec3*)(data + header.scaleOffset);
+	instances = instanceCount > 0 ? (const SceneInstance*)(data + header.instanceOffset) : NULL;
+	return true;
+}
+
+bool Scene::SaveText(const char* path) const
+{
+	FILE* out = fopen(path, "w");
+	if (!out)
+	{
+		std::cerr << "Unable to write the scene " << path << std::endl;
+		return false;
+	}
+
+	// Names are only known for text scenes
+	std::vector<std::string> jointNames(names);
+	for (int j = (int)jointNames.size(); j < jointCount; j++)
+		jointNames.push_back("joint" + std::to_string(j));
+
+	fprintf(out, "# %d joints, %d instances\n", jointCount, instanceCount);
+	for (int j = 0; j < jointCount; j++)
+	{
+		const float* q = rotations + 4 * j;
+		glm::vec3 rotation = QuatToEuler(glm::quat(q[3], q[0], q[1], q[2]));
+		fprintf(out, "joint %s %s offset %.9g %.9g %.9g pivot %.9g %.9g %.9g scale %.9g %.9g %.9g", jointNames[j].c_str(),
+			parents[j] < 0 ? "-" : jointNames[parents[j]].c_str(), translations[j].x, translations[j].y, translations[j].z,
+			pivots[j].x, pivots[j].y, pivots[j].z, scales[j].x, scales[j].y, scales[j].z);
+		if (rotation != glm::vec3(0.0f))
+			fprintf(out, " rotation %.9g %.9g %.9g", rotation.x, rotation.y, rotation.z);
+		fprintf(out, "\n");
+	}
+	for (int n = 0; n < instanceCount; n++)
+	{
+		const SceneInstance& instance = instances[n];
+		fprintf(out, "instance %.9g %.9g %.9g yaw %.9g phase %.9g frequency %.9g%s\n", instance.position[0], instance.position[1],
+			instance.position[2], instance.yaw, instance.phase, instance.frequency, instance.flags & SceneInstance::STATIC ? " static" : "");
+	}
+
+	bool written = !ferror(out);
+	written = fclose(out) == 0 && written;
+	if (!written)
+		std::cerr << "Unable to write the scene " << path << std::endl;
+	return written;
+}
+
+bool Scene::SaveBinary(const char* path) const
+{
+	SceneHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SCENE_MAGIC, sizeof(SCENE_MAGIC));
+	header.version = SCENE_VERSION;
+	header.jointCount = jointCount;
+	header.instanceCount = instanceCount;
+	header.parentOffset = Align16(sizeof(header));
+	header.translationOffset = Align16(header.parentOffset + jointCount * sizeof(int32_t));
+	header.rotationOffset = Align16(header.translationOffset + jointCount * sizeof(glm::vec3));
+	header.pivotOffset = Align16(header.rotationOffset + jointCount * 4 * sizeof(float));
+	header.scaleOffset = Align16(header.pivotOffset + jointCount * sizeof(glm::vec3));
+	header.instanceOffset = Align16(header.scaleOffset + jointCount * sizeof(glm::vec3));
+
+	std::vector<unsigned char> image(header.instanceOffset + instanceCount * sizeof(SceneInstance), 0);
+	memcpy(&image[0], &header, sizeof(header));
+	memcpy(&image[header.parentOffset], parents, jointCount * sizeof(int32_t));
+	memcpy(&image[header.translationOffset], translations, jointCount * sizeof(glm::vec3));
+	memcpy(&image[header.rotationOffset], rotations, jointCount * 4 * sizeof(float));
+	memcpy(&image[header.pivotOffset], pivots, jointCount * sizeof(glm::vec3));
+	memcpy(&image[header.scaleOffset], scales, jointCount * sizeof(glm::vec3));
+	if (instanceCount > 0)
+		memcpy(&image[header.instanceOffset], instances, instanceCount * sizeof(SceneInstance));
+
+	FILE* out = fopen(path, "wb");
+	bool written = out && fwrite(&image[0], 1, image.size(), out) == image.size();
+	if (out)
+		written = fclose(out) == 0 && written;
+	if (!written)
+		std::cerr << "Unable to write the scene " << path << std::endl;
+	return written;
+}
+
+void Scene::SetRig(const Skeleton& skeleton)
+{
+	// Keep the instances, which may live in the mapping
+	std::vector<SceneInstance> keep(instances, instances + instanceCount);
+	file.Close();
+	ownedInstances.swap(keep);
+
+	names.clear();
+	jointCount = skeleton.size();
+	ownedParents.assign(skeleton.parent.begin(), skeleton.parent.end());
+	ownedTranslations = skeleton.transRelParent;
+	ownedRotations.resize(jointCount * 4);
+	for (int j = 0; j < jointCount; j++)
+	{
+		const glm::quat& q = skeleton.rotRelJoint[j];
+		ownedRotations[j * 4 + 0] = q.x;
+		ownedRotations[j * 4 + 1] = q.y;
+		ownedRotations[j * 4 + 2] = q.z;
+		ownedRotations[j * 4 + 3] = q.w;
+	}
+	ownedPivots = skeleton.transRelJoint;
+	ownedScales = skeleton.scaleFactor;
+	UseOwned();
+}
+
+void Scene::AddInstance(const SceneInstance& instance)
+{
+	if (IsMapped())
+	{
+		// Copy out of the mapping before it goes
+		ownedParents.assign(parents, parents + jointCount);
+		ownedTranslations.assign(translations, translations + jointCount);
+		ownedRotations.assign(rotations, rotations + 4 * jointCount);
+		ownedPivots.assign(pivots, pivots + jointCount);
+		ownedScales.assign(scales, scales + jointCount);
+		ownedInstances.assign(instances, instances + instanceCount);
+		file.Close();
+	}
+	ownedInstances.push_back(instance);
+	UseOwned();
+}
+
+void Scene::BuildSkeleton(Skeleton& skeleton) const
+{
+	skeleton.Assign(jointCount, parents, translations, rotations, pivots, scales);
+}
+
+void Scene::BuildCrowd(Crowd& crowd) const
+{
+	crowd.Clear();
+	crowd.Reserve(instanceCount);
+	for (int n = 0; n < instanceCount; n++)
+	{
+		CrowdInstance instance;
+		instance.phase = instances[n].phase;
+		instance.frequency = instances[n].frequency;
+		instance.root = instances[n].Root();
+		instance.animated = !(instances[n].flags & SceneInstance::STATIC);
+		crowd.Add(instance);
+	}
+}
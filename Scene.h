@@ -0,0 +1,127 @@
+// Rig and crowd scene files written by Parker Drake
+#pragma once
+#ifndef _Scene_H_
+#define _Scene_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "MappedFile.h"
+
+class Skeleton;
+class Crowd;
+
+// One placed character: a translation and a turn about y, like the crowd grid
+struct SceneInstance
+{
+	float position[3];
+	float yaw; // Radians
+	float phase; // Time offset into the running cycle, in seconds
+	float frequency; // Running cycle frequency
+	uint32_t flags; // SceneInstance::STATIC
+	uint32_t reserved;
+
+	enum { STATIC = 1 }; // Holds its pose instead of animating
+
+	glm::mat4 Root() const;
+};
+
+// Binary layout (little-endian), version 1:
+//   SceneHeader
+//   jointCount parents (int32, -1 for the root, always below the joint's index)
+//   jointCount translations from the parent limb (x, y, z floats)
+//   jointCount rotations relative to the parent joint (x, y, z, w quaternions)
+//   jointCount translations relative to the parent joint (x, y, z floats)
+//   jointCount limb scales (x, y, z floats)
+//   instanceCount SceneInstance records
+// Each array starts at its offset, 16-byte aligned. The arrays are the
+// Skeleton's own layout, so the mapped file is used as is; joint names are
+// only kept by the text form.
+struct SceneHeader
+{
+	char magic[4]; // "RSCN"
+	uint32_t version;
+	uint32_t jointCount;
+	uint32_t instanceCount;
+	uint32_t parentOffset;
+	uint32_t translationOffset;
+	uint32_t rotationOffset;
+	uint32_t pivotOffset;
+	uint32_t scaleOffset;
+	uint32_t instanceOffset;
+};
+
+static const uint32_t SCENE_VERSION = 1;
+
+// A rig and the placements of its instances. Text scenes have one statement
+// per line ('#' starts a comment):
+//
+//   joint <name> <parent|-> offset <x> <y> <z> pivot <x> <y> <z> scale <x> <y> <z> [rotation <x> <y> <z>]
+//   instance <x> <y> <z> [yaw <radians>] [phase <s>] [frequency <f>] [static]
+//
+// Joints come parent first. offset is the translation from the parent limb,
+// pivot the translation of the limb from the joint it turns about, and
+// rotation the Euler angles it starts at (see EulerToQuat). Instances default
+// to yaw 0, phase 0 and frequency 6. Binary scenes (see SceneHeader) are
+// memory mapped and read in place; Load tells the two apart by the magic.
+class Scene
+{
+public:
+	Scene();
+
+	// Returns false, with a message naming the line or the problem, if the file cannot be used
+	bool Load(const char* path);
+	bool SaveText(const char* path) const;
+	bool SaveBinary(const char* path) const;
+	void Clear();
+	bool IsMapped() const { return file.IsOpen(); }
+
+	int JointCount() const { return jointCount; }
+	int InstanceCount() const { return instanceCount; }
+	const int32_t* Parents() const { return parents; }
+	const glm::vec3* Translations() const { return translations; }
+	const float* Rotations() const { return rotations; } // x, y, z, w per joint
+	const glm::vec3* Pivots() const { return pivots; }
+	const glm::vec3* Scales() const { return scales; }
+	const SceneInstance* Instances() const { return instances; }
+
+	// Replaces the rig with the skeleton's current channels
+	void SetRig(const Skeleton& skeleton);
+	void AddInstance(const SceneInstance& instance);
+
+	// Sets skeleton to the rig, with one allocation per array
+	void BuildSkeleton(Skeleton& skeleton) const;
+	// Replaces the crowd's instances with the scene's
+	void BuildCrowd(Crowd& crowd) const;
+
+private:
+	Scene(const Scene&);
+	Scene& operator=(const Scene&);
+
+	bool LoadText(const char* path);
+	bool LoadBinary(const char* path);
+	// Points the accessors at the owned arrays after they change
+	void UseOwned();
+
+	MappedFile file;
+	int jointCount;
+	int instanceCount;
+	const int32_t* parents;
+	const glm::vec3* translations;
+	const float* rotations;
+	const glm::vec3* pivots;
+	const glm::vec3* scales;
+	const SceneInstance* instances;
+
+	// Text scenes and scenes built in code
+	std::vector<std::string> names;
+	std::vector<int32_t> ownedParents;
+	std::vector<glm::vec3> ownedTranslations;
+	std::vector<float> ownedRotations;
+	std::vector<glm::vec3> ownedPivots;
+	std::vector<glm::vec3> ownedScales;
+	std::vector<SceneInstance> ownedInstances;
+};
+
+#endif
@@ -0,0 +1,379 @@
+// Shader program cache and hot reload written by Parker Drake
+#include "ShaderCache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+namespace
+{
+	const double CHECK_INTERVAL = 0.25; // Seconds between looks at the shader files
+	const int RELINK_FRAMES = 2; // Polls a relink gets before its status is read, without KHR_parallel_shader_compile
+
+	// Precedes the driver's program binary in a cache file
+	struct BinaryHeader
+	{
+		char magic[4];
+		GLenum format;
+		GLint length;
+	};
+	const char BINARY_MAGIC[4] = { 'S', 'H', 'B', 'N' };
+
+	// FNV-1a, continued from hash
+	unsigned long long Hash(const std::string& text, unsigned long long hash)
+	{
+		for (size_t i = 0; i < text.size(); i++)
+		{
+			hash ^= (unsigned char)text[i];
+			hash *= 1099511628211ULL;
+		}
+		// Separates consecutive strings so "ab" + "c" and "a" + "bc" differ
+		hash ^= 0xFF;
+		return hash * 1099511628211ULL;
+	}
+
+	std::string GLString(GLenum name)
+	{
+		const GLubyte* text = glGetString(name);
+		return text ? std::string((const char*)text) : std::string();
+	}
+
+	void MakeDirectory(const std::string& path)
+	{
+		// Fails harmlessly when it already exists
+#ifdef _WIN32
+		_mkdir(path.c_str());
+#else
+		mkdir(path.c_str(), 0755);
+#endif
+	}
+}
+
+ShaderCache::ShaderCache()
+	: binaries(false), parallel(false), lastCheck(0.0)
+{
+}
+
+ShaderCache::~ShaderCache()
+{
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		if (entries[i].pendingProgram)
+		{
+			glDeleteShader(entries[i].pendingShaders[0]);
+			glDeleteShader(entries[i].pendingShaders[1]);
+			glDeleteProgram(entries[i].pendingProgram);
+		}
+		if (entries[i].pendingFence)
+			glDeleteSync(entries[i].pendingFence);
+	}
+}
+
+void ShaderCache::Init(const std::string& shaders, const char* cache)
+{
+	shaderDirectory = shaders;
+	if (!shaderDirectory.empty() && shaderDirectory[shaderDirectory.size() - 1] != '/' && shaderDirectory[shaderDirectory.size() - 1] != '\\')
+		shaderDirectory += '/';
+	cacheDirectory = cache ? cache : "";
+	driver = GLString(GL_VENDOR) + "\n" + GLString(GL_RENDERER) + "\n" + GLString(GL_VERSION);
+
+	GLint formats = 0;
+	if (GLEW_ARB_get_program_binary)
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	binaries = cache && formats > 0;
+
+	parallel = false;
+#ifdef GL_KHR_parallel_shader_compile
+	if (GLEW_KHR_parallel_shader_compile)
+	{
+		// Let the driver use as many threads as it likes
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		parallel = true;
+	}
+#endif
+}
+
+void ShaderCache::Add(Program& program, const char* vertexFile, const char* fragmentFile)
+{
+	Entry entry;
+	entry.program = &program;
+	entry.vertexPath = shaderDirectory + vertexFile;
+	entry.fragmentPath = shaderDirectory + fragmentFile;
+	entry.vertexTime = entry.fragmentTime = -1;
+	entry.key = 0;
+	entry.built = false;
+	entry.pendingProgram = 0;
+	entry.pendingShaders[0] = entry.pendingShaders[1] = 0;
+	entry.pendingKey = 0;
+	entry.pendingFence = 0;
+	entry.pendingFrames = 0;
+	entries.push_back(entry);
+}
+
+bool ShaderCache::Build()
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bool ok = true;
+	std::vector<int> compiling;
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		Entry& entry = entries[i];
+		if (entry.built)
+			continue;
+		entry.built = true;
+
+		// Stamped before reading, so a missing file is retried by Poll once it appears
+		entry.vertexTime = ModificationTime(entry.vertexPath);
+		entry.fragmentTime = ModificationTime(entry.fragmentPath);
+		std::string vertexSource, fragmentSource;
+		if (!Program::ReadShader(entry.vertexPath.c_str(), vertexSource) || !Program::ReadShader(entry.fragmentPath.c_str(), fragmentSource))
+		{
+			stats.failed++;
+			ok = false;
+			continue;
+		}
+
+		entry.key = Key(vertexSource, fragmentSource);
+		GLuint restored = LoadBinary(entry.key);
+		if (restored)
+		{
+			entry.program->Adopt(restored);
+			stats.binaryHits++;
+			continue;
+		}
+		Start(entry, vertexSource, fragmentSource, entry.key);
+		compiling.push_back((int)i);
+	}
+
+	// Every compile is queued before the first status query, which waits for its program
+	for (size_t i = 0; i < compiling.size(); i++)
+	{
+		Entry& entry = entries[compiling[i]];
+		GLuint linked = Finish(entry);
+		if (linked)
+		{
+			entry.program->Adopt(linked);
+			stats.compiled++;
+		}
+		else
+		{
+			stats.failed++;
+			ok = false;
+		}
+	}
+
+	stats.buildSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return ok;
+}
+
+void ShaderCache::Poll(double time)
+{
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		Entry& entry = entries[i];
+		if (!entry.pendingProgram || !Ready(entry))
+			continue;
+		unsigned long long key = entry.pendingKey;
+		GLuint linked = Finish(entry);
+		if (!linked)
+		{
+			// Keep drawing with the last program that worked
+			stats.failed++;
+			continue;
+		}
+		entry.program->Adopt(linked);
+		entry.key = key;
+		stats.reloads++;
+		std::cout << "Reloaded " << entry.vertexPath << " and " << entry.fragmentPath << std::endl;
+	}
+
+	if (time - lastCheck < CHECK_INTERVAL)
+		return;
+	lastCheck = time;
+
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		Entry& entry = entries[i];
+		if (!entry.built || entry.pendingProgram)
+			continue;
+		long long vertexTime = ModificationTime(entry.vertexPath);
+		long long fragmentTime = ModificationTime(entry.fragmentPath);
+		if (vertexTime == entry.vertexTime && fragmentTime == entry.fragmentTime)
+			continue;
+		entry.vertexTime = vertexTime;
+		entry.fragmentTime = fragmentTime;
+
+		std::string vertexSource, fragmentSource;
+		if (!Program::ReadShader(entry.vertexPath.c_str(), vertexSource) || !Program::ReadShader(entry.fragmentPath.c_str(), fragmentSource))
+			continue;
+		unsigned long long key = Key(vertexSource, fragmentSource);
+		if (key == entry.key && entry.program->IsLinked())
+			continue;
+
+		GLuint restored = LoadBinary(key);
+		if (restored)
+		{
+			entry.program->Adopt(restored);
+			entry.key = key;
+			stats.binaryHits++;
+			stats.reloads++;
+			std::cout << "Reloaded " << entry.vertexPath << " and " << entry.fragmentPath << " from the cache" << std::endl;
+			continue;
+		}
+		Start(entry, vertexSource, fragmentSource, key);
+	}
+}
+
+unsigned long long ShaderCache::Key(const std::string& vertexSource, const std::string& fragmentSource) const
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	hash = Hash(vertexSource, hash);
+	hash = Hash(fragmentSource, hash);
+	return Hash(driver, hash);
+}
+
+std::string ShaderCache::BinaryPath(unsigned long long key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", key);
+	return cacheDirectory + "/" + name;
+}
+
+GLuint ShaderCache::LoadBinary(unsigned long long key) const
+{
+	if (!binaries)
+		return 0;
+	std::ifstream in(BinaryPath(key).c_str(), std::ios::in | std::ios::binary);
+	if (!in)
+		return 0;
+	BinaryHeader header;
+	in.read((char*)&header, sizeof(header));
+	if (!in || memcmp(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0 || header.length <= 0)
+		return 0;
+	std::vector<char> data(header.length);
+	in.read(&data[0], header.length);
+	if (!in)
+		return 0;
+
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, header.format, &data[0], header.length);
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status == GL_FALSE)
+	{
+		// The driver no longer accepts it; compiling from source replaces the file
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+void ShaderCache::StoreBinary(unsigned long long key, GLuint program) const
+{
+	if (!binaries)
+		return;
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+	BinaryHeader header;
+	memcpy(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+	std::vector<char> data(length);
+	GLsizei written = 0;
+	glGetProgramBinary(program, length, &written, &header.format, &data[0]);
+	header.length = written;
+
+	MakeDirectory(cacheDirectory);
+	std::string path = BinaryPath(key);
+	std::ofstream out(path.c_str(), std::ios::out | std::ios::binary);
+	out.write((const char*)&header, sizeof(header));
+	out.write(&data[0], written);
+	if (!out)
+		std::cerr << "Unable to write the shader binary " << path << std::endl;
+}
+
+void ShaderCache::Start(Entry& entry, const std::string& vertexSource, const std::string& fragmentSource, unsigned long long key)
+{
+	entry.pendingShaders[0] = Program::CompileShader(GL_VERTEX_SHADER, vertexSource);
+	entry.pendingShaders[1] = Program::CompileShader(GL_FRAGMENT_SHADER, fragmentSource);
+	entry.pendingProgram = glCreateProgram();
+	glAttachShader(entry.pendingProgram, entry.pendingShaders[0]);
+	glAttachShader(entry.pendingProgram, entry.pendingShaders[1]);
+
+	// A reloaded program keeps the attribute locations vertex arrays were set up with
+	const std::map<std::string, GLint>& attributes = entry.program->GetAttributeLocations();
+	for (std::map<std::string, GLint>::const_iterator it = attributes.begin(); it != attributes.end(); ++it)
+	{
+		if (it->second >= 0)
+			glBindAttribLocation(entry.pendingProgram, it->second, it->first.c_str());
+	}
+	if (binaries)
+		glProgramParameteri(entry.pendingProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+	// Linking right away lets the driver carry on without us asking whether the shaders compiled
+	glLinkProgram(entry.pendingProgram);
+	entry.pendingKey = key;
+	entry.pendingFrames = 0;
+	if (!parallel)
+		entry.pendingFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLuint ShaderCache::Finish(Entry& entry)
+{
+	GLuint program = entry.pendingProgram;
+	bool compiled = Program::CheckShaderCompileStatus(entry.pendingShaders[0], entry.vertexPath.c_str());
+	compiled = Program::CheckShaderCompileStatus(entry.pendingShaders[1], entry.fragmentPath.c_str()) && compiled;
+	bool linked = compiled && Program::CheckLinkStatus(program, entry.vertexPath.c_str(), entry.fragmentPath.c_str());
+
+	glDetachShader(program, entry.pendingShaders[0]);
+	glDetachShader(program, entry.pendingShaders[1]);
+	glDeleteShader(entry.pendingShaders[0]);
+	glDeleteShader(entry.pendingShaders[1]);
+	entry.pendingProgram = 0;
+	entry.pendingShaders[0] = entry.pendingShaders[1] = 0;
+	if (entry.pendingFence)
+		glDeleteSync(entry.pendingFence);
+	entry.pendingFence = 0;
+
+	if (!linked)
+	{
+		glDeleteProgram(program);
+		return 0;
+	}
+	StoreBinary(entry.pendingKey, program);
+	return program;
+}
+
+bool ShaderCache::Ready(Entry& entry)
+{
+	if (!parallel)
+	{
+		// Reading the link status forces the driver to finish it, so give it
+		// frames of its own and wait until it has worked through the link
+		if (++entry.pendingFrames < RELINK_FRAMES)
+			return false;
+		return !entry.pendingFence || glClientWaitSync(entry.pendingFence, 0, 0) != GL_TIMEOUT_EXPIRED;
+	}
+#ifdef GL_KHR_parallel_shader_compile
+	GLint done = GL_FALSE;
+	glGetProgramiv(entry.pendingProgram, GL_COMPLETION_STATUS_KHR, &done);
+	return done != GL_FALSE;
+#else
+	return true;
+#endif
+}
+
+long long ShaderCache::ModificationTime(const std::string& path)
+{
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0)
+		return -1;
+	// Seconds alone miss two saves in the same second, so the size is folded in too
+	return (long long)info.st_mtime * 1000003LL + (long long)info.st_size;
+}
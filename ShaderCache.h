@@ -0,0 +1,97 @@
+// Shader program cache and hot reload written by Parker Drake
+#pragma once
+#ifndef _ShaderCache_H_
+#define _ShaderCache_H_
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+#include "Program.h"
+
+// Programs loaded, compiled and reloaded by a ShaderCache
+struct ShaderCacheStats
+{
+	int binaryHits; // Programs restored from a stored binary
+	int compiled; // Programs compiled and linked from source
+	int failed; // Programs that did not compile or link
+	int reloads; // Edited programs swapped in while running
+	double buildSeconds; // Wall time spent in Build
+
+	ShaderCacheStats() : binaryHits(0), compiled(0), failed(0), reloads(0), buildSeconds(0.0) {}
+};
+
+// Builds Programs from vertex/fragment file pairs in one shader directory.
+// Programs are keyed by a hash of their sources and the driver, and linked
+// binaries are stored in the cache directory with glGetProgramBinary, so
+// later starts restore them instead of compiling. Missing programs are
+// compiled together, letting drivers with KHR_parallel_shader_compile work
+// on them at once. Poll watches the files and relinks edited programs in
+// the background; the old program stays in use until the new one links.
+// Without the extension a relink is given a few frames and a fence behind
+// it before its status is read.
+class ShaderCache
+{
+public:
+	ShaderCache();
+	~ShaderCache();
+
+	// cacheDirectory may be NULL to always compile from source
+	void Init(const std::string& shaderDirectory, const char* cacheDirectory);
+
+	// The program is filled in by Build; file names are relative to the shader directory
+	void Add(Program& program, const char* vertexFile, const char* fragmentFile);
+	// Loads or compiles every program added since the last Build. Diagnostics go
+	// to std::cerr, and returns false if any program is left unlinked.
+	bool Build();
+
+	// Call once per frame. Checks for edited files a few times a second, and
+	// swaps in relinked programs once the driver has finished them.
+	void Poll(double time);
+
+	const ShaderCacheStats& GetStats() const { return stats; }
+
+private:
+	ShaderCache(const ShaderCache&);
+	ShaderCache& operator=(const ShaderCache&);
+
+	struct Entry
+	{
+		Program* program;
+		std::string vertexPath, fragmentPath;
+		long long vertexTime, fragmentTime; // Modification times of the loaded sources
+		unsigned long long key; // Hash of the loaded sources
+		bool built;
+
+		// Relink in flight
+		GLuint pendingProgram;
+		GLuint pendingShaders[2];
+		unsigned long long pendingKey;
+		// Without KHR_parallel_shader_compile: passed once the driver got through the link
+		GLsync pendingFence;
+		int pendingFrames; // Polls since the relink started
+	};
+
+	unsigned long long Key(const std::string& vertexSource, const std::string& fragmentSource) const;
+	std::string BinaryPath(unsigned long long key) const;
+	// Returns a linked program restored from the cache, or 0
+	GLuint LoadBinary(unsigned long long key) const;
+	void StoreBinary(unsigned long long key, GLuint program) const;
+	// Starts compiling and linking; the result is read by Finish
+	void Start(Entry& entry, const std::string& vertexSource, const std::string& fragmentSource, unsigned long long key);
+	// Returns the linked program, or 0 after printing the diagnostics
+	GLuint Finish(Entry& entry);
+	// Whether Finish can read the result without waiting; called once per Poll
+	bool Ready(Entry& entry);
+	static long long ModificationTime(const std::string& path);
+
+	std::string shaderDirectory;
+	std::string cacheDirectory;
+	std::string driver; // Vendor, renderer and version; binaries only load on the driver that made them
+	bool binaries;
+	bool parallel;
+	std::vector<Entry> entries;
+	double lastCheck;
+	ShaderCacheStats stats;
+};
+
+#endif
@@ -0,0 +1,43 @@
+// Fixed timestep simulation clock written by Parker Drake
+#include "SimulationClock.h"
+
+#include <math.h>
+
+SimulationClock::SimulationClock(double s, int m)
+	: step(s), maxSteps(m), last(0.0), accumulator(0.0), time(0.0), dropped(0)
+{
+}
+
+void SimulationClock::Reset(double now)
+{
+	last = now;
+	accumulator = 0.0;
+	dropped = 0;
+}
+
+int SimulationClock::Advance(double now)
+{
+	double elapsed = now - last;
+	last = now;
+	if (elapsed > 0.0)
+		accumulator += elapsed;
+
+	int steps = (int)floor(accumulator / step);
+	if (steps > maxSteps)
+	{
+		// Too far behind: keep the fraction for interpolation and drop the rest
+		dropped += steps - maxSteps;
+		accumulator = fmod(accumulator, step) + maxSteps * step;
+		steps = maxSteps;
+	}
+	return steps;
+}
+
+double SimulationClock::Tick()
+{
+	accumulator -= step;
+	if (accumulator < 0.0)
+		accumulator = 0.0;
+	time += step;
+	return time;
+}
@@ -0,0 +1,40 @@
+// Fixed timestep simulation clock written by Parker Drake
+#pragma once
+#ifndef _SimulationClock_H_
+#define _SimulationClock_H_
+
+// Turns real elapsed time into a whole number of fixed simulation steps.
+// What is left over is exposed as Alpha() so rendering can interpolate
+// between the previous and the current simulation state.
+class SimulationClock
+{
+public:
+	// step is the simulation timestep in seconds. At most maxSteps are run per
+	// Advance(); older backlog is dropped so a slow frame cannot snowball.
+	SimulationClock(double step = 1.0 / 120.0, int maxSteps = 8);
+
+	// Starts counting real time from now (in seconds)
+	void Reset(double now);
+	// Accounts real time up to now and returns how many steps are due
+	int Advance(double now);
+	// Starts the next step and returns the simulation time it produces
+	double Tick();
+
+	double Step() const { return step; }
+	int MaxSteps() const { return maxSteps; }
+	double Time() const { return time; }
+	// How far real time is between the last two simulated states, in [0, 1]
+	double Alpha() const { return accumulator < step ? accumulator / step : 1.0; }
+	// Steps that were due but dropped since the last Reset()
+	long long DroppedSteps() const { return dropped; }
+
+private:
+	double step;
+	int maxSteps;
+	double last;
+	double accumulator;
+	double time;
+	long long dropped;
+};
+
+#endif
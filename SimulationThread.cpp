@@ -0,0 +1,126 @@
+// Simulation on its own thread written by Parker Drake
+#include "SimulationThread.h"
+#include "SimulationClock.h"
+#include "InputRecording.h"
+#include "AnimationGraph.h"
+
+#include <algorithm>
+#include <chrono>
+
+double SimulationFrame::Alpha(double now) const
+{
+	double alpha = (now - stateTime) / step;
+	return alpha < 0.0 ? 0.0 : alpha > 1.0 ? 1.0 : alpha;
+}
+
+SimulationThread::SimulationThread()
+	: quit(false), input(256), unhandled(256), controls(NULL), robot(NULL), clock(NULL), recorder(NULL), graph(NULL),
+	inputSerial(0), inputTime(0.0), steps(0), published(0), dropped(0)
+{
+}
+
+SimulationThread::~SimulationThread()
+{
+	Stop();
+}
+
+void SimulationThread::Start(Controls& controls, Skeleton& robot, SimulationClock& clock, InputRecorder* recorder,
+	const AnimationGraph* graph, const std::function<double()>& now)
+{
+	Stop();
+	this->controls = &controls;
+	this->robot = &robot;
+	this->clock = &clock;
+	this->recorder = recorder;
+	this->graph = graph;
+	this->now = now;
+	previous = robot;
+
+	// The renderer always has a frame to draw, even before the first step
+	Publish(now());
+	quit = false;
+	thread = std::thread(&SimulationThread::Run, this);
+}
+
+void SimulationThread::Stop()
+{
+	if (!thread.joinable())
+		return;
+	quit = true;
+	thread.join();
+}
+
+bool SimulationThread::Post(const InputEvent& event, double time)
+{
+	PostedEvent posted;
+	posted.event = event;
+	posted.time = time;
+	if (input.Push(posted))
+		return true;
+	dropped++;
+	return false;
+}
+
+void SimulationThread::Run()
+{
+	while (!quit.load(std::memory_order_acquire))
+	{
+		// Events first, then the steps that are due, in the order a replay applies them
+		double time = now();
+		bool handled = false;
+		PostedEvent posted;
+		while (input.Pop(posted))
+		{
+			if (recorder)
+				recorder->Record(posted.event);
+			if (!controls->Handle(posted.event) && !unhandled.Push(posted.event))
+				dropped++; // The render thread is not taking them back
+			inputSerial++;
+			inputTime = posted.time;
+			handled = true;
+		}
+
+		int due = clock->Advance(time);
+		for (int i = 0; i < due; i++)
+		{
+			previous = *robot;
+			controls->Simulate(clock->Tick(), clock->Step());
+		}
+		steps += due;
+
+		// Every clock reading is recorded, so a replay's clock ends where this one does
+		if (recorder)
+			recorder->EndFrame(time, due);
+		if (due > 0 || handled)
+			Publish(time);
+
+		// Sleep until the next step is due, looking for input every millisecond
+		double wake = time + clock->Step() * (1.0 - clock->Alpha());
+		while (!quit.load(std::memory_order_relaxed) && input.Empty())
+		{
+			double left = wake - now();
+			if (left <= 0.0)
+				break;
+			std::this_thread::sleep_for(std::chrono::duration<double>(std::min(left, 0.001)));
+		}
+	}
+}
+
+void SimulationThread::Publish(double time)
+{
+	SimulationFrame& frame = frames.Back();
+	frame.previous = previous;
+	frame.current = *robot;
+	frame.eye = controls->eye;
+	frame.center = controls->center;
+	frame.up = controls->up;
+	frame.limbIndex = controls->limbIndex;
+	frame.animationState = graph && graph->IsLoaded() ? graph->CurrentState() : -1;
+	frame.stateTime = time - clock->Alpha() * clock->Step();
+	frame.step = clock->Step();
+	frame.inputSerial = inputSerial;
+	frame.inputTime = inputTime;
+	frame.steps = steps;
+	frames.Publish();
+	published++;
+}
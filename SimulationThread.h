@@ -0,0 +1,112 @@
+// Simulation on its own thread written by Parker Drake
+#pragma once
+#ifndef _SimulationThread_H_
+#define _SimulationThread_H_
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <glm/glm.hpp>
+#include "Controls.h"
+#include "Skeleton.h"
+#include "SpscQueue.h"
+#include "TripleBuffer.h"
+
+class SimulationClock;
+class InputRecorder;
+class AnimationGraph;
+
+// What the renderer takes from the simulation: the last two states to
+// interpolate between and the camera and selection they were simulated with
+struct SimulationFrame
+{
+	Skeleton previous;
+	Skeleton current;
+	glm::vec3 eye;
+	glm::vec3 center;
+	glm::vec3 up;
+	int limbIndex;
+	int animationState; // Animation graph state, -1 without a graph
+	double stateTime; // Clock time current is due at; previous is one step earlier
+	double step;
+	long long inputSerial; // Input events applied so far
+	double inputTime; // Clock time the newest of them was posted at
+	long long steps; // Simulation steps run so far
+
+	// How far the clock reading now is between previous and current, in [0, 1]
+	double Alpha(double now) const;
+};
+
+// Runs the fixed-step simulation of the viewer on a thread of its own. Input
+// arrives through a lock-free queue instead of callbacks writing the controls,
+// and every state is published through a triple buffer, so the render thread
+// only ever copies out the newest finished frame and neither side waits on
+// the other. Events the controls do not handle go back through a second queue.
+//
+// While it runs, the thread owns the controls, the robot, the clock, the
+// graph and the recorder given to Start(); they are the caller's again after Stop().
+class SimulationThread
+{
+public:
+	SimulationThread();
+	~SimulationThread();
+
+	// controls must be attached to robot and clock reset. recorder and graph may
+	// be NULL. now reads the clock the simulation and the event times are on.
+	void Start(Controls& controls, Skeleton& robot, SimulationClock& clock, InputRecorder* recorder,
+		const AnimationGraph* graph, const std::function<double()>& now);
+	void Stop();
+	bool IsRunning() const { return thread.joinable(); }
+
+	// Render thread: queues an event posted at time. Returns false, dropping it, if the queue is full.
+	bool Post(const InputEvent& event, double time);
+	// Events lost to a full queue, either way
+	long long Dropped() const { return dropped.load(std::memory_order_relaxed); }
+	// Render thread: the next event the controls left to the window
+	bool PollUnhandled(InputEvent& event) { return unhandled.Pop(event); }
+
+	// Render thread: makes the newest published frame current. Returns false,
+	// keeping the current one, if nothing was published since.
+	bool Acquire() { return frames.Acquire(); }
+	const SimulationFrame& Frame() const { return frames.Front(); }
+
+	// Owned by the simulation thread until Stop()
+	const Skeleton& Previous() const { return previous; }
+	// States published so far; any thread
+	long long Published() const { return published.load(std::memory_order_relaxed); }
+
+private:
+	SimulationThread(const SimulationThread&);
+	SimulationThread& operator=(const SimulationThread&);
+
+	struct PostedEvent
+	{
+		InputEvent event;
+		double time;
+	};
+
+	void Run();
+	void Publish(double now);
+
+	std::thread thread;
+	std::atomic<bool> quit;
+	SpscQueue<PostedEvent> input;
+	SpscQueue<InputEvent> unhandled;
+	TripleBuffer<SimulationFrame> frames;
+
+	Controls* controls;
+	Skeleton* robot;
+	SimulationClock* clock;
+	InputRecorder* recorder;
+	const AnimationGraph* graph;
+	std::function<double()> now;
+
+	Skeleton previous;
+	long long inputSerial;
+	double inputTime;
+	long long steps;
+	std::atomic<long long> published;
+	std::atomic<long long> dropped; // Events either thread could not queue
+};
+
+#endif
@@ -0,0 +1,189 @@
+// Flat skeleton storage written by Parker Drake
+#include "Skeleton.h"
+#include "MatrixKernels.h"
+#include "Quaternion.h"
+
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cassert>
+
+Skeleton::Skeleton()
+	: anyDirty(false), rootValid(false), cachedRoot(1.0f), recomputed(0)
+{
+}
+
+Skeleton::~Skeleton()
+{
+}
+
+int Skeleton::AddJoint(int p, glm::vec3 trp, glm::vec3 rrj, glm::vec3 trj, glm::vec3 sf)
+{
+	int joint = size();
+	assert(p < joint);
+
+	parent.push_back(p);
+	transRelParent.push_back(trp);
+	rotRelJoint.push_back(EulerToQuat(rrj));
+	transRelJoint.push_back(trj);
+	scaleFactor.push_back(sf);
+
+	childCount.push_back(0);
+	firstChild.push_back(-1);
+	lastChild.push_back(-1);
+	nextSibling.push_back(-1);
+
+	local.push_back(glm::mat4(1.0f));
+	world.push_back(glm::mat4(1.0f));
+	dirty.push_back(1);
+	changed.push_back(0);
+	anyDirty = true;
+
+	if (p >= 0)
+	{
+		// Append to the end of the parent's child list
+		if (lastChild[p] < 0)
+			firstChild[p] = joint;
+		else
+			nextSibling[lastChild[p]] = joint;
+		lastChild[p] = joint;
+		childCount[p]++;
+	}
+
+	return joint;
+}
+
+void Skeleton::Assign(int count, const int* parents, const glm::vec3* trp, const float* rotations, const glm::vec3* trj, const glm::vec3* sf)
+{
+	parent.assign(parents, parents + count);
+	transRelParent.assign(trp, trp + count);
+	rotRelJoint.resize(count);
+	for (int j = 0; j < count; j++)
+		rotRelJoint[j] = glm::quat(rotations[4 * j + 3], rotations[4 * j], rotations[4 * j + 1], rotations[4 * j + 2]);
+	transRelJoint.assign(trj, trj + count);
+	scaleFactor.assign(sf, sf + count);
+
+	childCount.assign(count, 0);
+	firstChild.assign(count, -1);
+	lastChild.assign(count, -1);
+	nextSibling.assign(count, -1);
+	for (int joint = 0; joint < count; joint++)
+	{
+		int p = parent[joint];
+		assert(p < joint);
+		if (p < 0)
+			continue;
+		if (lastChild[p] < 0)
+			firstChild[p] = joint;
+		else
+			nextSibling[lastChild[p]] = joint;
+		lastChild[p] = joint;
+		childCount[p]++;
+	}
+
+	local.assign(count, glm::mat4(1.0f));
+	world.assign(count, glm::mat4(1.0f));
+	dirty.assign(count, 1);
+	changed.assign(count, 0);
+	anyDirty = true;
+	rootValid = false;
+	recomputed = 0;
+}
+
+void Skeleton::Clear()
+{
+	parent.clear();
+	transRelParent.clear();
+	rotRelJoint.clear();
+	transRelJoint.clear();
+	scaleFactor.clear();
+	childCount.clear();
+	firstChild.clear();
+	lastChild.clear();
+	nextSibling.clear();
+	local.clear();
+	world.clear();
+	dirty.clear();
+	changed.clear();
+	anyDirty = false;
+	rootValid = false;
+	recomputed = 0;
+}
+
+void Skeleton::MarkAllDirty()
+{
+	std::fill(dirty.begin(), dirty.end(), 1);
+	anyDirty = true;
+}
+
+int Skeleton::Child(int joint, int n) const
+{
+	assert(n >= 0 && n < childCount[joint]);
+	int child = firstChild[joint];
+	while (n-- > 0)
+		child = nextSibling[child];
+	return child;
+}
+
+void Skeleton::Interpolate(const Skeleton& a, const Skeleton& b, float alpha)
+{
+	assert(a.size() == size() && b.size() == size());
+	if (size() == 0)
+		return;
+
+	// Joints that are the same in a, b and here keep their exact values and cache
+	for (int i = 0; i < size(); i++)
+	{
+		changed[i] = !(a.transRelParent[i] == b.transRelParent[i] && a.rotRelJoint[i] == b.rotRelJoint[i]
+			&& a.transRelJoint[i] == b.transRelJoint[i] && a.scaleFactor[i] == b.scaleFactor[i]
+			&& transRelParent[i] == a.transRelParent[i] && rotRelJoint[i] == a.rotRelJoint[i]
+			&& transRelJoint[i] == a.transRelJoint[i] && scaleFactor[i] == a.scaleFactor[i]);
+	}
+
+	QuatBlend::Nlerp(&a.rotRelJoint[0], &b.rotRelJoint[0], alpha, &rotRelJoint[0], size());
+	for (int i = 0; i < size(); i++)
+	{
+		if (!changed[i])
+		{
+			rotRelJoint[i] = a.rotRelJoint[i];
+			continue;
+		}
+		transRelParent[i] = glm::mix(a.transRelParent[i], b.transRelParent[i], alpha);
+		transRelJoint[i] = glm::mix(a.transRelJoint[i], b.transRelJoint[i], alpha);
+		scaleFactor[i] = glm::mix(a.scaleFactor[i], b.scaleFactor[i], alpha);
+		MarkDirty(i);
+	}
+}
+
+bool Skeleton::UpdateTransforms(const glm::mat4& root)
+{
+	bool rootChanged = !rootValid || root != cachedRoot;
+	if (!anyDirty && !rootChanged)
+	{
+		recomputed = 0;
+		return false;
+	}
+	cachedRoot = root;
+	rootValid = true;
+
+	const glm::vec3 unitScale(1.0f);
+	recomputed = 0;
+	for (int i = 0; i < size(); i++)
+	{
+		// Parents come first, so their transform and changed flag are already final
+		bool parentChanged = parent[i] < 0 ? rootChanged : changed[parent[i]] != 0;
+		changed[i] = dirty[i] || parentChanged;
+		if (!changed[i])
+			continue;
+
+		// Translate away from parent, rotate about the joint
+		if (dirty[i])
+			ComposeAffine(rotRelJoint[i], transRelParent[i], unitScale, transRelJoint[i], local[i]);
+		const glm::mat4& parentWorld = parent[i] < 0 ? root : world[parent[i]];
+		MatrixKernels::MultiplyAffine(glm::value_ptr(parentWorld), glm::value_ptr(local[i]), glm::value_ptr(world[i]));
+
+		dirty[i] = 0;
+		recomputed++;
+	}
+	anyDirty = false;
+	return true;
+}
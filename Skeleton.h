@@ -0,0 +1,81 @@
+// Flat skeleton storage written by Parker Drake
+#pragma once
+#ifndef _Skeleton_H_
+#define _Skeleton_H_
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Joints are stored as parallel arrays in topological order: a joint's parent
+// always has a smaller index than the joint itself, so world transforms can be
+// built in a single forward pass without recursion.
+//
+// Each joint caches its local and world matrices behind a dirty flag. Write the
+// channels through the setters, or call MarkDirty after writing the arrays, so
+// UpdateTransforms knows which subtrees to rebuild.
+class Skeleton
+{
+public:
+	Skeleton();
+	~Skeleton();
+
+	// Appends a joint and returns its index. The parent must already exist (or be -1 for a root).
+	// rrj is the initial rotation as Euler angles (see EulerToQuat).
+	int AddJoint(int p, glm::vec3 trp, glm::vec3 rrj, glm::vec3 trj, glm::vec3 sf);
+	// Replaces every joint from flat arrays already in topological order, as a
+	// Scene stores them. rotations holds x, y, z, w quaternions.
+	void Assign(int count, const int* parents, const glm::vec3* trp, const float* rotations, const glm::vec3* trj, const glm::vec3* sf);
+	void Clear();
+	int size() const { return (int)parent.size(); }
+
+	// Child queries used for limb selection
+	int ChildCount(int joint) const { return childCount[joint]; }
+	int Child(int joint, int n) const;
+	int LastChild(int joint) const { return lastChild[joint]; }
+
+	void SetTranslation(int joint, const glm::vec3& translation) { transRelParent[joint] = translation; MarkDirty(joint); }
+	void SetRotation(int joint, const glm::quat& rotation) { rotRelJoint[joint] = rotation; MarkDirty(joint); }
+	void SetScale(int joint, const glm::vec3& scale) { scaleFactor[joint] = scale; MarkDirty(joint); }
+	void MarkDirty(int joint) { dirty[joint] = 1; anyDirty = true; }
+	void MarkAllDirty();
+	bool IsDirty() const { return anyDirty; }
+
+	// Sets every joint to the blend of a and b, which must share this skeleton's layout.
+	// Only joints whose channels change are marked dirty.
+	void Interpolate(const Skeleton& a, const Skeleton& b, float alpha);
+
+	// Brings the cached world transform (without the limb scale) of every joint up to
+	// date for root. Dirty joints and their descendants are recomputed, everything
+	// else is reused. Returns false without any work if neither root nor a joint changed.
+	bool UpdateTransforms(const glm::mat4& root);
+	const glm::mat4& World(int joint) const { return world[joint]; }
+
+	// Joints recomputed and reused by the last UpdateTransforms
+	int Recomputed() const { return recomputed; }
+	int Reused() const { return size() - recomputed; }
+
+	std::vector<int> parent; // Index of joint's parent, -1 for the root
+	std::vector<glm::vec3> transRelParent; // Current translation from parent limb
+	std::vector<glm::quat> rotRelJoint; // Current rotation relative to parent joint
+	std::vector<glm::vec3> transRelJoint; // Current translation relative to parent joint
+	std::vector<glm::vec3> scaleFactor; // Current scale of limb
+
+private:
+	std::vector<int> childCount;
+	std::vector<int> firstChild;
+	std::vector<int> lastChild;
+	std::vector<int> nextSibling;
+
+	// Transform cache
+	std::vector<glm::mat4> local;
+	std::vector<glm::mat4> world;
+	std::vector<unsigned char> dirty;
+	std::vector<unsigned char> changed; // World transform rebuilt in the current update
+	bool anyDirty;
+	bool rootValid;
+	glm::mat4 cachedRoot;
+	int recomputed;
+};
+
+#endif
@@ -0,0 +1,424 @@
+// Skinned meshes and CPU skinning written by Parker Drake
+#include "SkinnedMesh.h"
+#include "Skeleton.h"
+#include "WorkerPool.h"
+#include "Profiler.h"
+
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SKINNING_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SKINNING_NEON
+#include <arm_neon.h>
+#endif
+
+void SkinnedMesh::Clear()
+{
+	positions.clear();
+	colors.clear();
+	joints.clear();
+	weights.clear();
+	indices.clear();
+	inverseBind.clear();
+	jointCount = 0;
+}
+
+void SkinnedMesh::AddVertex(const glm::vec3& position, const glm::vec3& color, const int* vertexJoints, const float* vertexWeights, int influences)
+{
+	// Heaviest first, so skinning can stop at the first zero weight
+	std::pair<float, int> sorted[16];
+	influences = std::min(influences, 16);
+	for (int i = 0; i < influences; i++)
+		sorted[i] = std::make_pair(vertexWeights[i], vertexJoints[i]);
+	std::sort(sorted, sorted + influences, [](const std::pair<float, int>& a, const std::pair<float, int>& b) { return a.first > b.first; });
+
+	float total = 0.0f;
+	for (int i = 0; i < std::min(influences, MAX_INFLUENCES); i++)
+		total += std::max(0.0f, sorted[i].first);
+
+	for (int k = 0; k < 3; k++)
+	{
+		positions.push_back(position[k]);
+		colors.push_back(color[k]);
+	}
+	for (int i = 0; i < MAX_INFLUENCES; i++)
+	{
+		bool used = i < influences && total > 0.0f && sorted[i].first > 0.0f;
+		joints.push_back(used ? (unsigned char)sorted[i].second : 0);
+		weights.push_back(used ? sorted[i].first / total : (i == 0 && total <= 0.0f ? 1.0f : 0.0f));
+		if (used)
+			jointCount = std::max(jointCount, sorted[i].second + 1);
+	}
+}
+
+bool SkinnedMesh::Load(const char* path)
+{
+	Clear();
+	std::ifstream ifs(path);
+	if (!ifs)
+	{
+		std::cerr << "Failed to open the mesh:" << path << std::endl;
+		return false;
+	}
+
+	std::string line;
+	int lineNumber = 0;
+	int declaredJoints = 0;
+	std::string error;
+	while (error.empty() && std::getline(ifs, line))
+	{
+		lineNumber++;
+		line = line.substr(0, line.find('#'));
+		std::istringstream words(line);
+		std::string keyword;
+		if (!(words >> keyword))
+			continue;
+
+		if (keyword == "joints")
+		{
+			if (!(words >> declaredJoints) || declaredJoints <= 0 || declaredJoints > 256)
+				error = "expected: joints <count>, at most 256";
+		}
+		else if (keyword == "v")
+		{
+			glm::vec3 position, color;
+			words >> position.x >> position.y >> position.z >> color.x >> color.y >> color.z;
+			if (!words)
+				error = "expected: v <x> <y> <z> <r> <g> <b> <joint>:<weight> ...";
+
+			int vertexJoints[16];
+			float vertexWeights[16];
+			int influences = 0;
+			std::string influence;
+			while (error.empty() && words >> influence)
+			{
+				size_t colon = influence.find(':');
+				int joint = atoi(influence.c_str());
+				if (colon == std::string::npos || joint < 0 || joint >= declaredJoints)
+					error = "influence " + influence + " is not <joint>:<weight> with a declared joint";
+				else if (influences < 16)
+				{
+					vertexJoints[influences] = joint;
+					vertexWeights[influences++] = (float)atof(influence.c_str() + colon + 1);
+				}
+			}
+			if (error.empty() && influences == 0)
+				error = "vertex has no joint";
+			if (error.empty())
+				AddVertex(position, color, vertexJoints, vertexWeights, influences);
+		}
+		else if (keyword == "f")
+		{
+			long a, b, c;
+			if (!(words >> a >> b >> c))
+				error = "expected: f <a> <b> <c>";
+			else if (a < 0 || b < 0 || c < 0 || a >= VertexCount() || b >= VertexCount() || c >= VertexCount())
+				error = "triangle refers to a vertex that is not defined yet";
+			else
+			{
+				indices.push_back((unsigned)a);
+				indices.push_back((unsigned)b);
+				indices.push_back((unsigned)c);
+			}
+		}
+		else
+			error = "unknown statement " + keyword;
+	}
+
+	if (error.empty() && VertexCount() == 0)
+		error = "the mesh has no vertices";
+	if (!error.empty())
+	{
+		std::cerr << path << ":" << lineNumber << ": " << error << std::endl;
+		Clear();
+		return false;
+	}
+	jointCount = declaredJoints;
+	return true;
+}
+
+bool SkinnedMesh::Save(const char* path) const
+{
+	FILE* file = fopen(path, "w");
+	if (!file)
+	{
+		std::cerr << "Unable to create the mesh " << path << std::endl;
+		return false;
+	}
+
+	fprintf(file, "# %d vertices, %d triangles\njoints %d\n", VertexCount(), TriangleCount(), jointCount);
+	for (int i = 0; i < VertexCount(); i++)
+	{
+		const float* p = &positions[i * 3];
+		const float* c = &colors[i * 3];
+		fprintf(file, "v %.9g %.9g %.9g %g %g %g", p[0], p[1], p[2], c[0], c[1], c[2]);
+		for (int k = 0; k < MAX_INFLUENCES && weights[i * MAX_INFLUENCES + k] > 0.0f; k++)
+			fprintf(file, " %d:%.9g", joints[i * MAX_INFLUENCES + k], weights[i * MAX_INFLUENCES + k]);
+		fprintf(file, "\n");
+	}
+	for (int t = 0; t < TriangleCount(); t++)
+		fprintf(file, "f %u %u %u\n", indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2]);
+	return fclose(file) == 0;
+}
+
+bool SkinnedMesh::Bind(Skeleton& skeleton)
+{
+	if (skeleton.size() < jointCount)
+	{
+		std::cerr << "The mesh needs " << jointCount << " joints, the skeleton has " << skeleton.size() << std::endl;
+		return false;
+	}
+	skeleton.UpdateTransforms(glm::mat4(1.0f));
+	inverseBind.resize(skeleton.size());
+	for (int j = 0; j < skeleton.size(); j++)
+		inverseBind[j] = glm::inverse(skeleton.World(j));
+	return true;
+}
+
+void SkinnedMesh::Expand(const float* skinned, std::vector<float>& triangles) const
+{
+	triangles.resize(indices.size() * 6);
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		unsigned v = indices[i];
+		for (int k = 0; k < 3; k++)
+		{
+			triangles[i * 6 + k] = skinned[v * 3 + k];
+			triangles[i * 6 + 3 + k] = colors[v * 3 + k];
+		}
+	}
+}
+
+void BuildRobotMesh(Skeleton& robot, SkinnedMesh& mesh, int segments)
+{
+	mesh.Clear();
+	robot.UpdateTransforms(glm::mat4(1.0f));
+	segments = std::max(1, segments);
+
+	for (int j = 0; j < robot.size(); j++)
+	{
+		const glm::vec3& size = robot.scaleFactor[j];
+		int along = size.x >= size.y && size.x >= size.z ? 0 : size.y >= size.z ? 1 : 2;
+
+		// The joint the limb turns about sits on the side transRelJoint points to
+		float pivotSide = robot.transRelJoint[j][along];
+		bool blends = robot.parent[j] >= 0 && pivotSide != 0.0f;
+
+		// Each face of the unit cube, normal axis and direction, colored like CubeMesh
+		for (int axis = 0; axis < 3; axis++)
+		{
+			glm::vec3 color(0.2f);
+			color[axis] = 0.8f;
+			int p = (axis + 1) % 3, q = (axis + 2) % 3;
+			int np = p == along ? segments : 1;
+			int nq = q == along ? segments : 1;
+			for (int sign = -1; sign <= 1; sign += 2)
+			{
+				unsigned first = (unsigned)mesh.VertexCount();
+				for (int a = 0; a <= np; a++)
+				{
+					for (int b = 0; b <= nq; b++)
+					{
+						glm::vec3 cube;
+						cube[axis] = (float)sign;
+						cube[p] = -1.0f + 2.0f * a / np;
+						cube[q] = -1.0f + 2.0f * b / nq;
+
+						// Half weight to the parent on the pivot face, fading out half a unit into the limb
+						float distance = pivotSide > 0.0f ? 1.0f - cube[along] : cube[along] + 1.0f;
+						float parentWeight = blends ? std::max(0.0f, 0.5f - distance) : 0.0f;
+						int vertexJoints[2] = { j, robot.parent[j] };
+						float vertexWeights[2] = { 1.0f - parentWeight, parentWeight };
+
+						glm::vec4 position = robot.World(j) * glm::vec4(cube * size, 1.0f);
+						mesh.AddVertex(glm::vec3(position), color, vertexJoints, vertexWeights, blends ? 2 : 1);
+					}
+				}
+				for (int a = 0; a < np; a++)
+				{
+					for (int b = 0; b < nq; b++)
+					{
+						unsigned v = first + a * (nq + 1) + b;
+						unsigned quad[4] = { v, v + nq + 1, v + nq + 2, v + 1 };
+						unsigned triangles[6] = { quad[0], quad[1], quad[2], quad[0], quad[2], quad[3] };
+						mesh.indices.insert(mesh.indices.end(), triangles, triangles + 6);
+					}
+				}
+			}
+		}
+	}
+	mesh.jointCount = robot.size();
+	mesh.Bind(robot);
+}
+
+namespace
+{
+#if defined(SKINNING_SSE)
+	void SkinRange(const SkinnedMesh& mesh, const glm::mat4* palette, int begin, int end, float* out)
+	{
+		const float* positions = &mesh.positions[0];
+		const unsigned char* joints = &mesh.joints[0];
+		const float* weights = &mesh.weights[0];
+		for (int i = begin; i < end; i++)
+		{
+			// Blend the affine columns of the joints' matrices; most vertices follow one joint
+			const unsigned char* joint = joints + i * MAX_INFLUENCES;
+			const float* weight = weights + i * MAX_INFLUENCES;
+			const float* m = glm::value_ptr(palette[joint[0]]);
+			__m128 c0 = _mm_loadu_ps(m), c1 = _mm_loadu_ps(m + 4), c2 = _mm_loadu_ps(m + 8), c3 = _mm_loadu_ps(m + 12);
+			if (weight[1] > 0.0f)
+			{
+				__m128 w = _mm_set1_ps(weight[0]);
+				c0 = _mm_mul_ps(c0, w);
+				c1 = _mm_mul_ps(c1, w);
+				c2 = _mm_mul_ps(c2, w);
+				c3 = _mm_mul_ps(c3, w);
+				for (int k = 1; k < MAX_INFLUENCES && weight[k] > 0.0f; k++)
+				{
+					m = glm::value_ptr(palette[joint[k]]);
+					w = _mm_set1_ps(weight[k]);
+					c0 = _mm_add_ps(c0, _mm_mul_ps(_mm_loadu_ps(m), w));
+					c1 = _mm_add_ps(c1, _mm_mul_ps(_mm_loadu_ps(m + 4), w));
+					c2 = _mm_add_ps(c2, _mm_mul_ps(_mm_loadu_ps(m + 8), w));
+					c3 = _mm_add_ps(c3, _mm_mul_ps(_mm_loadu_ps(m + 12), w));
+				}
+			}
+
+			const float* p = positions + i * 3;
+			__m128 result = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(p[0])), _mm_mul_ps(c1, _mm_set1_ps(p[1]))),
+				_mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(p[2])), c3));
+
+			// Four-wide stores overlap the next vertex, except at the end of the range, which another thread may own
+			if (i + 1 < end)
+				_mm_storeu_ps(out + i * 3, result);
+			else
+			{
+				float last[4];
+				_mm_storeu_ps(last, result);
+				out[i * 3] = last[0];
+				out[i * 3 + 1] = last[1];
+				out[i * 3 + 2] = last[2];
+			}
+		}
+	}
+#elif defined(SKINNING_NEON)
+	void SkinRange(const SkinnedMesh& mesh, const glm::mat4* palette, int begin, int end, float* out)
+	{
+		const float* positions = &mesh.positions[0];
+		const unsigned char* joints = &mesh.joints[0];
+		const float* weights = &mesh.weights[0];
+		for (int i = begin; i < end; i++)
+		{
+			const unsigned char* joint = joints + i * MAX_INFLUENCES;
+			const float* weight = weights + i * MAX_INFLUENCES;
+			const float* m = glm::value_ptr(palette[joint[0]]);
+			float32x4_t c0 = vld1q_f32(m), c1 = vld1q_f32(m + 4), c2 = vld1q_f32(m + 8), c3 = vld1q_f32(m + 12);
+			if (weight[1] > 0.0f)
+			{
+				c0 = vmulq_n_f32(c0, weight[0]);
+				c1 = vmulq_n_f32(c1, weight[0]);
+				c2 = vmulq_n_f32(c2, weight[0]);
+				c3 = vmulq_n_f32(c3, weight[0]);
+				for (int k = 1; k < MAX_INFLUENCES && weight[k] > 0.0f; k++)
+				{
+					m = glm::value_ptr(palette[joint[k]]);
+					c0 = vmlaq_n_f32(c0, vld1q_f32(m), weight[k]);
+					c1 = vmlaq_n_f32(c1, vld1q_f32(m + 4), weight[k]);
+					c2 = vmlaq_n_f32(c2, vld1q_f32(m + 8), weight[k]);
+					c3 = vmlaq_n_f32(c3, vld1q_f32(m + 12), weight[k]);
+				}
+			}
+
+			const float* p = positions + i * 3;
+			float32x4_t result = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(c3, c0, p[0]), c1, p[1]), c2, p[2]);
+			vst1_f32(out + i * 3, vget_low_f32(result));
+			out[i * 3 + 2] = vgetq_lane_f32(result, 2);
+		}
+	}
+#else
+	void SkinRange(const SkinnedMesh& mesh, const glm::mat4* palette, int begin, int end, float* out)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			const unsigned char* joint = &mesh.joints[i * MAX_INFLUENCES];
+			const float* weight = &mesh.weights[i * MAX_INFLUENCES];
+			glm::mat4 blend = palette[joint[0]];
+			if (weight[1] > 0.0f)
+			{
+				blend = blend * weight[0];
+				for (int k = 1; k < MAX_INFLUENCES && weight[k] > 0.0f; k++)
+					blend += palette[joint[k]] * weight[k];
+			}
+			const float* p = &mesh.positions[i * 3];
+			glm::vec4 result = blend[0] * p[0] + blend[1] * p[1] + blend[2] * p[2] + blend[3];
+			out[i * 3] = result.x;
+			out[i * 3 + 1] = result.y;
+			out[i * 3 + 2] = result.z;
+		}
+	}
+#endif
+}
+
+namespace Skinning
+{
+	void ComputePalette(const Skeleton& skeleton, const SkinnedMesh& mesh, glm::mat4* palette)
+	{
+		for (int j = 0; j < (int)mesh.inverseBind.size(); j++)
+			palette[j] = skeleton.World(j) * mesh.inverseBind[j];
+	}
+
+	void Skin(const SkinnedMesh& mesh, const glm::mat4* palette, int begin, int end, float* out)
+	{
+		if (begin < end)
+			SkinRange(mesh, palette, begin, end, out);
+	}
+
+	void Skin(const SkinnedMesh& mesh, const glm::mat4* palette, float* out, WorkerPool& pool)
+	{
+		PROFILE_SCOPE("Skinning");
+		// Chunks of a few thousand vertices keep the wake up cost small next to the work
+		int grain = std::max(4096, mesh.VertexCount() / (pool.ThreadCount() * 4));
+		pool.ParallelFor(mesh.VertexCount(), grain, [&](int begin, int end, int worker)
+		{
+			SkinRange(mesh, palette, begin, end, out);
+		});
+	}
+
+	void SkinReference(const SkinnedMesh& mesh, const glm::mat4* palette, float* out)
+	{
+		for (int i = 0; i < mesh.VertexCount(); i++)
+		{
+			glm::mat4 blend(0.0f);
+			for (int k = 0; k < MAX_INFLUENCES; k++)
+			{
+				float weight = mesh.weights[i * MAX_INFLUENCES + k];
+				const glm::mat4& m = palette[mesh.joints[i * MAX_INFLUENCES + k]];
+				for (int c = 0; c < 4; c++)
+					blend[c] += m[c] * weight;
+			}
+			glm::vec4 result = blend * glm::vec4(mesh.positions[i * 3], mesh.positions[i * 3 + 1], mesh.positions[i * 3 + 2], 1.0f);
+			out[i * 3] = result.x;
+			out[i * 3 + 1] = result.y;
+			out[i * 3 + 2] = result.z;
+		}
+	}
+
+	const char* Name()
+	{
+#if defined(SKINNING_SSE)
+		return "SSE";
+#elif defined(SKINNING_NEON)
+		return "NEON";
+#else
+		return "scalar";
+#endif
+	}
+}
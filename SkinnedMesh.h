@@ -0,0 +1,76 @@
+// Skinned meshes and CPU skinning written by Parker Drake
+#pragma once
+#ifndef _SkinnedMesh_H_
+#define _SkinnedMesh_H_
+
+#include <vector>
+#include <glm/glm.hpp>
+
+class Skeleton;
+class WorkerPool;
+
+const int MAX_INFLUENCES = 4; // Joints per vertex
+
+// An indexed triangle mesh whose vertices follow up to four weighted joints.
+// Positions are in model space with the skeleton in its bind pose. Meshes
+// are loaded from a text file, one statement per line ('#' starts a comment):
+//
+//   joints <count>                              Joints the mesh expects in the skeleton
+//   v <x> <y> <z> <r> <g> <b> <joint>:<weight> ...
+//   f <a> <b> <c>                               Triangle of 0-based vertex indices
+//
+// Weights are normalized on load; only the four largest are kept, heaviest first.
+struct SkinnedMesh
+{
+	std::vector<float> positions; // x, y, z per vertex
+	std::vector<float> colors; // r, g, b per vertex
+	std::vector<unsigned char> joints; // MAX_INFLUENCES per vertex
+	std::vector<float> weights; // MAX_INFLUENCES per vertex, summing to 1
+	std::vector<unsigned> indices; // Three per triangle
+	std::vector<glm::mat4> inverseBind; // Per joint, set by Bind
+	int jointCount;
+
+	SkinnedMesh() : jointCount(0) {}
+
+	int VertexCount() const { return (int)positions.size() / 3; }
+	int TriangleCount() const { return (int)indices.size() / 3; }
+	void Clear();
+
+	// Returns false, with a message naming the line, if the file cannot be used
+	bool Load(const char* path);
+	bool Save(const char* path) const;
+
+	// Appends a vertex; influences beyond the four heaviest are dropped
+	void AddVertex(const glm::vec3& position, const glm::vec3& color, const int* vertexJoints, const float* vertexWeights, int influences);
+
+	// Takes the skeleton's current pose as the bind pose. Returns false if the
+	// skeleton has fewer joints than the mesh uses.
+	bool Bind(Skeleton& skeleton);
+
+	// Copies positions (x, y, z per vertex) and the mesh colors into a
+	// non-indexed x, y, z, r, g, b triangle list, as SoftwareRasterizer::DrawMesh takes
+	void Expand(const float* skinned, std::vector<float>& triangles) const;
+};
+
+// Builds the robot's limbs as one mesh in its current pose: each limb is a box
+// cut into segments along its longest side, and the rings next to the joint a
+// limb hangs from blend with the parent joint so the joint bends smoothly.
+void BuildRobotMesh(Skeleton& robot, SkinnedMesh& mesh, int segments = 8);
+
+namespace Skinning
+{
+	// Joint palette: palette[j] = world(j) * inverseBind[j]; UpdateTransforms must have run
+	void ComputePalette(const Skeleton& skeleton, const SkinnedMesh& mesh, glm::mat4* palette);
+
+	// Skins vertices [begin, end) into out, 3 floats per vertex from out[3 * begin]
+	void Skin(const SkinnedMesh& mesh, const glm::mat4* palette, int begin, int end, float* out);
+	// Skins every vertex, split across the pool's threads
+	void Skin(const SkinnedMesh& mesh, const glm::mat4* palette, float* out, WorkerPool& pool);
+	// One glm matrix blend per vertex, for checking the SIMD path
+	void SkinReference(const SkinnedMesh& mesh, const glm::mat4* palette, float* out);
+
+	// Instruction set used by Skin
+	const char* Name();
+}
+
+#endif
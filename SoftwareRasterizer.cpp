@@ -0,0 +1,350 @@
+// CPU rasterizer written by Parker Drake
+#include "SoftwareRasterizer.h"
+#include "CubeMesh.h"
+#include "ImageIO.h"
+#include "Profiler.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RASTERIZER_SSE
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	unsigned int PackColor(float r, float g, float b)
+	{
+		unsigned int ir = (unsigned int)floor(std::min(std::max(r, 0.0f), 1.0f) * 255.0f + 0.5f);
+		unsigned int ig = (unsigned int)floor(std::min(std::max(g, 0.0f), 1.0f) * 255.0f + 0.5f);
+		unsigned int ib = (unsigned int)floor(std::min(std::max(b, 0.0f), 1.0f) * 255.0f + 0.5f);
+		return ir | (ig << 8) | (ib << 16) | 0xFF000000u;
+	}
+
+	double Seconds(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+SoftwareRasterizer::SoftwareRasterizer(WorkerPool& p, int w, int h)
+	: pool(p), width(0), height(0), stride(0), tilesX(0), tilesY(0)
+{
+	stats = Stats();
+	Resize(w, h);
+}
+
+SoftwareRasterizer::~SoftwareRasterizer()
+{
+}
+
+void SoftwareRasterizer::Resize(int w, int h)
+{
+	width = w;
+	height = h;
+	stride = (w + 3) & ~3;
+	tilesX = (w + TILE_SIZE - 1) / TILE_SIZE;
+	tilesY = (h + TILE_SIZE - 1) / TILE_SIZE;
+	color.assign(stride * h, 0xFF000000u);
+	depth.assign(stride * h, 1.0f);
+	bins.clear();
+}
+
+void SoftwareRasterizer::Clear(const glm::vec3& c)
+{
+	std::fill(color.begin(), color.end(), PackColor(c.x, c.y, c.z));
+	std::fill(depth.begin(), depth.end(), 1.0f);
+}
+
+void SoftwareRasterizer::Draw(const glm::mat4* mvp, int count)
+{
+	DrawMesh(cubeVertices, CUBE_VERTEX_COUNT, mvp, count);
+}
+
+void SoftwareRasterizer::DrawMesh(const float* vertices, int vertexCount, const glm::mat4* mvp, int count)
+{
+	PROFILE_SCOPE("Rasterize");
+	stats = Stats();
+	stats.triangles = vertexCount / 3 * count;
+
+	int workers = pool.ThreadCount();
+	bins.resize(workers);
+	for (int w = 0; w < workers; w++)
+	{
+		bins[w].triangles.clear();
+		bins[w].tiles.resize(tilesX * tilesY);
+		for (size_t t = 0; t < bins[w].tiles.size(); t++)
+			bins[w].tiles[t].clear();
+	}
+
+	// Setup: transform, clip and bin. Each worker takes a contiguous range of
+	// meshes, so walking the workers in order replays submission order.
+	auto start = std::chrono::high_resolution_clock::now();
+	int meshesPerWorker = (count + workers - 1) / workers;
+	pool.ParallelFor(count, std::max(1, meshesPerWorker), [&](int begin, int end, int worker)
+	{
+		Bins& local = bins[worker];
+		for (int n = begin; n < end; n++)
+		{
+			for (int v = 0; v + 2 < vertexCount; v += 3)
+			{
+				glm::vec4 clip[3];
+				const float* colors[3];
+				for (int k = 0; k < 3; k++)
+				{
+					const float* vertex = vertices + (v + k) * CUBE_VERTEX_STRIDE;
+					clip[k] = mvp[n] * glm::vec4(vertex[0], vertex[1], vertex[2], 1.0f);
+					colors[k] = vertex + 3;
+				}
+				SetupTriangle(clip, colors, local);
+			}
+		}
+	});
+	stats.setupSeconds = Seconds(start);
+
+	for (int w = 0; w < workers; w++)
+	{
+		stats.rasterized += (int)bins[w].triangles.size();
+		for (size_t t = 0; t < bins[w].tiles.size(); t++)
+			stats.binned += bins[w].tiles[t].size();
+	}
+
+	// Raster: tiles are independent
+	start = std::chrono::high_resolution_clock::now();
+	pool.ParallelFor(tilesX * tilesY, 1, [&](int begin, int end, int)
+	{
+		for (int tile = begin; tile < end; tile++)
+			RasterizeTile(tile);
+	});
+	stats.rasterSeconds = Seconds(start);
+}
+
+void SoftwareRasterizer::SetupTriangle(const glm::vec4 clip[3], const float* colors[3], Bins& local)
+{
+	// Clip against the near plane (z >= -w), which also keeps w positive.
+	// A triangle becomes at most a quad, drawn as a fan.
+	glm::vec4 polygon[4];
+	glm::vec3 polygonColor[4];
+	int n = 0;
+	for (int k = 0; k < 3; k++)
+	{
+		const glm::vec4& a = clip[k];
+		const glm::vec4& b = clip[(k + 1) % 3];
+		float da = a.z + a.w;
+		float db = b.z + b.w;
+		glm::vec3 ca(colors[k][0], colors[k][1], colors[k][2]);
+		glm::vec3 cb(colors[(k + 1) % 3][0], colors[(k + 1) % 3][1], colors[(k + 1) % 3][2]);
+		if (da >= 0.0f)
+		{
+			polygon[n] = a;
+			polygonColor[n++] = ca;
+		}
+		if ((da >= 0.0f) != (db >= 0.0f))
+		{
+			float t = da / (da - db);
+			polygon[n] = a + (b - a) * t;
+			polygonColor[n++] = glm::mix(ca, cb, t);
+		}
+	}
+
+	for (int k = 1; k + 1 < n; k++)
+	{
+		int index[3] = { 0, k, k + 1 };
+
+		// Perspective divide and viewport transform, pixel centers at +0.5
+		float x[3], y[3];
+		Triangle triangle;
+		for (int i = 0; i < 3; i++)
+		{
+			const glm::vec4& p = polygon[index[i]];
+			float invW = 1.0f / p.w;
+			x[i] = (p.x * invW * 0.5f + 0.5f) * width;
+			y[i] = (p.y * invW * 0.5f + 0.5f) * height;
+			triangle.depth[i] = p.z * invW * 0.5f + 0.5f;
+			triangle.color[i][0] = polygonColor[index[i]].x;
+			triangle.color[i][1] = polygonColor[index[i]].y;
+			triangle.color[i][2] = polygonColor[index[i]].z;
+		}
+
+		// Make the winding counter-clockwise so inside is where all edges are positive
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+		if (area == 0.0f || area != area)
+			continue;
+		if (area < 0.0f)
+		{
+			std::swap(x[1], x[2]);
+			std::swap(y[1], y[2]);
+			std::swap(triangle.depth[1], triangle.depth[2]);
+			for (int c = 0; c < 3; c++)
+				std::swap(triangle.color[1][c], triangle.color[2][c]);
+			area = -area;
+		}
+		triangle.invArea = 1.0f / area;
+
+		// Edge i is opposite vertex i, so its value is vertex i's barycentric weight times area
+		for (int i = 0; i < 3; i++)
+		{
+			int a = (i + 1) % 3, b = (i + 2) % 3;
+			float A = y[a] - y[b];
+			float B = x[b] - x[a];
+			triangle.edge[i][0] = A;
+			triangle.edge[i][1] = B;
+			triangle.edge[i][2] = -(A * x[a] + B * y[a]);
+			// Top-left fill rule: pixels exactly on a top or left edge belong to the triangle
+			triangle.topLeft[i] = (y[b] < y[a]) || (y[a] == y[b] && x[b] < x[a]);
+		}
+
+		// Pixel centers covered by the bounding box, clamped to the screen
+		triangle.minX = std::max(0, (int)ceil(std::min(x[0], std::min(x[1], x[2])) - 0.5f));
+		triangle.minY = std::max(0, (int)ceil(std::min(y[0], std::min(y[1], y[2])) - 0.5f));
+		triangle.maxX = std::min(width - 1, (int)floor(std::max(x[0], std::max(x[1], x[2])) - 0.5f));
+		triangle.maxY = std::min(height - 1, (int)floor(std::max(y[0], std::max(y[1], y[2])) - 0.5f));
+		if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+			continue;
+
+		int id = (int)local.triangles.size();
+		local.triangles.push_back(triangle);
+		for (int ty = triangle.minY / TILE_SIZE; ty <= triangle.maxY / TILE_SIZE; ty++)
+			for (int tx = triangle.minX / TILE_SIZE; tx <= triangle.maxX / TILE_SIZE; tx++)
+				local.tiles[ty * tilesX + tx].push_back(id);
+	}
+}
+
+void SoftwareRasterizer::RasterizeTile(int tile)
+{
+	int x0 = (tile % tilesX) * TILE_SIZE;
+	int y0 = (tile / tilesX) * TILE_SIZE;
+	int x1 = std::min(x0 + TILE_SIZE, width) - 1;
+	int y1 = std::min(y0 + TILE_SIZE, height) - 1;
+
+	for (size_t w = 0; w < bins.size(); w++)
+	{
+		const std::vector<int>& list = bins[w].tiles[tile];
+		for (size_t i = 0; i < list.size(); i++)
+		{
+			const Triangle& triangle = bins[w].triangles[list[i]];
+			RasterizeTriangle(triangle, std::max(x0, triangle.minX), std::max(y0, triangle.minY), std::min(x1, triangle.maxX), std::min(y1, triangle.maxY));
+		}
+	}
+}
+
+void SoftwareRasterizer::RasterizeTriangle(const Triangle& t, int x0, int y0, int x1, int y1)
+{
+#ifdef RASTERIZER_SSE
+	// Four pixels per step. Rows start on a multiple of 4 inside the tile, and
+	// lanes past x1 are masked off, so loads and stores stay inside the padded row.
+	int startX = x0 & ~3;
+	const __m128 laneOffset = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 lastX = _mm_set1_ps((float)x1 + 0.75f);
+	__m128 A[3], weightDepth[3], weightColor[3][3];
+	for (int e = 0; e < 3; e++)
+	{
+		A[e] = _mm_set1_ps(t.edge[e][0]);
+		weightDepth[e] = _mm_set1_ps(t.depth[e] * t.invArea);
+		for (int c = 0; c < 3; c++)
+			weightColor[e][c] = _mm_set1_ps(t.color[e][c] * t.invArea * 255.0f);
+	}
+
+	for (int y = y0; y <= y1; y++)
+	{
+		float py = y + 0.5f;
+		__m128 rowC[3];
+		for (int e = 0; e < 3; e++)
+			rowC[e] = _mm_set1_ps(t.edge[e][1] * py + t.edge[e][2]);
+
+		for (int x = startX; x <= x1; x += 4)
+		{
+			__m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffset);
+			__m128 mask = _mm_cmplt_ps(px, lastX);
+			__m128 w[3];
+			for (int e = 0; e < 3; e++)
+			{
+				w[e] = _mm_add_ps(_mm_mul_ps(A[e], px), rowC[e]);
+				mask = _mm_and_ps(mask, t.topLeft[e] ? _mm_cmpge_ps(w[e], zero) : _mm_cmpgt_ps(w[e], zero));
+			}
+			if (_mm_movemask_ps(mask) == 0)
+				continue;
+
+			// Depth test against the buffer, and drop fragments beyond the far plane
+			float* depthRow = &depth[y * stride + x];
+			__m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(w[0], weightDepth[0]), _mm_mul_ps(w[1], weightDepth[1])), _mm_mul_ps(w[2], weightDepth[2]));
+			__m128 oldZ = _mm_loadu_ps(depthRow);
+			mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmplt_ps(z, oldZ), _mm_cmple_ps(z, one)));
+			int bits = _mm_movemask_ps(mask);
+			if (bits == 0)
+				continue;
+			_mm_storeu_ps(depthRow, _mm_or_ps(_mm_and_ps(mask, z), _mm_andnot_ps(mask, oldZ)));
+
+			__m128i packed = _mm_set1_epi32((int)0xFF000000u);
+			for (int c = 0; c < 3; c++)
+			{
+				__m128 value = _mm_add_ps(_mm_add_ps(_mm_mul_ps(w[0], weightColor[0][c]), _mm_mul_ps(w[1], weightColor[1][c])), _mm_mul_ps(w[2], weightColor[2][c]));
+				value = _mm_min_ps(_mm_max_ps(value, zero), _mm_set1_ps(255.0f));
+				packed = _mm_or_si128(packed, _mm_slli_epi32(_mm_cvtps_epi32(value), 8 * c));
+			}
+			unsigned int* colorRow = &color[y * stride + x];
+			__m128i oldColor = _mm_loadu_si128((const __m128i*)colorRow);
+			__m128i keep = _mm_castps_si128(mask);
+			_mm_storeu_si128((__m128i*)colorRow, _mm_or_si128(_mm_and_si128(keep, packed), _mm_andnot_si128(keep, oldColor)));
+		}
+	}
+#else
+	for (int y = y0; y <= y1; y++)
+	{
+		float py = y + 0.5f;
+		for (int x = x0; x <= x1; x++)
+		{
+			float px = x + 0.5f;
+			float w[3];
+			bool inside = true;
+			for (int e = 0; e < 3; e++)
+			{
+				w[e] = t.edge[e][0] * px + t.edge[e][1] * py + t.edge[e][2];
+				inside = inside && (t.topLeft[e] ? w[e] >= 0.0f : w[e] > 0.0f);
+			}
+			if (!inside)
+				continue;
+
+			float z = (w[0] * t.depth[0] + w[1] * t.depth[1] + w[2] * t.depth[2]) * t.invArea;
+			float& stored = depth[y * stride + x];
+			if (!(z < stored && z <= 1.0f))
+				continue;
+			stored = z;
+
+			float rgb[3];
+			for (int c = 0; c < 3; c++)
+				rgb[c] = (w[0] * t.color[0][c] + w[1] * t.color[1][c] + w[2] * t.color[2][c]) * t.invArea;
+			color[y * stride + x] = PackColor(rgb[0], rgb[1], rgb[2]);
+		}
+	}
+#endif
+}
+
+void SoftwareRasterizer::ReadPixels(std::vector<unsigned char>& rgba) const
+{
+	rgba.resize(width * height * 4);
+	for (int y = 0; y < height; y++)
+	{
+		const unsigned int* row = &color[(height - 1 - y) * stride];
+		for (int x = 0; x < width; x++)
+		{
+			unsigned char* out = &rgba[(y * width + x) * 4];
+			out[0] = row[x] & 0xFF;
+			out[1] = (row[x] >> 8) & 0xFF;
+			out[2] = (row[x] >> 16) & 0xFF;
+			out[3] = (row[x] >> 24) & 0xFF;
+		}
+	}
+}
+
+bool SoftwareRasterizer::WriteImage(const char* path) const
+{
+	std::vector<unsigned char> rgba;
+	ReadPixels(rgba);
+	return ::WriteImage(path, width, height, &rgba[0]);
+}
@@ -0,0 +1,87 @@
+// CPU rasterizer written by Parker Drake
+#pragma once
+#ifndef _SoftwareRasterizer_H_
+#define _SoftwareRasterizer_H_
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "CubeRenderer.h"
+
+class WorkerPool;
+
+// Renders cubes into a color + depth framebuffer on the CPU, following the
+// viewer's GL state: depth test GL_LESS, no face culling, clipping against
+// the near plane. Triangles are set up and binned into screen tiles in
+// parallel, then each tile is rasterized by one worker with SIMD edge
+// functions, so the image does not depend on the thread count.
+class SoftwareRasterizer : public CubeRenderer
+{
+public:
+	SoftwareRasterizer(WorkerPool& pool, int width, int height);
+	~SoftwareRasterizer();
+
+	const char* Name() const { return "software"; }
+
+	void Resize(int width, int height);
+	void Clear(const glm::vec3& color = glm::vec3(0.0f, 0.0f, 0.0f));
+
+	void Draw(const glm::mat4* mvp, int count);
+	// Draws vertexCount interleaved x, y, z, r, g, b triangle vertices once per MVP
+	void DrawMesh(const float* vertices, int vertexCount, const glm::mat4* mvp, int count);
+
+	int Width() const { return width; }
+	int Height() const { return height; }
+	// Copies the color buffer out as RGBA rows, top row first (the GL framebuffer is bottom-up)
+	void ReadPixels(std::vector<unsigned char>& rgba) const;
+	float Depth(int x, int y) const { return depth[y * stride + x]; }
+	bool WriteImage(const char* path) const;
+
+	// Work done by the last Draw() call
+	struct Stats
+	{
+		int triangles; // Submitted
+		int rasterized; // Survived clipping and covered pixel centers' bounds
+		long long binned; // Triangle-tile pairs
+		double setupSeconds;
+		double rasterSeconds;
+	};
+	const Stats& GetStats() const { return stats; }
+
+	static const int TILE_SIZE = 64;
+
+private:
+	// Screen space triangle ready for edge function evaluation
+	struct Triangle
+	{
+		float edge[3][3]; // A, B, C of A * x + B * y + C for each edge
+		bool topLeft[3];
+		float depth[3]; // Window depth per vertex
+		float color[3][3];
+		float invArea;
+		int minX, minY, maxX, maxY;
+	};
+
+	// Per-worker setup output, kept between frames to avoid reallocating
+	struct Bins
+	{
+		std::vector<Triangle> triangles;
+		std::vector<std::vector<int> > tiles;
+	};
+
+	void SetupTriangle(const glm::vec4 clip[3], const float* colors[3], Bins& bins);
+	void RasterizeTile(int tile);
+	void RasterizeTriangle(const Triangle& triangle, int x0, int y0, int x1, int y1);
+
+	WorkerPool& pool;
+	int width;
+	int height;
+	int stride; // Row pitch in pixels, a multiple of 4 so SIMD rows never leave the buffer
+	int tilesX;
+	int tilesY;
+	std::vector<unsigned int> color; // RGBA8 with red in the lowest byte, bottom row first
+	std::vector<float> depth;
+	std::vector<Bins> bins;
+	Stats stats;
+};
+
+#endif
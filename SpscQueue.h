@@ -0,0 +1,65 @@
+// Single-producer single-consumer queue written by Parker Drake
+#pragma once
+#ifndef _SpscQueue_H_
+#define _SpscQueue_H_
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Fixed-capacity ring that hands values from one thread to exactly one other
+// without locks. Push() fails instead of blocking when the ring is full, so
+// the producer never waits on the consumer.
+template <typename T>
+class SpscQueue
+{
+public:
+	// capacity is rounded up to a power of two
+	explicit SpscQueue(size_t capacity = 256)
+		: head(0), tail(0)
+	{
+		size_t size = 1;
+		while (size < capacity)
+			size <<= 1;
+		slots.resize(size);
+		mask = size - 1;
+	}
+
+	// Producer only
+	bool Push(const T& value)
+	{
+		size_t end = tail.load(std::memory_order_relaxed);
+		if (end - head.load(std::memory_order_acquire) > mask)
+			return false;
+		slots[end & mask] = value;
+		tail.store(end + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only; returns false when the queue is empty
+	bool Pop(T& value)
+	{
+		size_t begin = head.load(std::memory_order_relaxed);
+		if (begin == tail.load(std::memory_order_acquire))
+			return false;
+		value = slots[begin & mask];
+		head.store(begin + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool Empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+	size_t Capacity() const { return slots.size(); }
+
+private:
+	SpscQueue(const SpscQueue&);
+	SpscQueue& operator=(const SpscQueue&);
+
+	std::vector<T> slots;
+	size_t mask;
+	// Each counter is written by one side only; separate cache lines keep the
+	// two threads from invalidating each other's on every push and pop
+	alignas(64) std::atomic<size_t> head; // Next slot to pop
+	alignas(64) std::atomic<size_t> tail; // Next slot to push
+};
+
+#endif
@@ -0,0 +1,50 @@
+// Lock-free triple buffer written by Parker Drake
+#pragma once
+#ifndef _TripleBuffer_H_
+#define _TripleBuffer_H_
+
+#include <atomic>
+
+// Three copies of T shared by one writer and one reader. The writer fills the
+// back copy and publishes it by swapping it with the middle one; the reader
+// swaps the middle one for its front copy when something new was published.
+// Neither side ever waits: the writer may publish faster than the reader
+// takes copies (older ones are dropped), and the reader keeps showing its
+// front copy until a newer one arrives.
+template <typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() : middle(1), front(0), back(2) {}
+
+	// Writer only: the copy to fill, then Publish() it
+	T& Back() { return slots[back]; }
+	void Publish() { back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX; }
+
+	// Reader only: makes the newest published copy the front one. Returns
+	// false, leaving the front copy as it was, if nothing was published since.
+	bool Acquire()
+	{
+		if (!(middle.load(std::memory_order_relaxed) & FRESH))
+			return false;
+		front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+		return true;
+	}
+	const T& Front() const { return slots[front]; }
+
+	// For setting all three copies up before either thread starts
+	T& Slot(int i) { return slots[i]; }
+
+private:
+	TripleBuffer(const TripleBuffer&);
+	TripleBuffer& operator=(const TripleBuffer&);
+
+	enum { INDEX = 3, FRESH = 4 };
+
+	T slots[3];
+	std::atomic<unsigned> middle; // Index of the middle copy, with FRESH set until the reader takes it
+	unsigned front; // Reader's
+	unsigned back; // Writer's
+};
+
+#endif
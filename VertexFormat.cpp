@@ -0,0 +1,268 @@
+// Packed interleaved vertex formats written by Parker Drake
+#include "VertexFormat.h"
+#include "CubeMesh.h"
+#include "SkinnedMesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+namespace
+{
+	int Round(float value)
+	{
+		return (int)floorf(value + 0.5f);
+	}
+}
+
+int FormatSize(AttributeFormat format)
+{
+	switch (format)
+	{
+	case FORMAT_FLOAT3: return 12;
+	case FORMAT_HALF3: return 8;
+	default: return 4;
+	}
+}
+
+int FormatComponents(AttributeFormat format)
+{
+	return format == FORMAT_FLOAT3 || format == FORMAT_HALF3 || format == FORMAT_SNORM_10_10_10_2 ? 3 : 4;
+}
+
+unsigned short FloatToHalf(float value)
+{
+	unsigned bits;
+	memcpy(&bits, &value, sizeof(bits));
+	unsigned sign = (bits >> 16) & 0x8000;
+	unsigned exponent = (bits >> 23) & 0xFF;
+	unsigned mantissa = bits & 0x7FFFFF;
+
+	// Infinity stays infinity, NaN stays NaN
+	if (exponent == 0xFF)
+		return (unsigned short)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+
+	int e = (int)exponent - 127 + 15;
+	if (e >= 31)
+		return (unsigned short)(sign | 0x7C00);
+	unsigned half, rest, halfway;
+	if (e <= 0)
+	{
+		// Too small for a normal half: shift the implicit one into a subnormal
+		if (e < -10)
+			return (unsigned short)sign;
+		mantissa |= 0x800000;
+		int shift = 14 - e;
+		half = mantissa >> shift;
+		rest = mantissa & ((1u << shift) - 1);
+		halfway = 1u << (shift - 1);
+	}
+	else
+	{
+		half = ((unsigned)e << 10) | (mantissa >> 13);
+		rest = mantissa & 0x1FFF;
+		halfway = 0x1000;
+	}
+	// Round to nearest even; a carry out of the mantissa correctly bumps the exponent
+	if (rest > halfway || (rest == halfway && (half & 1)))
+		half++;
+	return (unsigned short)(sign | half);
+}
+
+float HalfToFloat(unsigned short half)
+{
+	unsigned sign = (unsigned)(half & 0x8000) << 16;
+	unsigned exponent = (half >> 10) & 0x1F;
+	unsigned mantissa = half & 0x3FF;
+	if (exponent == 0)
+	{
+		float value = ldexpf((float)mantissa, -24);
+		return sign ? -value : value;
+	}
+	unsigned bits = exponent == 31 ? sign | 0x7F800000 | (mantissa << 13) : sign | ((exponent + 112) << 23) | (mantissa << 13);
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+void PackAttribute(AttributeFormat format, const float* values, int components, unsigned char* out)
+{
+	float v[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < std::min(components, 4); i++)
+		v[i] = values[i];
+
+	switch (format)
+	{
+	case FORMAT_FLOAT3:
+		memcpy(out, v, 12);
+		break;
+	case FORMAT_HALF3:
+	{
+		unsigned short half[4] = { FloatToHalf(v[0]), FloatToHalf(v[1]), FloatToHalf(v[2]), 0 };
+		memcpy(out, half, 8);
+		break;
+	}
+	case FORMAT_SNORM_10_10_10_2:
+	{
+		// Two's complement fields from the low bits up: x, y, z, then w in the top two
+		unsigned packed = 0;
+		for (int i = 0; i < 3; i++)
+			packed |= (unsigned)(Round(std::max(-1.0f, std::min(1.0f, v[i])) * 511.0f) & 0x3FF) << (10 * i);
+		packed |= (unsigned)(Round(std::max(-1.0f, std::min(1.0f, v[3]))) & 0x3) << 30;
+		memcpy(out, &packed, 4);
+		break;
+	}
+	case FORMAT_UNORM8x4:
+		for (int i = 0; i < 4; i++)
+			out[i] = (unsigned char)Round(std::max(0.0f, std::min(1.0f, v[i])) * 255.0f);
+		break;
+	case FORMAT_UINT8x4:
+		for (int i = 0; i < 4; i++)
+			out[i] = (unsigned char)std::max(0, std::min(255, Round(v[i])));
+		break;
+	}
+}
+
+void UnpackAttribute(AttributeFormat format, const unsigned char* in, float* values)
+{
+	switch (format)
+	{
+	case FORMAT_FLOAT3:
+		memcpy(values, in, 12);
+		break;
+	case FORMAT_HALF3:
+	{
+		unsigned short half[3];
+		memcpy(half, in, 6);
+		for (int i = 0; i < 3; i++)
+			values[i] = HalfToFloat(half[i]);
+		break;
+	}
+	case FORMAT_SNORM_10_10_10_2:
+	{
+		unsigned packed;
+		memcpy(&packed, in, 4);
+		for (int i = 0; i < 3; i++)
+		{
+			int field = (int)((packed >> (10 * i)) & 0x3FF);
+			if (field >= 512)
+				field -= 1024;
+			values[i] = std::max(-1.0f, field / 511.0f);
+		}
+		break;
+	}
+	case FORMAT_UNORM8x4:
+		for (int i = 0; i < 4; i++)
+			values[i] = in[i] / 255.0f;
+		break;
+	case FORMAT_UINT8x4:
+		for (int i = 0; i < 4; i++)
+			values[i] = in[i];
+		break;
+	}
+}
+
+void VertexLayout::Add(const char* name, AttributeFormat format)
+{
+	Attribute attribute;
+	attribute.name = name;
+	attribute.format = format;
+	attribute.offset = stride;
+	attributes.push_back(attribute);
+	stride += FormatSize(format);
+}
+
+int VertexLayout::Find(const char* name) const
+{
+	for (size_t i = 0; i < attributes.size(); i++)
+	{
+		if (!strcmp(attributes[i].name, name))
+			return (int)i;
+	}
+	return -1;
+}
+
+void PackedMesh::AddVertex(const float* const* values, const int* components)
+{
+	size_t start = vertices.size();
+	vertices.resize(start + layout.stride);
+	for (size_t i = 0; i < layout.attributes.size(); i++)
+		PackAttribute(layout.attributes[i].format, values[i], components[i], &vertices[start + layout.attributes[i].offset]);
+}
+
+void PackedMesh::Deduplicate()
+{
+	int count = VertexCount();
+	if (indices.empty())
+	{
+		indices.resize(count);
+		for (int i = 0; i < count; i++)
+			indices[i] = (unsigned)i;
+	}
+
+	// Packing makes equal vertices byte for byte equal, so the bytes are the key
+	std::unordered_map<std::string, unsigned> unique;
+	std::vector<unsigned> remap(count);
+	std::vector<unsigned char> merged;
+	for (int i = 0; i < count; i++)
+	{
+		std::string key((const char*)&vertices[i * layout.stride], layout.stride);
+		std::unordered_map<std::string, unsigned>::iterator found = unique.find(key);
+		if (found != unique.end())
+		{
+			remap[i] = found->second;
+			continue;
+		}
+		remap[i] = (unsigned)unique.size();
+		unique[key] = remap[i];
+		merged.insert(merged.end(), key.begin(), key.end());
+	}
+	vertices.swap(merged);
+	for (size_t i = 0; i < indices.size(); i++)
+		indices[i] = remap[indices[i]];
+}
+
+void BuildCubeMesh(PackedMesh& out)
+{
+	out = PackedMesh();
+	out.layout.Add("position", FORMAT_HALF3);
+	out.layout.Add("color", FORMAT_UNORM8x4);
+	int components[2] = { 3, 3 };
+	for (int v = 0; v < CUBE_VERTEX_COUNT; v++)
+	{
+		const float* vertex = cubeVertices + v * CUBE_VERTEX_STRIDE;
+		const float* values[2] = { vertex, vertex + 3 };
+		out.AddVertex(values, components);
+	}
+	out.Deduplicate();
+}
+
+void PackSkinnedMesh(const SkinnedMesh& mesh, PackedMesh& out)
+{
+	out = PackedMesh();
+	out.layout.Add("position", FORMAT_HALF3);
+	out.layout.Add("color", FORMAT_UNORM8x4);
+	out.layout.Add("boneIndices", FORMAT_UINT8x4);
+	out.layout.Add("boneWeights", FORMAT_UNORM8x4);
+	int weightsOffset = out.layout.attributes[3].offset;
+	int components[4] = { 3, 3, MAX_INFLUENCES, MAX_INFLUENCES };
+
+	for (int v = 0; v < mesh.VertexCount(); v++)
+	{
+		float joints[MAX_INFLUENCES];
+		for (int k = 0; k < MAX_INFLUENCES; k++)
+			joints[k] = mesh.joints[v * MAX_INFLUENCES + k];
+		const float* values[4] = { &mesh.positions[v * 3], &mesh.colors[v * 3], joints, &mesh.weights[v * MAX_INFLUENCES] };
+		out.AddVertex(values, components);
+
+		// Rounded weights can miss 1 by a step; the heaviest, first, takes up the difference
+		unsigned char* weights = &out.vertices[v * out.layout.stride + weightsOffset];
+		int rest = 0;
+		for (int k = 1; k < MAX_INFLUENCES; k++)
+			rest += weights[k];
+		weights[0] = (unsigned char)(255 - rest);
+	}
+	out.indices = mesh.indices;
+}
@@ -0,0 +1,80 @@
+// Packed interleaved vertex formats written by Parker Drake
+#pragma once
+#ifndef _VertexFormat_H_
+#define _VertexFormat_H_
+
+#include <vector>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+struct SkinnedMesh;
+
+// How one attribute is stored in a vertex. Every format is padded to a
+// multiple of four bytes so the attributes after it stay aligned.
+enum AttributeFormat
+{
+	FORMAT_FLOAT3, // 12 bytes
+	FORMAT_HALF3, // Half floats, 8 bytes with padding
+	FORMAT_SNORM_10_10_10_2, // x, y, z in [-1, 1] with 10 bits each, 4 bytes; for normals (no mesh has them yet)
+	FORMAT_UNORM8x4, // Four [0, 1] values with 8 bits each, 4 bytes; for colors and weights
+	FORMAT_UINT8x4 // Four integers below 256, 4 bytes; for joint indices
+};
+
+int FormatSize(AttributeFormat format);
+// Values the shader receives from the attribute
+int FormatComponents(AttributeFormat format);
+
+unsigned short FloatToHalf(float value);
+float HalfToFloat(unsigned short half);
+
+// Writes components values as format into out, zero filling what they leave out
+void PackAttribute(AttributeFormat format, const float* values, int components, unsigned char* out);
+// Reads back what PackAttribute wrote, FormatComponents(format) values
+void UnpackAttribute(AttributeFormat format, const unsigned char* in, float* values);
+
+// Named attributes of one interleaved vertex, in order
+struct VertexLayout
+{
+	struct Attribute
+	{
+		const char* name; // Shader input it feeds
+		AttributeFormat format;
+		int offset;
+	};
+
+	std::vector<Attribute> attributes;
+	int stride;
+
+	VertexLayout() : stride(0) {}
+	void Add(const char* name, AttributeFormat format);
+	// Index of the attribute, or -1
+	int Find(const char* name) const;
+};
+
+// Interleaved vertices and the triangles that index them
+struct PackedMesh
+{
+	VertexLayout layout;
+	std::vector<unsigned char> vertices; // layout.stride bytes per vertex
+	std::vector<unsigned> indices; // Three per triangle
+
+	int VertexCount() const { return layout.stride > 0 ? (int)(vertices.size() / layout.stride) : 0; }
+	// Indices fit in 16 bits
+	bool ShortIndices() const { return VertexCount() <= 65536; }
+	size_t VertexBytes() const { return vertices.size(); }
+	size_t IndexBytes() const { return indices.size() * (ShortIndices() ? 2 : 4); }
+
+	// Appends one vertex from per-attribute values, each of three or four floats
+	void AddVertex(const float* const* values, const int* components);
+	// Merges vertices with identical bytes, rewriting the indices. With no
+	// indices yet, the vertices are taken as a triangle list.
+	void Deduplicate();
+};
+
+// The unit cube of CubeMesh.h as half float positions and 8-bit colors, 36 vertices merged into 24
+void BuildCubeMesh(PackedMesh& out);
+// A skinned mesh's bind pose for GPU skinning: half float positions, 8-bit
+// colors, 8-bit joint indices and weights
+void PackSkinnedMesh(const SkinnedMesh& mesh, PackedMesh& out);
+
+#endif
@@ -0,0 +1,119 @@
+// Worker thread pool written by Parker Drake
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(int threads)
+	: task(NULL), count(0), grain(1), next(0), busy(0), generation(0), quit(false)
+{
+	Start(threads);
+}
+
+WorkerPool::~WorkerPool()
+{
+	Stop();
+}
+
+int WorkerPool::HardwareThreads()
+{
+	unsigned n = std::thread::hardware_concurrency();
+	return n > 0 ? (int)n : 1;
+}
+
+void WorkerPool::Resize(int threads)
+{
+	Stop();
+	Start(threads);
+}
+
+void WorkerPool::Start(int threads)
+{
+	if (threads <= 0)
+		threads = HardwareThreads();
+
+	// New threads must not take the last ParallelFor's generation for a new job
+	unsigned current;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = false;
+		current = generation;
+	}
+	for (int i = 1; i < threads; i++)
+		workers.push_back(std::thread(&WorkerPool::WorkerLoop, this, i, current));
+}
+
+void WorkerPool::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+	workers.clear();
+}
+
+void WorkerPool::ParallelFor(int n, int chunk, const RangeTask& job)
+{
+	if (n <= 0)
+		return;
+	if (chunk <= 0)
+		chunk = std::max(1, n / (ThreadCount() * 4));
+
+	// Nothing to share, skip the wake up
+	if (workers.empty() || chunk >= n)
+	{
+		job(0, n, 0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		task = &job;
+		count = n;
+		grain = chunk;
+		next.store(0);
+		busy = (int)workers.size();
+		generation++;
+	}
+	wake.notify_all();
+
+	RunChunks(0);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return busy == 0; });
+	task = NULL;
+}
+
+void WorkerPool::RunChunks(int worker)
+{
+	// Chunks are handed out in order, so neighbouring indices stay on one thread
+	for (;;)
+	{
+		int begin = next.fetch_add(grain);
+		if (begin >= count)
+			break;
+		(*task)(begin, std::min(begin + grain, count), worker);
+	}
+}
+
+void WorkerPool::WorkerLoop(int worker, unsigned seen)
+{
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return quit || generation != seen; });
+			if (quit)
+				return;
+			seen = generation;
+		}
+
+		RunChunks(worker);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--busy == 0)
+			done.notify_one();
+	}
+}
@@ -0,0 +1,74 @@
+// Worker thread pool written by Parker Drake
+#pragma once
+#ifndef _WorkerPool_H_
+#define _WorkerPool_H_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// Non-owning reference to a callable taking (begin, end, worker). Unlike
+// std::function it never allocates, so a lambda with any number of captures
+// can be handed to ParallelFor every frame without touching the heap. The
+// callable must outlive the reference, which it does for the length of a call.
+class RangeTask
+{
+public:
+	template <typename F>
+	RangeTask(const F& function) : object(&function), call(&Call<F>) {}
+
+	void operator()(int begin, int end, int worker) const { call(object, begin, end, worker); }
+
+private:
+	template <typename F>
+	static void Call(const void* object, int begin, int end, int worker) { (*static_cast<const F*>(object))(begin, end, worker); }
+
+	const void* object;
+	void (*call)(const void*, int, int, int);
+};
+
+// Fixed set of threads that split index ranges between them. The thread
+// calling ParallelFor() takes part in the work, so a pool of N threads
+// starts N - 1 extra threads.
+class WorkerPool
+{
+public:
+	// threads <= 0 uses one thread per hardware thread
+	explicit WorkerPool(int threads = 0);
+	~WorkerPool();
+
+	int ThreadCount() const { return (int)workers.size() + 1; }
+	void Resize(int threads);
+
+	// Calls task(begin, end, worker) over [0, count) in chunks of grain indices
+	// and returns once every chunk is done. worker is in [0, ThreadCount()).
+	// grain <= 0 picks a chunk size that gives each thread a few chunks.
+	void ParallelFor(int count, int grain, const RangeTask& task);
+
+	static int HardwareThreads();
+
+private:
+	void Start(int threads);
+	void Stop();
+	// seen is the generation the thread starts at; it works on the generations after it
+	void WorkerLoop(int worker, unsigned seen);
+	void RunChunks(int worker);
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	// Current job, published under mutex
+	const RangeTask* task;
+	int count;
+	int grain;
+	std::atomic<int> next;
+	int busy;
+	unsigned generation;
+	bool quit;
+};
+
+#endif
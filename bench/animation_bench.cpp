@@ -0,0 +1,298 @@
+// Regression benchmarks for the animation library written by Parker Drake
+// Covers the MatrixStack helpers, a walk of the robot skeleton, crowd
+// posing and CPU skinning. Run through the bench target, which writes bench.json; compare two
+// runs with bench/compare_bench.py. Nothing here needs a GPU.
+#include <benchmark/benchmark.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "MatrixStack.h"
+#include "Skeleton.h"
+#include "Robot.h"
+#include "PoseEvaluator.h"
+#include "Crowd.h"
+#include "WorkerPool.h"
+#include "Quaternion.h"
+#include "SkinnedMesh.h"
+
+namespace
+{
+	const glm::mat4 base(
+		glm::vec4(0.9f, 0.1f, -0.2f, 0.0f),
+		glm::vec4(-0.1f, 0.95f, 0.3f, 0.0f),
+		glm::vec4(0.2f, -0.3f, 0.9f, 0.0f),
+		glm::vec4(1.0f, 2.0f, -3.0f, 1.0f));
+
+	glm::mat4 DefaultViewProjection()
+	{
+		MatrixStack camera;
+		camera.Perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f);
+		camera.LookAt(glm::vec3(0.0f, 0.0f, 20.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		return camera.topMatrix();
+	}
+
+	// The recursive walk the windowed client used before the skeleton was flattened
+	struct LimbWalk
+	{
+		const Skeleton& skeleton;
+		std::vector<glm::vec3> angles; // Euler angles, as the recursive walk stored them
+		MatrixStack stack;
+		std::vector<glm::mat4> mvp;
+		int drawn;
+
+		explicit LimbWalk(const Skeleton& s)
+			: skeleton(s), angles(s.size()), mvp(s.size()), drawn(0)
+		{
+			for (int i = 0; i < s.size(); i++)
+				angles[i] = QuatToEuler(s.rotRelJoint[i]);
+		}
+
+		void DrawLimb(int joint)
+		{
+			MatrixScope limb(stack);
+			stack.translate(skeleton.transRelJoint[joint]);
+			stack.translate(skeleton.transRelParent[joint]);
+			stack.rotateX(angles[joint][0]);
+			stack.rotateY(angles[joint][1]);
+			stack.rotateZ(angles[joint][2]);
+			stack.translate(-skeleton.transRelJoint[joint]);
+			{
+				MatrixScope cube(stack);
+				stack.scale(skeleton.scaleFactor[joint]);
+				mvp[drawn++] = stack.topMatrix();
+			}
+			for (int i = 0; i < skeleton.ChildCount(joint); i++)
+				DrawLimb(skeleton.Child(joint, i));
+		}
+	};
+}
+
+static void BM_MultMatrix(benchmark::State& state)
+{
+	MatrixStack stack;
+	glm::mat4 matrix = base;
+	for (auto _ : state)
+	{
+		stack.topMatrix() = base;
+		stack.multMatrix(matrix);
+		benchmark::DoNotOptimize(stack.topMatrix());
+	}
+}
+BENCHMARK(BM_MultMatrix);
+
+static void BM_MultAffineMatrix(benchmark::State& state)
+{
+	MatrixStack stack;
+	glm::mat4 matrix = base;
+	for (auto _ : state)
+	{
+		stack.topMatrix() = base;
+		stack.multAffineMatrix(matrix);
+		benchmark::DoNotOptimize(stack.topMatrix());
+	}
+}
+BENCHMARK(BM_MultAffineMatrix);
+
+static void BM_LookAt(benchmark::State& state)
+{
+	MatrixStack stack;
+	for (auto _ : state)
+	{
+		stack.topMatrix() = base;
+		stack.LookAt(glm::vec3(0.0f, 0.0f, 20.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		benchmark::DoNotOptimize(stack.topMatrix());
+	}
+}
+BENCHMARK(BM_LookAt);
+
+static void BM_Perspective(benchmark::State& state)
+{
+	MatrixStack stack;
+	for (auto _ : state)
+	{
+		stack.topMatrix() = base;
+		stack.Perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f);
+		benchmark::DoNotOptimize(stack.topMatrix());
+	}
+}
+BENCHMARK(BM_Perspective);
+
+static void BM_Translate(benchmark::State& state)
+{
+	MatrixStack stack;
+	for (auto _ : state)
+	{
+		stack.topMatrix() = base;
+		stack.translate(2.0f, 1.5f, 0.0f);
+		benchmark::DoNotOptimize(stack.topMatrix());
+	}
+}
+BENCHMARK(BM_Translate);
+
+static void BM_Rotate(benchmark::State& state)
+{
+	MatrixStack stack;
+	for (auto _ : state)
+	{
+		stack.topMatrix() = base;
+		stack.rotateX(0.3f);
+		stack.rotateY(-1.0f);
+		stack.rotateZ(0.2f);
+		benchmark::DoNotOptimize(stack.topMatrix());
+	}
+	state.SetItemsProcessed(state.iterations() * 3);
+}
+BENCHMARK(BM_Rotate);
+
+static void BM_Scale(benchmark::State& state)
+{
+	MatrixStack stack;
+	for (auto _ : state)
+	{
+		stack.topMatrix() = base;
+		stack.scale(1.0f, 0.4f, 0.4f);
+		benchmark::DoNotOptimize(stack.topMatrix());
+	}
+}
+BENCHMARK(BM_Scale);
+
+static void BM_PushPop(benchmark::State& state)
+{
+	MatrixStack stack;
+	for (auto _ : state)
+	{
+		MatrixScope scope(stack);
+		stack.topMatrix()[3][0] += 1.0f;
+		benchmark::DoNotOptimize(stack.topMatrix());
+	}
+}
+BENCHMARK(BM_PushPop);
+
+// Recursive DrawLimb() walk of the robot, one MatrixStack helper per channel
+static void BM_RobotRecursiveWalk(benchmark::State& state)
+{
+	Skeleton robot;
+	ConstructRobot(robot);
+	SetRunningPose(robot, 0.3);
+	LimbWalk walk(robot);
+	glm::mat4 viewProjection = DefaultViewProjection();
+	for (auto _ : state)
+	{
+		walk.stack.topMatrix() = viewProjection;
+		walk.drawn = 0;
+		walk.DrawLimb(0);
+		benchmark::DoNotOptimize(walk.mvp[0]);
+	}
+	state.SetItemsProcessed(state.iterations() * robot.size());
+}
+BENCHMARK(BM_RobotRecursiveWalk);
+
+// The same robot through the flat skeleton with every joint rebuilt
+static void BM_RobotFullUpdate(benchmark::State& state)
+{
+	Skeleton robot;
+	ConstructRobot(robot);
+	SetRunningPose(robot, 0.3);
+	PoseEvaluator evaluator;
+	PoseBuffer pose;
+	glm::mat4 viewProjection = DefaultViewProjection();
+	for (auto _ : state)
+	{
+		robot.MarkAllDirty();
+		evaluator.Evaluate(robot, viewProjection, pose);
+		benchmark::DoNotOptimize(pose.mvp[0]);
+	}
+	state.SetItemsProcessed(state.iterations() * robot.size());
+}
+BENCHMARK(BM_RobotFullUpdate);
+
+// One frame of the running cycle: pose, hierarchy and projection
+static void BM_RobotRunningFrame(benchmark::State& state)
+{
+	Skeleton robot;
+	ConstructRobot(robot);
+	SetRunningStartPose(robot);
+	PoseEvaluator evaluator;
+	PoseBuffer pose;
+	glm::mat4 viewProjection = DefaultViewProjection();
+	double time = 0.0;
+	for (auto _ : state)
+	{
+		evaluator.Evaluate(robot, time, viewProjection, pose);
+		time += 1.0 / 60.0;
+		benchmark::DoNotOptimize(pose.mvp[0]);
+	}
+	state.SetItemsProcessed(state.iterations() * robot.size());
+}
+BENCHMARK(BM_RobotRunningFrame);
+
+// Posing N animated characters per frame on one thread, then on every hardware thread
+static void BM_CrowdPose(benchmark::State& state)
+{
+	Skeleton robot;
+	ConstructRobot(robot);
+	Crowd crowd(robot);
+	int count = (int)state.range(0);
+	int side = 1;
+	while (side * side < count)
+		side++;
+	for (int n = 0; n < count; n++)
+	{
+		CrowdInstance instance;
+		instance.phase = (n % 17) / 8.5f;
+		instance.frequency = 5.0f + (n % 7) / 3.5f;
+		MatrixStack placement;
+		placement.translate((n % side - side / 2) * 6.0f, 0.0f, -(n / side) * 6.0f);
+		instance.root = placement.topMatrix();
+		crowd.Add(instance);
+	}
+
+	WorkerPool pool((int)state.range(1));
+	glm::mat4 viewProjection = DefaultViewProjection();
+	double time = 0.0;
+	for (auto _ : state)
+	{
+		crowd.Evaluate(time, viewProjection, pool);
+		time += 1.0 / 60.0;
+		benchmark::DoNotOptimize(crowd.mvp[0]);
+	}
+	state.SetItemsProcessed(state.iterations() * count);
+	state.counters["threads"] = pool.ThreadCount();
+}
+BENCHMARK(BM_CrowdPose)
+	->ArgNames({ "instances", "threads" })
+	->Args({ 1, 1 })->Args({ 10, 1 })->Args({ 100, 1 })->Args({ 10000, 1 })
+	->Args({ 10000, 0 }) // 0 threads: one per hardware thread
+	->Unit(benchmark::kMicrosecond)
+	->UseRealTime();
+
+// Skinning the robot mesh on one thread, then on every hardware thread
+static void BM_Skin(benchmark::State& state)
+{
+	Skeleton robot;
+	ConstructRobot(robot);
+	SkinnedMesh mesh;
+	BuildRobotMesh(robot, mesh, (int)state.range(0));
+	SetRunningPose(robot, 0.3);
+	robot.UpdateTransforms(glm::mat4(1.0f));
+	std::vector<glm::mat4> palette(robot.size());
+	Skinning::ComputePalette(robot, mesh, &palette[0]);
+
+	WorkerPool pool((int)state.range(1));
+	std::vector<float> skinned(mesh.positions.size());
+	for (auto _ : state)
+	{
+		Skinning::Skin(mesh, &palette[0], &skinned[0], pool);
+		benchmark::DoNotOptimize(skinned[0]);
+	}
+	state.SetItemsProcessed(state.iterations() * mesh.VertexCount());
+	state.counters["vertices"] = mesh.VertexCount();
+	state.counters["threads"] = pool.ThreadCount();
+}
+BENCHMARK(BM_Skin)
+	->ArgNames({ "segments", "threads" })
+	->Args({ 8, 1 })->Args({ 256, 1 })
+	->Args({ 256, 0 }) // 0 threads: one per hardware thread
+	->Unit(benchmark::kMicrosecond)
+	->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,40 @@
+#!/usr/bin/env python3
+# Compares two Google Benchmark JSON files written by the bench target.
+# Usage: compare_bench.py baseline.json current.json [threshold percent, default 10]
+# Exits with 1 when any benchmark got slower than the threshold.
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        results = json.load(f)["benchmarks"]
+    # With repetitions only the median is compared
+    return {b["run_name"] if "run_name" in b else b["name"]: b for b in results
+            if b.get("aggregate_name", "median") == "median"}
+
+
+def main():
+    if len(sys.argv) < 3:
+        print(__doc__ or "usage: compare_bench.py baseline.json current.json [threshold]")
+        return 2
+    baseline, current = load(sys.argv[1]), load(sys.argv[2])
+    threshold = float(sys.argv[3]) if len(sys.argv) > 3 else 10.0
+
+    regressions = 0
+    print("%-44s %12s %12s %8s" % ("benchmark", "baseline", "current", "change"))
+    for name, result in current.items():
+        if name not in baseline:
+            print("%-44s %12s %12.1f %8s" % (name, "-", result["real_time"], "new"))
+            continue
+        before, after = baseline[name]["real_time"], result["real_time"]
+        change = (after - before) / before * 100.0
+        slower = change > threshold
+        regressions += slower
+        print("%-44s %12.1f %12.1f %+7.1f%%%s" % (name, before, after, change, "  SLOWER" if slower else ""))
+    print("(times in each benchmark's own unit, %d regression(s) over %g%%)" % (regressions, threshold))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,281 @@
+// Microbenchmark for the MatrixStack kernels written by Parker Drake
+// Compares the original scalar triple-loop product and full-matrix transform
+// helpers against the SIMD kernels and the column-only helpers.
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <stack>
+#include <memory>
+#include "MatrixStack.h"
+#include "MatrixKernels.h"
+#include "Quaternion.h"
+
+namespace
+{
+	// The product MatrixStack::multMatrix used to compute: top = top * matrix
+	void ReferenceMultMatrix(glm::mat4& top, const glm::mat4& matrix)
+	{
+		glm::mat4 temp(0.0f);
+		for (int i = 0; i < 4; i++)
+			for (int j = 0; j < 4; j++)
+				for (int k = 0; k < 4; k++)
+					temp[i][j] += matrix[i][k] * top[k][j];
+		top = temp;
+	}
+
+	void ReferenceTranslate(glm::mat4& top, const glm::vec3& t)
+	{
+		glm::mat4 m(1.0f);
+		m[3] = glm::vec4(t, 1.0f);
+		ReferenceMultMatrix(top, m);
+	}
+
+	void ReferenceRotate(glm::mat4& top, int axis, float angle)
+	{
+		int a = (axis + 1) % 3, b = (axis + 2) % 3;
+		glm::mat4 m(1.0f);
+		m[a][a] = cos(angle);
+		m[a][b] = sin(angle);
+		m[b][a] = -sin(angle);
+		m[b][b] = cos(angle);
+		ReferenceMultMatrix(top, m);
+	}
+
+	void ReferenceScale(glm::mat4& top, const glm::vec3& s)
+	{
+		glm::mat4 m(1.0f);
+		m[0][0] = s[0];
+		m[1][1] = s[1];
+		m[2][2] = s[2];
+		ReferenceMultMatrix(top, m);
+	}
+
+	glm::mat4 RandomMatrix(bool affine)
+	{
+		glm::mat4 m;
+		for (int i = 0; i < 4; i++)
+			for (int j = 0; j < 4; j++)
+				m[i][j] = rand() / float(RAND_MAX) * 2.0f - 1.0f;
+		if (affine)
+			m[0][3] = m[1][3] = m[2][3] = 0.0f, m[3][3] = 1.0f;
+		return m;
+	}
+
+	float MaxError(const glm::mat4& a, const glm::mat4& b)
+	{
+		float error = 0.0f;
+		for (int i = 0; i < 4; i++)
+			for (int j = 0; j < 4; j++)
+				error = std::max(error, std::fabs(a[i][j] - b[i][j]));
+		return error;
+	}
+
+	double Seconds(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// Same work as one limb of the old DrawLimb(): 3 translates, 3 rotates and a scale
+	const glm::vec3 pivot(-1.5f, 0.0f, 0.0f);
+	const glm::vec3 offset(2.0f, 1.5f, 0.0f);
+	const glm::vec3 angles(0.3f, -1.0f, 0.2f);
+	const glm::vec3 size(1.0f, 0.4f, 0.4f);
+
+	void ReferenceLimb(glm::mat4& top)
+	{
+		ReferenceTranslate(top, pivot);
+		ReferenceTranslate(top, offset);
+		ReferenceRotate(top, 0, angles[0]);
+		ReferenceRotate(top, 1, angles[1]);
+		ReferenceRotate(top, 2, angles[2]);
+		ReferenceTranslate(top, -pivot);
+		ReferenceScale(top, size);
+	}
+
+	void StackLimb(MatrixStack& stack)
+	{
+		stack.translate(pivot);
+		stack.translate(offset);
+		stack.rotateX(angles[0]);
+		stack.rotateY(angles[1]);
+		stack.rotateZ(angles[2]);
+		stack.translate(-pivot);
+		stack.scale(size);
+	}
+
+	// The storage MatrixStack used before it held its matrices inline
+	struct ReferenceStack
+	{
+		std::shared_ptr< std::stack<glm::mat4> > matrices;
+		ReferenceStack() : matrices(std::make_shared< std::stack<glm::mat4> >()) { matrices->push(glm::mat4(1.0f)); }
+		void push() { matrices->push(matrices->top()); }
+		void pop() { matrices->pop(); }
+	};
+
+	// The same limb with the rotation stored as a quaternion and composed in one step
+	void QuaternionLimb(MatrixStack& stack, const glm::quat& rotation)
+	{
+		glm::mat4 local;
+		ComposeAffine(rotation, offset, glm::vec3(1.0f), pivot, local);
+		stack.multAffineMatrix(local);
+		stack.scale(size);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const int iterations = argc > 1 ? atoi(argv[1]) : 2000000;
+	const int count = 256;
+
+	std::vector<glm::mat4> lhs(count), rhs(count), affine(count);
+	for (int i = 0; i < count; i++)
+	{
+		lhs[i] = RandomMatrix(false);
+		rhs[i] = RandomMatrix(false);
+		affine[i] = RandomMatrix(true);
+	}
+
+	glm::mat4 sink(0.0f);
+	std::chrono::high_resolution_clock::time_point start;
+
+	// Full 4x4 products
+	start = std::chrono::high_resolution_clock::now();
+	for (int n = 0; n < iterations; n++)
+	{
+		glm::mat4 top = lhs[n % count];
+		ReferenceMultMatrix(top, rhs[n % count]);
+		sink[n & 3] += top[n & 3];
+	}
+	double reference = Seconds(start);
+	printf("%-28s %8.2f ns/op\n", "mat4 x mat4 reference", reference * 1e9 / iterations);
+
+	const MatrixKernels::Kernel kernels[] = { MatrixKernels::KERNEL_SCALAR, MatrixKernels::KERNEL_SSE, MatrixKernels::KERNEL_AVX, MatrixKernels::KERNEL_NEON };
+	MatrixKernels::Kernel best = MatrixKernels::Active();
+	for (int k = 0; k < 4; k++)
+	{
+		if (!MatrixKernels::Select(kernels[k]))
+			continue;
+
+		float error = 0.0f;
+		for (int i = 0; i < count; i++)
+		{
+			glm::mat4 expected = lhs[i], result;
+			ReferenceMultMatrix(expected, rhs[i]);
+			MatrixKernels::Multiply(glm::value_ptr(lhs[i]), glm::value_ptr(rhs[i]), glm::value_ptr(result));
+			error = std::max(error, MaxError(expected, result));
+
+			expected = lhs[i];
+			ReferenceMultMatrix(expected, affine[i]);
+			MatrixKernels::MultiplyAffine(glm::value_ptr(lhs[i]), glm::value_ptr(affine[i]), glm::value_ptr(result));
+			error = std::max(error, MaxError(expected, result));
+		}
+
+		start = std::chrono::high_resolution_clock::now();
+		for (int n = 0; n < iterations; n++)
+		{
+			glm::mat4 top = lhs[n % count];
+			MatrixKernels::Multiply(glm::value_ptr(top), glm::value_ptr(rhs[n % count]), glm::value_ptr(top));
+			sink[n & 3] += top[n & 3];
+		}
+		double full = Seconds(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		for (int n = 0; n < iterations; n++)
+		{
+			glm::mat4 top = lhs[n % count];
+			MatrixKernels::MultiplyAffine(glm::value_ptr(top), glm::value_ptr(affine[n % count]), glm::value_ptr(top));
+			sink[n & 3] += top[n & 3];
+		}
+		double partial = Seconds(start);
+
+		printf("%-28s %8.2f ns/op  %5.2fx  (affine %6.2f ns/op %5.2fx)  max error %g\n", MatrixKernels::Name(kernels[k]),
+			full * 1e9 / iterations, reference / full, partial * 1e9 / iterations, reference / partial, error);
+	}
+	MatrixKernels::Select(best);
+
+	// One limb's worth of transform helpers
+	start = std::chrono::high_resolution_clock::now();
+	for (int n = 0; n < iterations; n++)
+	{
+		glm::mat4 top = lhs[n % count];
+		ReferenceLimb(top);
+		sink[n & 3] += top[n & 3];
+	}
+	double referenceLimb = Seconds(start);
+
+	MatrixStack stack;
+	start = std::chrono::high_resolution_clock::now();
+	for (int n = 0; n < iterations; n++)
+	{
+		stack.topMatrix() = lhs[n % count];
+		StackLimb(stack);
+		sink[n & 3] += stack.topMatrix()[n & 3];
+	}
+	double stackLimb = Seconds(start);
+
+	const glm::quat rotation = EulerToQuat(angles);
+	start = std::chrono::high_resolution_clock::now();
+	for (int n = 0; n < iterations; n++)
+	{
+		stack.topMatrix() = lhs[n % count];
+		QuaternionLimb(stack, rotation);
+		sink[n & 3] += stack.topMatrix()[n & 3];
+	}
+	double quaternionLimb = Seconds(start);
+
+	float limbError = 0.0f, quaternionError = 0.0f;
+	for (int i = 0; i < count; i++)
+	{
+		glm::mat4 expected = lhs[i];
+		ReferenceLimb(expected);
+		stack.topMatrix() = lhs[i];
+		StackLimb(stack);
+		limbError = std::max(limbError, MaxError(expected, stack.topMatrix()));
+		stack.topMatrix() = lhs[i];
+		QuaternionLimb(stack, rotation);
+		quaternionError = std::max(quaternionError, MaxError(expected, stack.topMatrix()));
+	}
+
+	printf("%-28s %8.2f ns/limb\n", "limb transforms reference", referenceLimb * 1e9 / iterations);
+	printf("%-28s %8.2f ns/limb %5.2fx  max error %g\n", "limb transforms MatrixStack", stackLimb * 1e9 / iterations, referenceLimb / stackLimb, limbError);
+	printf("%-28s %8.2f ns/limb %5.2fx  max error %g\n", "limb transforms quaternion", quaternionLimb * 1e9 / iterations, referenceLimb / quaternionLimb, quaternionError);
+	// Push, touch and pop, as a skeleton walk does per joint
+	ReferenceStack referenceStack;
+	start = std::chrono::high_resolution_clock::now();
+	for (int n = 0; n < iterations; n++)
+	{
+		for (int d = 0; d < 4; d++)
+		{
+			referenceStack.push();
+			referenceStack.matrices->top()[3][d] += 1.0f;
+		}
+		sink[n & 3] += referenceStack.matrices->top()[3];
+		for (int d = 0; d < 4; d++)
+			referenceStack.pop();
+	}
+	double referencePush = Seconds(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int n = 0; n < iterations; n++)
+	{
+		MatrixScope a(stack);
+		stack.topMatrix()[3][0] += 1.0f;
+		MatrixScope b(stack);
+		stack.topMatrix()[3][1] += 1.0f;
+		MatrixScope c(stack);
+		stack.topMatrix()[3][2] += 1.0f;
+		MatrixScope d(stack);
+		stack.topMatrix()[3][3] += 1.0f;
+		sink[n & 3] += stack.topMatrix()[3];
+	}
+	double inlinePush = Seconds(start);
+
+	printf("%-28s %8.2f ns/push\n", "push/pop std::stack", referencePush * 1e9 / iterations / 4);
+	printf("%-28s %8.2f ns/push %5.2fx\n", "push/pop MatrixStack", inlinePush * 1e9 / iterations / 4, referencePush / inlinePush);
+	printf("(active kernel %s, checksum %g)\n", MatrixKernels::Name(best), sink[0][0] + sink[1][1] + sink[2][2] + sink[3][3]);
+	return 0;
+}
@@ -0,0 +1,88 @@
+// Microbenchmark for batched quaternion blending written by Parker Drake
+// Blends the joints of a crowd of characters one quaternion at a time with
+// glm::slerp, then with the batched nlerp and slerp paths.
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "Quaternion.h"
+
+namespace
+{
+	glm::quat RandomRotation(float spread)
+	{
+		glm::vec3 angles;
+		for (int i = 0; i < 3; i++)
+			angles[i] = (rand() / float(RAND_MAX) * 2.0f - 1.0f) * spread;
+		return EulerToQuat(angles);
+	}
+
+	// Angle between two rotations in radians
+	float AngleBetween(const glm::quat& a, const glm::quat& b)
+	{
+		float d = std::min(1.0f, std::fabs(glm::dot(a, b)));
+		return 2.0f * std::acos(d);
+	}
+
+	double Seconds(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const int characters = argc > 1 ? atoi(argv[1]) : 10000;
+	const int joints = 10;
+	const int count = characters * joints;
+	const int repeats = 20;
+
+	// Key poses up to 3 radians apart per axis, with a blend weight per character
+	std::vector<glm::quat> a(count), b(count), reference(count), out(count);
+	std::vector<float> alpha(count);
+	for (int i = 0; i < count; i++)
+	{
+		a[i] = RandomRotation(3.0f);
+		b[i] = RandomRotation(3.0f);
+		alpha[i] = (i / joints) % 17 / 16.0f;
+	}
+
+	double sink = 0.0;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < repeats; r++)
+	{
+		for (int i = 0; i < count; i++)
+			reference[i] = glm::slerp(a[i], b[i], alpha[i]);
+		sink += reference[r % count].w;
+	}
+	double exact = Seconds(start) / repeats;
+
+	printf("%d characters x %d joints, %s batches\n", characters, joints, QuatBlend::Name());
+	printf("%-22s %10.2f ns/joint\n", "glm::slerp", exact * 1e9 / count);
+
+	for (int mode = 0; mode < 2; mode++)
+	{
+		start = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < repeats; r++)
+		{
+			if (mode == 0)
+				QuatBlend::Nlerp(&a[0], &b[0], &alpha[0], &out[0], count);
+			else
+				QuatBlend::Slerp(&a[0], &b[0], &alpha[0], &out[0], count);
+			sink += out[r % count].w;
+		}
+		double batched = Seconds(start) / repeats;
+
+		float error = 0.0f;
+		for (int i = 0; i < count; i++)
+			error = std::max(error, AngleBetween(reference[i], out[i]));
+		printf("%-22s %10.2f ns/joint %6.2fx  max angle from slerp %g rad\n", mode == 0 ? "QuatBlend::Nlerp" : "QuatBlend::Slerp",
+			batched * 1e9 / count, exact / batched, error);
+	}
+	printf("(checksum %g)\n", sink);
+	return 0;
+}
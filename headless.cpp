@@ -0,0 +1,1518 @@
+// Headless driver for the animation library written by Parker Drake
+// Runs the robot's running cycle without a window or GL context.
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <math.h>
+#include <thread>
+#include <functional>
+#include "MatrixStack.h"
+#include "Skeleton.h"
+#include "Robot.h"
+#include "PoseEvaluator.h"
+#include "Crowd.h"
+#include "WorkerPool.h"
+#include "SoftwareRasterizer.h"
+#include "ImageIO.h"
+#include "Pose.h"
+#include "AnimationClip.h"
+#include "AnimationGraph.h"
+#include "Profiler.h"
+#include "Controls.h"
+#include "InputRecording.h"
+#include "SimulationClock.h"
+#include "SkinnedMesh.h"
+#include "Culling.h"
+#include "VertexFormat.h"
+#include "CubeMesh.h"
+#include "Scene.h"
+#include "SimulationThread.h"
+#include "FramePacer.h"
+#include "JobSystem.h"
+#include "FrameGraph.h"
+#include "Memory.h"
+#include "CubeRenderer.h"
+
+struct Options
+{
+	int frames = 600;
+	double rate = 60.0;
+	bool dump = false;
+	int crowd = 0;
+	int animated = 100;
+	int threads = 0;
+	const char* render = NULL;
+	const char* compare = NULL;
+	int tolerance = 2;
+	int width = 800;
+	int height = 800;
+	double time = 0.0;
+	bool rasterBench = false;
+	const char* exportClip = NULL;
+	const char* verifyClip = NULL;
+	int clipCycles = 1;
+	const char* exportClips = NULL;
+	const char* blendBench = NULL;
+	const char* profile = NULL;
+	const char* replay = NULL;
+	bool paced = false;
+	bool skinBench = false;
+	const char* mesh = NULL;
+	const char* exportMesh = NULL;
+	bool cullBench = false;
+	LodSettings lod;
+	const char* scene = NULL;
+	const char* exportScene = NULL;
+	const char* convertFrom = NULL;
+	const char* convertTo = NULL;
+	bool pipelineBench = false;
+	bool jobs = false;
+	bool jobBench = false;
+	bool allocCheck = false;
+	bool verifyInstances = false;
+};
+
+static void PrintUsage()
+{
+	std::cout << "Usage: Realtime_Animation_Headless [options]" << std::endl;
+	std::cout << "  --frames N    Number of frames to evaluate (default 600)" << std::endl;
+	std::cout << "  --rate HZ     Simulated frame rate (default 60)" << std::endl;
+	std::cout << "  --dump        Print the per-limb MVP matrices of the last frame" << std::endl;
+	std::cout << "  --crowd N     Throughput mode: pose N robots per frame with 1 to all hardware threads" << std::endl;
+	std::cout << "  --threads T   Largest thread count tried in throughput mode (default: hardware threads)" << std::endl;
+	std::cout << "  --jobs        Pose the crowd on the work-stealing job system instead of the worker pool" << std::endl;
+	std::cout << "  --animated P  Percentage of the crowd that animates; the rest stands still (default 100)" << std::endl;
+	std::cout << "  --render FILE Rasterize the robot on the CPU into FILE (.ppm or .png)" << std::endl;
+	std::cout << "  --compare REF Compare the rendered frame with the PPM image REF; exit code 2 on mismatch" << std::endl;
+	std::cout << "  --tolerance N Largest per-channel difference --compare accepts (default 2)" << std::endl;
+	std::cout << "  --size W H    Framebuffer size for --render (default 800 800)" << std::endl;
+	std::cout << "  --time T      Running cycle time to render, in seconds (default 0)" << std::endl;
+	std::cout << "  --lod R P     Crowd level of detail: reduced updates below screen size R, proxies below P (e.g. 0.1 0.03)" << std::endl;
+	std::cout << "  --lod-intervals A B  Frames between pose updates at the reduced and proxy levels (default 2 4)" << std::endl;
+	std::cout << "  --raster-bench  Report software rasterization cost per limb across resolutions" << std::endl;
+	std::cout << "  --export-clip FILE  Write the running cycle as a keyframe clip" << std::endl;
+	std::cout << "  --clip-cycles N     Number of cycles --export-clip writes (default 1)" << std::endl;
+	std::cout << "  --verify-clip FILE  Check a running cycle clip against the procedural animation; exit code 2 on mismatch" << std::endl;
+	std::cout << "  --export-clips DIR  Write every built-in motion as DIR/run.clip, idle.clip and wave.clip" << std::endl;
+	std::cout << "  --blend-bench GRAPH Report animation graph cost per joint" << std::endl;
+	std::cout << "  --replay FILE       Re-run a session recorded by Realtime_Animation --record; exit code 2 if the final pose differs" << std::endl;
+	std::cout << "  --paced             Replay at the recorded pace instead of as fast as possible" << std::endl;
+	std::cout << "  --skin-bench        Report CPU skinning throughput, vertices per second per core" << std::endl;
+	std::cout << "  --mesh FILE         Skin FILE to the robot and rasterize it instead of the cubes (with --render)" << std::endl;
+	std::cout << "  --export-mesh FILE  Write the robot's built-in skinned mesh to FILE" << std::endl;
+	std::cout << "  --scene FILE        Take the rig, and the crowd's placements if it has any, from a text or binary scene" << std::endl;
+	std::cout << "  --export-scene FILE Write the robot and a crowd of --crowd N robots as a text scene" << std::endl;
+	std::cout << "  --convert-scene IN OUT  Compile a text scene into the binary form and time loading both" << std::endl;
+	std::cout << "  --cull-bench        Walk a camera through a crowd (--crowd N, default 10000) and report objects tested and culled" << std::endl;
+	std::cout << "  --pipeline-bench    Run the viewer's frame loop at --rate with the simulation inline and on its own thread;" << std::endl;
+	std::cout << "                      report throughput and input-to-frame latency" << std::endl;
+	std::cout << "  --job-bench         Run a crowd frame (--crowd N, default 10000) as a graph of jobs; report each stage" << std::endl;
+	std::cout << "                      from 1 to --threads threads (default 64)" << std::endl;
+	std::cout << "  --verify-instances  Check the instanced renderer's buffer packing against the posed MVPs; exit code 2 on mismatch" << std::endl;
+	std::cout << "  --alloc-check       Count heap allocations per frame once warmed up, for a crowd (--crowd N, default 1000)" << std::endl;
+	std::cout << "                      on each kind of pool; exit code 2 if a steady frame allocates" << std::endl;
+	std::cout << "  --profile PREFIX    Time each stage and write PREFIX.json (Chrome trace) and PREFIX.csv (percentiles)" << std::endl;
+}
+
+static double Seconds(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Same camera as the windowed client
+static glm::mat4 DefaultViewProjection()
+{
+	MatrixStack camera;
+	camera.Perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f);
+	camera.LookAt(glm::vec3(0.0f, 0.0f, 20.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	return camera.topMatrix();
+}
+
+// Builds the robot, or the rig of --scene, which must have the robot's hierarchy
+static bool LoadRig(const Options& options, Scene& scene, Skeleton& robot)
+{
+	if (!options.scene)
+	{
+		ConstructRobot(robot);
+		return true;
+	}
+	if (!scene.Load(options.scene))
+		return false;
+	scene.BuildSkeleton(robot);
+	if (!MatchesRobot(robot))
+	{
+		std::cerr << options.scene << " does not have the robot's hierarchy, which the running cycle needs" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Evaluates the single robot of the windowed client
+static int RunSingle(const Options& options)
+{
+	Scene scene;
+	Skeleton robot;
+	if (!LoadRig(options, scene, robot))
+		return 1;
+	SetRunningStartPose(robot);
+
+	glm::mat4 viewProjection = DefaultViewProjection();
+	PoseEvaluator evaluator;
+	PoseBuffer pose;
+
+	// Accumulate the output so the work cannot be optimized away
+	double checksum = 0.0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < options.frames; frame++)
+	{
+		Profiler::BeginFrame();
+		evaluator.Evaluate(robot, frame / options.rate, viewProjection, pose);
+		for (int i = 0; i < robot.size(); i++)
+			checksum += pose.mvp[i][3][0] + pose.mvp[i][3][1] + pose.mvp[i][3][2];
+	}
+	double seconds = Seconds(start);
+
+	if (options.dump)
+	{
+		for (int i = 0; i < robot.size(); i++)
+		{
+			char name[32];
+			snprintf(name, sizeof(name), "mvp[%d]", i);
+			MatrixStack::print(pose.mvp[i], name);
+		}
+	}
+
+	std::cout << "Evaluated " << options.frames << " frames of " << robot.size() << " limbs in " << seconds * 1000.0 << " ms";
+	std::cout << " (" << (options.frames > 0 ? seconds * 1e6 / options.frames : 0.0) << " us/frame, checksum " << checksum << ")" << std::endl;
+	return 0;
+}
+
+// Lays count robots out on a square grid with varied phases and frequencies.
+// Every robot whose index is not under animatedPercent of each hundred stands still.
+static void PopulateScene(Scene& scene, int count, int animatedPercent = 100)
+{
+	int side = (int)ceil(sqrt((double)count));
+	srand(1);
+	for (int n = 0; n < count; n++)
+	{
+		SceneInstance instance = SceneInstance();
+		instance.phase = rand() / float(RAND_MAX) * 2.0f;
+		instance.frequency = 5.0f + rand() / float(RAND_MAX) * 2.0f;
+		instance.position[0] = (n % side - side / 2) * 6.0f;
+		instance.position[2] = -(n / side) * 6.0f;
+		instance.yaw = rand() / float(RAND_MAX) * 6.28f;
+		instance.flags = n % 100 < animatedPercent ? 0 : SceneInstance::STATIC;
+		scene.AddInstance(instance);
+	}
+}
+
+static void PopulateCrowd(Crowd& crowd, int count, int animatedPercent = 100)
+{
+	Scene scene;
+	PopulateScene(scene, count, animatedPercent);
+	scene.BuildCrowd(crowd);
+}
+
+// Reports instances posed per second as the thread count grows
+static int RunThroughput(const Options& options)
+{
+	Scene scene;
+	Skeleton robot;
+	if (!LoadRig(options, scene, robot))
+		return 1;
+
+	// A scene without instances only gives the rig
+	if (scene.InstanceCount() == 0 && options.crowd <= 0)
+		return RunSingle(options);
+
+	Crowd crowd(robot);
+	if (scene.InstanceCount() > 0)
+		scene.BuildCrowd(crowd);
+	else
+		PopulateCrowd(crowd, options.crowd, options.animated);
+	crowd.SetLod(options.lod);
+
+	glm::mat4 viewProjection = DefaultViewProjection();
+	int maxThreads = options.threads > 0 ? options.threads : WorkerPool::HardwareThreads();
+	int frames = std::max(1, options.frames / 10);
+
+	printf("%d robots x %d limbs (%d%% animated), %d frames per run on the %s\n", crowd.size(), crowd.LimbCount(), options.animated, frames,
+		options.jobs ? "job system" : "worker pool");
+	printf("%8s %16s %10s %11s %12s\n", "threads", "instances/s", "speedup", "efficiency", "ms/frame");
+
+	WorkerPool pool(1);
+	JobSystem jobs(1);
+	auto evaluate = [&](double time)
+	{
+		if (options.jobs)
+			crowd.Evaluate(time, viewProjection, jobs);
+		else
+			crowd.Evaluate(time, viewProjection, pool);
+	};
+	double baseline = 0.0;
+	for (int threads = 1; threads <= maxThreads; threads = threads < maxThreads ? std::min(threads * 2, maxThreads) : threads + 1)
+	{
+		if (options.jobs)
+			jobs.Resize(threads);
+		else
+			pool.Resize(threads);
+		evaluate(0.0); // Warm up caches and scratch space
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			Profiler::BeginFrame();
+			evaluate(frame / options.rate);
+		}
+		double seconds = Seconds(start);
+
+		double rate = crowd.size() * (double)frames / seconds;
+		if (threads == 1)
+			baseline = rate;
+		printf("%8d %16.0f %9.2fx %10.0f%% %12.3f\n", threads, rate, rate / baseline, 100.0 * rate / baseline / threads, seconds * 1e3 / frames);
+	}
+
+	const CrowdStats& stats = crowd.GetStats();
+	printf("Last frame: %d posed, %d reprojected, %d skipped; %lld joints recomputed, %lld reused\n",
+		stats.posed, stats.projected, stats.skipped, stats.jointsRecomputed, stats.jointsReused);
+	if (options.lod.enabled)
+	{
+		// Average a few more frames on every thread for the per-level costs
+		CrowdStats total = CrowdStats();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			evaluate(frame / options.rate);
+			for (int level = 0; level < LOD_COUNT; level++)
+			{
+				total.lodInstances[level] += crowd.GetStats().lodInstances[level];
+				total.lodSampled[level] += crowd.GetStats().lodSampled[level];
+				total.lodSeconds[level] += crowd.GetStats().lodSeconds[level];
+			}
+		}
+		std::vector<glm::mat4> draws;
+		crowd.Gather(draws);
+		const char* names[] = { "full", "reduced", "proxy" };
+		printf("%-8s %10s %12s %10s %12s\n", "level", "robots", "posed/frame", "ms/frame", "us/robot");
+		for (int level = 0; level < LOD_COUNT; level++)
+		{
+			double robots = total.lodInstances[level] / (double)frames;
+			printf("%-8s %10.0f %12.0f %10.3f %12.3f\n", names[level], robots, total.lodSampled[level] / (double)frames,
+				total.lodSeconds[level] * 1e3 / frames, robots > 0 ? total.lodSeconds[level] * 1e6 / frames / robots : 0.0);
+		}
+		printf("%zu cubes drawn instead of %d\n", draws.size(), crowd.size() * crowd.LimbCount());
+	}
+	return 0;
+}
+
+// Rasterizes the robot at one point of the running cycle on the CPU
+static int RunRender(const Options& options)
+{
+	Skeleton robot;
+	ConstructRobot(robot);
+	SetRunningStartPose(robot);
+
+	MatrixStack camera;
+	camera.Perspective(glm::radians(60.0f), float(options.width) / float(options.height), 0.1f, 100.0f);
+	camera.LookAt(glm::vec3(0.0f, 0.0f, 20.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	PoseEvaluator evaluator;
+	PoseBuffer pose;
+	evaluator.Evaluate(robot, options.time, camera.topMatrix(), pose);
+
+	WorkerPool pool(options.threads);
+	SoftwareRasterizer rasterizer(pool, options.width, options.height);
+	rasterizer.Clear();
+	if (options.mesh)
+	{
+		// Bind in the construction pose, as the mesh was modeled in it
+		Skeleton bindPose;
+		ConstructRobot(bindPose);
+		SkinnedMesh mesh;
+		if (!mesh.Load(options.mesh) || !mesh.Bind(bindPose))
+			return 1;
+
+		std::vector<glm::mat4> palette(robot.size());
+		std::vector<float> skinned(mesh.positions.size()), triangles;
+		Skinning::ComputePalette(robot, mesh, &palette[0]);
+		Skinning::Skin(mesh, &palette[0], &skinned[0], pool);
+		mesh.Expand(&skinned[0], triangles);
+		glm::mat4 viewProjection = camera.topMatrix();
+		rasterizer.DrawMesh(&triangles[0], (int)triangles.size() / 6, &viewProjection, 1);
+	}
+	else
+		rasterizer.Draw(&pose.mvp[0], robot.size());
+
+	const SoftwareRasterizer::Stats& stats = rasterizer.GetStats();
+	printf("%dx%d, %d triangles (%d rasterized, %lld tile bins): setup %.3f ms, raster %.3f ms on %d threads\n",
+		options.width, options.height, stats.triangles, stats.rasterized, stats.binned,
+		stats.setupSeconds * 1e3, stats.rasterSeconds * 1e3, pool.ThreadCount());
+
+	if (options.render && !rasterizer.WriteImage(options.render))
+		return 1;
+
+	if (options.compare)
+	{
+		int refWidth, refHeight;
+		std::vector<unsigned char> reference, image;
+		if (!ReadPPM(options.compare, refWidth, refHeight, reference))
+			return 1;
+		if (refWidth != options.width || refHeight != options.height)
+		{
+			printf("Reference is %dx%d, rendered %dx%d\n", refWidth, refHeight, options.width, options.height);
+			return 2;
+		}
+
+		rasterizer.ReadPixels(image);
+		int mismatched = 0, largest = 0;
+		for (int i = 0; i < refWidth * refHeight; i++)
+		{
+			int difference = 0;
+			for (int c = 0; c < 3; c++)
+				difference = std::max(difference, abs(image[i * 4 + c] - reference[i * 4 + c]));
+			largest = std::max(largest, difference);
+			if (difference > options.tolerance)
+				mismatched++;
+		}
+		printf("%d pixels differ by more than %d (largest difference %d)\n", mismatched, options.tolerance, largest);
+		if (mismatched > 0)
+			return 2;
+	}
+	return 0;
+}
+
+// Software rasterization cost per limb and per resolution
+static int RunRasterBench(const Options& options)
+{
+	Skeleton robot;
+	ConstructRobot(robot);
+
+	const int sizes[] = { 256, 512, 1024, 2048 };
+	const int crowds[] = { 1, 10, 100 };
+	WorkerPool pool(options.threads);
+	int frames = std::max(1, options.frames / 60);
+
+	printf("%d threads, %d frames per run\n", pool.ThreadCount(), frames);
+	printf("%10s %8s %8s %12s %12s %12s\n", "resolution", "robots", "limbs", "setup ms", "raster ms", "us/limb");
+	for (int s = 0; s < 4; s++)
+	{
+		MatrixStack camera;
+		camera.Perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f);
+		camera.LookAt(glm::vec3(0.0f, 4.0f, 30.0f), glm::vec3(0.0f, 0.0f, -20.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		SoftwareRasterizer rasterizer(pool, sizes[s], sizes[s]);
+
+		for (int c = 0; c < 3; c++)
+		{
+			Crowd crowd(robot);
+			PopulateCrowd(crowd, crowds[c]);
+			crowd.Evaluate(options.time, camera.topMatrix(), pool);
+
+			double setup = 0.0, raster = 0.0;
+			for (int frame = 0; frame < frames; frame++)
+			{
+				Profiler::BeginFrame();
+				rasterizer.Clear();
+				rasterizer.Draw(&crowd.mvp[0], (int)crowd.mvp.size());
+				setup += rasterizer.GetStats().setupSeconds;
+				raster += rasterizer.GetStats().rasterSeconds;
+			}
+			int limbs = (int)crowd.mvp.size();
+			printf("%5dx%-4d %8d %8d %12.3f %12.3f %12.2f\n", sizes[s], sizes[s], crowds[c], limbs,
+				setup * 1e3 / frames, raster * 1e3 / frames, (setup + raster) * 1e6 / frames / limbs);
+		}
+	}
+	return 0;
+}
+
+// CPU skinning throughput of the robot mesh, replicated to a character-sized
+// vertex count, on 1 to all threads
+static int RunSkinBench(const Options& options)
+{
+	Skeleton robot;
+	ConstructRobot(robot);
+	SkinnedMesh limbs;
+	BuildRobotMesh(robot, limbs, 64);
+
+	if (options.exportMesh)
+	{
+		if (!limbs.Save(options.exportMesh))
+			return 1;
+		printf("Wrote %d vertices and %d triangles to %s\n", limbs.VertexCount(), limbs.TriangleCount(), options.exportMesh);
+		if (!options.skinBench)
+			return 0;
+	}
+
+	// About 100k vertices, far more than fit in the caches
+	SkinnedMesh mesh = limbs;
+	while (mesh.VertexCount() < 100000)
+	{
+		mesh.positions.insert(mesh.positions.end(), limbs.positions.begin(), limbs.positions.end());
+		mesh.joints.insert(mesh.joints.end(), limbs.joints.begin(), limbs.joints.end());
+		mesh.weights.insert(mesh.weights.end(), limbs.weights.begin(), limbs.weights.end());
+	}
+
+	SetRunningPose(robot, 0.3);
+	robot.UpdateTransforms(glm::mat4(1.0f));
+	std::vector<glm::mat4> palette(robot.size());
+	Skinning::ComputePalette(robot, mesh, &palette[0]);
+
+	std::vector<float> reference(mesh.positions.size()), skinned(mesh.positions.size());
+	Skinning::SkinReference(mesh, &palette[0], &reference[0]);
+
+	int maxThreads = options.threads > 0 ? options.threads : WorkerPool::HardwareThreads();
+	int runs = std::max(1, options.frames / 6);
+	printf("%d vertices, %d influences at most, %s kernel, %d runs per thread count\n",
+		mesh.VertexCount(), MAX_INFLUENCES, Skinning::Name(), runs);
+	printf("%8s %14s %16s %14s\n", "threads", "ms/skin", "Mverts/s", "Mverts/s/core");
+	WorkerPool pool(1);
+	for (int threads = 1; threads <= maxThreads; threads = threads < maxThreads ? std::min(threads * 2, maxThreads) : threads + 1)
+	{
+		pool.Resize(threads);
+		Skinning::Skin(mesh, &palette[0], &skinned[0], pool); // Warm up
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int run = 0; run < runs; run++)
+		{
+			Profiler::BeginFrame();
+			Skinning::Skin(mesh, &palette[0], &skinned[0], pool);
+		}
+		double seconds = Seconds(start) / runs;
+		double rate = mesh.VertexCount() / seconds / 1e6;
+		printf("%8d %14.3f %16.1f %14.1f\n", threads, seconds * 1e3, rate, rate / threads);
+	}
+
+	float largest = 0.0f;
+	for (size_t i = 0; i < skinned.size(); i++)
+		largest = std::max(largest, fabsf(skinned[i] - reference[i]));
+	printf("Largest difference from the reference skinning: %g\n", largest);
+
+	// What the viewer uploads for GPU skinning, against plain floats
+	PackedMesh packed;
+	PackSkinnedMesh(limbs, packed);
+	int floatStride = (3 + 3 + MAX_INFLUENCES) * sizeof(float) + MAX_INFLUENCES;
+	float positionError = 0.0f;
+	for (int v = 0; v < packed.VertexCount(); v++)
+	{
+		float position[3];
+		UnpackAttribute(FORMAT_HALF3, &packed.vertices[v * packed.layout.stride], position);
+		for (int k = 0; k < 3; k++)
+			positionError = std::max(positionError, fabsf(position[k] - limbs.positions[v * 3 + k]));
+	}
+	PackedMesh cube;
+	BuildCubeMesh(cube);
+	printf("Packed vertices: %d bytes instead of %d, largest position error %g; cube %d vertices, %d bytes instead of %d\n",
+		packed.layout.stride, floatStride, positionError, cube.VertexCount(), (int)(cube.VertexBytes() + cube.IndexBytes()),
+		(int)(CUBE_VERTEX_COUNT * CUBE_VERTEX_STRIDE * sizeof(float)));
+	return largest <= 1e-4f ? 0 : 2;
+}
+
+// Frustum culling of a large crowd seen by a camera walking through it. Checks
+// the hierarchy's result against testing every limb.
+static int RunCullBench(const Options& options)
+{
+	Skeleton robot;
+	ConstructRobot(robot);
+	Crowd crowd(robot);
+	PopulateCrowd(crowd, options.crowd > 0 ? options.crowd : 10000, options.animated);
+	WorkerPool pool(options.threads);
+
+	int side = (int)ceil(sqrt((double)crowd.size()));
+	int frames = std::max(1, options.frames);
+	CullStats total;
+	long long drawn = 0, mismatched = 0;
+	double hierarchySeconds = 0.0, bruteSeconds = 0.0;
+	std::vector<glm::mat4> visible, reference;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		Profiler::BeginFrame();
+		// Walk from the front row to the back, looking a little to each side in turn
+		double time = frame / options.rate;
+		float depth = side * 6.0f * frame / frames;
+		float heading = 0.6f * (float)sin(time * 0.5);
+		glm::vec3 eye(0.0f, 4.0f, 10.0f - depth);
+		MatrixStack camera;
+		camera.Perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f);
+		camera.LookAt(eye, eye + glm::vec3(sinf(heading), -0.1f, -cosf(heading)), glm::vec3(0.0f, 1.0f, 0.0f));
+		glm::mat4 viewProjection = camera.topMatrix();
+		crowd.Evaluate(time, viewProjection, pool);
+
+		Frustum frustum(viewProjection);
+		auto start = std::chrono::high_resolution_clock::now();
+		crowd.Cull(frustum, visible, total);
+		hierarchySeconds += Seconds(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		reference.clear();
+		for (size_t i = 0; i < crowd.limbBounds.size(); i++)
+		{
+			if (frustum.Classify(crowd.limbBounds[i]) != CULL_OUTSIDE)
+				reference.push_back(crowd.mvp[i]);
+		}
+		bruteSeconds += Seconds(start);
+
+		drawn += visible.size();
+		if (visible != reference)
+			mismatched++;
+	}
+
+	long long limbs = (long long)crowd.size() * crowd.LimbCount() * frames;
+	printf("%d robots x %d limbs, %d frames, %s plane tests\n", crowd.size(), crowd.LimbCount(), frames, Frustum::Name());
+	printf("Per frame: %.1f nodes tested, %.1f robots tested, %.1f of %d robots culled, %.1f limbs tested, %.1f limbs culled, %.1f of %d limbs drawn\n",
+		total.nodesTested / (double)frames, total.instancesTested / (double)frames, total.instancesCulled / (double)frames, crowd.size(),
+		total.limbsTested / (double)frames, total.limbsCulled / (double)frames, drawn / (double)frames, crowd.size() * crowd.LimbCount());
+	printf("Culling %.3f ms/frame with the hierarchy, %.3f ms/frame testing every limb (%.1f ns/limb)\n",
+		hierarchySeconds * 1e3 / frames, bruteSeconds * 1e3 / frames, bruteSeconds * 1e9 / limbs);
+	if (mismatched > 0)
+	{
+		printf("%lld frames drew different limbs than testing every limb\n", mismatched);
+		return 2;
+	}
+	return 0;
+}
+
+// Largest channel difference between two poses
+static float PoseDifference(const Pose& a, const Pose& b, unsigned channels)
+{
+	float largest = 0.0f;
+	for (int i = 0; i < a.size(); i++)
+	{
+		glm::vec3 t = glm::abs(a.translation[i] - b.translation[i]);
+		// q and -q are the same rotation
+		float sign = glm::dot(a.rotation[i], b.rotation[i]) < 0.0f ? -1.0f : 1.0f;
+		glm::vec4 r = glm::abs(glm::vec4(a.rotation[i].x, a.rotation[i].y, a.rotation[i].z, a.rotation[i].w)
+			- sign * glm::vec4(b.rotation[i].x, b.rotation[i].y, b.rotation[i].z, b.rotation[i].w));
+		glm::vec3 s = glm::abs(a.scale[i] - b.scale[i]);
+		if (channels & Pose::TRANSLATION)
+			largest = std::max(largest, std::max(t.x, std::max(t.y, t.z)));
+		if (channels & Pose::ROTATION)
+			largest = std::max(largest, std::max(std::max(r.x, r.y), std::max(r.z, r.w)));
+		if (channels & Pose::SCALE)
+			largest = std::max(largest, std::max(s.x, std::max(s.y, s.z)));
+	}
+	return largest;
+}
+
+// Exports the running cycle as a clip and/or checks a clip against it
+static int RunClip(const Options& options)
+{
+	if (options.exportClip)
+	{
+		if (!ExportRobotClip(options.exportClip, MOTION_RUNNING, 128, options.clipCycles))
+			return 1;
+		printf("Wrote %d cycles of the running animation to %s\n", options.clipCycles, options.exportClip);
+	}
+	if (options.exportClips)
+	{
+		const char* names[] = { "run", "idle", "wave" };
+		for (int motion = 0; motion < 3; motion++)
+		{
+			std::string path = std::string(options.exportClips) + "/" + names[motion] + ".clip";
+			if (!ExportRobotClip(path.c_str(), (RobotMotion)motion, 128, options.clipCycles))
+				return 1;
+			printf("Wrote %s\n", path.c_str());
+		}
+	}
+	if (!options.verifyClip)
+		return 0;
+
+	MappedClip mapped;
+	StreamedClip streamed;
+	if (!mapped.Open(options.verifyClip) || !streamed.Open(options.verifyClip))
+		return 1;
+
+	Skeleton robot;
+	ConstructRobot(robot);
+	SetRunningStartPose(robot);
+	if (mapped.JointCount() != robot.size())
+	{
+		printf("Clip has %d joints, the robot has %d\n", mapped.JointCount(), robot.size());
+		return 2;
+	}
+
+	unsigned channels = mapped.Channels();
+	double rate = mapped.Header().sampleRate;
+	Pose procedural, fromMapped, fromStreamed;
+	float keyError = 0.0f, midError = 0.0f, readerError = 0.0f;
+	for (int frame = 0; frame < mapped.FrameCount(); frame++)
+	{
+		// On the keyframe, where the clip must reproduce the procedural pose exactly
+		double time = frame / rate;
+		SetRunningPose(robot, time);
+		procedural.Capture(robot);
+		mapped.Sample(time, fromMapped);
+		streamed.Sample(time, fromStreamed);
+		keyError = std::max(keyError, PoseDifference(procedural, fromMapped, channels));
+		readerError = std::max(readerError, PoseDifference(fromMapped, fromStreamed, Pose::ALL_CHANNELS));
+
+		// Halfway to the next keyframe, which measures interpolation error
+		time = (frame + 0.5) / rate;
+		SetRunningPose(robot, time);
+		procedural.Capture(robot);
+		mapped.Sample(time, fromMapped);
+		streamed.Sample(time, fromStreamed);
+		midError = std::max(midError, PoseDifference(procedural, fromMapped, channels));
+		readerError = std::max(readerError, PoseDifference(fromMapped, fromStreamed, Pose::ALL_CHANNELS));
+	}
+
+	printf("%d joints, %d keyframes at %.3f Hz (%.3f s)\n", mapped.JointCount(), mapped.FrameCount(), rate, mapped.Duration());
+	printf("Largest difference from the procedural cycle: %g on keyframes, %g between keyframes\n", keyError, midError);
+	printf("Mapped and streamed readers differ by %g; streaming keeps %zu bytes resident after %d chunk loads\n",
+		readerError, streamed.ResidentBytes(), streamed.ChunkLoads());
+	return keyError == 0.0f && readerError == 0.0f ? 0 : 2;
+}
+
+// Cost of sampling and blending the animation graph, per joint
+static int RunBlendBench(const Options& options)
+{
+	Skeleton robot;
+	ConstructRobot(robot);
+	AnimationGraph graph;
+	if (!graph.Load(options.blendBench, robot.size()))
+		return 1;
+	if (graph.StateCount() < 2)
+	{
+		printf("The graph needs two states to cross-fade\n");
+		return 1;
+	}
+
+	const int updates = std::max(1, options.frames) * 100;
+	const double step = 1.0 / options.rate;
+	const char* names[] = { "one state", "cross-fade", "cross-fade + layers" };
+	double single = 0.0;
+
+	printf("%d joints, %d layers, %d updates per case\n", robot.size(), graph.LayerCount(), updates);
+	printf("%-22s %12s %14s\n", "case", "ns/joint", "blend ns/joint");
+	for (int mode = 0; mode < 3; mode++)
+	{
+		for (int layer = 0; layer < graph.LayerCount(); layer++)
+		{
+			graph.SetLayerWeight(layer, mode == 2 ? 1.0f : 0.0f);
+			graph.Update(60.0); // Settle the layer fades
+		}
+
+		double checksum = 0.0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int n = 0; n < updates; n++)
+		{
+			Profiler::BeginFrame();
+			// Swapping states every update keeps the graph inside a cross-fade
+			if (mode > 0)
+				graph.SetState(n & 1);
+			graph.Update(step);
+			checksum += graph.Output().rotation[n % robot.size()].w;
+		}
+		double perJoint = Seconds(start) * 1e9 / updates / robot.size();
+		if (mode == 0)
+			single = perJoint;
+		printf("%-22s %12.2f %14.2f  (checksum %g)\n", names[mode], perJoint, perJoint - single, checksum);
+	}
+	return 0;
+}
+
+// Re-runs a recorded viewer session through the viewer's input and simulation
+// code, then checks the final state against the recording bit for bit
+static int RunReplay(const Options& options)
+{
+	InputPlayback playback;
+	if (!playback.Open(options.replay))
+		return 1;
+
+	// Set up as the viewer's Init() does
+	Skeleton robot;
+	ConstructRobot(robot);
+	AnimationGraph graph;
+	if (!playback.GraphPath().empty() && !graph.Load(playback.GraphPath().c_str(), robot.size()))
+		return 1;
+	Controls controls;
+	controls.Attach(robot, &graph);
+	Skeleton previousRobot = robot;
+	Skeleton renderRobot = robot;
+	SimulationClock clock(playback.Step(), playback.MaxSteps());
+	clock.Reset(playback.Start());
+
+	std::vector<InputEvent> events;
+	double now = playback.Start();
+	int steps = 0;
+	long long frames = 0, eventCount = 0, simulated = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	while (playback.NextFrame(events, now, steps))
+	{
+		Profiler::BeginFrame();
+		if (options.paced)
+			std::this_thread::sleep_until(start + std::chrono::duration<double>(now - playback.Start()));
+
+		for (size_t i = 0; i < events.size(); i++)
+			controls.Handle(events[i]);
+		eventCount += events.size();
+
+		// The recorded step count, not the clock's, includes the viewer's budget cut-offs
+		clock.Advance(now);
+		for (int i = 0; i < steps; i++)
+		{
+			previousRobot = robot;
+			controls.Simulate(clock.Tick(), clock.Step());
+		}
+		simulated += steps;
+
+		renderRobot.Interpolate(previousRobot, robot, (float)clock.Alpha());
+		PROFILE_SCOPE("Hierarchy");
+		renderRobot.UpdateTransforms(glm::mat4(1.0f));
+		frames++;
+	}
+	double seconds = Seconds(start);
+	if (playback.Failed())
+		return 1;
+
+	printf("Replayed %lld frames, %lld events and %lld simulation steps (%.2f s recorded) in %.3f ms\n",
+		frames, eventCount, simulated, now - playback.Start(), seconds * 1e3);
+
+	if (playback.FinalState().empty())
+	{
+		printf("The recording has no final state to compare with\n");
+		return 0;
+	}
+	std::vector<float> state;
+	CaptureState(robot, renderRobot, controls, state);
+	size_t differences = 0;
+	for (size_t i = 0; i < state.size() && i < playback.FinalState().size(); i++)
+		differences += memcmp(&state[i], &playback.FinalState()[i], sizeof(float)) != 0;
+	if (state.size() != playback.FinalState().size() || differences > 0)
+	{
+		printf("Final state differs from the recording in %zu of %zu values\n", differences, playback.FinalState().size());
+		return 2;
+	}
+	printf("Final state matches the recording bit for bit\n");
+	return 0;
+}
+
+// Runs the viewer's frame loop, minus the window: a scroll event every few
+// frames, the simulation, and the robot rasterized in software in place of
+// the GL draw. Frames are paced at --rate as the viewer does without vsync.
+// Latency is from posting an event to the end of the first frame that draws
+// a state it was applied to; pose age is from the drawn state being due to
+// the end of the frame.
+static int RunPipelineBench(const Options& options)
+{
+	const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+	std::function<double()> now = [epoch]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - epoch).count(); };
+	const int EVENT_INTERVAL = 4;
+
+	WorkerPool pool(options.threads);
+	SoftwareRasterizer rasterizer(pool, options.width, options.height);
+	PoseEvaluator evaluator;
+	PoseBuffer pose;
+
+	printf("%d frames at %.0f Hz, %dx%d software render on %d threads\n", options.frames, options.rate, options.width, options.height, pool.ThreadCount());
+	printf("%-10s %10s %10s %11s %28s %22s\n", "mode", "frames/s", "steps/s", "new states", "input latency mean/p95/max", "pose age mean/p95");
+	for (int threaded = 0; threaded < 2; threaded++)
+	{
+		Skeleton robot;
+		ConstructRobot(robot);
+		Controls controls;
+		controls.Attach(robot, NULL);
+		controls.animate = true;
+		Skeleton previousRobot = robot;
+		Skeleton renderRobot = robot;
+		SimulationClock clock;
+		SimulationThread simulation;
+		FramePacer pacer(options.rate);
+		LatencyStats latency, age;
+
+		long long inputSerial = 0, shownSerial = 0, newStates = 0, lastSteps = 0, simulated = 0;
+		double inputTime = 0.0;
+		clock.Reset(now());
+		if (threaded)
+			simulation.Start(controls, robot, clock, NULL, NULL, now);
+
+		double start = now();
+		for (int f = 0; f < options.frames; f++)
+		{
+			double frameStart = now();
+			InputEvent event = InputEvent::Scroll(f % (2 * EVENT_INTERVAL) ? 0.01 : -0.01);
+			bool post = f % EVENT_INTERVAL == 0;
+
+			// What gets drawn: the interpolated robot, the camera and when the state was due
+			glm::vec3 eye, center, up;
+			double stateTime, drawnTime;
+			long long drawnSerial;
+			if (threaded)
+			{
+				if (post)
+					simulation.Post(event, frameStart);
+				if (simulation.Acquire() && simulation.Frame().steps != lastSteps)
+				{
+					newStates++;
+					lastSteps = simulation.Frame().steps;
+				}
+				const SimulationFrame& frame = simulation.Frame();
+				renderRobot.Interpolate(frame.previous, frame.current, (float)frame.Alpha(frameStart));
+				eye = frame.eye;
+				center = frame.center;
+				up = frame.up;
+				stateTime = frame.stateTime;
+				drawnSerial = frame.inputSerial;
+				drawnTime = frame.inputTime;
+			}
+			else
+			{
+				if (post)
+				{
+					controls.Handle(event);
+					inputSerial++;
+					inputTime = frameStart;
+				}
+				int due = clock.Advance(frameStart);
+				for (int i = 0; i < due; i++)
+				{
+					previousRobot = robot;
+					controls.Simulate(clock.Tick(), clock.Step());
+				}
+				simulated += due;
+				newStates += due > 0;
+				renderRobot.Interpolate(previousRobot, robot, (float)clock.Alpha());
+				eye = controls.eye;
+				center = controls.center;
+				up = controls.up;
+				stateTime = frameStart - clock.Alpha() * clock.Step();
+				drawnSerial = inputSerial;
+				drawnTime = inputTime;
+			}
+
+			MatrixStack camera;
+			camera.Perspective(glm::radians(60.0f), float(options.width) / float(options.height), 0.1f, 100.0f);
+			camera.LookAt(eye, center, up);
+			evaluator.Evaluate(renderRobot, camera.topMatrix(), pose);
+			rasterizer.Clear();
+			rasterizer.Draw(&pose.mvp[0], renderRobot.size());
+
+			double end = now();
+			if (drawnSerial > shownSerial)
+			{
+				latency.Add(end - drawnTime);
+				shownSerial = drawnSerial;
+			}
+			age.Add(end - stateTime);
+			pacer.WaitForNextFrame();
+		}
+		double seconds = now() - start;
+		simulation.Stop();
+		if (threaded)
+		{
+			simulation.Acquire();
+			simulated = simulation.Frame().steps;
+		}
+
+		char latencyText[64], ageText[64];
+		snprintf(latencyText, sizeof(latencyText), "%.2f/%.2f/%.2f ms", latency.Mean() * 1e3, latency.Percentile(0.95) * 1e3, latency.Max() * 1e3);
+		snprintf(ageText, sizeof(ageText), "%.2f/%.2f ms", age.Mean() * 1e3, age.Percentile(0.95) * 1e3);
+		printf("%-10s %10.1f %10.1f %10.0f%% %28s %22s\n", threaded ? "threaded" : "inline", options.frames / seconds, simulated / seconds,
+			100.0 * newStates / options.frames, latencyText, ageText);
+	}
+	return 0;
+}
+
+// A crowd frame split into the stages of a renderer's frame and run as a
+// graph on the job system: input moves the camera, animation samples each
+// robot's joint channels, world transforms builds the per-limb world and
+// MVP matrices, culling tests instance and limb boxes against the frustum,
+// and the command build packs the visible limbs into one draw list.
+// Reports each stage's time from 1 thread up to --threads, and checks that
+// every thread count draws the same limbs.
+static int RunJobBench(const Options& options)
+{
+	Skeleton robot;
+	ConstructRobot(robot);
+	Scene scene;
+	PopulateScene(scene, options.crowd > 0 ? options.crowd : 10000, options.animated);
+	const SceneInstance* instances = scene.Instances();
+	int count = scene.InstanceCount();
+	int limbs = robot.size();
+	int maxThreads = options.threads > 0 ? options.threads : 64;
+	int frames = std::max(1, options.frames / 10);
+
+	std::vector<glm::quat> rotations(count * limbs);
+	std::vector<glm::vec3> translations(count * limbs);
+	std::vector<glm::mat4> world(count * limbs), mvp(count * limbs);
+	std::vector<Skeleton> scratch(maxThreads, robot);
+	std::vector<PoseEvaluator> evaluators(maxThreads);
+	glm::mat4 viewProjection;
+	double time = 0.0;
+	int frame = 0;
+	int side = (int)ceil(sqrt((double)count));
+
+	// What only lives for one frame comes from the arena, reset before each one
+	FrameArena arena;
+	unsigned char* visible = NULL;
+	int* visibleCount = NULL;
+	int* offsets = NULL;
+	glm::mat4* commands = NULL;
+	int commandCount = 0;
+
+	FrameGraph graph;
+	int input = graph.AddStage("Input", [&](JobSystem&)
+	{
+		visible = arena.Allocate<unsigned char>(count * limbs);
+		visibleCount = arena.Allocate<int>(count);
+		offsets = arena.Allocate<int>(count + 1);
+
+		// Walk into the crowd as the cull bench does
+		time = frame / options.rate;
+		float depth = side * 6.0f * frame / frames;
+		float heading = 0.6f * (float)sin(time * 0.5);
+		glm::vec3 eye(0.0f, 4.0f, 10.0f - depth);
+		MatrixStack camera;
+		camera.Perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f);
+		camera.LookAt(eye, eye + glm::vec3(sinf(heading), -0.1f, -cosf(heading)), glm::vec3(0.0f, 1.0f, 0.0f));
+		viewProjection = camera.topMatrix();
+	});
+	int animation = graph.AddStage("Animation", [&](JobSystem& jobs)
+	{
+		jobs.ParallelFor(count, 0, [&](int begin, int end, int worker)
+		{
+			Skeleton& skeleton = scratch[worker];
+			for (int n = begin; n < end; n++)
+			{
+				bool animated = !(instances[n].flags & SceneInstance::STATIC);
+				SetRunningPose(skeleton, animated ? time + instances[n].phase : instances[n].phase, instances[n].frequency);
+				std::copy(skeleton.rotRelJoint.begin(), skeleton.rotRelJoint.end(), rotations.begin() + n * limbs);
+				std::copy(skeleton.transRelParent.begin(), skeleton.transRelParent.end(), translations.begin() + n * limbs);
+			}
+		});
+	}, { input });
+	int transforms = graph.AddStage("World transforms", [&](JobSystem& jobs)
+	{
+		jobs.ParallelFor(count, 0, [&](int begin, int end, int worker)
+		{
+			Skeleton& skeleton = scratch[worker];
+			for (int n = begin; n < end; n++)
+			{
+				for (int i = 0; i < limbs; i++)
+				{
+					skeleton.SetTranslation(i, translations[n * limbs + i]);
+					skeleton.SetRotation(i, rotations[n * limbs + i]);
+				}
+				evaluators[worker].Evaluate(skeleton, instances[n].Root(), viewProjection, &world[n * limbs], &mvp[n * limbs]);
+			}
+		});
+	}, { input, animation });
+	int culling = graph.AddStage("Culling", [&](JobSystem& jobs)
+	{
+		Frustum frustum(viewProjection);
+		jobs.ParallelFor(count, 0, [&](int begin, int end, int)
+		{
+			for (int n = begin; n < end; n++)
+			{
+				Bounds limbBounds[64], instanceBounds;
+				for (int i = 0; i < limbs; i++)
+				{
+					limbBounds[i] = LimbBounds(world[n * limbs + i], robot.scaleFactor[i]);
+					instanceBounds.Grow(limbBounds[i]);
+				}
+				CullResult result = frustum.Classify(instanceBounds);
+				int drawn = 0;
+				for (int i = 0; i < limbs; i++)
+				{
+					bool draw = result == CULL_INSIDE || (result == CULL_INTERSECTS && frustum.Classify(limbBounds[i]) != CULL_OUTSIDE);
+					visible[n * limbs + i] = draw;
+					drawn += draw;
+				}
+				visibleCount[n] = drawn;
+			}
+		});
+	}, { transforms });
+	graph.AddStage("Command build", [&](JobSystem& jobs)
+	{
+		offsets[0] = 0;
+		for (int n = 0; n < count; n++)
+			offsets[n + 1] = offsets[n] + visibleCount[n];
+		commandCount = offsets[count];
+		commands = arena.Allocate<glm::mat4>(commandCount);
+		jobs.ParallelFor(count, 0, [&](int begin, int end, int)
+		{
+			for (int n = begin; n < end; n++)
+			{
+				glm::mat4* out = commands + offsets[n];
+				for (int i = 0; i < limbs; i++)
+				{
+					if (visible[n * limbs + i])
+						*out++ = mvp[n * limbs + i];
+				}
+			}
+		});
+	}, { culling });
+	printf("%d robots x %d limbs, %d frames per run\n", count, limbs, frames);
+	printf("%8s", "threads");
+	for (int stage = 0; stage < graph.StageCount(); stage++)
+		printf(" %16s", graph.StageName(stage));
+	printf(" %10s %9s %12s %12s %12s %10s\n", "ms/frame", "speedup", "jobs/frame", "steals/frame", "allocs/frame", "draws");
+
+	JobSystem jobs(1);
+	double baseline = 0.0;
+	long long firstDraws = -1;
+	bool consistent = true;
+	for (int threads = 1; threads <= maxThreads; threads = threads < maxThreads ? std::min(threads * 2, maxThreads) : threads + 1)
+	{
+		jobs.Resize(threads);
+		frame = 0;
+		arena.Reset();
+		graph.Run(jobs); // Warm up, which also grows the arena to a frame's worth
+		jobs.ResetStats();
+
+		std::vector<double> stageSeconds(graph.StageCount(), 0.0);
+		long long draws = 0;
+		long long allocations = Memory::Allocations();
+		auto start = std::chrono::high_resolution_clock::now();
+		for (frame = 0; frame < frames; frame++)
+		{
+			Profiler::BeginFrame();
+			arena.Reset();
+			graph.Run(jobs);
+			for (int stage = 0; stage < graph.StageCount(); stage++)
+				stageSeconds[stage] += graph.StageSeconds(stage);
+			draws += commandCount;
+		}
+		double seconds = Seconds(start);
+		allocations = Memory::Allocations() - allocations;
+		if (threads == 1)
+			baseline = seconds;
+		if (firstDraws < 0)
+			firstDraws = draws;
+		consistent = consistent && draws == firstDraws;
+
+		JobStats stats = jobs.GetStats();
+		printf("%8d", threads);
+		for (int stage = 0; stage < graph.StageCount(); stage++)
+			printf(" %13.3f ms", stageSeconds[stage] * 1e3 / frames);
+		printf(" %10.3f %8.2fx %12.1f %12.1f %12.1f %10lld\n", seconds * 1e3 / frames, baseline / seconds,
+			stats.executed / (double)frames, stats.stolen / (double)frames, allocations / (double)frames, draws / frames);
+	}
+	if (!consistent)
+	{
+		printf("Thread counts drew different limbs\n");
+		return 2;
+	}
+	return 0;
+}
+
+// Packs MVPs into a copy of the instanced renderer's ring as it does, one
+// frame per region in turn, and reads them back the way the instanceMVP
+// attribute does: through the layout's region offsets, stride and column
+// offsets. Frames still in the other regions must survive each new one.
+static int RunVerifyInstances(const Options& options)
+{
+	Scene scene;
+	Skeleton robot;
+	if (!LoadRig(options, scene, robot))
+		return 1;
+	SetRunningStartPose(robot);
+	glm::mat4 viewProjection = DefaultViewProjection();
+	long long checked = 0, mismatches = 0;
+
+	// The columns must fit side by side in one instance
+	for (int column = 0; column < 4; column++)
+	{
+		for (int other = 0; other < column; other++)
+		{
+			size_t a = CubeInstanceLayout::ColumnOffset(column), b = CubeInstanceLayout::ColumnOffset(other);
+			if ((a > b ? a - b : b - a) < sizeof(glm::vec4))
+			{
+				printf("Columns %d and %d overlap\n", other, column);
+				mismatches++;
+			}
+		}
+		if (CubeInstanceLayout::ColumnOffset(column) + sizeof(glm::vec4) > CubeInstanceLayout::Stride())
+		{
+			printf("Column %d reaches past the stride\n", column);
+			mismatches++;
+		}
+	}
+	// and each region must hold its instances before the next one starts
+	for (int region = 0; region < CubeInstanceLayout::REGIONS; region++)
+	{
+		if (CubeInstanceLayout::RegionOffset(region + 1, robot.size()) - CubeInstanceLayout::RegionOffset(region, robot.size()) < CubeInstanceLayout::Stride() * robot.size())
+		{
+			printf("Region %d overlaps the next one\n", region);
+			mismatches++;
+		}
+	}
+	if (mismatches > 0)
+		return 2; // Packing would write out of bounds
+
+	std::vector<unsigned char> ring;
+	auto check = [&](const glm::mat4* mvp, int count, int region, int capacity)
+	{
+		const unsigned char* base = &ring[CubeInstanceLayout::RegionOffset(region, capacity)];
+		for (int i = 0; i < count; i++)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				float read[4];
+				memcpy(read, base + i * CubeInstanceLayout::Stride() + CubeInstanceLayout::ColumnOffset(column), sizeof(read));
+				bool same = true;
+				for (int row = 0; row < 4; row++)
+					same = same && read[row] == mvp[i][column][row];
+				if (!same && mismatches++ < 10)
+					printf("Region %d, instance %d, column %d differs\n", region, i, column);
+			}
+			checked++;
+		}
+	};
+
+	// The robot, a frame per region as the persistent ring is written
+	int limbs = robot.size();
+	int regions = CubeInstanceLayout::REGIONS;
+	ring.assign(CubeInstanceLayout::RegionOffset(regions, limbs), 0xCD);
+	PoseEvaluator evaluator;
+	std::vector<PoseBuffer> poses(regions);
+	for (int frame = 0; frame < options.frames; frame++)
+	{
+		int region = frame % regions;
+		evaluator.Evaluate(robot, frame / options.rate, viewProjection, poses[region]);
+		size_t bytes = CubeInstanceLayout::Pack(&poses[region].mvp[0], limbs, region, limbs, &ring[0]);
+		if (bytes != CubeInstanceLayout::Stride() * limbs)
+		{
+			printf("Packing %d instances wrote %d bytes, expected %d\n", limbs, (int)bytes, (int)(CubeInstanceLayout::Stride() * limbs));
+			mismatches++;
+		}
+		for (int back = 0; back < regions && back <= frame; back++)
+		{
+			int earlier = (frame - back) % regions;
+			check(&poses[earlier].mvp[0], limbs, earlier, limbs);
+		}
+	}
+
+	// A crowd in one batch, in the last region of a ring sized for it
+	Crowd crowd(robot);
+	PopulateCrowd(crowd, options.crowd > 0 ? options.crowd : 1000, options.animated);
+	WorkerPool pool(1);
+	crowd.Evaluate(0.0, viewProjection, pool);
+	std::vector<glm::mat4> all;
+	crowd.Gather(all);
+	int count = (int)all.size();
+	if (count > 0)
+	{
+		ring.assign(CubeInstanceLayout::RegionOffset(regions, count), 0xCD);
+		CubeInstanceLayout::Pack(&all[0], count, regions - 1, count, &ring[0]);
+		check(&all[0], count, regions - 1, count);
+	}
+
+	printf("Checked %lld packed instances, %lld mismatches\n", checked, mismatches);
+	return mismatches > 0 ? 2 : 0;
+}
+
+// Runs frame after frame of work and counts heap allocations in the ones after
+// the first few, which may still be growing buffers to their steady size
+static bool CheckAllocations(const char* name, int frames, const std::function<void(int)>& work)
+{
+	const int WARM_UP = 3;
+	for (int frame = 0; frame < WARM_UP; frame++)
+		work(frame);
+	long long allocations = Memory::Allocations();
+	for (int frame = WARM_UP; frame < WARM_UP + frames; frame++)
+		work(frame);
+	allocations = Memory::Allocations() - allocations;
+	printf("%-24s %10lld %14.2f\n", name, allocations, allocations / (double)frames);
+	return allocations == 0;
+}
+
+// Checks that the per-frame paths do not touch the heap once warmed up
+static int RunAllocCheck(const Options& options)
+{
+	if (!Memory::Counting())
+	{
+		printf("Allocation counting is compiled out (COUNT_ALLOCATIONS=0)\n");
+		return 1;
+	}
+	Scene scene;
+	Skeleton robot;
+	if (!LoadRig(options, scene, robot))
+		return 1;
+	SetRunningStartPose(robot);
+	int frames = std::max(1, options.frames / 10);
+	int threads = options.threads > 0 ? options.threads : JobSystem::HardwareThreads();
+	glm::mat4 viewProjection = DefaultViewProjection();
+
+	Crowd crowd(robot);
+	crowd.SetLod(options.lod);
+	if (scene.InstanceCount() > 0)
+		scene.BuildCrowd(crowd);
+	else
+		PopulateCrowd(crowd, options.crowd > 0 ? options.crowd : 1000, options.animated);
+	WorkerPool pool(threads);
+	JobSystem jobs(threads);
+	FrameArena arena;
+
+	printf("%d robots, %d threads, %d frames each\n", crowd.size(), threads, frames);
+	printf("%-24s %10s %14s\n", "", "allocations", "per frame");
+	bool clean = true;
+
+	PoseEvaluator evaluator;
+	PoseBuffer pose;
+	clean &= CheckAllocations("Single robot", frames, [&](int frame)
+	{
+		evaluator.Evaluate(robot, frame / options.rate, viewProjection, pose);
+	});
+	clean &= CheckAllocations("Crowd, worker pool", frames, [&](int frame)
+	{
+		crowd.Evaluate(frame / options.rate, viewProjection, pool);
+	});
+	clean &= CheckAllocations("Crowd, job system", frames, [&](int frame)
+	{
+		crowd.Evaluate(frame / options.rate, viewProjection, jobs);
+	});
+
+	// Small, so the frames checked run past the point where its reservoir is full
+	LatencyStats latency(16);
+	clean &= CheckAllocations("Latency stats", frames, [&](int frame)
+	{
+		latency.Add(frame / options.rate);
+	});
+
+	std::vector<glm::mat4> visible;
+	Frustum frustum(viewProjection);
+	clean &= CheckAllocations("Crowd cull", frames, [&](int)
+	{
+		CullStats stats;
+		crowd.Cull(frustum, visible, stats);
+	});
+
+	// The crowd's evaluation, then a copy of its matrices into the arena, as a frame graph
+	double time = 0.0;
+	glm::mat4* commands = NULL;
+	FrameGraph graph;
+	int animation = graph.AddStage("Animation", [&](JobSystem& jobs)
+	{
+		crowd.Evaluate(time, viewProjection, jobs);
+	});
+	graph.AddStage("Command build", [&](JobSystem& jobs)
+	{
+		int limbs = crowd.LimbCount();
+		commands = arena.Allocate<glm::mat4>(crowd.mvp.size());
+		jobs.ParallelFor(crowd.size(), 0, [&](int begin, int end, int)
+		{
+			std::copy(crowd.mvp.begin() + begin * limbs, crowd.mvp.begin() + end * limbs, commands + begin * limbs);
+		});
+	}, { animation });
+	clean &= CheckAllocations("Frame graph", frames, [&](int frame)
+	{
+		time = frame / options.rate;
+		arena.Reset();
+		graph.Run(jobs);
+	});
+	printf("Frame arena: %zu bytes, high water %zu, %lld overflows while warming up\n", arena.Capacity(), arena.HighWater(), arena.Overflows());
+
+	if (!clean)
+	{
+		printf("Steady frames allocated\n");
+		return 2;
+	}
+	return 0;
+}
+
+// Writes the robot and a crowd as a text scene, or compiles a text scene and
+// times loading it both ways
+static int RunScene(const Options& options)
+{
+	if (options.exportScene)
+	{
+		Skeleton robot;
+		ConstructRobot(robot);
+		Scene scene;
+		scene.SetRig(robot);
+		PopulateScene(scene, options.crowd, options.animated);
+		if (!scene.SaveText(options.exportScene))
+			return 1;
+		printf("Wrote %d joints and %d instances to %s\n", scene.JointCount(), scene.InstanceCount(), options.exportScene);
+		if (!options.convertFrom)
+			return 0;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	Scene text;
+	if (!text.Load(options.convertFrom))
+		return 1;
+	double textSeconds = Seconds(start);
+	if (!text.SaveBinary(options.convertTo))
+		return 1;
+
+	// Loading includes building the rig and the crowd, the work a run starts with
+	Skeleton robot;
+	start = std::chrono::high_resolution_clock::now();
+	Scene binary;
+	if (!binary.Load(options.convertTo))
+		return 1;
+	binary.BuildSkeleton(robot);
+	Crowd crowd(robot);
+	binary.BuildCrowd(crowd);
+	double binarySeconds = Seconds(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	text.BuildSkeleton(robot);
+	Crowd textCrowd(robot);
+	text.BuildCrowd(textCrowd);
+	textSeconds += Seconds(start);
+
+	bool same = crowd.size() == textCrowd.size();
+	for (int n = 0; same && n < crowd.size(); n++)
+		same = crowd.instances[n].root == textCrowd.instances[n].root && crowd.instances[n].phase == textCrowd.instances[n].phase;
+	printf("%s: %d joints, %d instances\n", options.convertTo, binary.JointCount(), binary.InstanceCount());
+	printf("Load and build: text %.3f ms, binary %.3f ms (%.1fx faster)\n", textSeconds * 1e3, binarySeconds * 1e3, textSeconds / binarySeconds);
+	if (!same)
+	{
+		printf("The binary scene does not match the text scene\n");
+		return 2;
+	}
+	return 0;
+}
+
+// Runs the mode the options select
+static int Run(const Options& options)
+{
+	if (options.replay)
+		return RunReplay(options);
+	if (options.exportClip || options.exportClips || options.verifyClip)
+		return RunClip(options);
+	if (options.blendBench)
+		return RunBlendBench(options);
+	if (options.rasterBench)
+		return RunRasterBench(options);
+	if (options.cullBench)
+		return RunCullBench(options);
+	if (options.pipelineBench)
+		return RunPipelineBench(options);
+	if (options.allocCheck)
+		return RunAllocCheck(options);
+	if (options.verifyInstances)
+		return RunVerifyInstances(options);
+	if (options.jobBench)
+		return RunJobBench(options);
+	if (options.skinBench || options.exportMesh)
+		return RunSkinBench(options);
+	if (options.render || options.compare)
+		return RunRender(options);
+	if (options.exportScene || options.convertFrom)
+		return RunScene(options);
+	if (options.crowd > 0 || options.scene)
+		return RunThroughput(options);
+	return RunSingle(options);
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+			options.frames = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--rate") && i + 1 < argc)
+			options.rate = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--dump"))
+			options.dump = true;
+		else if (!strcmp(argv[i], "--crowd") && i + 1 < argc)
+			options.crowd = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+			options.threads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--animated") && i + 1 < argc)
+			options.animated = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--render") && i + 1 < argc)
+			options.render = argv[++i];
+		else if (!strcmp(argv[i], "--compare") && i + 1 < argc)
+			options.compare = argv[++i];
+		else if (!strcmp(argv[i], "--tolerance") && i + 1 < argc)
+			options.tolerance = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--size") && i + 2 < argc)
+		{
+			options.width = atoi(argv[++i]);
+			options.height = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--time") && i + 1 < argc)
+			options.time = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--lod") && i + 2 < argc)
+		{
+			options.lod.enabled = true;
+			options.lod.reducedBelow = (float)atof(argv[++i]);
+			options.lod.proxyBelow = (float)atof(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--lod-intervals") && i + 2 < argc)
+		{
+			options.lod.reducedInterval = atoi(argv[++i]);
+			options.lod.proxyInterval = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--raster-bench"))
+			options.rasterBench = true;
+		else if (!strcmp(argv[i], "--export-clip") && i + 1 < argc)
+			options.exportClip = argv[++i];
+		else if (!strcmp(argv[i], "--verify-clip") && i + 1 < argc)
+			options.verifyClip = argv[++i];
+		else if (!strcmp(argv[i], "--clip-cycles") && i + 1 < argc)
+			options.clipCycles = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--export-clips") && i + 1 < argc)
+			options.exportClips = argv[++i];
+		else if (!strcmp(argv[i], "--blend-bench") && i + 1 < argc)
+			options.blendBench = argv[++i];
+		else if (!strcmp(argv[i], "--replay") && i + 1 < argc)
+			options.replay = argv[++i];
+		else if (!strcmp(argv[i], "--paced"))
+			options.paced = true;
+		else if (!strcmp(argv[i], "--skin-bench"))
+			options.skinBench = true;
+		else if (!strcmp(argv[i], "--mesh") && i + 1 < argc)
+			options.mesh = argv[++i];
+		else if (!strcmp(argv[i], "--export-mesh") && i + 1 < argc)
+			options.exportMesh = argv[++i];
+		else if (!strcmp(argv[i], "--scene") && i + 1 < argc)
+			options.scene = argv[++i];
+		else if (!strcmp(argv[i], "--export-scene") && i + 1 < argc)
+			options.exportScene = argv[++i];
+		else if (!strcmp(argv[i], "--convert-scene") && i + 2 < argc)
+		{
+			options.convertFrom = argv[++i];
+			options.convertTo = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--jobs"))
+			options.jobs = true;
+		else if (!strcmp(argv[i], "--job-bench"))
+			options.jobBench = true;
+		else if (!strcmp(argv[i], "--alloc-check"))
+			options.allocCheck = true;
+		else if (!strcmp(argv[i], "--verify-instances"))
+			options.verifyInstances = true;
+		else if (!strcmp(argv[i], "--pipeline-bench"))
+			options.pipelineBench = true;
+		else if (!strcmp(argv[i], "--cull-bench"))
+			options.cullBench = true;
+		else if (!strcmp(argv[i], "--profile") && i + 1 < argc)
+			options.profile = argv[++i];
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (!options.profile)
+		return Run(options);
+
+	Profiler::SetEnabled(true);
+	int result = Run(options);
+	Profiler::SetEnabled(false);
+
+	std::string trace = std::string(options.profile) + ".json";
+	std::string percentiles = std::string(options.profile) + ".csv";
+	if (!Profiler::WriteChromeTrace(trace.c_str()) || !Profiler::WritePercentiles(percentiles.c_str()))
+	{
+		std::cerr << "Unable to write the profile " << options.profile << std::endl;
+		return 1;
+	}
+
+	std::vector<ProfileSummary> summaries;
+	Profiler::Summarize(summaries);
+	printf("%-18s %8s %10s %10s %10s\n", "stage", "frames", "p50 ms", "p95 ms", "p99 ms");
+	for (size_t i = 0; i < summaries.size(); i++)
+		printf("%-18s %8d %10.4f %10.4f %10.4f\n", summaries[i].name.c_str(), summaries[i].frames, summaries[i].p50, summaries[i].p95, summaries[i].p99);
+	return result;
+}
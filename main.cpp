@@ -1,4 +1,4 @@
-// RobotElements class and constructors and animation functions written by Parker Drake
+// Windowed client for the robot animation written by Parker Drake
 #define GLEW_STATIC
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -8,150 +8,215 @@
 #include <iostream>
 #include <math.h>
 #include <algorithm>
+#include <memory>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
 #include "MatrixStack.h"
 #include "Program.h"
+#include "Skeleton.h"
+#include "Robot.h"
+#include "PoseEvaluator.h"
+#include "SimulationClock.h"
+#include "FramePacer.h"
+#include "Quaternion.h"
+#include "AnimationGraph.h"
+#include "CubeMesh.h"
+#include "GLCubeRenderer.h"
+#include "GLSkinnedRenderer.h"
+#include "GLMesh.h"
+#include "VertexFormat.h"
+#include "SkinnedMesh.h"
+#include "WorkerPool.h"
+#include "Culling.h"
+#include "GpuTimer.h"
+#include "Profiler.h"
+#include "Controls.h"
+#include "InputRecording.h"
+#include "ShaderCache.h"
+#include "Scene.h"
+#include "SimulationThread.h"
+#include "Memory.h"
 
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 800
 
-char* vertShaderPath = "../shaders/shader.vert";
-char* fragShaderPath = "../shaders/shader.frag";
+// The build points SHADER_DIRECTORY at the source tree; --shaders DIR overrides it
+#ifdef SHADER_DIRECTORY
+const char* shaderDirectory = SHADER_DIRECTORY;
+#else
+const char* shaderDirectory = "../shaders";
+#endif
+// Likewise ANIMATION_GRAPH_PATH, which --graph FILE overrides
+#ifdef ANIMATION_GRAPH_PATH
+const char* animationGraphPath = ANIMATION_GRAPH_PATH;
+#else
+const char* animationGraphPath = "../graphs/robot.graph";
+#endif
+const char* shaderCacheDirectory = "shader_cache";
+const char* vertShaderFile = "shader.vert";
+const char* fragShaderFile = "shader.frag";
+const char* instancedVertShaderFile = "instanced.vert";
+const char* instancedFragShaderFile = "instanced.frag";
+const char* skinnedVertShaderFile = "skinned.vert";
+const char* skinnedCpuVertShaderFile = "skinned_cpu.vert";
+const char* profileTracePath = "profile.json";
+const char* profilePercentilesPath = "profile.csv";
 
 GLFWwindow* window;
-glm::vec3 eye(0.0f, 0.0f, 20.0f);
-glm::vec3 center(0.0f, 0.0f, 0.0f);
-glm::vec3 up(0.0f, 1.0f, 0.0f);
-
-// Index for tree branches
-int index = 0;
-
-// Angles for camera rotation
-float theta = 3.14 / 2;
-float phi = 3.14 / 2;
-
-// Mouse position trackers
-float lastx, lasty;
-
-// Animate flag
-bool animate = false;
 
+// Camera, limb selection and animation toggles, driven by the callbacks below
+Controls controls;
+
+// Captures the session for Realtime_Animation_Headless --replay when started with --record FILE
+InputRecorder recorder;
+const char* recordPath = NULL;
+// Rig to animate instead of the built-in robot (--scene FILE)
+const char* scenePath = NULL;
+
+// Clip states and layers; the procedural running cycle is used when the graph cannot be loaded
+AnimationGraph animationGraph;
+
+// Simulation runs in fixed steps; frames are paced by vsync, or by sleeping when it is off
+SimulationClock simulationClock(1.0 / 120.0);
+FramePacer framePacer(60.0);
+bool vsync = true;
+
+// With --sim-thread the steps run on their own thread, which takes the input
+// events and hands back finished states; otherwise they run between input and render
+bool threadedSimulation = false;
+SimulationThread simulationThread;
+
+// Time from an input event to the swap that first shows it, and the age of the
+// drawn state at the swap, in both modes; reported at exit
+LatencyStats inputLatency;
+LatencyStats poseAge;
+long long inputSerial = 0; // Events handled on this thread
+double inputTime = 0.0; // When the newest of them arrived
+
+// Every program, restored from linked binaries when the shaders are unchanged and relinked when they are edited
+ShaderCache shaderCache;
 Program program;
 MatrixStack modelViewProjectionMatrix;
 
-// Draw cube on screen
-void DrawCube(glm::mat4& modelViewProjectionMatrix)
+// Cube mesh and the two ways of drawing it: instanced, with per-limb draws as the fallback
+GLMesh cubeMesh;
+std::unique_ptr<PerLimbCubeRenderer> perLimbRenderer;
+InstancedCubeRenderer instancedRenderer;
+CubeRenderer* cubeRenderer;
+bool instancedAvailable = false;
+
+// The robot as one skinned mesh, drawn instead of the cubes when skinning is switched on
+enum DrawMode { DRAW_CUBES, DRAW_CPU_SKINNED, DRAW_GPU_SKINNED };
+DrawMode drawMode = DRAW_CUBES;
+SkinnedMesh robotMesh;
+SkinnedMeshRenderer skinnedRenderer;
+bool skinnedAvailable = false;
+std::vector<glm::mat4> skinPalette;
+WorkerPool skinningPool;
+
+// Robot skeleton
+Skeleton robot;
+
+// Robot state before the last simulation step, and the blend of the two that gets drawn
+Skeleton previousRobot;
+Skeleton renderRobot;
+
+// Turns the robot into per-limb matrices each frame
+PoseEvaluator poseEvaluator;
+PoseBuffer poseBuffer;
+long long jointsRecomputed = 0, jointsReused = 0; // Dirty-flag effectiveness, reported at exit
+
+// Limbs outside the view are not drawn; the counts are reported at exit
+CullStats cullStats;
+
+// Data that only lives until the frame is drawn, reset after each swap
+FrameArena frameArena(64 * 1024);
+
+// Per-stage timings, shown in the window title while profiling and written out when it stops
+GpuTimer gpuTimer;
+const int PROFILE_TITLE_FRAMES = 60;
+
+// Writes the recorded frames as a Chrome trace and a table of per-stage percentiles
+void WriteProfile()
 {
-	program.SendUniformData(modelViewProjectionMatrix, "mvp");
-	glDrawArrays(GL_TRIANGLES, 0, 36);
+	if (Profiler::WriteChromeTrace(profileTracePath) && Profiler::WritePercentiles(profilePercentilesPath))
+		std::cout << "Profile written to " << profileTracePath << " and " << profilePercentilesPath << std::endl;
+	else
+		std::cerr << "Unable to write the profile" << std::endl;
 }
 
-class RobotElements
+// Shows the median and 95th percentile of each stage over the last frames
+void ShowProfile()
 {
-private:
-
-public:
-	RobotElements* parent = NULL; // Pointer to limb's parent
-	std::vector<RobotElements*> children; // Pointer to limb's children
-	glm::vec3 transRelParent = glm::vec3(0, 0, 0); // Current translation from parent limb
-	glm::vec3 rotRelJoint = glm::vec3(0, 0, 0); // Current rotation relative to parent joint {X, Y, Z}
-	glm::vec3 transRelJoint = glm::vec3(0, 0, 0); // Current translation relative to parent joint
-	glm::vec3 scaleFactor = glm::vec3(0, 0, 0); // Current scale of limb
+	static const char* stages[] = { "Frame", "Input", "Simulation", "Render", "GPU draw" };
+	std::vector<ProfileSummary> summaries;
+	Profiler::Summarize(summaries, PROFILE_TITLE_FRAMES);
 
-	RobotElements(RobotElements* p, glm::vec3 trp, glm::vec3 rrj, glm::vec3 trj, glm::vec3 sf)
+	std::ostringstream title;
+	title << "Realtime Animation" << std::fixed << std::setprecision(2);
+	for (size_t i = 0; i < sizeof(stages) / sizeof(stages[0]); i++)
 	{
-		parent = p;
-		transRelParent = trp;
-		rotRelJoint = rrj;
-		transRelJoint = trj;
-		scaleFactor = sf;
+		for (size_t j = 0; j < summaries.size(); j++)
+		{
+			if (summaries[j].name == stages[i])
+				title << " | " << stages[i] << " " << summaries[j].p50 << "/" << summaries[j].p95 << " ms";
+		}
 	}
-	~RobotElements() {}
-
+	glfwSetWindowTitle(window, title.str().c_str());
+}
 
-	void DrawLimb() // Recursively draw each component by calling DrawLimb to draw children
+void DrawRobot(const glm::mat4& viewProjection)
+{
 	{
-		modelViewProjectionMatrix.pushMatrix(); // Copy the parent (top) matrix
-
-		// Perform transformations based on stored, current transform
-		modelViewProjectionMatrix.translate(transRelJoint); // Translate away from joint
-
-		modelViewProjectionMatrix.translate(transRelParent); // Translate away from parent
-
-
-		modelViewProjectionMatrix.rotateX(rotRelJoint[0]); // Rotate on the x-axis
-		modelViewProjectionMatrix.rotateY(rotRelJoint[1]); // Rotate on the y-axis
-		modelViewProjectionMatrix.rotateZ(rotRelJoint[2]); // Rotate on the z-axis
-
-		modelViewProjectionMatrix.translate(glm::vec3(transRelJoint[0] * -1, transRelJoint[1] * -1, transRelJoint[2] * -1)); // Translate towards joint
-
-		modelViewProjectionMatrix.pushMatrix(); // Push before scaling to scale locally, draw before popping
-		modelViewProjectionMatrix.scale(scaleFactor); // Scale by scaleFactor
-
-		DrawCube(modelViewProjectionMatrix.topMatrix()); // Draw the current limb
-
-		modelViewProjectionMatrix.popMatrix();
-
-
-
-		for (int i = 0; i < children.size(); i++) // Call DrawLimb() on each child recursively
+		PROFILE_SCOPE("Pose evaluation");
+		poseEvaluator.Evaluate(renderRobot, viewProjection, poseBuffer);
+	}
+	jointsRecomputed += renderRobot.Recomputed();
+	jointsReused += renderRobot.Reused();
+
+	// Skip the robot when its box is out of view, otherwise the limbs that are
+	Frustum frustum(viewProjection);
+	Bounds robotBounds;
+	glm::mat4* visibleMvp = frameArena.Allocate<glm::mat4>(renderRobot.size());
+	int visibleCount = 0;
+	{
+		PROFILE_SCOPE("Culling");
+		for (int i = 0; i < renderRobot.size(); i++)
+			robotBounds.Grow(LimbBounds(poseBuffer.world[i], renderRobot.scaleFactor[i]));
+		cullStats.instancesTested++;
+		if (frustum.Classify(robotBounds) == CULL_OUTSIDE)
 		{
-			children[i]->DrawLimb();
+			cullStats.instancesCulled++;
+			return;
+		}
+		for (int i = 0; drawMode == DRAW_CUBES && i < renderRobot.size(); i++)
+		{
+			cullStats.limbsTested++;
+			if (frustum.Classify(LimbBounds(poseBuffer.world[i], renderRobot.scaleFactor[i])) != CULL_OUTSIDE)
+				visibleMvp[visibleCount++] = poseBuffer.mvp[i];
+			else
+				cullStats.limbsCulled++;
 		}
-
-
-		modelViewProjectionMatrix.popMatrix(); // Pop current limb from the stack - done with this limb
 	}
 
-};
-
-// Pointers to torso and current selected limb
-RobotElements* torsoPtr;
-RobotElements* limbPtr;
-
-void ConstructRobot()
-{
-	RobotElements* torso = new RobotElements(NULL, glm::vec3(0, 0, 0), glm::vec3(0, 0, 0), glm::vec3(0, 0, 0), glm::vec3(1.1, 2.2, 0.88));
-	RobotElements* head = new RobotElements(torso, glm::vec3(0, 2.5, 0), glm::vec3(0, 0, 0), glm::vec3(0, 0, 0), glm::vec3(.5, 0.5, 0.5));
-
-	RobotElements* upperLeftArm = new RobotElements(torso, glm::vec3(2, 1.5, 0), glm::vec3(0, 0, 0), glm::vec3(-1.5, 0, 0), glm::vec3(1, 0.4, 0.4));
-	RobotElements* lowerLeftArm = new RobotElements(upperLeftArm, glm::vec3(2, 0, 0), glm::vec3(0, 0, 0), glm::vec3(-1.5, 0, 0), glm::vec3(1, 0.3, 0.3));
-
-	RobotElements* upperRightArm = new RobotElements(torso, glm::vec3(-2, 1.5, 0), glm::vec3(0, 0, 0), glm::vec3(1.5, 0, 0), glm::vec3(1, 0.4, 0.4));
-	RobotElements* lowerRightArm = new RobotElements(upperRightArm, glm::vec3(-2, 0, 0), glm::vec3(0, 0, 0), glm::vec3(1.5, 0, 0), glm::vec3(1, 0.3, 0.3));
-
-	RobotElements* upperLeftLeg = new RobotElements(torso, glm::vec3(0.5, -4, 0), glm::vec3(0, 0, 0), glm::vec3(0, 2.5, 0), glm::vec3(0.45, 2, 0.5));
-	RobotElements* lowerLeftLeg = new RobotElements(upperLeftLeg, glm::vec3(0, -4, 0), glm::vec3(0, 0, 0), glm::vec3(0, 2.5, 0), glm::vec3(0.35, 2, 0.4));
-
-	RobotElements* upperRightLeg = new RobotElements(torso, glm::vec3(-0.5, -4, 0), glm::vec3(0, 0, 0), glm::vec3(0, 2.5, 0), glm::vec3(0.45, 2, 0.5));
-	RobotElements* lowerRightLeg = new RobotElements(upperRightLeg, glm::vec3(0, -4, 0), glm::vec3(0, 0, 0), glm::vec3(0, 2.5, 0), glm::vec3(0.35, 2, .4));
-
-	// Push all limbs to their respective children vectors
-	torso->children.push_back(head);
-
-	torso->children.push_back(upperLeftArm);
-	upperLeftArm->children.push_back(lowerLeftArm);
-
-	torso->children.push_back(upperRightArm);
-	upperRightArm->children.push_back(lowerRightArm);
-
-	torso->children.push_back(upperLeftLeg);
-	upperLeftLeg->children.push_back(lowerLeftLeg);
-
-	torso->children.push_back(upperRightLeg);
-	upperRightLeg->children.push_back(lowerRightLeg);
-
-	// Set pointers to the torso
-	torsoPtr = torso;
-	limbPtr = torso;
+	// Draw the visible limbs, or the mesh bound to them
+	gpuTimer.Begin("GPU draw");
+	if (drawMode == DRAW_CUBES)
+		cubeRenderer->Draw(visibleMvp, visibleCount);
+	else
+	{
+		Skinning::ComputePalette(renderRobot, robotMesh, &skinPalette[0]);
+		SkinnedMeshRenderer::Mode mode = drawMode == DRAW_CPU_SKINNED ? SkinnedMeshRenderer::CPU_SKINNING : SkinnedMeshRenderer::GPU_SKINNING;
+		skinnedRenderer.Draw(mode, &skinPalette[0], viewProjection, skinningPool);
+	}
+	gpuTimer.End();
 }
 
-
-void Display()
+void Display(const glm::vec3& eye, const glm::vec3& center, const glm::vec3& up)
 {
-	program.Bind();
-
 	modelViewProjectionMatrix.loadIdentity();
-	modelViewProjectionMatrix.pushMatrix();
+	MatrixScope scope(modelViewProjectionMatrix);
 
 	// Setting the view and Projection matrices
 	int width, height;
@@ -164,258 +229,107 @@ void Display()
 	modelViewProjectionMatrix.LookAt(eye, center, up);
 
 	// Drawing the robot
-	torsoPtr->DrawLimb();
-	modelViewProjectionMatrix.popMatrix();
-
-	program.Unbind();
-
+	DrawRobot(modelViewProjectionMatrix.topMatrix());
 }
 
-void runningAnimation()
+// Keys that only affect this window, not the animation
+void WindowKey(unsigned key)
 {
-	torsoPtr->rotRelJoint = glm::vec3(0.8, 0, 0); // Torso position
-	torsoPtr->children[0]->rotRelJoint = glm::vec3(-0.5, 0, 0); // Head position
-	torsoPtr->children[1]->rotRelJoint = glm::vec3(0.0, 1, 0); // Left upper arm position
-	torsoPtr->children[1]->children[0]->rotRelJoint = glm::vec3(0.0, 0, 0); // Left lower arm position
-	torsoPtr->children[2]->rotRelJoint = glm::vec3(0.0, -1, 0); // Right upper arm position
-	torsoPtr->children[2]->children[0]->rotRelJoint = glm::vec3(0.0, 0, 0); // Right lower arm position
-	torsoPtr->children[3]->rotRelJoint = glm::vec3(-2, 0, 0); // Left upper leg position
-	torsoPtr->children[3]->children[0]->rotRelJoint = glm::vec3(2, 0, 0); // Left lower leg position
-	torsoPtr->children[4]->rotRelJoint = glm::vec3(0.0, 0, 0); // Right upper leg position
-	torsoPtr->children[4]->children[0]->rotRelJoint = glm::vec3(0.0, 0, 0); // Right lower leg position
-
-	while (animate)
+	switch (key)
 	{
-		double  time = glfwGetTime();
-		double frequency = 6;
-
-		torsoPtr->transRelParent = glm::vec3(0, 0.75 * sin(2 * frequency * time - 3.14 / 10), 0); // Torso bounce
-		torsoPtr->rotRelJoint = glm::vec3(0.8, 0.1 * sin(frequency * time), 0); // Torso twist
-
-		torsoPtr->children[1]->rotRelJoint = glm::vec3(0, 1, 0.2 * sin(frequency * time) - 0.5);
-		torsoPtr->children[2]->rotRelJoint = glm::vec3(0, -1, 0.2 * sin(frequency * time) + 0.5);
-
-
-		torsoPtr->children[3]->rotRelJoint = glm::vec3(sin(frequency * time) - 1, 0, 0);
-		torsoPtr->children[3]->children[0]->rotRelJoint = glm::vec3((-1 * sin(frequency * time) + 1), 0, 0);
+	case 'i':
+		// Switch between one instanced draw and one draw per limb
+		if (cubeRenderer == perLimbRenderer.get() && instancedAvailable)
+			cubeRenderer = &instancedRenderer;
+		else
+			cubeRenderer = perLimbRenderer.get();
+		std::cout << "Drawing limbs " << cubeRenderer->Name() << std::endl;
+		break;
+	case 'k':
+		// Cycle through the cubes, the mesh skinned on the CPU and the mesh skinned on the GPU
+		if (!skinnedAvailable)
+			break;
+		drawMode = DrawMode((drawMode + 1) % 3);
+		if (drawMode == DRAW_CUBES)
+			std::cout << "Drawing limbs as cubes" << std::endl;
+		else
+			std::cout << "Drawing the " << SkinnedMeshRenderer::ModeName(drawMode == DRAW_CPU_SKINNED ? SkinnedMeshRenderer::CPU_SKINNING : SkinnedMeshRenderer::GPU_SKINNING) << " mesh" << std::endl;
+		break;
+	case 'p':
+		// Start profiling, or stop and write out what was recorded
+		if (!Profiler::Enabled())
+		{
+			Profiler::Clear();
+			Profiler::SetEnabled(true);
+		}
+		else
+		{
+			Profiler::SetEnabled(false);
+			WriteProfile();
+			glfwSetWindowTitle(window, "Realtime Animation");
+		}
+		break;
+	}
+}
 
-		torsoPtr->children[4]->rotRelJoint = glm::vec3((-1 * sin(frequency * time) - 1), 0, 0);
-		torsoPtr->children[4]->children[0]->rotRelJoint = glm::vec3((sin(frequency * time) + 1), 0, 0);
+// Queues the event for the simulation thread when it runs, otherwise hands it
+// to the controls straight away; keys they leave go to WindowKey()
+void SendInput(const InputEvent& event)
+{
+	double time = glfwGetTime();
+	if (simulationThread.IsRunning())
+	{
+		if (!simulationThread.Post(event, time))
+			std::cerr << "Input queue full, event dropped" << std::endl;
+		return;
+	}
 
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		Display();
-		glFlush();
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+	recorder.Record(event);
+	inputSerial++;
+	inputTime = time;
+	if (controls.Handle(event))
+	{
+		if (event.type == InputEvent::CHARACTER && event.key == 'n' && animationGraph.IsLoaded())
+			std::cout << "Animation state " << animationGraph.StateName(animationGraph.CurrentState()) << std::endl;
 	}
+	else if (event.type == InputEvent::CHARACTER)
+		WindowKey(event.key);
 }
 
-
 // Mouse callback function
 void MouseCallback(GLFWwindow* lWindow, int button, int action, int mods)
 {
 	if (button == GLFW_MOUSE_BUTTON_LEFT && GLFW_PRESS == action)
 		std::cout << "Mouse left button is pressed." << std::endl;
+	SendInput(InputEvent::Button(button, action == GLFW_PRESS));
 }
 
 void ScrollCallback(GLFWwindow* lWindow, double xoffset, double yoffset)
 {
-	glm::vec3 b = eye - center;
-	if (yoffset == 1)
-	{
-		b /= 1.1;
-	}
-	if (yoffset == -1)
-	{
-		b *= 1.1;
-	}
-	eye = b + center;
+	SendInput(InputEvent::Scroll(yoffset));
 }
 
 // Mouse position callback function
 void CursorPositionCallback(GLFWwindow* lWindow, double xpos, double ypos)
 {
-	int state = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT);
-	int state2 = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT);
-	if (state == GLFW_PRESS)
-	{
-		theta = -0.02 * (xpos - lastx);
-		phi = -0.02 * (ypos - lasty);
-
-		glm::vec3 b = (eye - center);
-		glm::vec4 b4(b[0], b[1], b[2], 1);
-		glm::vec4 up4(up[0], up[1], up[2], 1);
-
-		glm::vec3 right = glm::normalize(glm::cross(up, b));
-				
-		glm::mat4 thetaMat = glm::rotate(glm::mat4(1.0f), theta, up);
-		glm::mat4 phiMat = glm::rotate(glm::mat4(1.0f), phi, right);
-
-		b4 = phiMat * thetaMat * b4;
-		up4 = phiMat * thetaMat * up4;
-
-		b = glm::vec3(b4[0], b4[1], b4[2]);
-		up = glm::vec3(up4[0], up4[1], up4[2]);
-
-		eye = center + b;
-	}
-	if (state2 == GLFW_PRESS)
-	{
-		eye[0] += 0.02 * (xpos - lastx);
-		center[0] += 0.02 * (xpos - lastx);
-
-		eye[1] -= 0.02 * (ypos - lasty);
-		center[1] -= 0.02 * (ypos - lasty);
-	}	
-
-	lastx = xpos;
-	lasty = ypos;
+	SendInput(InputEvent::Cursor(xpos, ypos));
 }
 
-
 // Keyboard character callback function
 void CharacterCallback(GLFWwindow* lWindow, unsigned int key)
 {
-	switch (key)
-	{
-	case ',':
-		// Next Limb
-		limbPtr->scaleFactor /= 1.1;
-		if (limbPtr != torsoPtr)
-		{
-			if (limbPtr->parent != torsoPtr)
-			{
-				limbPtr = limbPtr->parent;
-			}
-			else if (limbPtr->parent == torsoPtr)
-			{
-				if (index == 0)
-				{
-					limbPtr = torsoPtr;
-				}
-				else
-				{
-					index--;
-					limbPtr = torsoPtr->children[index];
-					if (limbPtr->children.size() > 0)
-					{
-						limbPtr = limbPtr->children.back();
-					}
-				}
-			}
-		}		
-		limbPtr->scaleFactor *= 1.1;
-		break;
-	case '.':
-		// Previous limb
-		limbPtr->scaleFactor /= 1.1;
-		if (limbPtr == torsoPtr)
-		{
-			limbPtr = limbPtr->children[index];
-		}
-		else if (limbPtr->children.size() > 0)
-		{
-			limbPtr = limbPtr->children[0];
-		}
-		else if (limbPtr->children.size() == 0)
-		{
-			if (index < torsoPtr->children.size() - 1)
-			{
-				index++;
-				limbPtr = torsoPtr->children[index];
-			}			
-		}
-		limbPtr->scaleFactor *= 1.1;
-		break;
-	case 'x':
-		limbPtr->rotRelJoint -= glm::vec3(0.1, 0, 0);
-		break;
-	case 'X':
-		limbPtr->rotRelJoint += glm::vec3(0.1, 0, 0);
-		break;
-	case 'y':
-		limbPtr->rotRelJoint -= glm::vec3(0, 0.1, 0);
-		break;
-	case 'Y':
-		limbPtr->rotRelJoint += glm::vec3(0, 0.1, 0);
-		break;
-	case 'z':
-		limbPtr->rotRelJoint -= glm::vec3(0, 0, 0.1);
-		break;
-	case 'Z':
-		limbPtr->rotRelJoint += glm::vec3(0, 0, 0.1);
-		break;
-	case '~':
-		if (!animate)
-		{
-			animate = true;
-			runningAnimation();
-		}
-		else
-			animate = false;
-		break;
-	}
+	SendInput(InputEvent::Character(key));
 }
 
-void CreateCube()
+bool CreateCube()
 {
-	// x, y, z, r, g, b, ...
-	float cubeVerts[] = {
-		// Face x-
-		-1.0f,	+1.0f,	+1.0f,	0.8f,	0.2f,	0.2f,
-		-1.0f,	+1.0f,	-1.0f,	0.8f,	0.2f,	0.2f,
-		-1.0f,	-1.0f,	+1.0f,	0.8f,	0.2f,	0.2f,
-		-1.0f,	-1.0f,	+1.0f,	0.8f,	0.2f,	0.2f,
-		-1.0f,	+1.0f,	-1.0f,	0.8f,	0.2f,	0.2f,
-		-1.0f,	-1.0f,	-1.0f,	0.8f,	0.2f,	0.2f,
-		// Face x+
-		+1.0f,	+1.0f,	+1.0f,	0.8f,	0.2f,	0.2f,
-		+1.0f,	-1.0f,	+1.0f,	0.8f,	0.2f,	0.2f,
-		+1.0f,	+1.0f,	-1.0f,	0.8f,	0.2f,	0.2f,
-		+1.0f,	+1.0f,	-1.0f,	0.8f,	0.2f,	0.2f,
-		+1.0f,	-1.0f,	+1.0f,	0.8f,	0.2f,	0.2f,
-		+1.0f,	-1.0f,	-1.0f,	0.8f,	0.2f,	0.2f,
-		// Face y-
-		+1.0f,	-1.0f,	+1.0f,	0.2f,	0.8f,	0.2f,
-		-1.0f,	-1.0f,	+1.0f,	0.2f,	0.8f,	0.2f,
-		+1.0f,	-1.0f,	-1.0f,	0.2f,	0.8f,	0.2f,
-		+1.0f,	-1.0f,	-1.0f,	0.2f,	0.8f,	0.2f,
-		-1.0f,	-1.0f,	+1.0f,	0.2f,	0.8f,	0.2f,
-		-1.0f,	-1.0f,	-1.0f,	0.2f,	0.8f,	0.2f,
-		// Face y+
-		+1.0f,	+1.0f,	+1.0f,	0.2f,	0.8f,	0.2f,
-		+1.0f,	+1.0f,	-1.0f,	0.2f,	0.8f,	0.2f,
-		-1.0f,	+1.0f,	+1.0f,	0.2f,	0.8f,	0.2f,
-		-1.0f,	+1.0f,	+1.0f,	0.2f,	0.8f,	0.2f,
-		+1.0f,	+1.0f,	-1.0f,	0.2f,	0.8f,	0.2f,
-		-1.0f,	+1.0f,	-1.0f,	0.2f,	0.8f,	0.2f,
-		// Face z-
-		+1.0f,	+1.0f,	-1.0f,	0.2f,	0.2f,	0.8f,
-		+1.0f,	-1.0f,	-1.0f,	0.2f,	0.2f,	0.8f,
-		-1.0f,	+1.0f,	-1.0f,	0.2f,	0.2f,	0.8f,
-		-1.0f,	+1.0f,	-1.0f,	0.2f,	0.2f,	0.8f,
-		+1.0f,	-1.0f,	-1.0f,	0.2f,	0.2f,	0.8f,
-		-1.0f,	-1.0f,	-1.0f,	0.2f,	0.2f,	0.8f,
-		// Face z+
-		+1.0f,	+1.0f,	+1.0f,	0.2f,	0.2f,	0.8f,
-		-1.0f,	+1.0f,	+1.0f,	0.2f,	0.2f,	0.8f,
-		+1.0f,	-1.0f,	+1.0f,	0.2f,	0.2f,	0.8f,
-		+1.0f,	-1.0f,	+1.0f,	0.2f,	0.2f,	0.8f,
-		-1.0f,	+1.0f,	+1.0f,	0.2f,	0.2f,	0.8f,
-		-1.0f,	-1.0f,	+1.0f,	0.2f,	0.2f,	0.8f
-	};
-
-	GLuint vertBufferID;
-	glGenBuffers(1, &vertBufferID);
-	glBindBuffer(GL_ARRAY_BUFFER, vertBufferID);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVerts), cubeVerts, GL_STATIC_DRAW);
-	GLint posID = glGetAttribLocation(program.GetPID(), "position");
-	glEnableVertexAttribArray(posID);
-	glVertexAttribPointer(posID, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), 0);
-	GLint colID = glGetAttribLocation(program.GetPID(), "color");
-	glEnableVertexAttribArray(colID);
-	glVertexAttribPointer(colID, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-
+	PackedMesh cube;
+	BuildCubeMesh(cube);
+	if (!cubeMesh.Init(cube, program))
+		return false;
+	std::cout << "Cube mesh: " << cube.VertexCount() << " vertices of " << cube.layout.stride << " bytes, " << cubeMesh.Bytes();
+	std::cout << " bytes (" << sizeof(cubeVertices) << " as float triangles)" << std::endl;
+	return true;
 }
 
 void FrameBufferSizeCallback(GLFWwindow* lWindow, int width, int height)
@@ -423,7 +337,7 @@ void FrameBufferSizeCallback(GLFWwindow* lWindow, int width, int height)
 	glViewport(0, 0, width, height);
 }
 
-void Init()
+bool Init()
 {
 	glfwInit();
 	window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Realtime Animation", NULL, NULL);
@@ -438,26 +352,226 @@ void Init()
 	glfwSetFramebufferSizeCallback(window, FrameBufferSizeCallback);
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 	glEnable(GL_DEPTH_TEST);
-	program.SetShadersFileName(vertShaderPath, fragShaderPath);
-	program.Init();
 
-	ConstructRobot();
-	CreateCube();
+	shaderCache.Init(shaderDirectory, shaderCacheDirectory);
+	shaderCache.Add(program, vertShaderFile, fragShaderFile);
+	shaderCache.Add(instancedRenderer.GetProgram(), instancedVertShaderFile, instancedFragShaderFile);
+	shaderCache.Add(skinnedRenderer.GetProgram(SkinnedMeshRenderer::CPU_SKINNING), skinnedCpuVertShaderFile, instancedFragShaderFile);
+	shaderCache.Add(skinnedRenderer.GetProgram(SkinnedMeshRenderer::GPU_SKINNING), skinnedVertShaderFile, instancedFragShaderFile);
+	shaderCache.Build();
+	const ShaderCacheStats& shaderStats = shaderCache.GetStats();
+	std::cout << "Shaders: " << shaderStats.binaryHits << " programs from the cache, " << shaderStats.compiled << " compiled, ";
+	std::cout << shaderStats.failed << " failed in " << shaderStats.buildSeconds * 1000.0 << " ms" << std::endl;
+	if (!program.IsLinked())
+	{
+		std::cerr << "Unable to build the shaders in " << shaderDirectory << std::endl;
+		return false;
+	}
+
+	if (scenePath)
+	{
+		Scene scene;
+		if (!scene.Load(scenePath))
+			return false;
+		scene.BuildSkeleton(robot);
+		if (!MatchesRobot(robot))
+		{
+			std::cerr << scenePath << " does not have the robot's hierarchy, which the running cycle needs" << std::endl;
+			return false;
+		}
+	}
+	else
+		ConstructRobot(robot);
+	BuildRobotMesh(robot, robotMesh);
+	skinPalette.resize(robot.size());
+	if (!animationGraph.Load(animationGraphPath, robot.size()))
+		std::cout << "Animating with the procedural running cycle" << std::endl;
+	controls.Attach(robot, &animationGraph);
+	previousRobot = robot;
+	renderRobot = robot;
+	if (!CreateCube())
+		return false;
+
+	perLimbRenderer.reset(new PerLimbCubeRenderer(program, cubeMesh));
+	instancedAvailable = instancedRenderer.Init(cubeMesh);
+	cubeRenderer = instancedAvailable ? (CubeRenderer*)&instancedRenderer : perLimbRenderer.get();
+	skinnedAvailable = skinnedRenderer.Init(robotMesh);
+	if (skinnedAvailable)
+		std::cout << "Skinned mesh: " << robotMesh.VertexCount() << " vertices, " << skinnedRenderer.Bytes() << " bytes" << std::endl;
+	if (!gpuTimer.Init())
+		std::cout << "No GL timer queries, profiling the CPU only" << std::endl;
+
+	// Let the swap wait for the display instead of rendering as fast as possible
+	glfwSwapInterval(vsync ? 1 : 0);
+	double start = glfwGetTime();
+	simulationClock.Reset(start);
+	if (recordPath && recorder.Open(recordPath, simulationClock, start, animationGraph.IsLoaded() ? animationGraphPath : NULL))
+		std::cout << "Recording the session to " << recordPath << std::endl;
+	if (threadedSimulation)
+	{
+		simulationThread.Start(controls, robot, simulationClock, recorder.IsOpen() ? &recorder : NULL, &animationGraph, glfwGetTime);
+		std::cout << "Simulating on its own thread" << std::endl;
+	}
+	return true;
 }
 
 
-int main()
+int main(int argc, char** argv)
 {
-	Init();
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--record") && i + 1 < argc)
+			recordPath = argv[++i];
+		else if (!strcmp(argv[i], "--shaders") && i + 1 < argc)
+			shaderDirectory = argv[++i];
+		else if (!strcmp(argv[i], "--scene") && i + 1 < argc)
+			scenePath = argv[++i];
+		else if (!strcmp(argv[i], "--graph") && i + 1 < argc)
+			animationGraphPath = argv[++i];
+		else if (!strcmp(argv[i], "--sim-thread"))
+			threadedSimulation = true;
+		else
+		{
+			std::cout << "Usage: Realtime_Animation [--record FILE] [--shaders DIR] [--scene FILE] [--graph FILE] [--sim-thread]" << std::endl;
+			return 1;
+		}
+	}
+
+	if (!Init())
+	{
+		glfwTerminate();
+		return 1;
+	}
+	// Meshes uploaded at startup are not part of the per-frame cost
+	long long startupUploads = GLBuffer::Uploaded();
+	long long shownSerial = 0;
+	int shownState = -1;
+	double loopStart = glfwGetTime();
 	while (glfwWindowShouldClose(window) == 0)
 	{
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		Display();
-		glFlush();
+		framePacer.BeginFrame();
+		Profiler::BeginFrame();
+
+		// Input
+		double stageStart = glfwGetTime();
+		{
+			PROFILE_SCOPE("Input");
+			glfwPollEvents();
+			shaderCache.Poll(stageStart);
+			InputEvent event;
+			while (simulationThread.PollUnhandled(event))
+			{
+				if (event.type == InputEvent::CHARACTER)
+					WindowKey(event.key);
+			}
+		}
+		framePacer.EndStage(FramePacer::STAGE_INPUT, glfwGetTime() - stageStart);
+
+		// Simulation: whole fixed steps, leaving the rest for later frames when over budget
+		stageStart = glfwGetTime();
+		if (!threadedSimulation)
+		{
+			PROFILE_SCOPE("Simulation");
+			int steps = simulationClock.Advance(stageStart);
+			int ran = 0;
+			for (; ran < steps && framePacer.WithinBudget(FramePacer::STAGE_SIMULATION, glfwGetTime() - stageStart); ran++)
+			{
+				previousRobot = robot;
+				controls.Simulate(simulationClock.Tick(), simulationClock.Step());
+			}
+			recorder.EndFrame(stageStart, ran);
+			framePacer.EndStage(FramePacer::STAGE_SIMULATION, glfwGetTime() - stageStart);
+		}
+
+		// Render the state between the last two simulation steps: this thread's,
+		// or the newest the simulation thread finished
+		stageStart = glfwGetTime();
+		long long drawnSerial = inputSerial;
+		double drawnInputTime = inputTime;
+		double stateTime; // When the drawn state was due
+		{
+			PROFILE_SCOPE("Render");
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			if (threadedSimulation)
+			{
+				simulationThread.Acquire();
+				const SimulationFrame& frame = simulationThread.Frame();
+				renderRobot.Interpolate(frame.previous, frame.current, (float)frame.Alpha(stageStart));
+				drawnSerial = frame.inputSerial;
+				drawnInputTime = frame.inputTime;
+				stateTime = frame.stateTime;
+				if (frame.animationState != shownState && frame.animationState >= 0)
+					std::cout << "Animation state " << animationGraph.StateName(frame.animationState) << std::endl;
+				shownState = frame.animationState;
+				Display(frame.eye, frame.center, frame.up);
+			}
+			else
+			{
+				renderRobot.Interpolate(previousRobot, robot, (float)simulationClock.Alpha());
+				stateTime = stageStart - simulationClock.Alpha() * simulationClock.Step();
+				Display(controls.eye, controls.center, controls.up);
+			}
+			glFlush();
+		}
+		framePacer.EndStage(FramePacer::STAGE_RENDER, glfwGetTime() - stageStart);
 		glfwSwapBuffers(window);
-		glfwPollEvents();
+		frameArena.Reset();
+
+		double swapped = glfwGetTime();
+		if (drawnSerial > shownSerial)
+		{
+			inputLatency.Add(swapped - drawnInputTime);
+			shownSerial = drawnSerial;
+		}
+		poseAge.Add(swapped - stateTime);
+
+		// GPU timings arrive a frame or more late
+		gpuTimer.Collect();
+		if (Profiler::Enabled() && Profiler::Frame() % PROFILE_TITLE_FRAMES == 0)
+			ShowProfile();
+
+		// With vsync the swap has already waited for the display
+		if (!vsync)
+			framePacer.WaitForNextFrame();
 	}
 
+	double loopSeconds = glfwGetTime() - loopStart;
+	if (threadedSimulation)
+	{
+		// The robot is this thread's again; what a replay renders last is the
+		// state between the simulation's last two steps at its clock's reading
+		simulationThread.Stop();
+		renderRobot.Interpolate(simulationThread.Previous(), robot, (float)simulationClock.Alpha());
+		renderRobot.UpdateTransforms(glm::mat4(1.0f));
+	}
+
+	if (Profiler::Enabled())
+		WriteProfile();
+	if (recorder.IsOpen())
+	{
+		if (recorder.Close(robot, renderRobot, controls))
+			std::cout << "Recorded " << recorder.Frames() << " frames to " << recordPath << std::endl;
+		else
+			std::cerr << "Unable to write the recording " << recordPath << std::endl;
+	}
+	std::cout << framePacer.Frames() << " frames, over budget: input " << framePacer.Overruns(FramePacer::STAGE_INPUT);
+	std::cout << ", simulation " << framePacer.Overruns(FramePacer::STAGE_SIMULATION);
+	std::cout << ", render " << framePacer.Overruns(FramePacer::STAGE_RENDER);
+	std::cout << " (" << simulationClock.DroppedSteps() << " simulation steps dropped)" << std::endl;
+	std::cout << "Throughput: " << framePacer.Frames() / loopSeconds << " frames/s, " << simulationClock.Time() / simulationClock.Step() / loopSeconds << " steps/s";
+	if (threadedSimulation)
+		std::cout << " on the simulation thread, " << simulationThread.Published() << " states published, " << simulationThread.Dropped() << " events dropped";
+	std::cout << std::endl;
+	std::cout << "Input to swap: " << inputLatency.Mean() * 1e3 << " ms mean, " << inputLatency.Percentile(0.95) * 1e3 << " p95, ";
+	std::cout << inputLatency.Max() * 1e3 << " max over " << inputLatency.Count() << " frames; drawn state age ";
+	std::cout << poseAge.Mean() * 1e3 << " ms mean, " << poseAge.Percentile(0.95) * 1e3 << " p95" << std::endl;
+	std::cout << "Joint transforms: " << jointsRecomputed << " recomputed, " << jointsReused << " reused" << std::endl;
+	std::cout << "Culling: " << cullStats.instancesCulled << " of " << cullStats.instancesTested << " frames out of view, ";
+	std::cout << cullStats.limbsCulled << " of " << cullStats.limbsTested << " limbs culled" << std::endl;
+	std::cout << "Shader reloads: " << shaderCache.GetStats().reloads << std::endl;
+	std::cout << "Buffer uploads: " << (GLBuffer::Uploaded() - startupUploads) / std::max(1LL, framePacer.Frames()) << " bytes per frame" << std::endl;
+	std::cout << "Uniform uploads: " << program.GetUniformStats().issued << " issued, " << program.GetUniformStats().skipped << " skipped" << std::endl;
+
 	glfwTerminate();
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,16 @@
+#version 330 core
+
+// Cube vertex
+in vec3 position;
+in vec3 color;
+
+// One MVP per drawn limb, advanced once per instance
+in mat4 instanceMVP;
+
+out vec3 vertexColor;
+
+void main()
+{
+	gl_Position = instanceMVP * vec4(position, 1.0);
+	vertexColor = color;
+}
@@ -0,0 +1,23 @@
+#version 330 core
+
+// Bind pose vertex and its four heaviest joints, weights summing to 1
+in vec3 position;
+in vec3 color;
+in vec4 boneIndices;
+in vec4 boneWeights;
+
+// world(joint) * inverseBind(joint) for each joint of the skeleton
+uniform mat4 bones[32];
+uniform mat4 viewProjection;
+
+out vec3 vertexColor;
+
+void main()
+{
+	mat4 skin = bones[int(boneIndices.x)] * boneWeights.x
+		+ bones[int(boneIndices.y)] * boneWeights.y
+		+ bones[int(boneIndices.z)] * boneWeights.z
+		+ bones[int(boneIndices.w)] * boneWeights.w;
+	gl_Position = viewProjection * skin * vec4(position, 1.0);
+	vertexColor = color;
+}
@@ -0,0 +1,15 @@
+#version 330 core
+
+// Vertex already skinned on the CPU
+in vec3 position;
+in vec3 color;
+
+uniform mat4 viewProjection;
+
+out vec3 vertexColor;
+
+void main()
+{
+	gl_Position = viewProjection * vec4(position, 1.0);
+	vertexColor = color;
+}